@@ -164,6 +164,12 @@ Event* Event::parse(uint16 type_hint, const std::string& record, const ServerID&
     }
     else if (type_hint == ObjectSegmentationProcessedRequestAnalysisTag) {
         PARSE_PBJ_RECORD(Trace::OSeg::ProcessedRequest);
+    }
+    else if (type_hint == OSegBatchLookupTag) {
+        PARSE_PBJ_RECORD(Trace::OSeg::BatchLookup);
+    }
+    else if (type_hint == OSegLookupLatencyTag) {
+        PARSE_PBJ_RECORD(Trace::OSeg::LookupLatency);
     }
       else {
           SILOG(analysis, error,"\n*****I got an unknown tag in analysis.cpp.  Value:  "<<(uint32)type_hint<<"\n");
@@ -1617,8 +1623,19 @@ LatencyAnalysis::~LatencyAnalysis() {
     //    double avgTime = totalTimes/((double) allRoundTripEvts.size());
     double avgTime = totalTimes/((double) numProcessedAfter);
 
+    // Migration rate over the window from processedAfter to the last
+    // completed migration
+    double migsPerSecond = 0;
+    if (numProcessedAfter > 0)
+    {
+      double windowInSeconds = (allRoundTripEvts.back().time.raw() - processedAfterInMicro) / OSEG_SECOND_TO_RAW_CONVERSION_FACTOR;
+      if (windowInSeconds > 0)
+        migsPerSecond = numProcessedAfter / windowInSeconds;
+    }
+
     fileOut<< "\n\n Avg Migrate Time:    "<<avgTime<<"\n";
-    fileOut<< "Num processed after  " << processedAfter<<" seconds:       "<<numProcessedAfter<<"\n\n";
+    fileOut<< "Num processed after  " << processedAfter<<" seconds:       "<<numProcessedAfter<<"\n";
+    fileOut<< "Migrations per second:  "<<migsPerSecond<<"\n\n";
     fileOut<< "END*******\n\n";
   }
 
@@ -1845,6 +1862,82 @@ bool OSegCacheResponseAnalysis::compareEvts(OSegCacheResponseEvent A, OSegCacheR
 }
 
 
+
+OSegLookupLatencyAnalysis::OSegLookupLatencyAnalysis(const char* opt_name, const uint32 nservers)
+{
+  for(uint32 server_id = 1; server_id <= nservers; server_id++)
+  {
+    String loc_file = GetPerServerFile(opt_name, server_id);
+    std::ifstream is(loc_file.c_str(), std::ios::in);
+
+    while(is)
+    {
+        uint16 type_hint;
+        std::string raw_evt;
+        if (!read_record(is, &type_hint, &raw_evt)) break;
+        Event* evt = Event::parse(type_hint, raw_evt, server_id);
+      if (evt == NULL)
+        break;
+
+      OSegLookupLatencyEvent* oseg_latency_evt = dynamic_cast<OSegLookupLatencyEvent*> (evt);
+
+      if (oseg_latency_evt != NULL)
+      {
+        allLookupLatencyEvts.push_back(*oseg_latency_evt);
+        delete evt;
+        continue;
+      }
+      delete evt;
+    }
+  }
+}
+
+
+OSegLookupLatencyAnalysis::~OSegLookupLatencyAnalysis()
+{
+
+}
+
+
+void OSegLookupLatencyAnalysis::printData(std::ostream &fileOut, int processAfter)
+{
+  double processedAfterInMicro = processAfter * OSEG_SECOND_TO_RAW_CONVERSION_FACTOR;
+
+  std::vector<double> latencies;
+  double total = 0;
+  for (int s=0; s < (int)allLookupLatencyEvts.size(); ++s)
+  {
+    if (allLookupLatencyEvts[s].time.raw() <= processedAfterInMicro)
+      continue;
+
+    double latency = allLookupLatencyEvts[s].data.latency().toSeconds() * 1000.0;
+    latencies.push_back(latency);
+    total += latency;
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  fileOut << "\n\n*******************OSegLookupLatency Analysis*************\n\n\n";
+  fileOut << "Num lookups processed after " << processAfter << " seconds:  " << latencies.size() << "\n";
+
+  if (!latencies.empty())
+  {
+    fileOut << "Mean (ms):   " << total / latencies.size() << "\n";
+    fileOut << "p50 (ms):    " << percentile(latencies, .50) << "\n";
+    fileOut << "p90 (ms):    " << percentile(latencies, .90) << "\n";
+    fileOut << "p99 (ms):    " << percentile(latencies, .99) << "\n";
+    fileOut << "Max (ms):    " << latencies.back() << "\n";
+  }
+
+  fileOut<<"\n\tEND*****\n";
+}
+
+double OSegLookupLatencyAnalysis::percentile(const std::vector<double>& sorted, double p)
+{
+  size_t idx = (size_t)(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+
 //oseg cache error analysis
 
 
@@ -283,6 +283,21 @@ public:
   };
 
 
+  // Percentiles of the time between the first lookup being queued for an
+  // object and the OSeg resolving it, across all servers.
+  class OSegLookupLatencyAnalysis
+  {
+  private:
+    std::vector<OSegLookupLatencyEvent> allLookupLatencyEvts;
+    static double percentile(const std::vector<double>& sorted, double p);
+
+  public:
+    OSegLookupLatencyAnalysis(const char* opt_name, const uint32 nservers);
+    ~OSegLookupLatencyAnalysis();
+    void printData(std::ostream &fileOut, int processAfter =0);
+  };
+
+
   class OSegCumulativeTraceAnalysis
   {
   private:
@@ -102,6 +102,8 @@ typedef PBJEvent<Trace::OSeg::Shutdown> OSegShutdownEvent;
 typedef PBJEvent<Trace::OSeg::CacheResponse> OSegCacheResponseEvent;
 typedef PBJEvent<Trace::OSeg::InvalidLookup> OSegInvalidLookupEvent;
 typedef PBJEvent<Trace::OSeg::CumulativeResponse> OSegCumulativeResponseEvent;
+typedef PBJEvent<Trace::OSeg::BatchLookup> OSegBatchLookupEvent;
+typedef PBJEvent<Trace::OSeg::LookupLatency> OSegLookupLatencyEvent;
 //Migration
 typedef PBJEvent<Trace::Migration::Begin> MigrationBeginEvent;
 typedef PBJEvent<Trace::Migration::Ack> MigrationAckEvent;
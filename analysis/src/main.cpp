@@ -330,6 +330,20 @@ int main(int argc, char** argv) {
 
         //end cache response analysis
 
+
+        //oseg lookup latency analysis
+        String oseg_lookup_latency_filename = "oseg_lookup_latency_file";
+        oseg_lookup_latency_filename += ".dat";
+
+        OSegLookupLatencyAnalysis oseg_lookup_latency_analysis(STATS_TRACE_FILE, max_space_servers);
+
+        std::ofstream oseg_lookup_latency_stream(oseg_lookup_latency_filename.c_str());
+
+        oseg_lookup_latency_analysis.printData(oseg_lookup_latency_stream,osegProcessedAfterSeconds);
+
+        oseg_lookup_latency_stream.flush();
+        oseg_lookup_latency_stream.close();
+
         //cached error analysis
         String oseg_cached_response_error_filename = "oseg_cached_response_error_file";
         oseg_cached_response_error_filename += ".dat";
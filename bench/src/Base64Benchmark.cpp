@@ -0,0 +1,117 @@
+/*  Sirikata
+ *  Base64Benchmark.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "Base64Benchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/util/Base64.hpp>
+
+namespace Sirikata {
+
+Base64Benchmark::Base64Benchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mSize(0),
+          mIterations(0)
+{
+    OptionValue* size;
+    OptionValue* iterations;
+    Sirikata::InitializeClassOptions ico("Base64Benchmark",this,
+        size=new OptionValue("size","65536",Sirikata::OptionValueType<uint32>(),"Number of raw bytes in each buffer"),
+        iterations=new OptionValue("iterations","2000",Sirikata::OptionValueType<uint32>(),"Number of times each buffer is encoded and decoded"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("Base64Benchmark",this);
+    optionsSet->parse(param);
+
+    mSize = size->as<uint32>();
+    mIterations = std::max(iterations->as<uint32>(), (uint32)1);
+}
+
+String Base64Benchmark::name() {
+    return "base64";
+}
+
+Duration Base64Benchmark::run(CodingFunction func, const std::vector<uint8>& src, std::vector<uint8>* dst) {
+    Time start = Timer::now();
+    for(uint32 i = 0; i < mIterations && !mForceStop; i++)
+        func(src.empty() ? NULL : &src[0], src.size(), &(*dst)[0]);
+    return Timer::now() - start;
+}
+
+void Base64Benchmark::report(const char* label, size_t bytes, const Duration& dur) {
+    double total = (double)bytes * mIterations;
+    SILOG(benchmark,info,
+          label << ": " << mIterations << " x " << bytes << " bytes, " << dur << ": "
+          << (total/dur.toSeconds())/(1024.0*1024.0) << " MB/s");
+}
+
+void Base64Benchmark::start() {
+    mForceStop = false;
+
+    std::vector<uint8> raw(mSize);
+    for(uint32 i = 0; i < mSize; i++)
+        raw[i] = (uint8)(rand() & 0xff);
+
+    std::vector<uint8> encoded(Base64::encodedSize(mSize) + 1);
+    encoded.resize(Base64::encode(raw.empty() ? NULL : &raw[0], raw.size(), &encoded[0]));
+    std::vector<uint8> decoded(Base64::decodedMaxSize(encoded.size()) + 1);
+
+    SILOG(benchmark,info, "Base64 kernels: " << Base64::implementation());
+
+    // Throughput is reported in terms of raw (decoded) bytes for both
+    // directions so the numbers are directly comparable.
+    Duration dur = run(&Base64::encode, raw, &encoded);
+    if (mForceStop) return;
+    report("encode", mSize, dur);
+
+    dur = run(&Base64::encodeScalar, raw, &encoded);
+    if (mForceStop) return;
+    report("encode (scalar)", mSize, dur);
+
+    dur = run(&Base64::decode, encoded, &decoded);
+    if (mForceStop) return;
+    report("decode", mSize, dur);
+
+    dur = run(&Base64::decodeScalar, encoded, &decoded);
+    if (mForceStop) return;
+    report("decode (scalar)", mSize, dur);
+
+    notifyFinished();
+}
+
+void Base64Benchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,244 @@
+/*  Sirikata
+ *  CSegLookupBenchmark.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CSegLookupBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/util/Thread.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/space/SegmentationSnapshot.hpp>
+#include <sirikata/space/SegmentationLookupCache.hpp>
+
+namespace Sirikata {
+
+namespace {
+// Lookups the way CoordinateSegmentationClient used to do them: scan a list
+// of regions under a mutex.
+class LockedScanLookup {
+public:
+    LockedScanLookup(const std::vector<SegmentationInfo>& segmentation)
+     : mSegmentation(segmentation)
+    {}
+
+    ServerID lookup(const Vector3f& pos) {
+        boost::mutex::scoped_lock lock(mMutex);
+        for(uint32 si = 0; si < mSegmentation.size(); si++) {
+            for(uint32 ri = 0; ri < mSegmentation[si].region.size(); ri++) {
+                if (mSegmentation[si].region[ri].contains(pos))
+                    return mSegmentation[si].server;
+            }
+        }
+        return NullServerID;
+    }
+
+private:
+    boost::mutex mMutex;
+    std::vector<SegmentationInfo> mSegmentation;
+};
+
+class SnapshotLookup {
+public:
+    SnapshotLookup(const std::vector<SegmentationInfo>& segmentation)
+    {
+        mPublisher.publish(new SegmentationSnapshot(segmentation));
+    }
+
+    ServerID lookup(const Vector3f& pos) {
+        return SegmentationSnapshot::Publisher::Reader(mPublisher)->lookup(pos);
+    }
+
+private:
+    SegmentationSnapshot::Publisher mPublisher;
+};
+
+// Lookups the way CoordinateSegmentationClient does them now, while another
+// thread keeps adding lookup responses and publishing them every tick like
+// CoordinateSegmentationClient::service().
+class ClientLookup {
+public:
+    ClientLookup(const std::vector<SegmentationInfo>& segmentation)
+     : mSegmentation(segmentation),
+       mStop(false)
+    {
+        std::map<ServerID, BoundingBoxList> regions;
+        for(uint32 si = 0; si < segmentation.size(); si++)
+            regions[segmentation[si].server] = segmentation[si].region;
+        mCache.replaceRegions(regions);
+
+        mServiceThread = new Thread(std::tr1::bind(&ClientLookup::serviceMain, this));
+    }
+
+    ~ClientLookup() {
+        mStop = true;
+        mServiceThread->join();
+        delete mServiceThread;
+    }
+
+    ServerID lookup(const Vector3f& pos) {
+        return mCache.lookup(pos);
+    }
+
+private:
+    void serviceMain() {
+        // Responses repeat regions we already know, so results don't change
+        uint32 next = 0;
+        while(!mStop) {
+            const SegmentationInfo& info = mSegmentation[next++ % mSegmentation.size()];
+            mCache.addRegion(info.server, info.region[0]);
+            mCache.service();
+            boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+        }
+    }
+
+    std::vector<SegmentationInfo> mSegmentation;
+    SegmentationLookupCache mCache;
+    volatile bool mStop;
+    Thread* mServiceThread;
+};
+
+template<typename LookupType>
+void lookupThread(LookupType* lookup, uint32 seed, uint32 count, float32 extent, volatile bool* force_stop, AtomicValue<uint32>* misses) {
+    // Each thread gets its own cheap generator so we don't measure contention
+    // on rand()
+    uint32 state = seed;
+    uint32 local_misses = 0;
+    for(uint32 i = 0; i < count && !*force_stop; i++) {
+        Vector3f pos;
+        for(int axis = 0; axis < 3; axis++) {
+            state = state * 1664525 + 1013904223;
+            pos[axis] = (state >> 8) * (extent / 16777216.f);
+        }
+        if (lookup->lookup(pos) == NullServerID)
+            local_misses++;
+    }
+    (*misses) += local_misses;
+}
+}
+
+CSegLookupBenchmark::CSegLookupBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mThreads(0),
+          mServersPerAxis(0),
+          mLookups(0)
+{
+    OptionValue* threads;
+    OptionValue* servers;
+    OptionValue* lookups;
+    Sirikata::InitializeClassOptions ico("CSegLookupBenchmark",this,
+        threads=new OptionValue("threads","8",Sirikata::OptionValueType<uint32>(),"Number of threads performing lookups"),
+        servers=new OptionValue("servers-per-axis","4",Sirikata::OptionValueType<uint32>(),"Number of servers along each axis of the uniform segmentation"),
+        lookups=new OptionValue("lookups","2000000",Sirikata::OptionValueType<uint32>(),"Number of lookups each thread performs"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("CSegLookupBenchmark",this);
+    optionsSet->parse(param);
+
+    mThreads = std::max(threads->as<uint32>(), (uint32)1);
+    mServersPerAxis = std::max(servers->as<uint32>(), (uint32)1);
+    mLookups = lookups->as<uint32>();
+}
+
+String CSegLookupBenchmark::name() {
+    return "cseg-lookup";
+}
+
+template<typename LookupType>
+Duration CSegLookupBenchmark::run(LookupType* lookup) {
+    AtomicValue<uint32> misses(0);
+
+    Time start = Timer::now();
+    std::vector<Thread*> threads;
+    for(uint32 i = 0; i < mThreads; i++)
+        threads.push_back(new Thread(std::tr1::bind(&lookupThread<LookupType>, lookup, i+1, mLookups, (float32)mServersPerAxis, &mForceStop, &misses)));
+    for(uint32 i = 0; i < threads.size(); i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+    Duration dur = Timer::now() - start;
+
+    if (misses.read() > 0)
+        SILOG(benchmark,error,misses.read() << " lookups didn't find a server");
+    return dur;
+}
+
+void CSegLookupBenchmark::start() {
+    mForceStop = false;
+
+    // Unit cubes, one per server
+    std::vector<SegmentationInfo> segmentation;
+    for(uint32 x = 0; x < mServersPerAxis; x++) {
+        for(uint32 y = 0; y < mServersPerAxis; y++) {
+            for(uint32 z = 0; z < mServersPerAxis; z++) {
+                SegmentationInfo info;
+                info.server = (x*mServersPerAxis + y)*mServersPerAxis + z + 1;
+                info.region.push_back(BoundingBox3f(Vector3f(x,y,z), Vector3f(x+1,y+1,z+1)));
+                segmentation.push_back(info);
+            }
+        }
+    }
+
+    double total = (double)mThreads * mLookups;
+
+#define CSEG_LOOKUP_RUN(label, lookup)                                  \
+    {                                                                   \
+        Duration dur = run(lookup);                                     \
+        if (mForceStop) return;                                         \
+        SILOG(benchmark,info,                                           \
+            label << ": " << mThreads << " threads, " << segmentation.size() \
+            << " servers, " << total << " lookups, " << dur << ": "     \
+            << (dur.toMicroseconds()*1000/total) << "ns/lookup, "       \
+            << (total/dur.toSeconds())/1000000.0 << " M lookups/s");    \
+    }
+
+    {
+        LockedScanLookup lookup(segmentation);
+        CSEG_LOOKUP_RUN("Locked scan", &lookup);
+    }
+    {
+        SnapshotLookup lookup(segmentation);
+        CSEG_LOOKUP_RUN("Snapshot", &lookup);
+    }
+    {
+        ClientLookup lookup(segmentation);
+        CSEG_LOOKUP_RUN("Client lookup cache", &lookup);
+    }
+
+#undef CSEG_LOOKUP_RUN
+
+    notifyFinished();
+}
+
+void CSegLookupBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,150 @@
+/*  Sirikata
+ *  FairQueueBenchmark.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FairQueueBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/queue/FairQueue.hpp>
+
+namespace Sirikata {
+
+namespace {
+struct BenchMessage {
+    uint32 bytes;
+
+    BenchMessage(uint32 b)
+     : bytes(b) {}
+
+    uint32 size() const {
+        return bytes;
+    }
+};
+typedef Queue<BenchMessage*> BenchMessageQueue;
+typedef FairQueue<BenchMessage, uint32, BenchMessageQueue> BenchFairQueue;
+
+float32 randFloat(float32 lo, float32 hi) {
+    return lo + (hi - lo) * (rand() / (float32)RAND_MAX);
+}
+
+uint32 randSize() {
+    return 64 + (rand() % 1400);
+}
+}
+
+FairQueueBenchmark::FairQueueBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mMinFlows(0),
+          mMaxFlows(0),
+          mMessages(0),
+          mWeightUpdateInterval(0)
+{
+    OptionValue* min_flows;
+    OptionValue* max_flows;
+    OptionValue* messages;
+    OptionValue* weight_interval;
+    Sirikata::InitializeClassOptions ico("FairQueueBenchmark",this,
+        min_flows=new OptionValue("min-flows","1000",Sirikata::OptionValueType<uint32>(),"Smallest number of flows to test"),
+        max_flows=new OptionValue("max-flows","10000",Sirikata::OptionValueType<uint32>(),"Largest number of flows to test, doubling from min-flows"),
+        messages=new OptionValue("messages","1000000",Sirikata::OptionValueType<uint32>(),"Number of messages to pop for each number of flows"),
+        weight_interval=new OptionValue("weight-interval","100",Sirikata::OptionValueType<uint32>(),"Adjust one flow's weight every this many messages, 0 to disable"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("FairQueueBenchmark",this);
+    optionsSet->parse(param);
+
+    mMinFlows = std::max(min_flows->as<uint32>(), (uint32)1);
+    mMaxFlows = std::max(max_flows->as<uint32>(), mMinFlows);
+    mMessages = messages->as<uint32>();
+    mWeightUpdateInterval = weight_interval->as<uint32>();
+}
+
+String FairQueueBenchmark::name() {
+    return "fair-queue";
+}
+
+Duration FairQueueBenchmark::run(uint32 num_flows) {
+    BenchFairQueue fq;
+    for(uint32 i = 0; i < num_flows; i++) {
+        fq.addQueue(new BenchMessageQueue(1 << 20), i, randFloat(.5f, 2.f));
+        // A couple of messages per flow so they stay backlogged
+        fq.push(i, new BenchMessage(randSize()));
+        fq.push(i, new BenchMessage(randSize()));
+    }
+
+    Time start = Timer::now();
+    for(uint32 i = 0; i < mMessages && !mForceStop; i++) {
+        uint32 key;
+        BenchMessage* msg = fq.pop(&key);
+        assert(msg != NULL);
+        msg->bytes = randSize();
+        fq.push(key, msg);
+
+        if (mWeightUpdateInterval > 0 && (i % mWeightUpdateInterval) == 0)
+            fq.setQueueWeight(rand() % num_flows, randFloat(.5f, 2.f));
+    }
+    Duration dur = Timer::now() - start;
+
+    while(!fq.empty())
+        delete fq.pop();
+
+    return dur;
+}
+
+void FairQueueBenchmark::start() {
+    mForceStop = false;
+
+    for(uint32 flows = mMinFlows; !mForceStop; flows *= 2) {
+        flows = std::min(flows, mMaxFlows);
+
+        Duration dur = run(flows);
+        if (mForceStop)
+            return;
+
+        double total = (double)mMessages;
+        SILOG(benchmark,info,
+              flows << " flows: " << total << " messages, " << dur << ": "
+              << (dur.toMicroseconds()*1000/total) << "ns/message, "
+              << (total/dur.toSeconds())/1000000.0 << " M messages/s");
+
+        if (flows == mMaxFlows)
+            break;
+    }
+
+    notifyFinished();
+}
+
+void FairQueueBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,170 @@
+/*  Sirikata
+ *  LocationExtrapolationBenchmark.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "LocationExtrapolationBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/util/MotionQuaternion.hpp>
+#include <sirikata/core/util/BoundingSphere.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/space/DenseLocationStore.hpp>
+
+namespace Sirikata {
+
+namespace {
+// Mirrors the per-object record in CBRLocationServiceCache so the map version
+// has the same memory footprint.
+struct ObjectRecord {
+    TimedMotionVector3f location;
+    TimedMotionQuaternion orientation;
+    BoundingSphere3f bounds;
+    BoundingSphere3f region;
+    float32 maxSize;
+    bool isLocal;
+    String mesh;
+    String physics;
+    bool exists;
+    int16 tracking;
+};
+typedef std::tr1::unordered_map<UUID, ObjectRecord, UUID::Hasher> ObjectRecordMap;
+
+float32 randFloat(float32 lo, float32 hi) {
+    return lo + (hi - lo) * (rand() / (float32)RAND_MAX);
+}
+}
+
+LocationExtrapolationBenchmark::LocationExtrapolationBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mNumObjects(0),
+          mIterations(0)
+{
+    OptionValue* num_objects;
+    OptionValue* iterations;
+    Sirikata::InitializeClassOptions ico("LocationExtrapolationBenchmark",this,
+        num_objects=new OptionValue("objects","1000000",Sirikata::OptionValueType<uint32>(),"Number of objects to extrapolate"),
+        iterations=new OptionValue("iterations","10",Sirikata::OptionValueType<uint32>(),"Number of passes over all objects"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("LocationExtrapolationBenchmark",this);
+    optionsSet->parse(param);
+
+    mNumObjects = num_objects->as<uint32>();
+    mIterations = iterations->as<uint32>();
+}
+
+String LocationExtrapolationBenchmark::name() {
+    return "loc-extrapolation";
+}
+
+void LocationExtrapolationBenchmark::start() {
+    mForceStop = false;
+
+    Time t0 = Time::null() + Duration::seconds(100.f);
+
+    ObjectRecordMap records;
+    DenseLocationStore dense;
+    for(uint32 i = 0; i < mNumObjects && !mForceStop; i++) {
+        UUID id = UUID::random();
+        ObjectRecord rec;
+        rec.location = TimedMotionVector3f(
+            t0 - Duration::milliseconds((int64)(rand() % 1000)),
+            MotionVector3f(
+                Vector3f(randFloat(-1000.f, 1000.f), randFloat(-1000.f, 1000.f), randFloat(-1000.f, 1000.f)),
+                Vector3f(randFloat(-1.f, 1.f), randFloat(-1.f, 1.f), randFloat(-1.f, 1.f))
+            )
+        );
+        rec.bounds = BoundingSphere3f(Vector3f(0,0,0), randFloat(.5f, 10.f));
+        rec.region = BoundingSphere3f(Vector3f(0,0,0), 0.f);
+        rec.maxSize = rec.bounds.radius();
+        rec.isLocal = true;
+        // Long enough to defeat any small string optimization
+        rec.mesh = "meerkat:///someuser/models/object_" + id.toString() + ".dae";
+        rec.physics = "";
+        rec.exists = true;
+        rec.tracking = 1;
+        records[id] = rec;
+
+        dense.add(id, rec.location, rec.maxSize);
+    }
+
+    if (mForceStop)
+        return;
+
+    // Map of records, one lookup-free walk per pass.
+    float32 sink = 0.f;
+    Time map_start = Timer::now();
+    for(uint32 iter = 0; iter < mIterations && !mForceStop; iter++) {
+        Time t = t0 + Duration::milliseconds((int64)iter);
+        for(ObjectRecordMap::const_iterator it = records.begin(); it != records.end(); it++) {
+            Vector3f pos = it->second.location.position(t);
+            sink += pos.x + it->second.maxSize;
+        }
+    }
+    Duration map_dur = Timer::now() - map_start;
+
+    if (mForceStop)
+        return;
+
+    // Dense arrays
+    std::vector<float32> xs(dense.capacity()), ys(dense.capacity()), zs(dense.capacity());
+    Time dense_start = Timer::now();
+    for(uint32 iter = 0; iter < mIterations && !mForceStop; iter++) {
+        Time t = t0 + Duration::milliseconds((int64)iter);
+        dense.extrapolate(t, &xs[0], &ys[0], &zs[0]);
+        const float32* radii = dense.radii();
+        for(uint32 i = 0; i < dense.capacity(); i++)
+            sink += xs[i] + radii[i];
+    }
+    Duration dense_dur = Timer::now() - dense_start;
+
+    if (mForceStop)
+        return;
+
+    double total = (double)mNumObjects * mIterations;
+    SILOG(benchmark,info,
+          "Map: " << total << " extrapolations, " << map_dur << ": "
+          << (map_dur.toMicroseconds()*1000/total) << "ns/object, "
+          << (total/map_dur.toSeconds())/1000000.0 << " M objects/s");
+    SILOG(benchmark,info,
+          "Dense: " << total << " extrapolations, " << dense_dur << ": "
+          << (dense_dur.toMicroseconds()*1000/total) << "ns/object, "
+          << (total/dense_dur.toSeconds())/1000000.0 << " M objects/s");
+    SILOG(benchmark,insane, "Checksum " << sink);
+
+    notifyFinished();
+}
+
+void LocationExtrapolationBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,255 @@
+/*  Sirikata
+ *  OSegCacheBenchmark.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "OSegCacheBenchmark.hpp"
+#include <sirikata/core/network/IOServiceFactory.hpp>
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/service/Context.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/util/Thread.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/space/CacheLRUOriginal.hpp>
+#include <sirikata/space/ShardedClockProCache.hpp>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+namespace Sirikata {
+
+namespace {
+// The entry stored doesn't matter for the benchmark, just derive a
+// plausible one from the object.
+OSegEntry entryFor(const UUID& obj) {
+    return OSegEntry(obj.hash() % 16 + 1, 1.f);
+}
+
+// Replays count lookups of the trace starting at offset, inserting on a miss
+// the way the OSeg does once its lookup completes.
+void replayThread(OSegCache* cache, const std::vector<UUID>* trace, uint32 offset, uint32 count, volatile bool* force_stop, AtomicValue<uint32>* hits) {
+    uint32 local_hits = 0;
+    for(uint32 i = 0; i < count && !*force_stop; i++) {
+        const UUID& obj = (*trace)[(offset + i) % trace->size()];
+        if (cache->get(obj).notNull())
+            local_hits++;
+        else
+            cache->insert(obj, entryFor(obj));
+    }
+    (*hits) += local_hits;
+}
+}
+
+OSegCacheBenchmark::OSegCacheBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mServer(0),
+          mCacheSize(0),
+          mShards(0),
+          mThreads(0),
+          mObjects(0),
+          mLookups(0),
+          mSkew(0)
+{
+    OptionValue* trace;
+    OptionValue* server;
+    OptionValue* size;
+    OptionValue* shards;
+    OptionValue* threads;
+    OptionValue* objects;
+    OptionValue* lookups;
+    OptionValue* skew;
+    Sirikata::InitializeClassOptions ico("OSegCacheBenchmark",this,
+        trace=new OptionValue("trace","",Sirikata::OptionValueType<String>(),"Lookup trace generated by the analysis tool. If empty, a synthetic trace is used."),
+        server=new OptionValue("server","0",Sirikata::OptionValueType<uint32>(),"Only replay lookups recorded by this server, 0 for all servers"),
+        size=new OptionValue("size","10000",Sirikata::OptionValueType<uint32>(),"Maximum number of entries in each cache"),
+        shards=new OptionValue("shards","16",Sirikata::OptionValueType<uint32>(),"Number of shards in the sharded cache"),
+        threads=new OptionValue("threads","8",Sirikata::OptionValueType<uint32>(),"Number of threads replaying the trace concurrently"),
+        objects=new OptionValue("objects","100000",Sirikata::OptionValueType<uint32>(),"Number of objects in the synthetic trace"),
+        lookups=new OptionValue("lookups","1000000",Sirikata::OptionValueType<uint32>(),"Number of lookups in the synthetic trace"),
+        skew=new OptionValue("skew","0.9",Sirikata::OptionValueType<double>(),"Zipf exponent of object popularity in the synthetic trace"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("OSegCacheBenchmark",this);
+    optionsSet->parse(param);
+
+    mTraceFile = trace->as<String>();
+    mServer = server->as<uint32>();
+    mCacheSize = std::max(size->as<uint32>(), (uint32)1);
+    mShards = std::max(shards->as<uint32>(), (uint32)1);
+    mThreads = std::max(threads->as<uint32>(), (uint32)1);
+    mObjects = std::max(objects->as<uint32>(), (uint32)1);
+    mLookups = lookups->as<uint32>();
+    mSkew = skew->as<double>();
+}
+
+String OSegCacheBenchmark::name() {
+    return "oseg-cache";
+}
+
+bool OSegCacheBenchmark::loadTrace() {
+    std::ifstream is(mTraceFile.c_str());
+    if (!is) {
+        SILOG(benchmark,error,"Couldn't open OSeg lookup trace " << mTraceFile);
+        return false;
+    }
+
+    // Each lookup is printed as a block of lines, the server which recorded
+    // it comes before the object.
+    const String server_label = "Registered from:";
+    const String obj_label = "Obj id:";
+    uint32 server = 0;
+    String line;
+    while(std::getline(is, line)) {
+        String::size_type pos;
+        if ((pos = line.find(server_label)) != String::npos) {
+            server = strtoul(line.c_str() + pos + server_label.size(), NULL, 10);
+        }
+        else if ((pos = line.find(obj_label)) != String::npos) {
+            if (mServer != 0 && server != mServer) continue;
+            String obj_str = line.substr(pos + obj_label.size());
+            obj_str.erase(0, obj_str.find_first_not_of(" \t"));
+            obj_str.erase(obj_str.find_last_not_of(" \t\r") + 1);
+            mTrace.push_back(UUID(obj_str, UUID::HumanReadable()));
+        }
+    }
+
+    return !mTrace.empty();
+}
+
+void OSegCacheBenchmark::generateTrace() {
+    std::vector<UUID> objects;
+    std::vector<double> cdf;
+    double total = 0;
+    for(uint32 i = 0; i < mObjects; i++) {
+        objects.push_back(UUID::random());
+        total += 1.0 / std::pow((double)(i+1), mSkew);
+        cdf.push_back(total);
+    }
+
+    uint32 state = 1;
+    for(uint32 i = 0; i < mLookups; i++) {
+        state = state * 1664525 + 1013904223;
+        double r = (state >> 8) * (total / 16777216.0);
+        uint32 idx = std::lower_bound(cdf.begin(), cdf.end(), r) - cdf.begin();
+        mTrace.push_back(objects[std::min(idx, mObjects-1)]);
+    }
+}
+
+double OSegCacheBenchmark::hitRate(OSegCache* cache) {
+    AtomicValue<uint32> hits(0);
+    replayThread(cache, &mTrace, 0, mTrace.size(), &mForceStop, &hits);
+    return (double)hits.read() / mTrace.size();
+}
+
+Duration OSegCacheBenchmark::run(OSegCache* cache, double* hit_rate) {
+    AtomicValue<uint32> hits(0);
+    uint32 per_thread = mTrace.size();
+
+    Time start = Timer::now();
+    std::vector<Thread*> threads;
+    for(uint32 i = 0; i < mThreads; i++) {
+        uint32 offset = (uint32)(((uint64)mTrace.size() * i) / mThreads);
+        threads.push_back(new Thread(std::tr1::bind(&replayThread, cache, &mTrace, offset, per_thread, &mForceStop, &hits)));
+    }
+    for(uint32 i = 0; i < threads.size(); i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+    Duration dur = Timer::now() - start;
+
+    *hit_rate = (double)hits.read() / ((double)per_thread * mThreads);
+    return dur;
+}
+
+void OSegCacheBenchmark::start() {
+    mForceStop = false;
+
+    mTrace.clear();
+    if (!mTraceFile.empty()) {
+        if (!loadTrace()) {
+            SILOG(benchmark,error,"No lookups found in " << mTraceFile);
+            notifyFinished();
+            return;
+        }
+    }
+    else {
+        generateTrace();
+    }
+
+    // The caches only use the context as a time source
+    Network::IOService* ios = Network::IOServiceFactory::makeIOService();
+    Network::IOStrand* strand = ios->createStrand();
+    Context* ctx = new Context("OSegCacheBenchmark", ios, strand, NULL, Timer::now());
+
+    double total = (double)mThreads * mTrace.size();
+
+#define OSEG_CACHE_RUN(label, create)                                   \
+    {                                                                   \
+        OSegCache* cache = create;                                      \
+        double single_hit_rate = hitRate(cache);                        \
+        delete cache;                                                   \
+        cache = create;                                                 \
+        double concurrent_hit_rate = 0;                                 \
+        Duration dur = run(cache, &concurrent_hit_rate);                \
+        delete cache;                                                   \
+        if (mForceStop) break;                                          \
+        SILOG(benchmark,info,                                           \
+            label << ": " << mTrace.size() << " lookups, " << mCacheSize \
+            << " entries, hit rate " << single_hit_rate << "; "         \
+            << mThreads << " threads, " << dur << ": "                  \
+            << (dur.toMicroseconds()*1000/total) << "ns/lookup, "       \
+            << (total/dur.toSeconds())/1000000.0 << " M lookups/s, "    \
+            << "hit rate " << concurrent_hit_rate);                     \
+    }
+
+    Duration lifetime = Duration::seconds(3600);
+    do {
+        OSEG_CACHE_RUN("LRU", new CacheLRUOriginal(ctx, mCacheSize, 25, lifetime, Duration::zero()));
+        OSEG_CACHE_RUN("CLOCK-Pro", new ShardedClockProCache(ctx, mCacheSize, 1, lifetime, Duration::zero()));
+        OSEG_CACHE_RUN("Sharded CLOCK-Pro", new ShardedClockProCache(ctx, mCacheSize, mShards, lifetime, Duration::zero()));
+    } while(false);
+
+#undef OSEG_CACHE_RUN
+
+    delete ctx;
+    delete strand;
+    Network::IOServiceFactory::destroyIOService(ios);
+
+    if (!mForceStop)
+        notifyFinished();
+}
+
+void OSegCacheBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
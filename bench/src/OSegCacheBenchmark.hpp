@@ -0,0 +1,88 @@
+/*  Sirikata
+ *  OSegCacheBenchmark.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_OSEG_CACHE_BENCHMARK_HPP_
+#define _SIRIKATA_OSEG_CACHE_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/core/util/UUID.hpp>
+
+namespace Sirikata {
+
+class OSegCache;
+
+/** OSegCacheBenchmark replays a sequence of OSeg lookups against each OSeg
+ *  cache implementation, reporting the hit rate of a single replay and the
+ *  throughput of many threads replaying it at once.  The sequence is read
+ *  from the lookup-not-on-server output of the analysis tool
+ *  (oseg_object_segmentation_lookup_not_on_server_file.dat, generated with
+ *  --analysis.oseg), which lists every lookup that had to consult the
+ *  cache.  Without a trace, a Zipf distributed sequence is generated.
+ */
+class OSegCacheBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new OSegCacheBenchmark(finished_cb, param);
+    }
+
+    OSegCacheBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    bool loadTrace();
+    void generateTrace();
+
+    double hitRate(OSegCache* cache);
+    Duration run(OSegCache* cache, double* hit_rate);
+
+    bool mForceStop;
+    String mTraceFile;
+    uint32 mServer;
+    uint32 mCacheSize;
+    uint32 mShards;
+    uint32 mThreads;
+    uint32 mObjects;
+    uint32 mLookups;
+    double mSkew;
+
+    std::vector<UUID> mTrace;
+}; // class OSegCacheBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_OSEG_CACHE_BENCHMARK_HPP_
@@ -0,0 +1,197 @@
+/*  Sirikata
+ *  ProxEncodingBenchmark.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ProxEncodingBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/util/MotionQuaternion.hpp>
+#include <sirikata/core/util/BoundingSphere.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/network/Message.hpp>
+#include <sirikata/core/network/Frame.hpp>
+#include <sirikata/core/network/ProxCompactEncoding.hpp>
+
+#include "Protocol_Prox.pbj.hpp"
+
+namespace Sirikata {
+
+namespace {
+struct ResultRecord {
+    UUID id;
+    TimedMotionVector3f location;
+    TimedMotionQuaternion orientation;
+    BoundingSphere3f bounds;
+    String mesh;
+};
+typedef std::vector<ResultRecord> ResultRecordList;
+
+float32 randFloat(float32 lo, float32 hi) {
+    return lo + (hi - lo) * (rand() / (float32)RAND_MAX);
+}
+}
+
+ProxEncodingBenchmark::ProxEncodingBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mNumObjects(0),
+          mNumMeshes(0),
+          mPerMessage(0),
+          mIterations(0)
+{
+    OptionValue* num_objects;
+    OptionValue* num_meshes;
+    OptionValue* per_message;
+    OptionValue* iterations;
+    Sirikata::InitializeClassOptions ico("ProxEncodingBenchmark",this,
+        num_objects=new OptionValue("objects","5000",Sirikata::OptionValueType<uint32>(),"Number of objects in the query result"),
+        num_meshes=new OptionValue("meshes","100",Sirikata::OptionValueType<uint32>(),"Number of distinct meshes used by the objects"),
+        per_message=new OptionValue("per-message","5",Sirikata::OptionValueType<uint32>(),"Number of results per message, as in prox.max-per-result"),
+        iterations=new OptionValue("iterations","20",Sirikata::OptionValueType<uint32>(),"Number of times every object is added and removed"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("ProxEncodingBenchmark",this);
+    optionsSet->parse(param);
+
+    mNumObjects = num_objects->as<uint32>();
+    mNumMeshes = std::max(num_meshes->as<uint32>(), (uint32)1);
+    mPerMessage = std::max(per_message->as<uint32>(), (uint32)1);
+    mIterations = iterations->as<uint32>();
+}
+
+String ProxEncodingBenchmark::name() {
+    return "prox-encoding";
+}
+
+void ProxEncodingBenchmark::start() {
+    mForceStop = false;
+
+    Time t = Time::null() + Duration::seconds(100.f);
+    Vector3f querier(randFloat(-1000.f, 1000.f), randFloat(-1000.f, 1000.f), randFloat(-1000.f, 1000.f));
+
+    ResultRecordList records(mNumObjects);
+    for(uint32 i = 0; i < mNumObjects; i++) {
+        ResultRecord& rec = records[i];
+        rec.id = UUID::random();
+        Vector3f pos = querier + Vector3f(randFloat(-200.f, 200.f), randFloat(-200.f, 200.f), randFloat(-200.f, 200.f));
+        rec.location = TimedMotionVector3f(
+            t - Duration::milliseconds((int64)(rand() % 1000)),
+            MotionVector3f(pos, Vector3f(randFloat(-1.f, 1.f), randFloat(-1.f, 1.f), randFloat(-1.f, 1.f)))
+        );
+        rec.orientation = TimedMotionQuaternion(t, MotionQuaternion(Quaternion::identity(), Quaternion::identity()));
+        rec.bounds = BoundingSphere3f(pos, randFloat(.5f, 10.f));
+        std::ostringstream mesh;
+        mesh << "meerkat:///someuser/models/object_" << (rand() % mNumMeshes) << ".dae";
+        rec.mesh = mesh.str();
+    }
+
+    // Protocol::Prox path, as done by Proximity::generateObjectQueryEvents
+    uint64 pbj_bytes = 0;
+    uint64 pbj_messages = 0;
+    Time pbj_start = Timer::now();
+    for(uint32 iter = 0; iter < mIterations && !mForceStop; iter++) {
+        for(uint32 removals = 0; removals < 2; removals++) {
+            for(uint32 base = 0; base < mNumObjects; base += mPerMessage) {
+                Sirikata::Protocol::Prox::ProximityResults prox_results;
+                prox_results.set_t(t);
+                Sirikata::Protocol::Prox::IProximityUpdate event_results = prox_results.add_update();
+                for(uint32 i = base; i < base + mPerMessage && i < mNumObjects; i++) {
+                    const ResultRecord& rec = records[i];
+                    if (removals) {
+                        Sirikata::Protocol::Prox::IObjectRemoval removal = event_results.add_removal();
+                        removal.set_object(rec.id);
+                        continue;
+                    }
+                    Sirikata::Protocol::Prox::IObjectAddition addition = event_results.add_addition();
+                    addition.set_object(rec.id);
+                    Sirikata::Protocol::ITimedMotionVector motion = addition.mutable_location();
+                    motion.set_t(rec.location.updateTime());
+                    motion.set_position(rec.location.position());
+                    motion.set_velocity(rec.location.velocity());
+                    Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
+                    msg_orient.set_t(rec.orientation.updateTime());
+                    msg_orient.set_position(rec.orientation.position());
+                    msg_orient.set_velocity(rec.orientation.velocity());
+                    addition.set_bounds(rec.bounds);
+                    addition.set_mesh(rec.mesh);
+                }
+                pbj_bytes += Network::Frame::write(serializePBJMessage(prox_results)).size();
+                pbj_messages++;
+            }
+        }
+    }
+    Duration pbj_dur = Timer::now() - pbj_start;
+
+    if (mForceStop)
+        return;
+
+    // Compact path, with one encoder for the life of the stream
+    uint64 compact_bytes = 0;
+    uint64 compact_messages = 0;
+    Network::ProxCompactEncoder encoder;
+    Time compact_start = Timer::now();
+    for(uint32 iter = 0; iter < mIterations && !mForceStop; iter++) {
+        for(uint32 removals = 0; removals < 2; removals++) {
+            for(uint32 base = 0; base < mNumObjects; base += mPerMessage) {
+                encoder.begin(t, querier);
+                for(uint32 i = base; i < base + mPerMessage && i < mNumObjects; i++) {
+                    const ResultRecord& rec = records[i];
+                    if (removals)
+                        encoder.addRemoval(rec.id);
+                    else
+                        encoder.addAddition(rec.id, rec.location, rec.orientation, rec.bounds, rec.mesh, "");
+                }
+                compact_bytes += Network::Frame::write(encoder.finish()).size();
+                compact_messages++;
+            }
+        }
+    }
+    Duration compact_dur = Timer::now() - compact_start;
+
+    if (mForceStop)
+        return;
+
+    SILOG(benchmark,info,
+          "PBJ: " << pbj_messages << " messages, " << pbj_bytes << " bytes, " << pbj_dur << ": "
+          << ((double)pbj_bytes/pbj_messages) << " bytes/message, "
+          << (pbj_dur.toMicroseconds()*1000.0/pbj_messages) << "ns/message");
+    SILOG(benchmark,info,
+          "Compact: " << compact_messages << " messages, " << compact_bytes << " bytes, " << compact_dur << ": "
+          << ((double)compact_bytes/compact_messages) << " bytes/message, "
+          << (compact_dur.toMicroseconds()*1000.0/compact_messages) << "ns/message");
+
+    notifyFinished();
+}
+
+void ProxEncodingBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,151 @@
+/*  Sirikata
+ *  QueueContentionBenchmark.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "QueueContentionBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/util/Thread.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/queue/ThreadSafeQueue.hpp>
+#include <sirikata/core/queue/LockFreeQueue.hpp>
+#include <sirikata/core/queue/RingBufferQueue.hpp>
+
+namespace Sirikata {
+
+namespace {
+template<typename QueueType>
+void produce(QueueType* queue, uint32 count, volatile bool* force_stop) {
+    for(uint32 i = 0; i < count && !*force_stop; i++)
+        queue->push(i + 1);
+}
+
+// Consumers poll rather than using blockingPop since LockFreeQueue doesn't
+// support it. They stop once all items have been consumed.
+template<typename QueueType>
+void consume(QueueType* queue, AtomicValue<uint32>* remaining, volatile bool* force_stop) {
+    uint32 val = 0;
+    while(remaining->read() > 0 && !*force_stop) {
+        if (queue->pop(val))
+            --(*remaining);
+        else
+            Thread::yield();
+    }
+}
+}
+
+QueueContentionBenchmark::QueueContentionBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mProducers(0),
+          mConsumers(0),
+          mItems(0),
+          mCapacity(0)
+{
+    OptionValue* producers;
+    OptionValue* consumers;
+    OptionValue* items;
+    OptionValue* capacity;
+    Sirikata::InitializeClassOptions ico("QueueContentionBenchmark",this,
+        producers=new OptionValue("producers","4",Sirikata::OptionValueType<uint32>(),"Number of producer threads"),
+        consumers=new OptionValue("consumers","1",Sirikata::OptionValueType<uint32>(),"Number of consumer threads"),
+        items=new OptionValue("items","1000000",Sirikata::OptionValueType<uint32>(),"Number of items each producer pushes"),
+        capacity=new OptionValue("capacity","4096",Sirikata::OptionValueType<uint32>(),"Capacity of the bounded ring buffer queue"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("QueueContentionBenchmark",this);
+    optionsSet->parse(param);
+
+    mProducers = std::max(producers->as<uint32>(), (uint32)1);
+    mConsumers = std::max(consumers->as<uint32>(), (uint32)1);
+    mItems = items->as<uint32>();
+    mCapacity = capacity->as<uint32>();
+}
+
+String QueueContentionBenchmark::name() {
+    return "queue-contention";
+}
+
+template<typename QueueType>
+Duration QueueContentionBenchmark::run(QueueType* queue) {
+    AtomicValue<uint32> remaining(mProducers * mItems);
+
+    Time start = Timer::now();
+    std::vector<Thread*> threads;
+    for(uint32 i = 0; i < mConsumers; i++)
+        threads.push_back(new Thread(std::tr1::bind(&consume<QueueType>, queue, &remaining, &mForceStop)));
+    for(uint32 i = 0; i < mProducers; i++)
+        threads.push_back(new Thread(std::tr1::bind(&produce<QueueType>, queue, mItems, &mForceStop)));
+    for(uint32 i = 0; i < threads.size(); i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+    return Timer::now() - start;
+}
+
+void QueueContentionBenchmark::start() {
+    mForceStop = false;
+
+    double total = (double)mProducers * mItems;
+
+#define QUEUE_CONTENTION_RUN(label, queue)                              \
+    {                                                                   \
+        Duration dur = run(queue);                                      \
+        if (mForceStop) return;                                         \
+        SILOG(benchmark,info,                                           \
+            label << ": " << mProducers << " producers, " << mConsumers \
+            << " consumers, " << total << " items, " << dur << ": "     \
+            << (dur.toMicroseconds()*1000/total) << "ns/item, "         \
+            << (total/dur.toSeconds())/1000000.0 << " M items/s");      \
+    }
+
+    {
+        ThreadSafeQueue<uint32> queue;
+        QUEUE_CONTENTION_RUN("ThreadSafeQueue", &queue);
+    }
+    {
+        LockFreeQueue<uint32> queue;
+        QUEUE_CONTENTION_RUN("LockFreeQueue", &queue);
+    }
+    {
+        RingBufferQueue<uint32> queue(mCapacity);
+        QUEUE_CONTENTION_RUN("RingBufferQueue", &queue);
+    }
+
+#undef QUEUE_CONTENTION_RUN
+
+    notifyFinished();
+}
+
+void QueueContentionBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
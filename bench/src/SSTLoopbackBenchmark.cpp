@@ -0,0 +1,356 @@
+/*  Sirikata
+ *  SSTLoopbackBenchmark.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "SSTLoopbackBenchmark.hpp"
+#include <sirikata/core/network/IOServiceFactory.hpp>
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/util/Random.hpp>
+#include <sirikata/core/options/Options.hpp>
+
+#define SST_LOOPBACK_LISTEN_PORT 50
+#define SST_LOOPBACK_DATAGRAM_PORT 51
+
+namespace Sirikata {
+
+using std::tr1::placeholders::_1;
+using std::tr1::placeholders::_2;
+using std::tr1::placeholders::_3;
+
+SSTLoopbackBenchmark::SSTLoopbackBenchmark(const FinishedCallback& finished_cb, const String& param, bool loss)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mName(loss ? "sst-loss" : "sst-loopback"),
+          mStreamMode(false),
+          mNumDatagrams(0),
+          mDatagramSize(0),
+          mWindow(0),
+          mStreamBytes(0),
+          mIOService(NULL),
+          mIOStrand(NULL),
+          mContext(NULL),
+          mODP(NULL),
+          mLossRate(0.f),
+          mSent(0),
+          mReceived(0),
+          mPacketsDelivered(0),
+          mPacketsDropped(0),
+          mSendScheduled(false),
+          mTransferring(false),
+          mStartTime(Time::null())
+{
+    OptionValue* mode;
+    OptionValue* loss_rates;
+    OptionValue* num_datagrams;
+    OptionValue* datagram_size;
+    OptionValue* window;
+    OptionValue* stream_bytes;
+    Sirikata::InitializeClassOptions ico("SSTLoopbackBenchmark",this,
+        mode=new OptionValue("mode",(loss ? "stream" : "datagram"),Sirikata::OptionValueType<String>(),"Whether to send datagrams or transfer data over a reliable stream (datagram, stream)"),
+        loss_rates=new OptionValue("loss",(loss ? "0,0.01,0.05,0.1" : "0"),Sirikata::OptionValueType<std::vector<String> >(),"Comma separated list of packet loss rates to run with, each in [0,1)"),
+        num_datagrams=new OptionValue("num-datagrams","100000",Sirikata::OptionValueType<uint32>(),"Number of datagrams to send"),
+        datagram_size=new OptionValue("size","32",Sirikata::OptionValueType<uint32>(),"Size of each datagram in bytes"),
+        window=new OptionValue("window","1000",Sirikata::OptionValueType<uint32>(),"Maximum number of datagrams sent but not yet received. Should stay below SST's segment queue limit, which silently drops datagrams."),
+        stream_bytes=new OptionValue("bytes","2000000",Sirikata::OptionValueType<uint32>(),"Number of bytes to transfer in stream mode"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("SSTLoopbackBenchmark",this);
+    optionsSet->parse(param);
+
+    mStreamMode = (mode->as<String>() == "stream");
+    std::vector<String> rates = loss_rates->as<std::vector<String> >();
+    for(uint32 i = 0; i < rates.size(); i++) {
+        float32 rate = std::max(0.f, std::min(boost::lexical_cast<float32>(rates[i]), 0.99f));
+        mLossRates.push_back(rate);
+    }
+    if (mLossRates.empty())
+        mLossRates.push_back(0.f);
+    mNumDatagrams = num_datagrams->as<uint32>();
+    mDatagramSize = std::max(datagram_size->as<uint32>(), (uint32)1);
+    mWindow = std::max(window->as<uint32>(), (uint32)1);
+    mStreamBytes = stream_bytes->as<uint32>();
+}
+
+String SSTLoopbackBenchmark::name() {
+    return mName;
+}
+
+ODP::DelegatePort* SSTLoopbackBenchmark::createPort(ODP::DelegateService* parentService, const SpaceObjectReference& sor, ODP::PortID port) {
+    ODP::Endpoint port_ep(sor, port);
+    return new ODP::DelegatePort(
+        parentService,
+        port_ep,
+        std::tr1::bind(
+            &SSTLoopbackBenchmark::sendPacket, this,
+            port_ep, _1, _2
+        )
+    );
+}
+
+bool SSTLoopbackBenchmark::sendPacket(const ODP::Endpoint& src, const ODP::Endpoint& dst, MemoryReference payload) {
+    // Only drop once the transfer starts so connection setup isn't affected
+    if (mTransferring && mLossRate > 0.f && randFloat() < mLossRate) {
+        mPacketsDropped++;
+        return true;
+    }
+
+    // Always bounce through the strand: SST sends while holding locks that
+    // the receive path needs.
+    mIOStrand->post(
+        std::tr1::bind(
+            &SSTLoopbackBenchmark::deliverPacket, this,
+            src, dst, String((const char*)payload.data(), payload.size())
+        )
+    );
+    return true;
+}
+
+void SSTLoopbackBenchmark::deliverPacket(const ODP::Endpoint& src, const ODP::Endpoint& dst, const String& payload) {
+    mPacketsDelivered++;
+    mODP->deliver(src, dst, MemoryReference(payload.data(), payload.size()));
+}
+
+void SSTLoopbackBenchmark::listenerStream(int err, SSTStreamPtr s) {
+    if (err != SST_IMPL_SUCCESS) {
+        SILOG(benchmark,error,"SST loopback listener failed to accept stream");
+        finish();
+        return;
+    }
+
+    mReceiveStream = s;
+    if (mStreamMode) {
+        s->registerReadCallback(
+            std::tr1::bind(&SSTLoopbackBenchmark::receivedStreamData, this, _1, _2)
+        );
+    }
+    else {
+        SSTConnectionPtr conn = s->connection().lock();
+        conn->registerReadDatagramCallback(
+            SST_LOOPBACK_DATAGRAM_PORT,
+            std::tr1::bind(&SSTLoopbackBenchmark::receivedDatagram, this, _1, _2)
+        );
+    }
+}
+
+void SSTLoopbackBenchmark::senderStream(int err, SSTStreamPtr s) {
+    if (err != SST_IMPL_SUCCESS) {
+        SILOG(benchmark,error,"SST loopback sender failed to connect");
+        finish();
+        return;
+    }
+
+    mSendStream = s;
+    mStartTime = Timer::now();
+    mTransferring = true;
+    if (mStreamMode)
+        writeStream();
+    else
+        sendDatagrams();
+}
+
+void SSTLoopbackBenchmark::sendDatagrams() {
+    mSendScheduled = false;
+    if (mForceStop || !mSendStream) return;
+
+    SSTConnectionPtr conn = mSendStream->connection().lock();
+    if (!conn) return;
+
+    while(mSent < mNumDatagrams && mSent - mReceived < mWindow) {
+        if (!conn->datagram(&mPayload[0], mPayload.size(), SST_LOOPBACK_DATAGRAM_PORT, SST_LOOPBACK_DATAGRAM_PORT, NULL))
+            break;
+        mSent++;
+    }
+}
+
+void SSTLoopbackBenchmark::receivedDatagram(uint8* data, int size) {
+    mReceived++;
+
+    if (mReceived >= mNumDatagrams) {
+        Duration dur = Timer::now() - mStartTime;
+        SILOG(benchmark,info,
+              mReceived << " datagrams of " << mDatagramSize << " bytes in " << dur << ": "
+              << mReceived / dur.toSeconds() << " datagrams/s, "
+              << mPacketsDelivered / dur.toSeconds() << " packets/s");
+        finish();
+        return;
+    }
+
+    // Top up once half the window has drained
+    if (!mSendScheduled && mSent - mReceived <= mWindow / 2) {
+        mSendScheduled = true;
+        mIOStrand->post(std::tr1::bind(&SSTLoopbackBenchmark::sendDatagrams, this));
+    }
+}
+
+void SSTLoopbackBenchmark::writeStream() {
+    if (mForceStop || !mSendStream) return;
+
+    while(mSent < mStreamBytes) {
+        int len = std::min((uint32)mPayload.size(), mStreamBytes - mSent);
+        int written = mSendStream->write(&mPayload[0], len);
+        if (written < 0) {
+            SILOG(benchmark,error,"SST loopback stream write failed");
+            finish();
+            return;
+        }
+        if (written == 0) {
+            // Send queue is full, try again shortly
+            mIOStrand->post(Duration::milliseconds((int64)1), std::tr1::bind(&SSTLoopbackBenchmark::writeStream, this));
+            return;
+        }
+        mSent += written;
+    }
+}
+
+void SSTLoopbackBenchmark::receivedStreamData(uint8* data, int size) {
+    mReceived += size;
+
+    if (mReceived >= mStreamBytes) {
+        Duration dur = Timer::now() - mStartTime;
+        SILOG(benchmark,info,
+              "loss " << mLossRate*100.f << "%: " << mReceived << " bytes in " << dur << ": "
+              << (mReceived / dur.toSeconds())/(1024.0*1024.0) << " MB/s, "
+              << mPacketsDropped << " of " << (mPacketsDelivered + mPacketsDropped) << " packets dropped");
+        finish();
+    }
+}
+
+void SSTLoopbackBenchmark::finish() {
+    mTransferring = false;
+    mIOService->stop();
+}
+
+void SSTLoopbackBenchmark::run(float32 loss_rate) {
+    mLossRate = loss_rate;
+    mSent = 0;
+    mReceived = 0;
+    mPacketsDelivered = 0;
+    mPacketsDropped = 0;
+    mSendScheduled = false;
+    mTransferring = false;
+
+    {
+        boost::mutex::scoped_lock lock(mIOServiceMutex);
+        if (mForceStop) return;
+        mIOService = Network::IOServiceFactory::makeIOService();
+        mIOStrand = mIOService->createStrand();
+    }
+    mContext = new Context("SSTLoopbackBenchmark", mIOService, mIOStrand, NULL, Timer::now());
+
+    // Fresh endpoints each run since SST never forgets datagram layers
+    SpaceObjectReference sender(SpaceID::null(), ObjectReference(UUID::random()));
+    SpaceObjectReference receiver(SpaceID::null(), ObjectReference(UUID::random()));
+    SSTDatagramLayer::createDatagramLayer(sender, mContext, mODP);
+    SSTDatagramLayer::createDatagramLayer(receiver, mContext, mODP);
+
+    SSTStream::listen(
+        std::tr1::bind(&SSTLoopbackBenchmark::listenerStream, this, _1, _2),
+        SSTEndpoint(receiver, SST_LOOPBACK_LISTEN_PORT)
+    );
+    SSTStream::connectStream(
+        SSTEndpoint(sender, 0),
+        SSTEndpoint(receiver, SST_LOOPBACK_LISTEN_PORT),
+        std::tr1::bind(&SSTLoopbackBenchmark::senderStream, this, _1, _2)
+    );
+
+    mIOService->run();
+
+    uint32 total = mStreamMode ? mStreamBytes : mNumDatagrams;
+    if (mReceived < total)
+        SILOG(benchmark,info,"Stopped after receiving " << mReceived << " of " << total << (mStreamMode ? " bytes" : " datagrams"));
+
+    if (mStreamMode) {
+        std::vector<SSTConnectionStats> conn_stats;
+        SSTConnectionManager::getStats(&conn_stats);
+        uint64 retransmits = 0, fast_retransmits = 0, timeouts = 0;
+        for(uint32 ci = 0; ci < conn_stats.size(); ci++) {
+            for(uint32 si = 0; si < conn_stats[ci].streams.size(); si++) {
+                const SSTStreamStats& stream_stats = conn_stats[ci].streams[si];
+                retransmits += stream_stats.numRetransmits;
+                fast_retransmits += stream_stats.numFastRetransmits;
+                timeouts += stream_stats.numTimeouts;
+            }
+        }
+        SILOG(benchmark,info,
+              "  " << retransmits << " buffers retransmitted (" << fast_retransmits << " fast), "
+              << timeouts << " timeouts");
+    }
+
+    // Tear down while the ODP service is still around, pending handlers hold
+    // the last references to the connections
+    if (mSendStream) mSendStream->close(true);
+    if (mReceiveStream) mReceiveStream->close(true);
+    mSendStream.reset();
+    mReceiveStream.reset();
+    SSTConnectionManager sst_connections;
+    sst_connections.stop();
+
+    delete mContext;
+    mContext = NULL;
+    {
+        boost::mutex::scoped_lock lock(mIOServiceMutex);
+        delete mIOStrand;
+        mIOStrand = NULL;
+        Network::IOServiceFactory::destroyIOService(mIOService);
+        mIOService = NULL;
+    }
+}
+
+void SSTLoopbackBenchmark::start() {
+    mForceStop = false;
+
+    mPayload.resize(mStreamMode ? 65536 : mDatagramSize);
+    for(uint32 i = 0; i < mPayload.size(); i++)
+        mPayload[i] = (uint8)(rand() & 0xff);
+
+    if (mODP == NULL) {
+        mODP = new ODP::DelegateService(
+            std::tr1::bind(&SSTLoopbackBenchmark::createPort, this, _1, _2, _3)
+        );
+    }
+
+    for(uint32 i = 0; i < mLossRates.size() && !mForceStop; i++)
+        run(mLossRates[i]);
+
+    notifyFinished();
+}
+
+void SSTLoopbackBenchmark::stop() {
+    mForceStop = true;
+    boost::mutex::scoped_lock lock(mIOServiceMutex);
+    if (mIOService)
+        mIOService->stop();
+}
+
+} // namespace Sirikata
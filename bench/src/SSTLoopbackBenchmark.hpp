@@ -0,0 +1,132 @@
+/*  Sirikata
+ *  SSTLoopbackBenchmark.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SIRIKATA_SST_LOOPBACK_BENCHMARK_HPP_
+#define _SIRIKATA_SST_LOOPBACK_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/core/network/SSTImpl.hpp>
+#include <sirikata/core/odp/DelegateService.hpp>
+#include <sirikata/core/odp/DelegatePort.hpp>
+
+namespace Sirikata {
+
+/** SSTLoopbackBenchmark pushes data through an SST connection between two
+ *  endpoints in the same process. The BaseDatagramLayer sits on an ODP
+ *  service which just hands packets back to itself, so the result measures
+ *  SST's own overhead rather than any real network.
+ *
+ *  In datagram mode (sst-loopback) it sends a large number of small
+ *  datagrams, exercising the per-packet path: connection and stream lookups,
+ *  outstanding segment tracking, acks. In stream mode (sst-loss) it transfers
+ *  a block of data over a reliable stream while the loopback drops a fraction
+ *  of packets, once for each requested loss rate, to show how well
+ *  retransmission copes.
+ */
+class SSTLoopbackBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new SSTLoopbackBenchmark(finished_cb, param, false);
+    }
+    static Benchmark* createLoss(const FinishedCallback& finished_cb, const String& param) {
+        return new SSTLoopbackBenchmark(finished_cb, param, true);
+    }
+
+    SSTLoopbackBenchmark(const FinishedCallback& finished_cb, const String& param, bool loss);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    typedef Stream<SpaceObjectReference> SSTStream;
+    typedef SSTStream::Ptr SSTStreamPtr;
+    typedef Connection<SpaceObjectReference> SSTConnection;
+    typedef SSTConnection::Ptr SSTConnectionPtr;
+    typedef EndPoint<SpaceObjectReference> SSTEndpoint;
+    typedef BaseDatagramLayer<SpaceObjectReference> SSTDatagramLayer;
+
+    // Loopback ODP service
+    ODP::DelegatePort* createPort(ODP::DelegateService* parentService, const SpaceObjectReference& sor, ODP::PortID port);
+    bool sendPacket(const ODP::Endpoint& src, const ODP::Endpoint& dst, MemoryReference payload);
+    void deliverPacket(const ODP::Endpoint& src, const ODP::Endpoint& dst, const String& payload);
+
+    // Sets up a fresh pair of endpoints and runs one transfer with the given
+    // packet loss rate
+    void run(float32 loss_rate);
+
+    void listenerStream(int err, SSTStreamPtr s);
+    void senderStream(int err, SSTStreamPtr s);
+    void sendDatagrams();
+    void receivedDatagram(uint8* data, int size);
+    void writeStream();
+    void receivedStreamData(uint8* data, int size);
+    void finish();
+
+    bool mForceStop;
+    String mName;
+    bool mStreamMode;
+    std::vector<float32> mLossRates;
+    uint32 mNumDatagrams;
+    uint32 mDatagramSize;
+    uint32 mWindow;
+    uint32 mStreamBytes;
+
+    boost::mutex mIOServiceMutex;
+    Network::IOService* mIOService;
+    Network::IOStrand* mIOStrand;
+    Context* mContext;
+    // Backs the datagram layers, which SST keeps in a static map, so it has
+    // to live as long as the process does.
+    ODP::DelegateService* mODP;
+
+    SSTStreamPtr mSendStream;
+    SSTStreamPtr mReceiveStream;
+    std::vector<uint8> mPayload;
+
+    float32 mLossRate;
+    uint32 mSent;
+    uint32 mReceived;
+    uint32 mPacketsDelivered;
+    uint32 mPacketsDropped;
+    bool mSendScheduled;
+    bool mTransferring;
+    Time mStartTime;
+}; // class SSTLoopbackBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SST_LOOPBACK_BENCHMARK_HPP_
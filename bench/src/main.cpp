@@ -36,6 +36,14 @@
 #include "TimerJitterBenchmark.hpp"
 #include "TimerMonotonicityBenchmark.hpp"
 #include "TCPSSTBenchmark.hpp"
+#include "LocationExtrapolationBenchmark.hpp"
+#include "ProxEncodingBenchmark.hpp"
+#include "QueueContentionBenchmark.hpp"
+#include "FairQueueBenchmark.hpp"
+#include "Base64Benchmark.hpp"
+#include "SSTLoopbackBenchmark.hpp"
+#include "CSegLookupBenchmark.hpp"
+#include "OSegCacheBenchmark.hpp"
 
 #include <sirikata/core/util/DynamicLibrary.hpp>
 
@@ -67,6 +75,15 @@ int main(int argc, char** argv) {
     ADD_BENCHMARK(timer-monotonicity, TimerMonotonicityBenchmark::create);
 
     ADD_BENCHMARK(ping, SSTBenchmark::create);
+    ADD_BENCHMARK(loc-extrapolation, LocationExtrapolationBenchmark::create);
+    ADD_BENCHMARK(prox-encoding, ProxEncodingBenchmark::create);
+    ADD_BENCHMARK(queue-contention, QueueContentionBenchmark::create);
+    ADD_BENCHMARK(fair-queue, FairQueueBenchmark::create);
+    ADD_BENCHMARK(base64, Base64Benchmark::create);
+    ADD_BENCHMARK(sst-loopback, SSTLoopbackBenchmark::create);
+    ADD_BENCHMARK(sst-loss, SSTLoopbackBenchmark::createLoss);
+    ADD_BENCHMARK(cseg-lookup, CSegLookupBenchmark::create);
+    ADD_BENCHMARK(oseg-cache, OSegCacheBenchmark::create);
     BenchmarkRunner runner(factory, Duration::seconds(30.f));
 
 
@@ -1,5 +1,5 @@
 MACRO(ADD_CXXTEST_CPP_TARGET)
-  PARSE_ARGUMENTS(CXXTEST "DEPENDS;OUTPUTDIR;LIBRARYDIR" "" ${ARGN})
+  PARSE_ARGUMENTS(CXXTEST "DEPENDS;OUTPUTDIR;LIBRARYDIR;OUTPUT" "" ${ARGN})
   CAR(CXXTEST_NAME ${CXXTEST_DEFAULT_ARGS})
   CDR(CXXTEST_FILES ${CXXTEST_DEFAULT_ARGS})
 
@@ -10,7 +10,10 @@ MACRO(ADD_CXXTEST_CPP_TARGET)
   #IF(CXXTEST_OUTPUTDIR)
   #  SET(CXXTEST_OPTIONS ${CXXTEST_OPTIONS} -o ${CXXTEST_OUTPUTDIR})
   #ENDIF(CXXTEST_OUTPUTDIR)
-  SET(CXXTEST_CPP_FILE ${CMAKE_CURRENT_BINARY_DIR}/test.cc)
+  IF(NOT CXXTEST_OUTPUT)
+    SET(CXXTEST_OUTPUT test.cc)
+  ENDIF()
+  SET(CXXTEST_CPP_FILE ${CMAKE_CURRENT_BINARY_DIR}/${CXXTEST_OUTPUT})
 
   IF(PYTHON_EXECUTABLE)
     SET(CXXTEST_COMPILER ${PYTHON_EXECUTABLE})
@@ -18,7 +21,7 @@ MACRO(ADD_CXXTEST_CPP_TARGET)
   ELSE()
     FIND_PACKAGE(Perl)
     IF(PERL_EXECUTABLE)
-      SET(CXXTEST_CPP_FILE test.cc)      #perl cannot output to a full path.
+      SET(CXXTEST_CPP_FILE ${CXXTEST_OUTPUT})      #perl cannot output to a full path.
       SET(CXXTEST_COMPILER ${PERL_EXECUTABLE})
       SET(CXXTEST_GEN ${CXXTEST_LIBRARYDIR}/cxxtestgen.pl)
     ELSE()
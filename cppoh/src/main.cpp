@@ -134,7 +134,12 @@ int main (int argc, char** argv) {
     Trace::TimeSeries* time_series = Trace::TimeSeriesFactory::getSingleton().getConstructor(timeseries_type)(ctx, timeseries_options);
 
 
-    SSTConnectionManager* sstConnMgr = new SSTConnectionManager();
+    SSTConnectionManager* sstConnMgr = new SSTConnectionManager(
+        ctx,
+        GetOptionValue<Duration>(OPT_SST_STATS_INTERVAL),
+        String("oh") + boost::lexical_cast<String>(oh_id) + ".sst",
+        GetOptionValue<bool>(OPT_SST_STATS_PER_CONNECTION)
+    );
 
     SpaceID mainSpace(GetOptionValue<UUID>(OPT_MAIN_SPACE));
 
@@ -0,0 +1,201 @@
+/*  Sirikata
+ *  ProxCompactEncoding.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_LIBCORE_NETWORK_PROX_COMPACT_ENCODING_HPP_
+#define _SIRIKATA_LIBCORE_NETWORK_PROX_COMPACT_ENCODING_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/UUID.hpp>
+#include <sirikata/core/util/MotionVector.hpp>
+#include <sirikata/core/util/MotionQuaternion.hpp>
+#include <sirikata/core/util/BoundingSphere.hpp>
+
+namespace Sirikata {
+
+namespace Protocol {
+namespace Prox {
+class ProximityResults;
+}
+}
+
+namespace Network {
+
+/** Compact encoding for proximity results sent on a prox stream, an
+ *  alternative to serializing Protocol::Prox::ProximityResults.
+ *
+ *  Positions are quantized relative to a reference point (normally the
+ *  querier), objects are referred to by an index into a per-stream UUID
+ *  dictionary after their first appearance, and mesh URIs are interned per
+ *  stream. Both ends therefore have to see every message on the stream, in
+ *  order. The dictionaries have a fixed size. Once one is full the encoder
+ *  picks which slot to reuse, and the decoder just stores new entries at the
+ *  slot they're sent with, so it never needs more than that much space.
+ *
+ *  Encoded messages start with a byte that can't start a valid protocol
+ *  buffer, so they can be distinguished from regular results. A client
+ *  requests the encoding by sending hello() on the prox stream.
+ */
+class SIRIKATA_EXPORT ProxCompactEncoding {
+public:
+    enum {
+        Magic = 0xFF,
+        Version = 2
+    };
+
+    /** Default dictionary sizes. */
+    enum {
+        MaxObjects = 16384,
+        MaxMeshes = 4096
+    };
+
+    /** Message a client sends to request the compact encoding. */
+    static std::string hello();
+    /** Returns true if the message is a request for the compact encoding. */
+    static bool isHello(const std::string& msg);
+    /** Returns true if the message uses the compact encoding. */
+    static bool isCompact(const std::string& msg);
+};
+
+/** Encodes proximity results. Each message is built with begin(), any number
+ *  of addRemoval() and addAddition() calls, and finish(). Removals are always
+ *  applied before additions in the decoded result.
+ */
+class SIRIKATA_EXPORT ProxCompactEncoder {
+public:
+    /** step is the position quantization step, in meters. max_objects and
+     *  max_meshes are the dictionary sizes, which must not be larger than the
+     *  decoder's.
+     */
+    ProxCompactEncoder(float32 step = 0.01f, uint32 max_objects = ProxCompactEncoding::MaxObjects, uint32 max_meshes = ProxCompactEncoding::MaxMeshes);
+
+    void begin(const Time& t, const Vector3f& reference);
+    void addRemoval(const UUID& objid);
+    void addAddition(const UUID& objid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics);
+    std::string finish();
+
+private:
+    void writeObject(const UUID& objid, std::string& out);
+
+    // Fixed size dictionary. Entries take the next free slot until it fills
+    // up, after which slots are reused in CLOCK order, passing over entries
+    // used since the hand last went by.
+    template<typename KeyType, typename HasherType>
+    class Dictionary {
+    public:
+        Dictionary(uint32 capacity)
+         : mCapacity(capacity),
+           mHand(0)
+        {
+            assert(mCapacity > 0);
+        }
+
+        /** Looks up the slot for key, assigning one if it isn't present.
+         *  Returns true if key was newly added.
+         */
+        bool lookup(const KeyType& key, uint32* slot) {
+            typename IndexMap::iterator it = mIndex.find(key);
+            if (it != mIndex.end()) {
+                mReferenced[it->second] = true;
+                *slot = it->second;
+                return false;
+            }
+
+            uint32 idx;
+            if (mKeys.size() < mCapacity) {
+                idx = mKeys.size();
+                mKeys.push_back(key);
+                mReferenced.push_back(false);
+            }
+            else {
+                while(mReferenced[mHand]) {
+                    mReferenced[mHand] = false;
+                    mHand = (mHand + 1) % mCapacity;
+                }
+                idx = mHand;
+                mHand = (mHand + 1) % mCapacity;
+                mIndex.erase(mKeys[idx]);
+                mKeys[idx] = key;
+            }
+            mIndex[key] = idx;
+            *slot = idx;
+            return true;
+        }
+    private:
+        typedef std::tr1::unordered_map<KeyType, uint32, HasherType> IndexMap;
+        IndexMap mIndex;
+        std::vector<KeyType> mKeys;
+        std::vector<bool> mReferenced;
+        uint32 mCapacity;
+        uint32 mHand;
+    };
+
+    float32 mStep;
+    Dictionary<UUID, UUID::Hasher> mObjects;
+    Dictionary< String, std::tr1::hash<String> > mMeshes;
+
+    // Current message. Additions are stored as the object and the offset of
+    // the rest of its data in mAdditionData.
+    typedef std::vector<UUID> ObjectList;
+    typedef std::vector< std::pair<UUID, uint32> > AdditionList;
+    Time mTime;
+    Vector3f mReference;
+    ObjectList mRemovals;
+    AdditionList mAdditions;
+    std::string mAdditionData;
+};
+
+/** Decodes messages produced by ProxCompactEncoder into the equivalent
+ *  Protocol::Prox::ProximityResults.
+ */
+class SIRIKATA_EXPORT ProxCompactDecoder {
+public:
+    /** max_objects and max_meshes are the dictionary sizes. Messages which
+     *  refer to slots past them are rejected.
+     */
+    ProxCompactDecoder(uint32 max_objects = ProxCompactEncoding::MaxObjects, uint32 max_meshes = ProxCompactEncoding::MaxMeshes);
+
+    /** Decode msg into results. Returns false if the message is invalid, in
+     *  which case the decoder's state can't be trusted anymore.
+     */
+    bool decode(const std::string& msg, Sirikata::Protocol::Prox::ProximityResults* results);
+
+private:
+    uint32 mMaxObjects;
+    uint32 mMaxMeshes;
+    std::vector<UUID> mObjects;
+    std::vector<String> mMeshes;
+};
+
+} // namespace Network
+} // namespace Sirikata
+
+#endif //_SIRIKATA_LIBCORE_NETWORK_PROX_COMPACT_ENCODING_HPP_
@@ -0,0 +1,178 @@
+/*  Sirikata
+ *  SSTCongestionControl.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_SST_CONGESTION_CONTROL_HPP_
+#define _SIRIKATA_SST_CONGESTION_CONTROL_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/Time.hpp>
+
+namespace Sirikata {
+
+/** Smoothed round trip time and retransmission timeout estimation, following
+ *  RFC 6298. Callers are responsible for Karn's algorithm, i.e. not providing
+ *  samples from retransmitted packets.
+ */
+class SIRIKATA_EXPORT RTTEstimator {
+public:
+    RTTEstimator(const Duration& initial_rto = Duration::seconds(1),
+        const Duration& min_rto = Duration::milliseconds((int64)200),
+        const Duration& max_rto = Duration::seconds(20));
+
+    void sample(const Duration& rtt);
+    /** Double the RTO after a retransmission timeout. The backoff is cleared
+     *  by the next sample.
+     */
+    void backoff();
+
+    bool hasSample() const { return mHasSample; }
+    Duration smoothed() const { return Duration::microseconds(mSmoothed); }
+    Duration variance() const { return Duration::microseconds(mVariance); }
+    Duration latest() const { return Duration::microseconds(mLatest); }
+    /** Smallest sample seen, used as the propagation delay estimate by delay
+     *  based congestion control.
+     */
+    Duration minimum() const { return Duration::microseconds(mMinimum); }
+    Duration rto() const;
+
+private:
+    int64 mMinRTO;
+    int64 mMaxRTO;
+    int64 mInitialRTO;
+
+    bool mHasSample;
+    int64 mSmoothed;
+    int64 mVariance;
+    int64 mLatest;
+    int64 mMinimum;
+    uint32 mBackoff;
+};
+
+/** Interface for SST congestion control algorithms. Implementations maintain a
+ *  congestion window in bytes which, together with the receiver's advertised
+ *  window, bounds the amount of unacknowledged data a Stream may have
+ *  outstanding.
+ */
+class SIRIKATA_EXPORT SSTCongestionControl {
+public:
+    /** Create an algorithm by name, "aimd" (slow start and additive increase,
+     *  multiplicative decrease, i.e. Reno), "delay" (a Vegas style variant
+     *  which backs off as queueing delay builds) or "none" (no congestion
+     *  control, only the receive window applies). Returns NULL for unknown
+     *  names.
+     */
+    static SSTCongestionControl* create(const String& algorithm, uint32 mss);
+
+    SSTCongestionControl(uint32 mss);
+    virtual ~SSTCongestionControl() {}
+
+    virtual const char* name() const = 0;
+
+    /** Called when acked_bytes of new data were acknowledged. rtt holds the
+     *  estimator's state, including the sample from this ack if there was
+     *  one.
+     */
+    virtual void onAck(uint32 acked_bytes, const RTTEstimator& rtt) = 0;
+    /** Called when loss is detected while data is still being acknowledged,
+     *  e.g. from duplicate acks.
+     */
+    virtual void onLoss();
+    /** Called when the retransmission timer expires. */
+    virtual void onTimeout();
+
+    uint32 window() const { return mWindow; }
+    uint32 slowStartThreshold() const { return mSlowStartThreshold; }
+    bool inSlowStart() const { return mWindow < mSlowStartThreshold; }
+
+protected:
+    // RFC 5681 initial window, between 2 and 4 segments depending on size
+    uint32 initialWindow() const;
+
+    uint32 mMSS;
+    uint32 mWindow;
+    uint32 mSlowStartThreshold;
+};
+
+/** Slow start followed by additive increase, multiplicative decrease (RFC
+ *  5681, without fast recovery).
+ */
+class SIRIKATA_EXPORT AIMDCongestionControl : public SSTCongestionControl {
+public:
+    AIMDCongestionControl(uint32 mss);
+
+    virtual const char* name() const { return "aimd"; }
+    virtual void onAck(uint32 acked_bytes, const RTTEstimator& rtt);
+
+private:
+    // Bytes acked since the window last grew during congestion avoidance
+    uint32 mAckedBytes;
+};
+
+/** Delay based congestion control in the style of TCP Vegas. Once per round
+ *  trip it compares the expected throughput, window / minimum RTT, with the
+ *  actual throughput, window / current RTT, and grows or shrinks the window by
+ *  a segment to keep between ALPHA and BETA segments queued in the network.
+ *  Losses are handled as in AIMD.
+ */
+class SIRIKATA_EXPORT DelayCongestionControl : public SSTCongestionControl {
+public:
+    enum {
+        ALPHA = 2,
+        BETA = 4,
+        // Leave slow start once this many segments are queued
+        GAMMA = 1
+    };
+
+    DelayCongestionControl(uint32 mss);
+
+    virtual const char* name() const { return "delay"; }
+    virtual void onAck(uint32 acked_bytes, const RTTEstimator& rtt);
+
+private:
+    // Bytes acked in the current round trip
+    uint32 mAckedBytes;
+};
+
+/** No congestion control, the window is effectively unlimited. */
+class SIRIKATA_EXPORT NullCongestionControl : public SSTCongestionControl {
+public:
+    NullCongestionControl(uint32 mss);
+
+    virtual const char* name() const { return "none"; }
+    virtual void onAck(uint32 acked_bytes, const RTTEstimator& rtt) {}
+    virtual void onLoss() {}
+    virtual void onTimeout() {}
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SST_CONGESTION_CONTROL_HPP_
@@ -53,8 +53,13 @@
 #include <sirikata/core/util/SerializationCheck.hpp>
 
 #include <sirikata/core/network/Message.hpp>
+#include <sirikata/core/network/SSTCongestionControl.hpp>
+#include <sirikata/core/network/SSTSequenceRing.hpp>
+#include <sirikata/core/network/SSTSelectiveAck.hpp>
+#include <sirikata/core/network/SSTSegmentScheduler.hpp>
 
 #include "Protocol_SSTHeader.pbj.hpp"
+#include "Protocol_SSTAck.pbj.hpp"
 
 namespace Sirikata {
 
@@ -80,6 +85,17 @@ public:
     return this->port < ep.port ;
   }
 
+  bool operator==(const EndPoint &ep) const {
+    return port == ep.port && endPoint == ep.endPoint;
+  }
+
+  class Hasher {
+  public:
+    size_t operator() (const EndPoint& ep) const {
+      return typename EndObjectType::Hasher()(ep.endPoint) ^ (ep.port * 2654435761u);
+    }
+  };
+
     std::string toString() const {
         return endPoint.toString() + boost::lexical_cast<std::string>(port);
     }
@@ -235,7 +251,7 @@ class SIRIKATA_EXPORT BaseDatagramLayer
     const Context* mContext;
     ODP::Service* mODP;
 
-    typedef std::map<EndPoint<EndPointType>, ODP::Port*> PortMap;
+    typedef std::tr1::unordered_map<EndPoint<EndPointType>, ODP::Port*, typename EndPoint<EndPointType>::Hasher> PortMap;
     PortMap mAllocatedPorts;
 
     boost::mutex mMutex;
@@ -276,12 +292,15 @@ public:
 
   Time mTransmitTime;
   Time mAckTime;
+  // RTT samples are only taken from segments sent once (Karn's algorithm)
+  uint16 mNumTransmissions;
 
   ChannelSegment( const void* data, int len, uint64 channelSeqNum, uint64 ackSequenceNum) :
                                                mBufferLength(len),
 					      mChannelSequenceNumber(channelSeqNum),
 					      mAckSequenceNumber(ackSequenceNum),
-					      mTransmitTime(Time::null()), mAckTime(Time::null())
+					      mTransmitTime(Time::null()), mAckTime(Time::null()),
+					      mNumTransmissions(0)
   {
     mBuffer = new uint8[len];
     memcpy( mBuffer, (const uint8*) data, len);
@@ -297,6 +316,72 @@ public:
 
 };
 
+/* Snapshot of the transport state of a Stream. */
+struct SSTStreamStats {
+  SSTStreamStats()
+   : lsid(0), remoteLSID(0), localPort(0), remotePort(0), state(0),
+     priority(0), congestionWindow(0), peerReceiveWindow(0),
+     outstandingBytes(0), outstandingBuffers(0), queuedBytes(0),
+     queuedBuffers(0), bytesSent(0), numRetransmits(0),
+     numFastRetransmits(0), numTimeouts(0)
+  {}
+
+  LSID lsid;
+  LSID remoteLSID;
+  uint16 localPort;
+  uint16 remotePort;
+  uint8 state;
+  int priority;
+
+  String congestionControl;
+  uint32 congestionWindow;   // bytes
+  uint32 peerReceiveWindow;  // bytes
+
+  uint32 outstandingBytes;   // sent but not yet acked
+  uint32 outstandingBuffers;
+  uint32 queuedBytes;        // waiting to be sent, including retransmissions
+  uint32 queuedBuffers;
+
+  uint64 bytesSent;          // total accepted from the application
+  uint64 numRetransmits;     // buffers sent again, for any reason
+  uint64 numFastRetransmits; // retransmissions triggered by duplicate acks
+  uint64 numTimeouts;        // retransmission timeouts with data outstanding
+};
+
+/* Snapshot of the transport state of a Connection and its Streams. */
+struct SSTConnectionStats {
+  typedef SegmentScheduler< std::tr1::shared_ptr<ChannelSegment> >::DelayStats QueueingDelayStats;
+
+  SSTConnectionStats()
+   : state(0), hasRTTSample(false), smoothedRTT(Duration::zero()),
+     rttVariance(Duration::zero()), rto(Duration::zero()),
+     congestionWindow(0), outstandingSegments(0), queuedSegments(0),
+     segmentsSent(0), numTimeouts(0)
+  {}
+
+  String localEndPoint;
+  String remoteEndPoint;
+  uint8 state;
+
+  bool hasRTTSample;
+  Duration smoothedRTT;
+  Duration rttVariance;
+  Duration rto;
+
+  uint16 congestionWindow;     // segments
+  uint32 outstandingSegments;  // sent but not yet acked
+  uint32 queuedSegments;       // waiting to be sent
+
+  uint64 segmentsSent;
+  uint64 numTimeouts;
+
+  // Queueing delay in the send queue, one entry per stream priority starting
+  // from the lowest
+  std::vector<QueueingDelayStats> queueingDelay;
+
+  std::vector<SSTStreamStats> streams;
+};
+
 template <class EndPointType>
 class SIRIKATA_EXPORT Connection {
   public:
@@ -311,13 +396,18 @@ private:
   friend class SSTConnectionManager;
   friend class BaseDatagramLayer<EndPointType>;
 
-  typedef std::map<EndPoint<EndPointType>, std::tr1::shared_ptr<Connection> >  ConnectionMap;
-  typedef std::map<EndPoint<EndPointType>, ConnectionReturnCallbackFunction>  ConnectionReturnCallbackMap;
-  typedef std::map<EndPoint<EndPointType>, StreamReturnCallbackFunction>   StreamReturnCallbackMap;
+  typedef typename EndPoint<EndPointType>::Hasher EndPointHasher;
+  typedef std::tr1::unordered_map<EndPoint<EndPointType>, std::tr1::shared_ptr<Connection>, EndPointHasher>  ConnectionMap;
+  typedef std::tr1::unordered_map<EndPoint<EndPointType>, ConnectionReturnCallbackFunction, EndPointHasher>  ConnectionReturnCallbackMap;
+  typedef std::tr1::unordered_map<EndPoint<EndPointType>, StreamReturnCallbackFunction, EndPointHasher>   StreamReturnCallbackMap;
 
 
   static ConnectionMap sConnectionMap;
   static std::bitset<65536> sAvailableChannels;
+  // Channels released since startup, reused before unallocated ones
+  static std::vector<uint16> sReleasedChannels;
+  // Highest channel that has never been handed out
+  static uint32 sNextUnusedChannel;
 
   static ConnectionReturnCallbackMap sConnectionReturnCallbackMap;
   static StreamReturnCallbackMap  sListeningConnectionsCallbackMap;
@@ -337,37 +427,42 @@ private:
   uint64 mTransmitSequenceNumber;
   uint64 mLastReceivedSequenceNumber;   //the last transmit sequence number received from the other side
 
-  typedef std::map<LSID, std::tr1::shared_ptr< Stream<EndPointType> > > LSIDStreamMap;
-  std::map<LSID, std::tr1::shared_ptr< Stream<EndPointType> > > mOutgoingSubstreamMap;
-  std::map<LSID, std::tr1::shared_ptr< Stream<EndPointType> > > mIncomingSubstreamMap;
+  typedef std::tr1::unordered_map<LSID, std::tr1::shared_ptr< Stream<EndPointType> > > LSIDStreamMap;
+  LSIDStreamMap mOutgoingSubstreamMap;
+  LSIDStreamMap mIncomingSubstreamMap;
 
-  std::map<uint16, StreamReturnCallbackFunction> mListeningStreamsCallbackMap;
-  std::map<uint16, std::vector<ReadDatagramCallback> > mReadDatagramCallbacks;
+  std::tr1::unordered_map<uint16, StreamReturnCallbackFunction> mListeningStreamsCallbackMap;
+  std::tr1::unordered_map<uint16, std::vector<ReadDatagramCallback> > mReadDatagramCallbacks;
   typedef std::vector<std::string> PartialPayloadList;
-  typedef std::map<LSID, PartialPayloadList> PartialPayloadMap;
+  typedef std::tr1::unordered_map<LSID, PartialPayloadList> PartialPayloadMap;
   PartialPayloadMap mPartialReadDatagrams;
 
   uint16 mNumStreams;
 
-  std::deque< std::tr1::shared_ptr<ChannelSegment> > mQueuedSegments;
-  std::deque< std::tr1::shared_ptr<ChannelSegment> > mOutstandingSegments;
+  typedef SegmentScheduler< std::tr1::shared_ptr<ChannelSegment> > SegmentSchedulerType;
+  // Segments waiting to be sent, scheduled across substreams by priority
+  SegmentSchedulerType mQueuedSegments;
+  // Segments sent but not yet acked, indexed by channel sequence number
+  SequenceRing< std::tr1::shared_ptr<ChannelSegment> > mOutstandingSegments;
 
   uint16 mCwnd;
-  int64 mRTOMicroseconds; // RTO in microseconds
-  bool mFirstRTO;
+  // Round trip time estimate for the connection, shared by its streams
+  RTTEstimator mRTTEstimator;
 
   boost::mutex mQueueMutex;
 
   uint16 MAX_DATAGRAM_SIZE;
   uint16 MAX_PAYLOAD_SIZE;
   uint32 MAX_QUEUED_SEGMENTS;
-  float  CC_ALPHA;
   Time mLastTransmitTime;
 
   std::tr1::weak_ptr<Connection<EndPointType> > mWeakThis;
 
   uint16 mNumInitialRetransmissionAttempts;
 
+  uint64 mNumSegmentsSent;
+  uint64 mNumTimeouts;
+
   google::protobuf::LogSilencer logSilencer;
 
 private:
@@ -378,13 +473,15 @@ private:
       mState(CONNECTION_DISCONNECTED),
       mRemoteChannelID(0), mLocalChannelID(1), mTransmitSequenceNumber(1),
       mLastReceivedSequenceNumber(1),
-      mNumStreams(0), mCwnd(1), mRTOMicroseconds(10000000),
-      mFirstRTO(true),  MAX_DATAGRAM_SIZE(1000), MAX_PAYLOAD_SIZE(1300),
+      mNumStreams(0), mCwnd(1),
+      MAX_DATAGRAM_SIZE(1000), MAX_PAYLOAD_SIZE(1300),
       MAX_QUEUED_SEGMENTS(3000),
-      CC_ALPHA(0.8), mLastTransmitTime(Time::null()),
+      mLastTransmitTime(Time::null()),
       mNumInitialRetransmissionAttempts(0),
+      mNumSegmentsSent(0), mNumTimeouts(0),
       inSendingMode(true), numSegmentsSent(0)
   {
+      mQueuedSegments.setQuantum(MAX_PAYLOAD_SIZE);
       mDatagramLayer = BaseDatagramLayer<EndPointType>::getDatagramLayer(localEndPoint.endPoint);
       mDatagramLayer->listenOn(
           localEndPoint,
@@ -409,14 +506,24 @@ private:
     return mDatagramLayer->context();
   }
 
-  /* Returns -1 if no channel is available. Otherwise returns the lowest
-     available channel. */
+  /* Returns 0 if no channel is available. Otherwise returns the most recently
+     released channel, or the highest channel never used if none have been
+     released. */
   static int getAvailableChannel() {
-    //TODO: faster implementation.
-    for (uint32 i = sAvailableChannels.size() - 1; i>0; i--) {
-      if (!sAvailableChannels.test(i)) {
-	sAvailableChannels.set(i, 1);
-	return i;
+    while (!sReleasedChannels.empty()) {
+      uint16 channel = sReleasedChannels.back();
+      sReleasedChannels.pop_back();
+      if (!sAvailableChannels.test(channel)) {
+        sAvailableChannels.set(channel, 1);
+        return channel;
+      }
+    }
+
+    while (sNextUnusedChannel > 0) {
+      uint16 channel = sNextUnusedChannel--;
+      if (!sAvailableChannels.test(channel)) {
+        sAvailableChannels.set(channel, 1);
+        return channel;
       }
     }
 
@@ -426,7 +533,10 @@ private:
   static void releaseChannel(uint16 channel) {
     assert(channel > 0);
 
+    if (!sAvailableChannels.test(channel)) return;
+
     sAvailableChannels.set(channel, 0);
+    sReleasedChannels.push_back(channel);
   }
 
   bool inSendingMode; uint16 numSegmentsSent;
@@ -496,9 +606,11 @@ private:
           }
 
 	  segment->mTransmitTime = curTime;
-	  mOutstandingSegments.push_back(segment);
+	  segment->mNumTransmissions++;
+	  mOutstandingSegments.insert(segment->mChannelSequenceNumber, segment);
 
 	  numSegmentsSent++;
+	  mNumSegmentsSent++;
 
 	  mLastTransmitTime = curTime;
 
@@ -506,12 +618,12 @@ private:
           if (mState != CONNECTION_PENDING_CONNECT || mNumInitialRetransmissionAttempts > 3) {
 
             inSendingMode = false;
-            mQueuedSegments.pop_front();
+            mQueuedSegments.pop(curTime);
           }
       }
 
       if (!inSendingMode || mState == CONNECTION_PENDING_CONNECT) {
-        getContext()->mainStrand->post(Duration::microseconds(mRTOMicroseconds),
+        getContext()->mainStrand->post(mRTTEstimator.rto(),
                                        std::tr1::bind(&Connection<EndPointType>::serviceConnectionNoReturn, this, mWeakThis.lock()) );
       }
     }
@@ -528,6 +640,8 @@ private:
       }
 
       if (mOutstandingSegments.size() > 0) {
+        mNumTimeouts++;
+        mRTTEstimator.backoff();
         mCwnd /= 2;
 
         if (mCwnd < 1) {
@@ -689,7 +803,21 @@ private:
     mOutgoingSubstreamMap[lsid]=stream;
   }
 
+  // Segments the connection sends for itself, e.g. during setup, and
+  // datagrams are queued under flows no substream LSID can collide with.
+  enum {
+    CONNECTION_FLOW = 0x10000,
+    DATAGRAM_FLOW = 0x10001
+  };
+
   uint64 sendData(const void* data, uint32 length, bool isAck) {
+    return sendData(data, length, isAck, CONNECTION_FLOW, SegmentSchedulerType::MAX_PRIORITY);
+  }
+
+  /* Sends data on behalf of a flow, normally a substream identified by its
+     LSID. Queued segments from different flows are interleaved according to
+     their priorities. */
+  uint64 sendData(const void* data, uint32 length, bool isAck, uint32 flow, int priority) {
     boost::mutex::scoped_lock lock(mQueueMutex);
 
     assert(length <= MAX_PAYLOAD_SIZE);
@@ -718,8 +846,10 @@ private:
     }
     else {
       if (mQueuedSegments.size() < MAX_QUEUED_SEGMENTS) {
-        mQueuedSegments.push_back( std::tr1::shared_ptr<ChannelSegment>(
-                                   new ChannelSegment(data, length, mTransmitSequenceNumber, mLastReceivedSequenceNumber) ) );
+        mQueuedSegments.push(flow, priority,
+                             std::tr1::shared_ptr<ChannelSegment>(
+                               new ChannelSegment(data, length, mTransmitSequenceNumber, mLastReceivedSequenceNumber) ),
+                             length, Timer::now());
         pushedIntoQueue = true;
 
         if (inSendingMode) {
@@ -761,36 +891,25 @@ private:
   }
 
   void markAcknowledgedPacket(uint64 receivedAckNum) {
-    for (std::deque< std::tr1::shared_ptr<ChannelSegment> >::iterator it = mOutstandingSegments.begin();
-         it != mOutstandingSegments.end(); it++)
-    {
-      std::tr1::shared_ptr<ChannelSegment> segment = *it;
+    std::tr1::shared_ptr<ChannelSegment>* found = mOutstandingSegments.find(receivedAckNum);
+    if (found == NULL) return;
 
-      if (segment->mChannelSequenceNumber == receivedAckNum) {
-	segment->mAckTime = Timer::now();
+    std::tr1::shared_ptr<ChannelSegment> segment = *found;
+    segment->mAckTime = Timer::now();
 
-        if (mFirstRTO ) {
-	    mRTOMicroseconds = ((segment->mAckTime - segment->mTransmitTime).toMicroseconds()) ;
-	    mFirstRTO = false;
-        }
-        else {
-          mRTOMicroseconds = CC_ALPHA * mRTOMicroseconds +
-            (1.0-CC_ALPHA) * (segment->mAckTime - segment->mTransmitTime).toMicroseconds();
-        }
+    if (segment->mNumTransmissions == 1)
+      mRTTEstimator.sample(segment->mAckTime - segment->mTransmitTime);
 
-        inSendingMode = true;
+    inSendingMode = true;
 
-        getContext()->mainStrand->post(
-                                     std::tr1::bind(&Connection<EndPointType>::serviceConnectionNoReturn, this, mWeakThis.lock()) );
+    getContext()->mainStrand->post(
+                                 std::tr1::bind(&Connection<EndPointType>::serviceConnectionNoReturn, this, mWeakThis.lock()) );
 
-        if (rand() % mCwnd == 0)  {
-          mCwnd += 1;
-        }
-
-        mOutstandingSegments.erase(it);
-        break;
-      }
+    if (rand() % mCwnd == 0)  {
+      mCwnd += 1;
     }
+
+    mOutstandingSegments.erase(receivedAckNum);
   }
 
   void receiveODPMessage(const ODP::Endpoint &src, const ODP::Endpoint &dst, MemoryReference payload) {
@@ -1024,7 +1143,29 @@ private:
   }
 
   uint64 getRTOMicroseconds() {
-    return mRTOMicroseconds;
+    return mRTTEstimator.rto().toMicroseconds();
+  }
+
+  const RTTEstimator& rttEstimator() const {
+    return mRTTEstimator;
+  }
+
+  /* Copies the current state of every connection, and each of their streams,
+     into stats. */
+  static void getAllStats(std::vector<SSTConnectionStats>* stats) {
+    // Copy the connections out first so we don't hold the static lock while
+    // taking the per-connection ones.
+    std::vector<ConnectionPtr> conns;
+    {
+      boost::mutex::scoped_lock lock(sStaticMembersLock.getMutex());
+      conns.reserve(sConnectionMap.size());
+      for(typename ConnectionMap::const_iterator it = sConnectionMap.begin(); it != sConnectionMap.end(); it++)
+        conns.push_back(it->second);
+    }
+
+    stats->resize(conns.size());
+    for(uint32 i = 0; i < conns.size(); i++)
+      conns[i]->getStats(&(*stats)[i]);
   }
 
   void eraseDisconnectedStream(Stream<EndPointType>* s) {
@@ -1253,7 +1394,7 @@ public:
                 continue;
             }
 
-            sendData(  buffer.data(), buffer.size(), false );
+            sendData(  buffer.data(), buffer.size(), false, DATAGRAM_FLOW, 0 );
 
             currOffset += buffLen;
             // If we got to the send, we can break out of the loop
@@ -1349,6 +1490,58 @@ public:
     return mRemoteEndPoint;
   }
 
+  typedef SegmentSchedulerType::DelayStats QueueingDelayStats;
+
+  /*
+    Returns how long segments sent at the given priority have waited in this
+    connection's send queue, covering every segment sent so far.
+
+    @param priority a stream priority, see Stream::setPriority
+    @return the number of segments sent and their average and maximum delay
+  */
+  virtual QueueingDelayStats queueingDelay(int priority) {
+    boost::mutex::scoped_lock lock(mQueueMutex);
+    return mQueuedSegments.queueingDelay(priority);
+  }
+
+  /*
+    Copies the current state of this connection and its streams into stats.
+  */
+  virtual void getStats(SSTConnectionStats* stats) {
+    stats->localEndPoint = mLocalEndPoint.toString();
+    stats->remoteEndPoint = mRemoteEndPoint.toString();
+    stats->state = mState;
+
+    stats->hasRTTSample = mRTTEstimator.hasSample();
+    stats->smoothedRTT = mRTTEstimator.smoothed();
+    stats->rttVariance = mRTTEstimator.variance();
+    stats->rto = mRTTEstimator.rto();
+
+    stats->segmentsSent = mNumSegmentsSent;
+    stats->numTimeouts = mNumTimeouts;
+
+    std::vector< std::tr1::shared_ptr< Stream<EndPointType> > > streams;
+    {
+      boost::mutex::scoped_lock lock(mQueueMutex);
+
+      stats->congestionWindow = mCwnd;
+      stats->outstandingSegments = mOutstandingSegments.size();
+      stats->queuedSegments = mQueuedSegments.size();
+
+      stats->queueingDelay.resize(SegmentSchedulerType::NUM_PRIORITIES);
+      for(int i = 0; i < SegmentSchedulerType::NUM_PRIORITIES; i++)
+        stats->queueingDelay[i] = mQueuedSegments.queueingDelay(SegmentSchedulerType::MIN_PRIORITY + i);
+
+      streams.reserve(mOutgoingSubstreamMap.size());
+      for(typename LSIDStreamMap::const_iterator it = mOutgoingSubstreamMap.begin(); it != mOutgoingSubstreamMap.end(); it++)
+        streams.push_back(it->second);
+    }
+
+    stats->streams.resize(streams.size());
+    for(uint32 i = 0; i < streams.size(); i++)
+      streams[i]->getStats(&stats->streams[i]);
+  }
+
 };
 #if SIRIKATA_PLATFORM == SIRIKATA_WINDOWS
 //SIRIKATA_EXPORT_TEMPLATE template class SIRIKATA_EXPORT Connection<Sirikata::UUID>;
@@ -1364,10 +1557,12 @@ public:
 
   Time mTransmitTime;
   Time mAckTime;
+  // RTT samples are only taken from buffers sent once (Karn's algorithm)
+  uint16 mNumTransmissions;
 
 
   StreamBuffer(const uint8* data, uint32 len, uint64 offset) :
-    mTransmitTime(Time::null()), mAckTime(Time::null())
+    mTransmitTime(Time::null()), mAckTime(Time::null()), mNumTransmissions(0)
   {
     assert(len > 0);
 
@@ -1380,6 +1575,10 @@ public:
   ~StreamBuffer() {
       delete []mBuffer;
   }
+
+  static bool offsetGreater(const std::tr1::shared_ptr<StreamBuffer>& lhs, const std::tr1::shared_ptr<StreamBuffer>& rhs) {
+      return lhs->mOffset > rhs->mOffset;
+  }
 };
 
 template <class EndPointType>
@@ -1407,6 +1606,8 @@ public:
     delete [] mReceiveBuffer;
     delete [] mReceiveBitmap;
 
+    delete mCongestionControl;
+
     mConnection.reset();
   }
 
@@ -1613,21 +1814,92 @@ public:
 
   /*
     Sets the priority of this stream.
-    As in the original SST interface, this implementation gives strict preference to
-    streams with higher priority over streams with lower priority, but it divides
-    available transmit bandwidth evenly among streams with the same priority level.
+    Segments queued on a connection are scheduled across its streams by
+    weighted fair queueing: each priority level above zero doubles the share of
+    the connection's transmit bandwidth a stream gets relative to streams at
+    the level below, and streams with the same priority level divide it evenly.
+    Unlike the original SST interface, lower priority streams are slowed down
+    but never starved. Priorities range from -4 to 3, other values are clamped.
     All streams have a default priority level of zero.
     @param the new priority level of the stream.
   */
   virtual void setPriority(int pri) {
-
+    mPriority = Connection<EndPointType>::SegmentSchedulerType::clampPriority(pri);
   }
 
   /*Returns the stream's current priority level.
     @return the stream's current priority level
   */
   virtual int priority() {
-    return 0;
+    return mPriority;
+  }
+
+  /*
+    Selects the congestion control algorithm used for data sent on this
+    stream: "aimd" (slow start with additive increase, multiplicative decrease,
+    the default), "delay" (backs off as queueing delay grows) or "none" (only
+    the receiver's window limits sending). The new algorithm starts from its
+    initial window.
+    @param algorithm the name of the algorithm
+    @return false if the algorithm is unknown, in which case the current one
+            is kept.
+  */
+  virtual bool setCongestionControl(const String& algorithm) {
+    SSTCongestionControl* cc = SSTCongestionControl::create(algorithm, MAX_PAYLOAD_SIZE);
+    if (cc == NULL)
+      return false;
+
+    boost::mutex::scoped_lock lock(mQueueMutex);
+    delete mCongestionControl;
+    mCongestionControl = cc;
+    recomputeTransmitWindow();
+    return true;
+  }
+
+  /*Returns the name of the stream's congestion control algorithm.
+  */
+  virtual String congestionControl() {
+    return mCongestionControl->name();
+  }
+
+  /*
+    Returns the smoothed round trip time between sending data and receiving
+    its acknowledgement, estimated by the stream's connection, or zero if no
+    estimate is available yet.
+  */
+  virtual Duration averageSendLatency() const {
+    std::tr1::shared_ptr<Connection<EndPointType> > conn = mConnection.lock();
+    if (!conn || !conn->rttEstimator().hasSample())
+      return Duration::zero();
+    return conn->rttEstimator().smoothed();
+  }
+
+  /*
+    Copies the current state of this stream into stats.
+  */
+  virtual void getStats(SSTStreamStats* stats) {
+    boost::mutex::scoped_lock lock(mQueueMutex);
+
+    stats->lsid = mLSID;
+    stats->remoteLSID = mRemoteLSID;
+    stats->localPort = mLocalPort;
+    stats->remotePort = mRemotePort;
+    stats->state = mState;
+    stats->priority = mPriority;
+
+    stats->congestionControl = mCongestionControl->name();
+    stats->congestionWindow = mCongestionControl->window();
+    stats->peerReceiveWindow = mPeerReceiveWindow;
+
+    stats->outstandingBytes = mNumOutstandingBytes;
+    stats->outstandingBuffers = mChannelToBufferMap.size();
+    stats->queuedBytes = mCurrentQueueLength;
+    stats->queuedBuffers = mQueuedBuffers.size();
+
+    stats->bytesSent = mNumBytesSent;
+    stats->numRetransmits = mNumRetransmits;
+    stats->numFastRetransmits = mNumFastRetransmits;
+    stats->numTimeouts = mNumTimeouts;
   }
 
   /* Returns the top-level connection that created this stream.
@@ -1708,15 +1980,21 @@ private:
     MAX_PAYLOAD_SIZE(1000),
     MAX_QUEUE_LENGTH(4000000),
     MAX_RECEIVE_WINDOW(10000),
-    mFirstRTO(true),
-    mStreamRTOMicroseconds(10000000),
-    FL_ALPHA(0.8),
+    mCongestionControl(NULL),
+    mPeerReceiveWindow(MAX_RECEIVE_WINDOW),
     mTransmitWindowSize(MAX_RECEIVE_WINDOW),
     mReceiveWindowSize(MAX_RECEIVE_WINDOW),
     mNumOutstandingBytes(0),
     mNextByteExpected(0),
     mLastContiguousByteReceived(-1),
+    mHighestByteReceived(-1),
     mLastSendTime(Time::null()),
+    mDuplicateAcks(3),
+    MAX_SACK_BLOCKS(4),
+    mPriority(0),
+    mNumRetransmits(0),
+    mNumFastRetransmits(0),
+    mNumTimeouts(0),
     mStreamReturnCallback(cb),
     mConnected (false),
     MAX_INIT_RETRANSMISSIONS(5)
@@ -1731,6 +2009,9 @@ private:
     mQueuedBuffers.clear();
     mCurrentQueueLength = 0;
 
+    mCongestionControl = SSTCongestionControl::create("aimd", MAX_PAYLOAD_SIZE);
+    recomputeTransmitWindow();
+
     // Continues in init, when we have mWeakThis set
   }
 
@@ -1874,10 +2155,10 @@ private:
     else {
       if (mState != DISCONNECTED) {
 
-        //if the stream has been waiting for an ACK for > 2*mStreamRTOMicroseconds,
-        //resend the unacked packets.
+        //if the stream has been waiting for an ACK for longer than the
+        //retransmission timeout, resend the unacked packets.
         if ( mLastSendTime != Time::null()
-             && (curTime - mLastSendTime).toMicroseconds() > 2*mStreamRTOMicroseconds)
+             && (curTime - mLastSendTime) > retransmitTimeout())
         {
 	  resendUnackedPackets();
 	  mLastSendTime = curTime;
@@ -1911,6 +2192,7 @@ private:
 					    buffer->mOffset
 					    );
           buffer->mTransmitTime = curTime;
+          buffer->mNumTransmissions++;
           sentSomething = true;
 
 	  if ( mChannelToBufferMap.find(channelID) == mChannelToBufferMap.end() ) {
@@ -1930,7 +2212,7 @@ private:
         if (sentSomething) {
           std::tr1::shared_ptr<Connection<EndPointType> > conn =  mConnection.lock();
           if (conn)
-            getContext()->mainStrand->post(Duration::microseconds(2*mStreamRTOMicroseconds),
+            getContext()->mainStrand->post(retransmitTimeout(),
               std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn) );
         }
       }
@@ -1942,44 +2224,52 @@ private:
   inline void resendUnackedPackets() {
     boost::mutex::scoped_lock lock(mQueueMutex);
 
-    for(std::map<uint64,std::tr1::shared_ptr<StreamBuffer> >::const_reverse_iterator it=mChannelToBufferMap.rbegin(),
-            it_end=mChannelToBufferMap.rend();
+    std::tr1::shared_ptr<Connection<EndPointType> > conn =  mConnection.lock();
+
+    if (!mChannelToBufferMap.empty()) {
+      // Data was lost, back off both the window and the timer
+      mNumTimeouts++;
+      mNumRetransmits += mChannelToBufferMap.size();
+      mCongestionControl->onTimeout();
+      if (conn)
+        conn->mRTTEstimator.backoff();
+    }
+    mDuplicateAcks.reset();
+
+    // Requeue in stream order, ahead of any data that hasn't been sent yet
+    std::vector< std::tr1::shared_ptr<StreamBuffer> > unacked;
+    unacked.reserve(mChannelToBufferMap.size());
+    for(typename ChannelToBufferMap::const_iterator it=mChannelToBufferMap.begin(),
+            it_end=mChannelToBufferMap.end();
         it != it_end; it++)
-     {
-       mQueuedBuffers.push_front(it->second);
-       mCurrentQueueLength += it->second->mBufferLength;
+      unacked.push_back(it->second);
+    std::sort(unacked.begin(), unacked.end(), &StreamBuffer::offsetGreater);
 
-       /*printf("On %d, resending unacked packet at offset %d:%d\n",
-         (int)mLSID, (int)it->first, (int)(it->second->mOffset));fflush(stdout);*/
+    for(uint32 i = 0; i < unacked.size(); i++) {
+       mQueuedBuffers.push_front(unacked[i]);
+       mCurrentQueueLength += unacked[i]->mBufferLength;
 
-       if (mTransmitWindowSize < it->second->mBufferLength){
-         assert( ((int) it->second->mBufferLength) > 0);
-         mTransmitWindowSize = it->second->mBufferLength;
-       }
-     }
+       /*printf("On %d, resending unacked packet at offset %d\n",
+         (int)mLSID, (int)(unacked[i]->mOffset));fflush(stdout);*/
+    }
 
 
-    std::tr1::shared_ptr<Connection<EndPointType> > conn =  mConnection.lock();
     if (conn)
       getContext()->mainStrand->post(Duration::seconds(0.01),
         std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn) );
 
-    if (mChannelToBufferMap.empty() && !mQueuedBuffers.empty()) {
+    mNumOutstandingBytes = 0;
+    mChannelToBufferMap.clear();
+
+    recomputeTransmitWindow();
+    // Always let at least the first buffer through so we keep making progress
+    if (!mQueuedBuffers.empty()) {
       std::tr1::shared_ptr<StreamBuffer> buffer = mQueuedBuffers.front();
 
       if (mTransmitWindowSize < buffer->mBufferLength) {
         mTransmitWindowSize = buffer->mBufferLength;
       }
     }
-
-    mNumOutstandingBytes = 0;
-
-    if (!mChannelToBufferMap.empty()) {
-      if (mStreamRTOMicroseconds < 20000000) {
-        mStreamRTOMicroseconds *= 2;
-      }
-      mChannelToBufferMap.clear();
-    }
   }
 
   /* This function sends received data up to the application interface.
@@ -2023,8 +2313,7 @@ private:
     else if (streamMsg->type() == streamMsg->DATA || streamMsg->type() == streamMsg->INIT) {
       boost::recursive_mutex::scoped_lock lock(mReceiveBufferMutex);
 
-      assert ( pow(2.0, streamMsg->window()) - mNumOutstandingBytes > 0);
-      mTransmitWindowSize = pow(2.0, streamMsg->window()) - mNumOutstandingBytes;
+      updateTransmitWindow(streamMsg->window());
 
       /*std::cout << "offset=" << offset << " , mLastContiguousByteReceived=" << mLastContiguousByteReceived
         << " , mNextByteExpected=" << mNextByteExpected <<"\n";*/
@@ -2036,6 +2325,7 @@ private:
 
 	  memcpy(mReceiveBuffer+offsetInBuffer, buffer, len);
 	  memset(mReceiveBitmap+offsetInBuffer, 1, len);
+          mHighestByteReceived = std::max(mHighestByteReceived, (int64)(offset+len-1));
 
 	  sendToApp(len);
 
@@ -2059,6 +2349,7 @@ private:
 
    	  memcpy(mReceiveBuffer+offsetInBuffer, buffer, len);
 	  memset(mReceiveBitmap+offsetInBuffer, 1, len);
+          mHighestByteReceived = std::max(mHighestByteReceived, (int64)(offset+len-1));
 
           sendAckPacket();
 	}
@@ -2073,59 +2364,51 @@ private:
     //handle any ACKS that might be included in the message...
     boost::mutex::scoped_lock lock(mQueueMutex);
 
-    if (mChannelToBufferMap.find(offset) != mChannelToBufferMap.end()) {
-      uint64 dataOffset = mChannelToBufferMap[offset]->mOffset;
-      mNumOutstandingBytes -= mChannelToBufferMap[offset]->mBufferLength;
+    typename ChannelToBufferMap::iterator buffer_it = mChannelToBufferMap.find(offset);
+    if (buffer_it != mChannelToBufferMap.end()) {
+      std::tr1::shared_ptr<StreamBuffer> buffer = buffer_it->second;
+      mNumOutstandingBytes -= buffer->mBufferLength;
 
-      mChannelToBufferMap[offset]->mAckTime = Timer::now();
+      buffer->mAckTime = Timer::now();
 
-      updateRTO(mChannelToBufferMap[offset]->mTransmitTime, mChannelToBufferMap[offset]->mAckTime);
+      handleAckedBuffer(buffer, true);
 
-      if ( (int) (pow(2.0, streamMsg->window()) - mNumOutstandingBytes) > 0 ) {
-        assert( pow(2.0, streamMsg->window()) - mNumOutstandingBytes > 0);
-        mTransmitWindowSize = pow(2.0, streamMsg->window()) - mNumOutstandingBytes;
-      }
-      else {
-        mTransmitWindowSize = 0;
-      }
-
-      //printf("REMOVED ack packet at offset %d\n", (int)mChannelToBufferMap[offset]->mOffset);
+      updateTransmitWindow(streamMsg->window());
 
-      mChannelToBufferMap.erase(offset);
+      //printf("REMOVED ack packet at offset %d\n", (int)buffer->mOffset);
 
-      std::vector <uint64> channelOffsets;
-      for(std::map<uint64, std::tr1::shared_ptr<StreamBuffer> >::iterator it = mChannelToBufferMap.begin();
-          it != mChannelToBufferMap.end(); ++it)
-	{
-	  if (it->second->mOffset == dataOffset) {
-	    channelOffsets.push_back(it->first);
-	  }
-	}
-
-      for (uint32 i=0; i< channelOffsets.size(); i++) {
-        mChannelToBufferMap.erase(channelOffsets[i]);
-      }
+      // A buffer is only ever outstanding under one channel sequence number:
+      // resendUnackedPackets() empties the map before the buffer is resent.
+      mChannelToBufferMap.erase(buffer_it);
+      mChannelToStreamOffsetMap.erase(offset);
     }
     else {
-      // ACK received but not found in mChannelToBufferMap
-      if (mChannelToStreamOffsetMap.find(offset) != mChannelToStreamOffsetMap.end()) {
-        uint64 dataOffset = mChannelToStreamOffsetMap[offset];
-        mChannelToStreamOffsetMap.erase(offset);
-
-        std::vector <uint64> channelOffsets;
-        for(std::map<uint64, std::tr1::shared_ptr<StreamBuffer> >::iterator it = mChannelToBufferMap.begin();
+      // ACK received but not found in mChannelToBufferMap, i.e. for a
+      // transmission we already gave up on. If the data was resent, the
+      // retransmission no longer needs to be acked. This only happens after
+      // a timeout, so a scan is fine here.
+      typename ChannelToStreamOffsetMap::iterator offset_it = mChannelToStreamOffsetMap.find(offset);
+      if (offset_it != mChannelToStreamOffsetMap.end()) {
+        uint64 dataOffset = offset_it->second;
+        mChannelToStreamOffsetMap.erase(offset_it);
+
+        for(typename ChannelToBufferMap::iterator it = mChannelToBufferMap.begin();
             it != mChannelToBufferMap.end(); ++it)
           {
             if (it->second->mOffset == dataOffset) {
-              channelOffsets.push_back(it->first);
+              mNumOutstandingBytes -= it->second->mBufferLength;
+              mChannelToStreamOffsetMap.erase(it->first);
+              mChannelToBufferMap.erase(it);
+              recomputeTransmitWindow();
+              break;
             }
           }
-
-        for (uint32 i=0; i< channelOffsets.size(); i++) {
-          mChannelToBufferMap.erase(channelOffsets[i]);
-        }
       }
     }
+
+    if (streamMsg->type() == streamMsg->ACK && streamMsg->has_bsn()) {
+      handleSelectiveAck(streamMsg);
+    }
   }
 
   LSID getLSID() {
@@ -2136,24 +2419,129 @@ private:
     return mRemoteLSID;
   }
 
-  void updateRTO(Time sampleStartTime, Time sampleEndTime) {
+  /* Processes the cumulative ack and selective ack blocks carried by an ACK
+     packet. Buffers the receiver already holds are released, and once
+     mDuplicateAcks says so, the buffer at the start of the hole is
+     retransmitted without waiting for the retransmission timer. mQueueMutex
+     must be locked before calling this function. */
+  void handleSelectiveAck(Sirikata::Protocol::SST::SSTStreamHeader* streamMsg) {
+    uint64 cumulative = streamMsg->bsn();
 
+    Sirikata::Protocol::SST::SSTSelectiveAck sack;
+    if (!streamMsg->payload().empty())
+      parsePBJMessage(&sack, streamMsg->payload());
+    int num_blocks = std::min(sack.block_begin_size(), sack.block_length_size());
+    SelectiveAckBlockList blocks;
+    for (int i = 0; i < num_blocks; i++)
+      blocks.push_back(SelectiveAckBlock(sack.block_begin(i), sack.block_length(i)));
 
-    if (sampleStartTime > sampleEndTime ) {
-      std::cout << "Bad sample\n";
+    mDuplicateAcks.ack(cumulative, !blocks.empty());
+
+    // Without blocks the receiver has no hole and every buffer gets its own
+    // ack, so there's nothing more to do
+    if (blocks.empty())
       return;
-    }
 
-    if (mFirstRTO) {
-      mStreamRTOMicroseconds = (sampleEndTime - sampleStartTime).toMicroseconds() ;
-      mFirstRTO = false;
+    std::vector<uint64> covered;
+    uint64 missing = 0;
+    bool found_missing = false;
+    uint64 highest_sent = 0;
+    for(typename ChannelToBufferMap::iterator it = mChannelToBufferMap.begin();
+        it != mChannelToBufferMap.end(); ++it)
+      {
+        const std::tr1::shared_ptr<StreamBuffer>& buffer = it->second;
+        uint64 end = buffer->mOffset + buffer->mBufferLength;
+        highest_sent = std::max(highest_sent, end);
+
+        if (selectiveAckCovers(cumulative, blocks, buffer->mOffset, end)) {
+          covered.push_back(it->first);
+        }
+        else if (buffer->mOffset == cumulative) {
+          missing = it->first;
+          found_missing = true;
+        }
+      }
+
+    for (uint32 i = 0; i < covered.size(); i++) {
+      typename ChannelToBufferMap::iterator it = mChannelToBufferMap.find(covered[i]);
+      mNumOutstandingBytes -= it->second->mBufferLength;
+      // The ack wasn't triggered by this buffer, so it's no good as an RTT
+      // sample, but the data did get through
+      handleAckedBuffer(it->second, false);
+      mChannelToStreamOffsetMap.erase(covered[i]);
+      mChannelToBufferMap.erase(it);
+    }
+
+    if (found_missing && mDuplicateAcks.shouldRetransmit()) {
+      typename ChannelToBufferMap::iterator it = mChannelToBufferMap.find(missing);
+      std::tr1::shared_ptr<StreamBuffer> buffer = it->second;
+
+      // Leave the channel to offset entry in place: if the original turns
+      // out to have arrived, its ack cancels the retransmission
+      mChannelToBufferMap.erase(it);
+      mNumOutstandingBytes -= buffer->mBufferLength;
+      mNumRetransmits++;
+      mNumFastRetransmits++;
+      mQueuedBuffers.push_front(buffer);
+      mCurrentQueueLength += buffer->mBufferLength;
+
+      mCongestionControl->onLoss();
+      mDuplicateAcks.retransmitted(highest_sent);
+
+      recomputeTransmitWindow();
+      // Retransmissions go out regardless of the window
+      if (mTransmitWindowSize < buffer->mBufferLength)
+        mTransmitWindowSize = buffer->mBufferLength;
+
+      std::tr1::shared_ptr<Connection<EndPointType> > conn =  mConnection.lock();
+      if (conn)
+        getContext()->mainStrand->post(
+          std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn) );
     }
     else {
+      recomputeTransmitWindow();
+    }
+  }
+
+  /* Feeds an acknowledged buffer to congestion control and, if sample_rtt is
+     set, the RTT estimator. mQueueMutex must be locked before calling this
+     function. */
+  void handleAckedBuffer(std::tr1::shared_ptr<StreamBuffer> buffer, bool sample_rtt) {
+    std::tr1::shared_ptr<Connection<EndPointType> > conn = mConnection.lock();
+    if (!conn)
+      return;
 
-      mStreamRTOMicroseconds = FL_ALPHA * mStreamRTOMicroseconds +
-	(1.0-FL_ALPHA) * (sampleEndTime - sampleStartTime).toMicroseconds();
+    if (sample_rtt && buffer->mNumTransmissions == 1) {
+      if (buffer->mTransmitTime > buffer->mAckTime) {
+        std::cout << "Bad sample\n";
+      }
+      else {
+        conn->mRTTEstimator.sample(buffer->mAckTime - buffer->mTransmitTime);
+      }
     }
 
+    mCongestionControl->onAck(buffer->mBufferLength, conn->mRTTEstimator);
+  }
+
+  Duration retransmitTimeout() {
+    std::tr1::shared_ptr<Connection<EndPointType> > conn = mConnection.lock();
+    if (!conn)
+      return RTTEstimator().rto();
+    return conn->mRTTEstimator.rto();
+  }
+
+  /* Updates the receiver's advertised window, 2^window_log2 bytes, and
+     recomputes how much more data we can send. */
+  void updateTransmitWindow(uint32 window_log2) {
+    mPeerReceiveWindow = (uint32)pow(2.0, (double)window_log2);
+    recomputeTransmitWindow();
+  }
+
+  /* Recomputes how much more data we can send, limited by both the receiver's
+     window and the congestion window. */
+  void recomputeTransmitWindow() {
+    uint32 window = std::min(mPeerReceiveWindow, mCongestionControl->window());
+    mTransmitWindowSize = (window > mNumOutstandingBytes) ? (window - mNumOutstandingBytes) : 0;
   }
 
   void sendInitPacket(void* data, uint32 len) {
@@ -2178,14 +2566,15 @@ private:
 
     if (!conn) return;
 
-    conn->sendData( buffer.data(), buffer.size(), false );
+    conn->sendData( buffer.data(), buffer.size(), false, mLSID, mPriority );
 
-    getContext()->mainStrand->post(Duration::microseconds(2*mStreamRTOMicroseconds),
+    getContext()->mainStrand->post(retransmitTimeout(),
 
         std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn) );
 
   }
 
+  /* mReceiveBufferMutex must be locked before calling this function. */
   void sendAckPacket() {
     Sirikata::Protocol::SST::SSTStreamHeader sstMsg;
     sstMsg.set_lsid( mLSID );
@@ -2194,6 +2583,26 @@ private:
     sstMsg.set_window( log((double)mReceiveWindowSize)/log(2.0)  );
     sstMsg.set_src_port(mLocalPort);
     sstMsg.set_dest_port(mRemotePort);
+
+    // Cumulative ack: the first byte we don't have. Data received but not yet
+    // handed to the app still counts. Anything past a hole is reported in
+    // selective ack blocks.
+    uint64 cumulative = mLastContiguousByteReceived + 1;
+    int64 span = std::min(mHighestByteReceived - mLastContiguousByteReceived, (int64)MAX_RECEIVE_WINDOW);
+    if (span > 0) {
+      SelectiveAckBlockList blocks;
+      cumulative = buildSelectiveAck(mReceiveBitmap, span, cumulative, MAX_SACK_BLOCKS, &blocks);
+      if (!blocks.empty()) {
+        Sirikata::Protocol::SST::SSTSelectiveAck sack;
+        for (uint32 i = 0; i < blocks.size(); i++) {
+          sack.add_block_begin(blocks[i].begin);
+          sack.add_block_length(blocks[i].length);
+        }
+        sstMsg.set_payload(serializePBJMessage(sack));
+      }
+    }
+    sstMsg.set_bsn(cumulative);
+
     std::string buffer = serializePBJMessage(sstMsg);
 
     //printf("Sending Ack packet with window %d\n", (int)sstMsg.window());
@@ -2220,7 +2629,7 @@ private:
 
     std::tr1::shared_ptr<Connection<EndPointType> > conn = mConnection.lock();
     assert(conn);
-    return conn->sendData(  buffer.data(), buffer.size(), false);
+    return conn->sendData(  buffer.data(), buffer.size(), false, mLSID, mPriority);
   }
 
   void sendReplyPacket(void* data, uint32 len, LSID remoteLSID) {
@@ -2240,7 +2649,7 @@ private:
 
     std::tr1::shared_ptr<Connection<EndPointType> > conn = mConnection.lock();
     assert(conn);
-    conn->sendData(  buffer.data(), buffer.size(), false);
+    conn->sendData(  buffer.data(), buffer.size(), false, mLSID, mPriority);
   }
 
   uint8 mState;
@@ -2256,8 +2665,12 @@ private:
   std::tr1::weak_ptr<Connection<EndPointType> > mConnection;
   const Context* mContext;
 
-  std::map<uint64, std::tr1::shared_ptr<StreamBuffer> >  mChannelToBufferMap;
-  std::map<uint64, uint32> mChannelToStreamOffsetMap;
+  // Outstanding buffers, keyed by the channel sequence number they were sent
+  // with, and the stream offsets of everything sent and not yet acked
+  typedef std::tr1::unordered_map<uint64, std::tr1::shared_ptr<StreamBuffer> > ChannelToBufferMap;
+  typedef std::tr1::unordered_map<uint64, uint64> ChannelToStreamOffsetMap;
+  ChannelToBufferMap mChannelToBufferMap;
+  ChannelToStreamOffsetMap mChannelToStreamOffsetMap;
 
   std::deque< std::tr1::shared_ptr<StreamBuffer> > mQueuedBuffers;
   uint32 mCurrentQueueLength;
@@ -2272,10 +2685,9 @@ private:
 
   boost::mutex mQueueMutex;
 
-  bool mFirstRTO;
-  int64 mStreamRTOMicroseconds;
-  float FL_ALPHA;
-
+  SSTCongestionControl* mCongestionControl;
+  // The receiver's advertised window, in bytes
+  uint32 mPeerReceiveWindow;
 
   uint32 mTransmitWindowSize;
   uint32 mReceiveWindowSize;
@@ -2283,8 +2695,21 @@ private:
 
   int64 mNextByteExpected;
   int64 mLastContiguousByteReceived;
+  // Last byte of the furthest data received, possibly past a hole
+  int64 mHighestByteReceived;
   Time mLastSendTime;
 
+  // Fast retransmit state, driven by the cumulative and selective acks
+  DuplicateAckTracker mDuplicateAcks;
+  uint32 MAX_SACK_BLOCKS;
+
+  // Scheduling priority of this stream's segments within the connection
+  int mPriority;
+
+  uint64 mNumRetransmits;
+  uint64 mNumFastRetransmits;
+  uint64 mNumTimeouts;
+
   uint8* mReceiveBuffer;
   uint8* mReceiveBitmap;
   boost::recursive_mutex mReceiveBufferMutex;
@@ -2293,7 +2718,7 @@ private:
   StreamReturnCallbackFunction mStreamReturnCallback;
 
 
-  typedef std::map<EndPoint<EndPointType>, StreamReturnCallbackFunction> StreamReturnCallbackMap;
+  typedef std::tr1::unordered_map<EndPoint<EndPointType>, StreamReturnCallbackFunction, typename EndPoint<EndPointType>::Hasher> StreamReturnCallbackMap;
   static StreamReturnCallbackMap mStreamReturnCallbackMap;
 
   friend class Connection<EndPointType>;
@@ -2313,17 +2738,38 @@ private:
 SIRIKATA_EXPORT_TEMPLATE template class SIRIKATA_EXPORT Stream<SpaceObjectReference>;
 #endif
 
-class SSTConnectionManager : public Service {
+class SIRIKATA_EXPORT SSTConnectionManager : public Service {
 public:
-    virtual void start() {
-    }
-    virtual void stop() {
-        Connection<SpaceObjectReference>::closeConnections();
-    }
+    SSTConnectionManager();
+    /** Creates a manager which also reports statistics about every SST
+     *  connection to ctx's TimeSeries every stats_interval, under names
+     *  starting with stats_prefix. A zero interval disables reporting.
+     *  Totals across all connections are always reported; per_connection adds
+     *  series for each individual connection.
+     */
+    SSTConnectionManager(Context* ctx, const Duration& stats_interval, const String& stats_prefix, bool per_connection = false);
+    ~SSTConnectionManager();
+
+    virtual void start();
+    virtual void stop();
+
+    /** Copies the current state of every SST connection, and each of their
+     *  streams, into stats.
+     */
+    static void getStats(std::vector<SSTConnectionStats>* stats);
 
-    ~SSTConnectionManager() {
-        Connection<SpaceObjectReference>::closeConnections();
-    }
+private:
+    typedef SSTConnectionStats::QueueingDelayStats QueueingDelayStats;
+
+    void reportStats();
+
+    Context* mContext;
+    Poller* mStatsPoller;
+    String mStatsPrefix;
+    bool mReportPerConnection;
+    // Queueing delay totals as of the last report, so each report covers
+    // only the segments sent since the previous one
+    std::vector<QueueingDelayStats> mLastQueueingDelay;
 };
 
 
@@ -0,0 +1,252 @@
+/*  Sirikata
+ *  SSTSegmentScheduler.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_SST_SEGMENT_SCHEDULER_HPP_
+#define _SIRIKATA_SST_SEGMENT_SCHEDULER_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/Time.hpp>
+
+namespace Sirikata {
+
+/** SegmentScheduler decides the order in which segments queued on an SST
+ *  connection are sent. Each flow (a substream, or the connection's own
+ *  control traffic) has its own FIFO, and flows with queued segments are
+ *  serviced by deficit round robin: each turn a flow at the default priority
+ *  may send up to quantum bytes, and that credit doubles with each priority
+ *  level above the default and halves with each level below it.
+ *  A higher priority flow therefore gets proportionally more of the
+ *  connection, but a bulk transfer can no longer hold up everything queued
+ *  behind it and lower priority flows are never starved outright.
+ *
+ *  Priorities range from MIN_PRIORITY to MAX_PRIORITY, with 0 the default;
+ *  values outside the range are clamped. Time spent queued is tracked per
+ *  priority.
+ *
+ *  Not thread safe, callers must provide their own locking.
+ */
+template <typename T>
+class SegmentScheduler {
+public:
+    typedef uint32 FlowID;
+
+    enum {
+        MIN_PRIORITY = -4,
+        MAX_PRIORITY = 3,
+        NUM_PRIORITIES = MAX_PRIORITY - MIN_PRIORITY + 1
+    };
+
+    /** Queueing delay seen by segments of one priority, from push() to
+     *  pop().
+     */
+    struct DelayStats {
+        DelayStats()
+         : count(0),
+           total(Duration::zero()),
+           max(Duration::zero())
+        {}
+
+        Duration average() const {
+            if (count == 0) return Duration::zero();
+            return total / (double)count;
+        }
+
+        uint64 count;
+        Duration total;
+        Duration max;
+    };
+
+    SegmentScheduler(uint32 quantum = 1500)
+     : mQuantum(quantum),
+       mSize(0),
+       mHeadCharged(false)
+    {
+    }
+
+    void setQuantum(uint32 quantum) {
+        mQuantum = quantum;
+    }
+
+    static int clampPriority(int priority) {
+        if (priority < MIN_PRIORITY) return MIN_PRIORITY;
+        if (priority > MAX_PRIORITY) return MAX_PRIORITY;
+        return priority;
+    }
+
+    /** Relative share of the connection a flow at the given priority gets. */
+    static uint32 weight(int priority) {
+        return 1 << (clampPriority(priority) - MIN_PRIORITY);
+    }
+
+    /** Bytes a flow at the given priority may send per turn. */
+    int64 credit(int priority) const {
+        int64 result = ((int64)mQuantum * weight(priority)) / weight(0);
+        return result > 0 ? result : 1;
+    }
+
+    /** Queue item of the given size on flow. The priority applies to this
+     *  item and to the flow's turns from now on, so a flow changing priority
+     *  takes effect immediately.
+     */
+    void push(FlowID flow, int priority, const T& item, uint32 size, const Time& enqueue_time) {
+        Flow& f = mFlows[flow];
+        f.priority = clampPriority(priority);
+        f.queue.push_back( Entry(item, size, f.priority, enqueue_time) );
+        if (f.queue.size() == 1)
+            mActiveFlows.push_back(flow);
+        mSize++;
+    }
+
+    bool empty() const {
+        return mSize == 0;
+    }
+
+    uint32 size() const {
+        return mSize;
+    }
+
+    /** The item that will be removed by the next pop(). Repeated calls
+     *  without a pop() return the same item. Must not be called when empty.
+     */
+    T& front() {
+        assert(!empty());
+        while(true) {
+            Flow& f = mFlows[mActiveFlows.front()];
+            if (!mHeadCharged) {
+                f.deficit += credit(f.priority);
+                mHeadCharged = true;
+            }
+            if (f.deficit >= (int64)f.queue.front().size)
+                return f.queue.front().item;
+            // Not enough credit left this turn, move to the back and let the
+            // next flow go.
+            mActiveFlows.push_back(mActiveFlows.front());
+            mActiveFlows.pop_front();
+            mHeadCharged = false;
+        }
+    }
+
+    /** Remove the item returned by front(), recording how long it was
+     *  queued.
+     */
+    void pop(const Time& dequeue_time) {
+        front();
+
+        FlowID flow_id = mActiveFlows.front();
+        typename FlowMap::iterator flow_it = mFlows.find(flow_id);
+        Flow& f = flow_it->second;
+        const Entry& entry = f.queue.front();
+
+        DelayStats& stats = mDelayStats[entry.priority - MIN_PRIORITY];
+        Duration delay = dequeue_time - entry.enqueueTime;
+        stats.count++;
+        stats.total += delay;
+        if (delay > stats.max)
+            stats.max = delay;
+
+        f.deficit -= entry.size;
+        f.queue.pop_front();
+        mSize--;
+
+        if (f.queue.empty()) {
+            // Idle flows don't bank credit
+            mFlows.erase(flow_it);
+            mActiveFlows.pop_front();
+            mHeadCharged = false;
+        }
+    }
+
+    void clear() {
+        mFlows.clear();
+        mActiveFlows.clear();
+        mSize = 0;
+        mHeadCharged = false;
+    }
+
+    /** Number of items queued on flow. */
+    uint32 size(FlowID flow) const {
+        typename FlowMap::const_iterator it = mFlows.find(flow);
+        if (it == mFlows.end()) return 0;
+        return it->second.queue.size();
+    }
+
+    const DelayStats& queueingDelay(int priority) const {
+        return mDelayStats[clampPriority(priority) - MIN_PRIORITY];
+    }
+
+    void resetQueueingDelay() {
+        for(int i = 0; i < NUM_PRIORITIES; i++)
+            mDelayStats[i] = DelayStats();
+    }
+
+private:
+    struct Entry {
+        Entry(const T& _item, uint32 _size, int _priority, const Time& _enqueue_time)
+         : item(_item),
+           size(_size),
+           priority(_priority),
+           enqueueTime(_enqueue_time)
+        {}
+
+        T item;
+        uint32 size;
+        int priority;
+        Time enqueueTime;
+    };
+
+    struct Flow {
+        Flow()
+         : priority(0),
+           deficit(0)
+        {}
+
+        std::deque<Entry> queue;
+        int priority;
+        int64 deficit;
+    };
+
+    typedef std::tr1::unordered_map<FlowID, Flow> FlowMap;
+
+    uint32 mQuantum;
+    uint32 mSize;
+    FlowMap mFlows;
+    // Flows with queued items, in service order. The front one is the flow
+    // currently taking its turn.
+    std::deque<FlowID> mActiveFlows;
+    // Whether the front flow has received its quantum for this turn
+    bool mHeadCharged;
+    DelayStats mDelayStats[NUM_PRIORITIES];
+}; // class SegmentScheduler
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SST_SEGMENT_SCHEDULER_HPP_
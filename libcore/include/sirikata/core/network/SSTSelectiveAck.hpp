@@ -0,0 +1,165 @@
+/*  Sirikata
+ *  SSTSelectiveAck.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SIRIKATA_SST_SELECTIVE_ACK_HPP_
+#define _SIRIKATA_SST_SELECTIVE_ACK_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+
+namespace Sirikata {
+
+/** A range of stream bytes the receiver holds past a hole. */
+struct SelectiveAckBlock {
+    SelectiveAckBlock(uint64 _begin, uint64 _length)
+     : begin(_begin), length(_length)
+    {}
+
+    uint64 begin;
+    uint64 length;
+};
+typedef std::vector<SelectiveAckBlock> SelectiveAckBlockList;
+
+/** Computes the acknowledgement for a receive window. bitmap[i] is 1 if the
+ *  byte at stream offset base+i has been received, and only the first span
+ *  entries are examined. Up to max_blocks ranges received past the first
+ *  hole are appended to blocks, in stream order.
+ *
+ *  \returns the cumulative ack, i.e. the offset of the first byte not yet
+ *           received
+ */
+inline uint64 buildSelectiveAck(const uint8* bitmap, int64 span, uint64 base, uint32 max_blocks, SelectiveAckBlockList* blocks) {
+    int64 i = 0;
+    while (i < span && bitmap[i] == 1) i++;
+    uint64 cumulative = base + i;
+
+    uint32 num_blocks = 0;
+    while (i < span && num_blocks < max_blocks) {
+        while (i < span && bitmap[i] == 0) i++;
+        int64 begin = i;
+        while (i < span && bitmap[i] == 1) i++;
+        if (i > begin) {
+            blocks->push_back(SelectiveAckBlock(base + begin, i - begin));
+            num_blocks++;
+        }
+    }
+    return cumulative;
+}
+
+/** Returns true if an ack with the given cumulative ack and blocks shows the
+ *  receiver holds all of [begin, end).
+ */
+inline bool selectiveAckCovers(uint64 cumulative, const SelectiveAckBlockList& blocks, uint64 begin, uint64 end) {
+    if (end <= cumulative)
+        return true;
+    for(uint32 i = 0; i < blocks.size(); i++) {
+        if (begin >= blocks[i].begin && end <= blocks[i].begin + blocks[i].length)
+            return true;
+    }
+    return false;
+}
+
+/** DuplicateAckTracker decides when the sender should retransmit the data at
+ *  the start of a hole without waiting for the retransmission timer. Every
+ *  ack which repeats the cumulative ack while reporting data past it counts
+ *  as a duplicate, and once there have been threshold of them the hole is
+ *  retransmitted. Until the cumulative ack passes everything that was
+ *  outstanding at that point, the sender is in fast recovery and doesn't
+ *  retransmit again, since later duplicates were likely triggered by data
+ *  sent before the retransmission.
+ *
+ *  Not thread safe, callers must provide their own locking.
+ */
+class DuplicateAckTracker {
+public:
+    DuplicateAckTracker(uint32 threshold)
+     : mThreshold(threshold),
+       mCumulative(0),
+       mDuplicates(0),
+       mInRecovery(false),
+       mRecoveryPoint(0)
+    {}
+
+    /** Record an ack carrying cumulative ack cumulative and, if has_blocks,
+     *  at least one selective ack block.
+     */
+    void ack(uint64 cumulative, bool has_blocks) {
+        if (cumulative > mCumulative) {
+            mCumulative = cumulative;
+            mDuplicates = 0;
+            if (mInRecovery && cumulative >= mRecoveryPoint)
+                mInRecovery = false;
+        }
+        else if (cumulative == mCumulative && has_blocks) {
+            mDuplicates++;
+        }
+    }
+
+    /** Returns true if the data at the cumulative ack should be
+     *  retransmitted now.
+     */
+    bool shouldRetransmit() const {
+        return !mInRecovery && mDuplicates >= mThreshold;
+    }
+
+    /** Record that the hole was retransmitted while data up to
+     *  recovery_point was outstanding.
+     */
+    void retransmitted(uint64 recovery_point) {
+        mInRecovery = true;
+        mRecoveryPoint = recovery_point;
+        mDuplicates = 0;
+    }
+
+    /** Forget about duplicates and recovery, e.g. after everything was
+     *  resent because the retransmission timer expired.
+     */
+    void reset() {
+        mDuplicates = 0;
+        mInRecovery = false;
+    }
+
+    uint64 cumulative() const { return mCumulative; }
+    uint32 duplicates() const { return mDuplicates; }
+    bool inRecovery() const { return mInRecovery; }
+
+private:
+    uint32 mThreshold;
+    uint64 mCumulative;
+    uint32 mDuplicates;
+    bool mInRecovery;
+    uint64 mRecoveryPoint;
+}; // class DuplicateAckTracker
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SST_SELECTIVE_ACK_HPP_
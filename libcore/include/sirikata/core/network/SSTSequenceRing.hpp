@@ -0,0 +1,169 @@
+/*  Sirikata
+ *  SSTSequenceRing.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_SST_SEQUENCE_RING_HPP_
+#define _SIRIKATA_SST_SEQUENCE_RING_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+
+namespace Sirikata {
+
+/** SequenceRing holds items keyed by sequence number, e.g. SST segments
+ *  waiting to be acknowledged. Sequence numbers are assigned in increasing
+ *  order and the live ones usually cover a small range, so each item is
+ *  stored directly in slot (seqno % capacity), giving constant time insert,
+ *  lookup and removal with no per-item allocation. If a new sequence number
+ *  lands on a slot still held by an older one, the ring doubles in size until
+ *  they no longer collide.
+ *
+ *  Not thread safe, callers must provide their own locking.
+ */
+template <typename T>
+class SequenceRing {
+public:
+    SequenceRing(uint32 initial_capacity = 64)
+     : mSlots(NULL),
+       mCapacity(roundUpCapacity(initial_capacity)),
+       mSize(0)
+    {
+        mSlots = new Slot[mCapacity];
+    }
+
+    ~SequenceRing() {
+        delete[] mSlots;
+    }
+
+    /** Insert item under seqno. If seqno is already present, its item is
+     *  replaced.
+     */
+    void insert(uint64 seqno, const T& item) {
+        while(true) {
+            Slot& slot = mSlots[seqno & (mCapacity-1)];
+            if (!slot.used) {
+                slot.used = true;
+                slot.seqno = seqno;
+                slot.item = item;
+                mSize++;
+                return;
+            }
+            if (slot.seqno == seqno) {
+                slot.item = item;
+                return;
+            }
+            grow();
+        }
+    }
+
+    /** Get the item stored under seqno, or NULL if there isn't one. */
+    T* find(uint64 seqno) {
+        Slot& slot = mSlots[seqno & (mCapacity-1)];
+        if (!slot.used || slot.seqno != seqno)
+            return NULL;
+        return &slot.item;
+    }
+
+    /** Remove the item stored under seqno. Returns true if there was one. */
+    bool erase(uint64 seqno) {
+        Slot& slot = mSlots[seqno & (mCapacity-1)];
+        if (!slot.used || slot.seqno != seqno)
+            return false;
+        slot.used = false;
+        slot.item = T();
+        mSize--;
+        return true;
+    }
+
+    void clear() {
+        if (mSize == 0) return;
+        for(uint32 i = 0; i < mCapacity; i++) {
+            if (!mSlots[i].used) continue;
+            mSlots[i].used = false;
+            mSlots[i].item = T();
+        }
+        mSize = 0;
+    }
+
+    uint32 size() const {
+        return mSize;
+    }
+
+    bool empty() const {
+        return mSize == 0;
+    }
+
+    uint32 capacity() const {
+        return mCapacity;
+    }
+
+private:
+    // Noncopyable
+    SequenceRing(const SequenceRing&);
+    SequenceRing& operator=(const SequenceRing&);
+
+    struct Slot {
+        Slot() : seqno(0), used(false) {}
+
+        uint64 seqno;
+        bool used;
+        T item;
+    };
+
+    static uint32 roundUpCapacity(uint32 capacity) {
+        uint32 result = 2;
+        while(result < capacity)
+            result <<= 1;
+        return result;
+    }
+
+    // Doubles the capacity. Two sequence numbers that are distinct modulo the
+    // old capacity are also distinct modulo the new one, so rehashing the
+    // existing items never collides.
+    void grow() {
+        uint32 new_capacity = mCapacity * 2;
+        Slot* new_slots = new Slot[new_capacity];
+        for(uint32 i = 0; i < mCapacity; i++) {
+            if (!mSlots[i].used) continue;
+            new_slots[mSlots[i].seqno & (new_capacity-1)] = mSlots[i];
+        }
+        delete[] mSlots;
+        mSlots = new_slots;
+        mCapacity = new_capacity;
+    }
+
+    Slot* mSlots;
+    uint32 mCapacity;
+    uint32 mSize;
+}; // class SequenceRing
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SST_SEQUENCE_RING_HPP_
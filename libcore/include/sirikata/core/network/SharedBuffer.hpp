@@ -0,0 +1,106 @@
+/*  Sirikata
+ *  SharedBuffer.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_CORE_NETWORK_SHARED_BUFFER_HPP_
+#define _SIRIKATA_CORE_NETWORK_SHARED_BUFFER_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+
+namespace Sirikata {
+namespace Network {
+
+/** SharedBuffer is an immutable, reference counted block of bytes. Copying a
+ *  SharedBuffer only copies a reference, so serialized data can be handed
+ *  between queues and down to the network without being copied at each step.
+ *  Data is moved in with take(), which steals the contents of a String.
+ */
+class SharedBuffer {
+public:
+    SharedBuffer() {}
+
+    /** Copy data into a new buffer. Prefer take() when the source can be
+     *  given up.
+     */
+    explicit SharedBuffer(const String& data)
+     : mData(new String(data))
+    {}
+
+    SharedBuffer(const void* data, size_t size)
+     : mData(new String((const char*)data, size))
+    {}
+
+    /** Create a buffer holding the contents of data without copying them.
+     *  data is left empty.
+     */
+    static SharedBuffer take(String* data) {
+        SharedBuffer result;
+        String* stolen = new String();
+        stolen->swap(*data);
+        result.mData = std::tr1::shared_ptr<const String>(stolen);
+        return result;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+    size_t size() const {
+        return mData ? mData->size() : 0;
+    }
+    const uint8* data() const {
+        return mData ? (const uint8*)mData->data() : NULL;
+    }
+
+    /** Get the contents as a String. The reference is valid as long as this
+     *  buffer (or any copy of it) is.
+     */
+    const String& str() const {
+        static const String sEmpty;
+        return mData ? *mData : sEmpty;
+    }
+
+    MemoryReference ref() const {
+        return MemoryReference(data(), size());
+    }
+
+    /** Number of SharedBuffers referring to the same data. */
+    long useCount() const {
+        return mData.use_count();
+    }
+
+private:
+    std::tr1::shared_ptr<const String> mData;
+};
+
+} // namespace Network
+} // namespace Sirikata
+
+#endif //_SIRIKATA_CORE_NETWORK_SHARED_BUFFER_HPP_
@@ -305,6 +305,29 @@ public:
         return Duration::zero();
     }
 
+    /** Counters for the buffers a Stream allocates to deliver received data
+     *  to the user.
+     */
+    struct ReceiveBufferStats {
+        ReceiveBufferStats()
+         : allocated(0), reused(0), retainedByUser(0)
+        {}
+
+        ///Buffers allocated from the heap
+        uint64 allocated;
+        ///Buffers recycled from previously delivered data
+        uint64 reused;
+        ///Buffers the user kept by swapping the data out of the received Chunk
+        uint64 retainedByUser;
+    };
+
+    /** Get counters for the receive buffers used by the stream. For streams
+     *  multiplexed over a shared connection these cover the whole connection.
+     */
+    virtual ReceiveBufferStats receiveBufferStats() const {
+        return ReceiveBufferStats();
+    }
+
 };
 } // namespace Network
 } // namespace Sirikata
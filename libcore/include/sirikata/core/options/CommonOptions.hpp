@@ -53,6 +53,9 @@
 #define OPT_TRACE_TIMESERIES           "trace.timeseries"
 #define OPT_TRACE_TIMESERIES_OPTIONS   "trace.timeseries-options"
 
+#define OPT_SST_STATS_INTERVAL         "sst.stats-interval"
+#define OPT_SST_STATS_PER_CONNECTION   "sst.stats-per-connection"
+
 
 namespace Sirikata {
 
@@ -40,11 +40,21 @@ namespace Sirikata {
 
 /** Fair Queue with one input queue of Messages per Key, backed by a TQueue. Each
  *  input queue can be assigned a weight and selection happens according to FairQueuing.
+ *
+ *  Queues which are enabled and have a message ready are kept in a binary heap
+ *  ordered by virtual finish time. Each queue records its position in the heap
+ *  so it can be removed or have its finish time adjusted in O(log n), making
+ *  push, pop, weight updates and enabling/disabling all O(log n) in the number
+ *  of queues.
  */
 template <class Message,class Key,class TQueue> class FairQueue {
 private:
     typedef TQueue MessageQueue;
 
+    enum {
+        NotInHeap = (size_t)-1
+    };
+
     struct QueueInfo {
     private:
         QueueInfo()
@@ -55,7 +65,10 @@ private:
            nextFinishMessage(NULL),
            nextFinishStartTime(Time::null()),
            nextFinishTime(Time::null()),
-           enabled(true)
+           enabled(true),
+           heapIndex(NotInHeap),
+           heapOrder(0),
+           countedDisabled(false)
         {
         }
     public:
@@ -67,7 +80,10 @@ private:
            nextFinishMessage(NULL),
            nextFinishStartTime(Time::null()),
            nextFinishTime(Time::null()),
-           enabled(true)
+           enabled(true),
+           heapIndex(NotInHeap),
+           heapOrder(0),
+           countedDisabled(false)
         {}
 
         ~QueueInfo() {
@@ -82,19 +98,16 @@ private:
         Time nextFinishStartTime; // The time the next message to finish started at, used to recompute if front() changed
         Time nextFinishTime;
         bool enabled;
+        size_t heapIndex; // Position in mQueuesByTime, or NotInHeap
+        uint64 heapOrder; // Breaks ties in finish time, earlier computed finish times go first
+        bool countedDisabled; // Whether this queue is counted in mDisabledPending
     };
 
     typedef std::map<Key, QueueInfo*> QueueInfoByKey; // NOTE: this could be unordered, but must be unique associative container
-    typedef std::multimap<Time, QueueInfo*> QueueInfoByFinishTime; // NOTE: this must be ordered multiple associative container
+    typedef std::vector<QueueInfo*> QueueInfoHeap;
 
     typedef typename QueueInfoByKey::iterator ByKeyIterator;
     typedef typename QueueInfoByKey::const_iterator ConstByKeyIterator;
-
-    typedef typename QueueInfoByFinishTime::iterator ByTimeIterator;
-    typedef typename QueueInfoByFinishTime::const_iterator ConstByTimeIterator;
-
-    typedef std::set<Key> KeySet;
-    typedef std::set<QueueInfo*> QueueInfoSet;
 public:
     FairQueue()
      :zero_time(Duration::zero()),
@@ -103,6 +116,9 @@ public:
       mCurrentVirtualTime(Time::null()),
       mQueuesByKey(),
       mQueuesByTime(),
+      mNextHeapOrder(0),
+      mDisabledPending(0),
+      mWeightSum(0.0),
       mFrontQueue(NULL)
     {
         warn_count = 0;
@@ -116,6 +132,7 @@ public:
     void addQueue(MessageQueue *mq, Key key, float weight) {
         QueueInfo* queue_info = new QueueInfo(key, mq, weight);
         mQueuesByKey[key] = queue_info;
+        mWeightSum += weight;
         computeNextFinishTime(queue_info);
         mFrontQueue = NULL; // Force recomputation of front
     }
@@ -127,20 +144,23 @@ public:
             float old_weight = qi->weight;
             qi->weight = weight;
             qi->weight_inv = (weight == 0.f ? 0.f : (1.f/weight));
-            // FIXME should we update the finish time here, or just wait until the next packet?
-            // Updating here requires either starting from current time or keeping track of
-            // the last dequeued time
-            //updateNextFinishTime(qi);
-
-            // Currently, we just special case queues going from zero
-            // to non-zero weight so they don't get stuck.  Computing
-            // based on the current virtual time is pretty much always
-            // better than waiting the default maximum amount of time
-            // for the current head packet to pass through.
-            if (old_weight == 0.0) {
-                removeFromTimeIndex(qi);
+            mWeightSum += (double)weight - (double)old_weight;
+
+            if (old_weight == weight)
+                return;
+
+            // Queues going from zero to non-zero weight are restarted from the
+            // current virtual time so they don't get stuck waiting the default
+            // maximum amount of time for the current head packet to pass
+            // through. Otherwise we recompute the head packet's finish time
+            // from the time it started, so the new weight applies immediately.
+            if (old_weight == 0.0)
                 computeNextFinishTime(qi);
-            }
+            else if (qi->nextFinishMessage != NULL)
+                computeNextFinishTime(qi, qi->nextFinishStartTime);
+
+            // The new finish time can change which queue is in front
+            mFrontQueue = NULL;
         }
     }
 
@@ -160,22 +180,23 @@ public:
         QueueInfo* qi = it->second;
 
         // Remove from the time index
-        removeFromTimeIndex(qi);
+        qi->nextFinishMessage = NULL;
+        updateTimeIndex(qi);
 
         // If its the front queue, reset it
         if (mFrontQueue == qi)
             mFrontQueue = NULL;
 
         // Clean up queue and main entry
+        mWeightSum -= qi->weight;
         mQueuesByKey.erase(it);
         delete qi;
 
         return true;
     }
 
-    // NOTE: Enabling and disabling only affects the computation of front() and
-    // pop() by setting a flag. Otherwise disabled queues are treated just like
-    // enabled queues, just ignored when looking for the next item.  Both
+    // NOTE: Disabled queues keep their finish times but are taken out of the
+    // heap, so they're ignored when looking for the next item.  Both
     // operations, under certain conditions, need to reset the previously
     // computed front queue because they can affect this computation by adding
     // or removing options.
@@ -185,6 +206,7 @@ public:
             return;
         QueueInfo* qi = it->second;
         qi->enabled = true;
+        updateTimeIndex(qi);
         // Enabling a queue *might* affect the choice of the front queue if
         //  a. another queue is currently selected as the front
         //  b. the enabled queue is non-empty
@@ -201,6 +223,7 @@ public:
         assert(it != mQueuesByKey.end());
         QueueInfo* qi = it->second;
         qi->enabled = false;
+        updateTimeIndex(qi);
 
         // Disabling a queue will only affect the choice of front queue if the
         // one disabled *was* the front queue.
@@ -249,7 +272,6 @@ public:
 
         // We just need to (re)compute the next finish time.
         QueueInfo* queue_info = qi_it->second;
-        removeFromTimeIndex(queue_info);
         computeNextFinishTime(queue_info);
 
         // Reevaluate front queue
@@ -311,9 +333,7 @@ public:
             assert(popped_val == mFrontQueue->nextFinishMessage);
             assert(popped_val == result);
 
-            // Remove from queue time list
-            removeFromTimeIndex(mFrontQueue);
-            // Update finish time and add back to time index if necessary
+            // Update finish time, which also fixes up the time index
             computeNextFinishTime(mFrontQueue, vftime);
 
             // Unmark the queue as being in front
@@ -324,15 +344,14 @@ public:
     }
 
     bool empty() const {
-        // Queues won't be in mQueuesByTime unless they have something in them
-        // This allows us to efficiently answer false if we know we have pending
-        // items
-        return mQueuesByTime.empty();
+        // Queues won't be in mQueuesByTime (or counted as disabled but
+        // pending) unless they have something in them. This allows us to
+        // efficiently answer false if we know we have pending items
+        return mQueuesByTime.empty() && mDisabledPending == 0;
     }
 
     // Returns the total amount of space that can be allocated for the destination
     uint32 maxSize(Key key) const {
-        // FIXME we could go through fewer using the ByTime index
         ConstByKeyIterator it = mQueuesByKey.find(key);
         if (it == mQueuesByKey.end()) return 0;
         return it->second->messageQueue->maxSize();
@@ -348,10 +367,7 @@ public:
     // FIXME we really shouldn't have to expose this
     float avg_weight() const {
         if (mQueuesByKey.size() == 0) return 1.f;
-        float w_sum = 0.f;
-        for(ConstByKeyIterator it = mQueuesByKey.begin(); it != mQueuesByKey.end(); it++)
-            w_sum += it->second->weight;
-        return w_sum / mQueuesByKey.size();
+        return (float)(mWeightSum / mQueuesByKey.size());
     }
 
     // Key iteration support
@@ -400,74 +416,120 @@ protected:
     void nextMessage(Message** result_out, Time* vftime_out, QueueInfo** min_queue_info_out) {
         *result_out = NULL;
 
-        // If there's nothing in the queue, there is no next message
+        // If there's nothing in the queue, there is no next message. Only
+        // enabled queues are in the heap, so the top is always the answer.
         if (mQueuesByTime.empty())
             return;
 
-        // Loop through until we find one that has data and can be handled.
-        bool advance = true; // Indicates whether the loop needs to advance, set to false when an unexpected front has already advanced to the next item in order to remove the current item
-        for(ByTimeIterator it = mQueuesByTime.begin(); it != mQueuesByTime.end(); advance ? it++ : it) {
-            Time min_queue_finish_time = it->first;
-            QueueInfo* min_queue_info = it->second;
-
-            advance = true;
+        QueueInfo* min_queue_info = mQueuesByTime.front();
 
-            // First, check if this queue is even enabled
-            if (!min_queue_info->enabled)
-                continue;
+        // These just assert that this queue is just sane.
+        assert(min_queue_info->enabled);
+        assert(min_queue_info->nextFinishMessage != NULL);
+        assert(min_queue_info->nextFinishMessage == min_queue_info->messageQueue->front());
 
-            // These just assert that this queue is just sane.
-            assert(min_queue_info->nextFinishMessage != NULL);
-            assert(min_queue_info->nextFinishMessage == min_queue_info->messageQueue->front());
+        *min_queue_info_out = min_queue_info;
+        *vftime_out = min_queue_info->nextFinishTime;
+        *result_out = min_queue_info->nextFinishMessage;
+    }
 
-            *min_queue_info_out = min_queue_info;
-            *vftime_out = min_queue_info->nextFinishTime;
-            *result_out = min_queue_info->nextFinishMessage;
-            break;
+    // Computes the next finish time for this queue and updates the time
+    // index: it's added if it has a message ready, repositioned if it was
+    // already there, or removed if it is now empty.
+    void computeNextFinishTime(QueueInfo* qi, const Time& last_finish_time) {
+        // If we don't restrict to strict queues, front() may return NULL even though the queue is not empty.
+        // For example, if the input queue is a FairQueue itself, nothing may be able to send due to the
+        // canSend predicate.
+        Message* front_msg = qi->messageQueue->empty() ? NULL : qi->messageQueue->front();
+        qi->nextFinishMessage = front_msg;
+        if (front_msg != NULL) {
+            qi->nextFinishTime = finishTime( front_msg->size(), qi, last_finish_time);
+            qi->nextFinishStartTime = last_finish_time;
+            qi->heapOrder = mNextHeapOrder++;
         }
-    }
 
-    // Finds and removes this queue from the time index (mQueuesByTime).
-    void removeFromTimeIndex(QueueInfo* qi) {
-        std::pair<ByTimeIterator, ByTimeIterator> eq_range = mQueuesByTime.equal_range(qi->nextFinishTime);
-        ByTimeIterator start_q = eq_range.first;
-        ByTimeIterator end_q = eq_range.second;
+        updateTimeIndex(qi);
+    }
 
-        for(ByTimeIterator it = start_q; it != end_q; it++) {
-            if (it->second == qi) {
-                mQueuesByTime.erase(it);
-                return;
-            }
-        }
+    void computeNextFinishTime(QueueInfo* qi) {
+        computeNextFinishTime(qi, mCurrentVirtualTime);
     }
 
-    // Computes the next finish time for this queue and, if it has one, inserts it into the time index
-    ByTimeIterator computeNextFinishTime(QueueInfo* qi, const Time& last_finish_time) {
-        if ( qi->messageQueue->empty() ) {
-            qi->nextFinishMessage = NULL;
-            return mQueuesByTime.end();
+    // Makes the time index reflect the queue's current state: it should be in
+    // the heap iff it is enabled and has a message ready.
+    void updateTimeIndex(QueueInfo* qi) {
+        bool pending = (qi->nextFinishMessage != NULL);
+
+        bool disabled_pending = pending && !qi->enabled;
+        if (disabled_pending != qi->countedDisabled) {
+            if (disabled_pending)
+                mDisabledPending++;
+            else
+                mDisabledPending--;
+            qi->countedDisabled = disabled_pending;
         }
 
-        // If we don't restrict to strict queues, front() may return NULL even though the queue is not empty.
-        // For example, if the input queue is a FairQueue itself, nothing may be able to send due to the
-        // canSend predicate.
-        Message* front_msg = qi->messageQueue->front();
-        if ( front_msg == NULL ) {
-            qi->nextFinishMessage = NULL;
-            return mQueuesByTime.end();
+        if (pending && qi->enabled) {
+            if (qi->heapIndex == (size_t)NotInHeap) {
+                qi->heapIndex = mQueuesByTime.size();
+                mQueuesByTime.push_back(qi);
+            }
+            siftDown(siftUp(qi->heapIndex));
         }
+        else if (qi->heapIndex != (size_t)NotInHeap) {
+            size_t idx = qi->heapIndex;
+            QueueInfo* last = mQueuesByTime.back();
+            mQueuesByTime.pop_back();
+            qi->heapIndex = NotInHeap;
+            if (last != qi) {
+                heapSet(idx, last);
+                siftDown(siftUp(idx));
+            }
+        }
+    }
 
-        qi->nextFinishMessage = front_msg;
-        qi->nextFinishTime = finishTime( front_msg->size(), qi, last_finish_time);
-        qi->nextFinishStartTime = last_finish_time;
+    static bool heapBefore(const QueueInfo* lhs, const QueueInfo* rhs) {
+        if (lhs->nextFinishTime != rhs->nextFinishTime)
+            return lhs->nextFinishTime < rhs->nextFinishTime;
+        return lhs->heapOrder < rhs->heapOrder;
+    }
 
-        ByTimeIterator new_it = mQueuesByTime.insert( typename QueueInfoByFinishTime::value_type(qi->nextFinishTime, qi) );
+    void heapSet(size_t idx, QueueInfo* qi) {
+        mQueuesByTime[idx] = qi;
+        qi->heapIndex = idx;
+    }
 
-        return new_it;
+    // Moves the entry at idx up until its parent is before it, returns its
+    // final position
+    size_t siftUp(size_t idx) {
+        QueueInfo* qi = mQueuesByTime[idx];
+        while(idx > 0) {
+            size_t parent = (idx - 1) / 2;
+            if (!heapBefore(qi, mQueuesByTime[parent]))
+                break;
+            heapSet(idx, mQueuesByTime[parent]);
+            idx = parent;
+        }
+        heapSet(idx, qi);
+        return idx;
     }
 
-    void computeNextFinishTime(QueueInfo* qi) {
-        computeNextFinishTime(qi, mCurrentVirtualTime);
+    // Moves the entry at idx down until it is before both its children
+    void siftDown(size_t idx) {
+        size_t count = mQueuesByTime.size();
+        QueueInfo* qi = mQueuesByTime[idx];
+        while(true) {
+            size_t child = 2 * idx + 1;
+            if (child >= count)
+                break;
+            if (child + 1 < count && heapBefore(mQueuesByTime[child + 1], mQueuesByTime[child]))
+                child++;
+            if (!heapBefore(mQueuesByTime[child], qi))
+                break;
+            heapSet(idx, mQueuesByTime[child]);
+            idx = child;
+        }
+        heapSet(idx, qi);
     }
 
     /** Finish time for a packet that was inserted into a non-empty queue, i.e. based on the previous packet's
@@ -495,9 +557,14 @@ protected:
 
     uint32 mRate;
     Time mCurrentVirtualTime;
-    // FIXME if I could get the templates to work, using multi_index_container instead of 2 containers would be preferable
     QueueInfoByKey mQueuesByKey;
-    QueueInfoByFinishTime mQueuesByTime;
+    // Binary heap of enabled queues with a message ready, ordered by finish
+    // time. Each QueueInfo tracks its own index into it.
+    QueueInfoHeap mQueuesByTime;
+    uint64 mNextHeapOrder;
+    // Queues with a message ready which are disabled, and so not in the heap
+    uint32 mDisabledPending;
+    double mWeightSum;
     QueueInfo* mFrontQueue; // Queue holding the front item
 }; // class FairQueue
 
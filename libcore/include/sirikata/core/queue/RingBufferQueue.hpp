@@ -0,0 +1,308 @@
+/*  Sirikata
+ *  RingBufferQueue.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_RING_BUFFER_QUEUE_HPP_
+#define _SIRIKATA_RING_BUFFER_QUEUE_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+#include "ThreadSafeQueue.hpp"
+
+namespace Sirikata {
+
+/** RingBufferQueue is a bounded, lock-free, multi-producer multi-consumer
+ *  queue. It is backed by a fixed size ring of slots, each tagged with a
+ *  sequence number which tells producers and consumers whether it is ready for
+ *  them, so push() and pop() each cost a single compare-and-swap in the
+ *  uncontended case and never allocate.
+ *
+ *  The head and tail indices are kept on separate cache lines so producers
+ *  and consumers don't contend on them. Blocking operations fall back to a
+ *  lock and condition only when they actually have to wait.
+ *
+ *  It provides the same interface as ThreadSafeQueue, minus swap(), so it can
+ *  be used with WorkQueueImpl. Note that since it is bounded, push() blocks
+ *  while the queue is full; use tryPush() to avoid that.
+ */
+template <typename T>
+class RingBufferQueue : Noncopyable {
+    enum {
+        CacheLineSize = 64
+    };
+    typedef intptr_t Diff;
+
+    struct Slot {
+        volatile size_t sequence;
+        T value;
+    };
+
+    // Keep each index on its own cache line
+    struct PaddedIndex {
+        volatile size_t value;
+        char padding[CacheLineSize - sizeof(size_t)];
+    };
+
+    char mPad0[CacheLineSize];
+    Slot* mSlots;
+    size_t mMask;
+    char mPad1[CacheLineSize];
+    PaddedIndex mTail; // Next slot to push into
+    PaddedIndex mHead; // Next slot to pop from
+    PaddedIndex mWaiters; // Threads blocked in blockingPop or push
+
+    ThreadSafeQueueNS::Lock* mLock;
+    ThreadSafeQueueNS::Condition* mNotEmpty;
+    ThreadSafeQueueNS::Condition* mNotFull;
+
+    static size_t roundUpCapacity(size_t capacity) {
+        size_t result = 2;
+        while(result < capacity)
+            result <<= 1;
+        return result;
+    }
+
+    // Wakes blocked threads, if there are any. Only takes the lock when
+    // someone is actually waiting.
+    void wake(ThreadSafeQueueNS::Condition* cond) {
+        memory_barrier();
+        if (mWaiters.value == 0) return;
+        ThreadSafeQueueNS::lock(mLock);
+        ThreadSafeQueueNS::notifyAll(cond);
+        ThreadSafeQueueNS::unlock(mLock);
+    }
+
+    // Helpers for ThreadSafeQueueNS::wait, return true to keep waiting
+    static bool popWaitCheck(void* thus, void* vretval) {
+        return !reinterpret_cast<RingBufferQueue*>(thus)->tryPopInternal(*reinterpret_cast<T*>(vretval));
+    }
+    static bool pushWaitCheck(void* thus, void* vvalue) {
+        return !reinterpret_cast<RingBufferQueue*>(thus)->tryPushInternal(*reinterpret_cast<const T*>(vvalue));
+    }
+
+    bool tryPushInternal(const T& value) {
+        size_t pos = mTail.value;
+        while(true) {
+            Slot* slot = &mSlots[pos & mMask];
+            size_t seq = slot->sequence;
+            memory_barrier();
+            Diff diff = (Diff)seq - (Diff)pos;
+            if (diff == 0) {
+                // Slot is free, try to claim it
+                if (SizedAtomicValue<sizeof(size_t)>::cas(&mTail.value, pos, pos + 1)) {
+                    slot->value = value;
+                    memory_barrier();
+                    slot->sequence = pos + 1;
+                    return true;
+                }
+                pos = mTail.value;
+            }
+            else if (diff < 0) {
+                // Slot still holds an element from the last lap, full
+                return false;
+            }
+            else {
+                // Another producer got it first
+                pos = mTail.value;
+            }
+        }
+    }
+
+    bool tryPopInternal(T& ret) {
+        size_t pos = mHead.value;
+        while(true) {
+            Slot* slot = &mSlots[pos & mMask];
+            size_t seq = slot->sequence;
+            memory_barrier();
+            Diff diff = (Diff)seq - (Diff)(pos + 1);
+            if (diff == 0) {
+                if (SizedAtomicValue<sizeof(size_t)>::cas(&mHead.value, pos, pos + 1)) {
+                    ret = slot->value;
+                    // Don't hold onto references, e.g. shared_ptrs
+                    slot->value = T();
+                    memory_barrier();
+                    slot->sequence = pos + mMask + 1;
+                    return true;
+                }
+                pos = mHead.value;
+            }
+            else if (diff < 0) {
+                // Nothing has been pushed into this slot yet, empty
+                return false;
+            }
+            else {
+                pos = mHead.value;
+            }
+        }
+    }
+
+    void blockUntil(bool (*check)(void*, void*), ThreadSafeQueueNS::Condition* cond, void* arg) {
+        SizedAtomicValue<sizeof(size_t)>::inc(&mWaiters.value);
+        ThreadSafeQueueNS::wait(mLock, cond, check, this, arg);
+        SizedAtomicValue<sizeof(size_t)>::dec(&mWaiters.value);
+    }
+
+public:
+    class NodeIterator : Noncopyable {
+        T* mNext;
+        std::deque<T> mPopped;
+    public:
+        NodeIterator(RingBufferQueue<T>& queue) : mNext(NULL) {
+            queue.popAll(&mPopped);
+        }
+
+        T* next() {
+            if (mNext)
+                mPopped.pop_front();
+            if (mPopped.empty())
+                return NULL;
+            mNext = &(mPopped.front());
+            return mNext;
+        }
+    };
+
+    /** Create a queue holding up to capacity elements. The capacity is rounded
+     *  up to a power of two.
+     */
+    explicit RingBufferQueue(size_t capacity = 1024)
+     : mSlots(NULL),
+       mMask(0)
+    {
+        size_t size = roundUpCapacity(capacity);
+        mSlots = new Slot[size];
+        mMask = size - 1;
+        for(size_t i = 0; i < size; i++)
+            mSlots[i].sequence = i;
+        mTail.value = 0;
+        mHead.value = 0;
+        mWaiters.value = 0;
+
+        mLock = ThreadSafeQueueNS::lockCreate();
+        mNotEmpty = ThreadSafeQueueNS::condCreate();
+        mNotFull = ThreadSafeQueueNS::condCreate();
+    }
+
+    ~RingBufferQueue() {
+        delete[] mSlots;
+        ThreadSafeQueueNS::lockDestroy(mLock);
+        ThreadSafeQueueNS::condDestroy(mNotEmpty);
+        ThreadSafeQueueNS::condDestroy(mNotFull);
+    }
+
+    size_t capacity() const {
+        return mMask + 1;
+    }
+
+    /** Try to push a value onto the queue.
+     *  \returns true if the value was pushed, false if the queue was full
+     */
+    bool tryPush(const T& value) {
+        if (!tryPushInternal(value))
+            return false;
+        wake(mNotEmpty);
+        return true;
+    }
+
+    /** Push a value onto the queue, blocking while it is full. */
+    void push(const T& value) {
+        if (!tryPushInternal(value))
+            blockUntil(&RingBufferQueue<T>::pushWaitCheck, mNotFull, const_cast<T*>(&value));
+        wake(mNotEmpty);
+    }
+
+    /** Push as many of count values as fit, waking consumers only once.
+     *  \returns the number of values pushed
+     */
+    size_t pushBatch(const T* values, size_t count) {
+        size_t pushed = 0;
+        while(pushed < count && tryPushInternal(values[pushed]))
+            pushed++;
+        if (pushed > 0)
+            wake(mNotEmpty);
+        return pushed;
+    }
+
+    /** Pops the front element from the queue and places it in ret.
+     *  \param ret storage for the popped element
+     *  \returns true if an element was popped, false if the queue was empty
+     */
+    bool pop(T& ret) {
+        if (!tryPopInternal(ret))
+            return false;
+        wake(mNotFull);
+        return true;
+    }
+
+    /** Pop up to max_count elements into out, waking producers only once.
+     *  \returns the number of elements popped
+     */
+    size_t popBatch(T* out, size_t max_count) {
+        size_t popped = 0;
+        while(popped < max_count && tryPopInternal(out[popped]))
+            popped++;
+        if (popped > 0)
+            wake(mNotFull);
+        return popped;
+    }
+
+    /** Pops all elements currently in the queue into popResults.  Any
+     *  elements currently in popResults will be discarded.
+     */
+    void popAll(std::deque<T>* popResults) {
+        popResults->clear();
+        T value;
+        while(tryPopInternal(value))
+            popResults->push_back(value);
+        if (!popResults->empty())
+            wake(mNotFull);
+    }
+
+    /** Pop an element from the queue, blocking until an element is available
+     *  if the queue is currently empty.
+     */
+    void blockingPop(T& retval) {
+        if (!tryPopInternal(retval))
+            blockUntil(&RingBufferQueue<T>::popWaitCheck, mNotEmpty, &retval);
+        wake(mNotFull);
+    }
+
+    /** Returns true if the queue appears empty. This may be out of date by
+     *  the time it returns if other threads are using the queue.
+     */
+    bool probablyEmpty() {
+        size_t pos = mHead.value;
+        return (Diff)mSlots[pos & mMask].sequence - (Diff)(pos + 1) < 0;
+    }
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_RING_BUFFER_QUEUE_HPP_
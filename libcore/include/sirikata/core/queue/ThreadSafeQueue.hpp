@@ -47,6 +47,8 @@ SIRIKATA_EXPORT void wait(Lock*lok,
           void* arg1, void* arg2);
 /// Notifies the condition once
 SIRIKATA_EXPORT void notify(Condition* cond);
+/// Notifies all waiters on the condition
+SIRIKATA_EXPORT void notifyAll(Condition* cond);
 /// release the lock
 SIRIKATA_EXPORT void unlock(Lock*lok);
 /// creates a Lock class
@@ -42,6 +42,7 @@ namespace Sirikata {
 
 template <class T> class LockFreeQueue;
 template <class T> class ThreadSafeQueue;
+template <class T> class RingBufferQueue;
 template <class T> class AtomicValue;
 
 namespace Task {
@@ -192,6 +193,8 @@ public:
 typedef WorkQueueImpl<LockFreeQueue<WorkItem*> > RealLockFreeWorkQueue;
 typedef WorkQueueImpl<ThreadSafeQueue<WorkItem*> > LockFreeWorkQueue;
 typedef WorkQueueImpl<ThreadSafeQueue<WorkItem*> > ThreadSafeWorkQueue;
+/// Bounded, lock-free work queue. enqueue() blocks while the queue is full.
+typedef WorkQueueImpl<RingBufferQueue<WorkItem*> > BoundedWorkQueue;
 
 template <class QueueType>
 class SIRIKATA_EXPORT UnsafeWorkQueueImpl : public WorkQueue {
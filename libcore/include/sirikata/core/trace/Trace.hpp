@@ -84,6 +84,8 @@ struct Drops {
 #define ObjectPingTag 17
 #define ObjectPingCreatedTag 32
 #define ObjectHitPointTag 34
+#define OSegBatchLookupTag 35
+#define OSegLookupLatencyTag 36
 
 #define OSegTrackedSetResultAnalysisTag   19
 #define OSegShutdownEventTag              20
@@ -54,6 +54,9 @@ public:
     template<typename T> static T dec(volatile T*scalar) {
         return (T)InterlockedDecrement((volatile LONG*)scalar);
     }
+    template<typename T> static bool cas(volatile T*scalar, T comperand, T exchange) {
+        return InterlockedCompareExchange((volatile LONG*)scalar, (LONG)exchange, (LONG)comperand) == (LONG)comperand;
+    }
 };
 template<> class SizedAtomicValue<8> {
 public:
@@ -66,6 +69,9 @@ public:
     template<typename T> static T dec(volatile T*scalar) {
         return (T)InterlockedDecrement64((volatile LONGLONG*)scalar);
     }
+    template<typename T> static bool cas(volatile T*scalar, T comperand, T exchange) {
+        return InterlockedCompareExchange64((volatile LONGLONG*)scalar, (LONGLONG)exchange, (LONGLONG)comperand) == (LONGLONG)comperand;
+    }
 };
 #elif defined(__APPLE__)
 template<int size> class SizedAtomicValue {
@@ -83,6 +89,9 @@ public:
     template <typename T> static T dec(volatile T*scalar) {
         return (T)OSAtomicDecrement32((int32*)scalar);
     }
+    template <typename T> static bool cas(volatile T*scalar, T comperand, T exchange) {
+        return OSAtomicCompareAndSwap32Barrier((int32)comperand, (int32)exchange, (int32*)scalar);
+    }
 };
 
 template<> class SizedAtomicValue<8> {
@@ -96,6 +105,9 @@ public:
     template <typename T> static T dec(volatile T*scalar) {
         return (T)OSAtomicDecrement64((int64*)scalar);
     }
+    template <typename T> static bool cas(volatile T*scalar, T comperand, T exchange) {
+        return OSAtomicCompareAndSwap64Barrier((int64)comperand, (int64)exchange, (int64*)scalar);
+    }
 };
 #else
 template<int size> class SizedAtomicValue {
@@ -109,8 +121,22 @@ public:
     template <typename T> static T dec(volatile T*scalar) {
         return __sync_sub_and_fetch(scalar, 1);
     }
+    template <typename T> static bool cas(volatile T*scalar, T comperand, T exchange) {
+        return __sync_bool_compare_and_swap(scalar, comperand, exchange);
+    }
 };
 #endif
+
+/// Full memory barrier, for ordering plain loads and stores around atomics.
+inline void memory_barrier() {
+#ifdef _WIN32
+    MemoryBarrier();
+#elif defined(__APPLE__)
+    OSMemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
 #ifdef _WIN32
 #pragma warning( push )
 #pragma warning (disable : 4312)
@@ -0,0 +1,81 @@
+/*  Sirikata
+ *  Base64.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_CORE_UTIL_BASE64_HPP_
+#define _SIRIKATA_CORE_UTIL_BASE64_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+
+namespace Sirikata {
+
+/** Base64 encoding and decoding. Encoding uses the URL safe alphabet ('-' and
+ *  '_' for 62 and 63) with '=' padding. Decoding accepts either alphabet,
+ *  skips whitespace and other characters outside the alphabet, and stops after
+ *  the first quartet containing padding.
+ *
+ *  Bulk data is handled with AVX2 or SSSE3 kernels when the library is built
+ *  with them enabled, with a scalar fallback for other builds and for input
+ *  that needs the decoder's slow path.
+ */
+class SIRIKATA_EXPORT Base64 {
+public:
+    /// Number of bytes encode() will write for len input bytes.
+    static size_t encodedSize(size_t len) {
+        return ((len + 2) / 3) * 4;
+    }
+    /// Space decode() needs for len input characters.
+    static size_t decodedMaxSize(size_t len) {
+        return (len * 3) / 4 + 3;
+    }
+
+    /** Encode len bytes from src into dst, which must have room for
+     *  encodedSize(len) bytes.
+     *  \returns the number of bytes written
+     */
+    static size_t encode(const uint8* src, size_t len, uint8* dst);
+    /** Decode len characters from src into dst, which must have room for
+     *  decodedMaxSize(len) bytes.
+     *  \returns the number of bytes written
+     */
+    static size_t decode(const uint8* src, size_t len, uint8* dst);
+
+    /// Scalar versions of encode and decode, for testing and benchmarking
+    static size_t encodeScalar(const uint8* src, size_t len, uint8* dst);
+    static size_t decodeScalar(const uint8* src, size_t len, uint8* dst);
+
+    /// Name of the vector kernels compiled in: "avx2", "ssse3" or "scalar".
+    static const char* implementation();
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_CORE_UTIL_BASE64_HPP_
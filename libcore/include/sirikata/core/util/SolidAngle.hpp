@@ -72,6 +72,30 @@ public:
     /// Get the maximum distance from an object of the given radius that could
     /// result in this solid angle.  Effectively the inverse of fromCenterRadius.
     float maxDistance(float obj_radius) const;
+
+    /** Test many objects against this solid angle at once. Object i is
+     *  visible if the sphere with center (cx[i], cy[i], cz[i]) and radius
+     *  radii[i] subtends at least this solid angle as seen from query_pos,
+     *  i.e. if fromCenterRadius(center - query_pos, radius) >= *this.
+     *
+     *  Results are written as a bitmask: bit (i % 32) of mask_out[i / 32] is
+     *  set for visible objects. mask_out must have room for (count+31)/32
+     *  words and is fully overwritten. Uses SSE or AVX when available, 4 or 8
+     *  objects at a time, with a scalar fallback.
+     *
+     *  \returns the number of visible objects
+     */
+    uint32 visibleBatch(const Vector3<float>& query_pos,
+        const float* cx, const float* cy, const float* cz, const float* radii, uint32 count,
+        uint32* mask_out) const;
+
+    /** Evaluate several queries against the same objects. Query q is at
+     *  (qx[q], qy[q], qz[q]) with angle angles[q], and its results are written
+     *  to row q of mask_out, where each row is (count+31)/32 words.
+     */
+    static void visibleBatch(const float* qx, const float* qy, const float* qz, const SolidAngle* angles, uint32 nqueries,
+        const float* cx, const float* cy, const float* cz, const float* radii, uint32 count,
+        uint32* mask_out);
 protected:
     static const float MinVal;
     static const float MaxVal;
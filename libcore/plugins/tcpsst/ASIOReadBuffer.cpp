@@ -40,6 +40,7 @@
 #include "MultiplexedSocket.hpp"
 #include "ASIOReadBuffer.hpp"
 #include "VariableLength.hpp"
+#include <sirikata/core/util/Base64.hpp>
 namespace Sirikata { namespace Network {
 
 struct ASIOReadBufferUtil {
@@ -115,70 +116,6 @@ ASIOReadBuffer::ReceivedResponse ASIOReadBuffer::processFullChunk(const Multiple
     );
     return (user_paused_stream ? PausedStream : AcceptedData);
 }
-static signed char WHITE_SPACE_ENC = -5; // Indicates white space in encoding
-static signed char EQUALS_SIGN_ENC = -1; // Indicates equals sign in encoding
-static int decode4to3(const signed char source[4],Chunk& destination, int destOffset) {
-    uint32 outBuf=((source[0]<<18)|(source[1]<<12));
-    destination[destOffset]=(uint8)(outBuf/65536);
-    if (source[2]==EQUALS_SIGN_ENC) {
-        return 1;
-    }
-    outBuf|=(source[2]<<6);
-    destination[destOffset+1]=(uint8)((outBuf/256)&255);
-    if (source[3]==EQUALS_SIGN_ENC) {
-            return 2;
-    }
-    outBuf|=source[3];
-    destination[destOffset+2]=(uint8)(outBuf&255);
-    return 3;
-}
-
-static signed char DECODABET [] = {
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,                 // Decimal  0 -  8
-        -5,-5,                                      // Whitespace: Tab and Linefeed
-        -9,-9,                                      // Decimal 11 - 12
-        -5,                                         // Whitespace: Carriage Return
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,     // Decimal 14 - 26
-        -9,-9,-9,-9,-9,                             // Decimal 27 - 31
-        -5,                                         // Whitespace: Space
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,-9,              // Decimal 33 - 42
-        62,                                         // Plus sign at decimal 43
-        -9,-9,-9,                                   // Decimal 44 - 46
-        63,                                         // Slash at decimal 47
-        52,53,54,55,56,57,58,59,60,61,              // Numbers zero through nine
-        -9,-9,-9,                                   // Decimal 58 - 60
-        -1,                                         // Equals sign at decimal 61
-        -9,-9,-9,                                      // Decimal 62 - 64
-        0,1,2,3,4,5,6,7,8,9,10,11,12,13,            // Letters 'A' through 'N'
-        14,15,16,17,18,19,20,21,22,23,24,25,        // Letters 'O' through 'Z'
-        -9,-9,-9,-9,-9,-9,                          // Decimal 91 - 96
-        26,27,28,29,30,31,32,33,34,35,36,37,38,     // Letters 'a' through 'm'
-        39,40,41,42,43,44,45,46,47,48,49,50,51,     // Letters 'n' through 'z'
-        -9,-9,-9,-9,-9                                 // Decimal 123 - 126
-};
-static signed char URLSAFEDECODABET [] = {
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,                 // Decimal  0 -  8
-        -5,-5,                                      // Whitespace: Tab and Linefeed
-        -9,-9,                                      // Decimal 11 - 12
-        -5,                                         // Whitespace: Carriage Return
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,     // Decimal 14 - 26
-        -9,-9,-9,-9,-9,                             // Decimal 27 - 31
-        -5,                                         // Whitespace: Space
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,-9,              // Decimal 33 - 42
-        62,                                         // Plus sign at decimal 43
-        -9,62,-9,                                   // Decimal 44 - 46
-        63,                                         // Slash at decimal 47
-        52,53,54,55,56,57,58,59,60,61,              // Numbers zero through nine
-        -9,-9,-9,                                   // Decimal 58 - 60
-        -1,                                         // Equals sign at decimal 61
-        -9,-9,-9,                                      // Decimal 62 - 64
-        0,1,2,3,4,5,6,7,8,9,10,11,12,13,            // Letters 'A' through 'N'
-        14,15,16,17,18,19,20,21,22,23,24,25,        // Letters 'O' through 'Z'
-        -9,-9,-9,-9,63,-9,                          // Decimal 91 - 94 underscore 95
-        26,27,28,29,30,31,32,33,34,35,36,37,38,     // Letters 'a' through 'm'
-        39,40,41,42,43,44,45,46,47,48,49,50,51,     // Letters 'n' through 'z'
-        -9,-9,-9,-9,-9                                 // Decimal 123 - 127
-};
 static Stream::StreamID parseId(Chunk&newChunk,int&outBuffPosn) {
     Stream::StreamID id;
     unsigned int headerLength=outBuffPosn;
@@ -216,34 +153,11 @@ ASIOReadBuffer::ReceivedResponse ASIOReadBuffer::processFullZeroDelimChunk(const
     begin+=streamIdOffset;
 
 
-    Chunk newChunk(((end-begin)*3)/4+3);//maximum of the size;
-    int remainderShift=0;
-
-    int outBuffPosn=0;
-    signed char b4[4];
-    uint8 b4Posn=0;
-    for (;begin!=end;++begin) {
-        uint8 cur=(*begin);
-        uint8 sbiCrop = (uint8)(cur & 0x7f); // Only the low seven bits
-        signed char sbiDecode = URLSAFEDECODABET[ sbiCrop ];   // Special value
-
-        // White space, Equals sign, or legit Base64 character
-        // Note the values such as -5 and -9 in the
-        // DECODABETs at the top of the file.
-        if( sbiDecode >= WHITE_SPACE_ENC && cur==sbiCrop )  {
-            if( sbiDecode >= EQUALS_SIGN_ENC ) {
-                b4[ b4Posn++ ] = sbiDecode;           // Save non-whitespace
-                if( b4Posn > 3 ) {                  // Time to decode?
-                    outBuffPosn += decode4to3( b4, newChunk, outBuffPosn );
-                    b4Posn = 0;
-                    // If that was the equals sign, break out of 'for' loop
-                    if( sbiDecode == EQUALS_SIGN_ENC ) {
-                        break;
-                    }   // end if: equals sign
-                }   // end if: quartet built
-            }   // end if: equals sign or better
-        }   // end if: white space, equals sign or better
-    }
+    ReceiveBufferPool&pool=parentSocket->getASIOSocketWrapper(whichSocket).getReceivePool();
+    Chunk newChunk;
+    pool.acquire(Base64::decodedMaxSize(end-begin),&newChunk);
+    newChunk.resize(Base64::decodedMaxSize(end-begin));
+    int outBuffPosn=(int)Base64::decode(begin,end-begin,&*newChunk.begin());
     assert(outBuffPosn<=(int)newChunk.size());
     newChunk.resize(outBuffPosn);
 
@@ -256,6 +170,8 @@ ASIOReadBuffer::ReceivedResponse ASIOReadBuffer::processFullZeroDelimChunk(const
         mCachedRejectedChunk=new Chunk;
         mCachedRejectedChunk->swap(newChunk);
         mNewChunkID=id;
+    }else {
+        pool.release(&newChunk);
     }
     return (user_paused_stream ? PausedStream : AcceptedData);
 }
@@ -381,7 +297,9 @@ void ASIOReadBuffer::translateBuffer(const MultiplexedSocketPtr &thus) {
                     }
                 }else {
                     uint32 chunkLength=packetLength.read();
+                    ReceiveBufferPool&pool=thus->getASIOSocketWrapper(mWhichBuffer).getReceivePool();
                     Chunk resultChunk;
+                    pool.acquire(chunkLength,&resultChunk);
                     Stream::StreamID resultID=processPartialChunk(mBuffer+chunkPos+packetHeaderLength,packetLength.read(),chunkLength,resultChunk);
                     size_t vectorSize=resultChunk.size();
 
@@ -391,8 +309,11 @@ void ASIOReadBuffer::translateBuffer(const MultiplexedSocketPtr &thus) {
                     );
                     if (process_resp == AcceptedData) {
                         chunkPos+=packetHeaderLength+packetLength.read();
+                        pool.release(&resultChunk);
                     } else { // Paused, most work already handled by callback
                         assert(resultChunk.size()==vectorSize);//if the user rejects the packet they should not munge it
+                        //the packet is parsed again from mBuffer when reading resumes
+                        pool.release(&resultChunk);
                         break;
                     }
                 }
@@ -464,8 +385,13 @@ void ASIOReadBuffer::asioReadIntoZeroDelimChunk(const ErrorCode&error,std::size_
         if (error){
             processError(&*thus,error);
         }else {
-            for (unsigned int i=curZeroScanLocation;i<mBufferPos;++i) {
-                if (mNewChunk[i]==0xff) {
+            unsigned int i=curZeroScanLocation;
+            while (i<mBufferPos) {
+                const uint8*scanBase=&*mNewChunk.begin();
+                const uint8*delim=(const uint8*)memchr(scanBase+i,0xff,mBufferPos-i);
+                if (delim==NULL) break;
+                i=(unsigned int)(delim-scanBase);
+                {
                     ReadStatus read_status_value =
                         (curOffset == 0) ? PAUSED_NEW_DELIM_CHUNK : PAUSED_FIXED_BUFFER;
                     ReceivedResponse resp = processFullZeroDelimChunk(
@@ -486,6 +412,7 @@ void ASIOReadBuffer::asioReadIntoZeroDelimChunk(const ErrorCode&error,std::size_
                         break;
                     }
                 }
+                ++i;
             }
             if (curOffset==0) {//no packet processed, still large
                 if (!readBufferFull)
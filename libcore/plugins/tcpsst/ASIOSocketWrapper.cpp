@@ -40,6 +40,7 @@
 #include "ASIOSocketWrapper.hpp"
 #include "MultiplexedSocket.hpp"
 #include "VariableLength.hpp"
+#include <sirikata/core/util/Base64.hpp>
 
 namespace Sirikata { namespace Network {
 
@@ -84,91 +85,41 @@ void BufferPrint(void * pointerkey, const char extension[16], const void * vbuf,
                 key.getArray().begin(),
                 UUID::static_size);
 }
-static uint32 conservativeBase64Size(size_t x) {
-    return (x+2)*4/3+6+x/64+(x%64?1:0);
-}
-static const uint8 _URL_SAFE_ALPHABET []= {
-        (uint8)'A', (uint8)'B', (uint8)'C', (uint8)'D', (uint8)'E', (uint8)'F', (uint8)'G',
-        (uint8)'H', (uint8)'I', (uint8)'J', (uint8)'K', (uint8)'L', (uint8)'M', (uint8)'N',
-        (uint8)'O', (uint8)'P', (uint8)'Q', (uint8)'R', (uint8)'S', (uint8)'T', (uint8)'U',
-        (uint8)'V', (uint8)'W', (uint8)'X', (uint8)'Y', (uint8)'Z',
-        (uint8)'a', (uint8)'b', (uint8)'c', (uint8)'d', (uint8)'e', (uint8)'f', (uint8)'g',
-        (uint8)'h', (uint8)'i', (uint8)'j', (uint8)'k', (uint8)'l', (uint8)'m', (uint8)'n',
-        (uint8)'o', (uint8)'p', (uint8)'q', (uint8)'r', (uint8)'s', (uint8)'t', (uint8)'u',
-        (uint8)'v', (uint8)'w', (uint8)'x', (uint8)'y', (uint8)'z',
-        (uint8)'0', (uint8)'1', (uint8)'2', (uint8)'3', (uint8)'4', (uint8)'5',
-        (uint8)'6', (uint8)'7', (uint8)'8', (uint8)'9', (uint8)'-', (uint8)'_'
-    };
-
-int translateBase64(uint8*destination, const uint8* source, int numSigBytes) {
-    uint32 source0=source[0];
-    uint32 source1=source[1];
-    uint32 source2=source[2];
-    uint32 inBuff =   ( numSigBytes > 0 ? ((source0 << 24) / 256) : 0 )
-                     | ( numSigBytes > 1 ? ((source1 << 24) / 65536) : 0 )
-                     | ( numSigBytes > 2 ? ((source2 << 24) / 65536/ 256) : 0 );
-
-    destination[ 0 ] = _URL_SAFE_ALPHABET[ (inBuff >> 18)        ];
-    destination[ 1 ] = _URL_SAFE_ALPHABET[ (inBuff >> 12) & 0x3f ];
-
-    switch( numSigBytes )
-    {
-      case 3:
-        destination[ 2 ] = _URL_SAFE_ALPHABET[ (inBuff >>  6) & 0x3f ];
-        destination[ 3 ] = _URL_SAFE_ALPHABET[ (inBuff      ) & 0x3f ];
-        return 4;
-      case 2:
-        destination[ 2 ] = _URL_SAFE_ALPHABET[ (inBuff >>  6) & 0x3f ];
-        destination[ 3 ] = '=';
-        return 4;
-
-      case 1:
-        destination[ 2 ] = '=';
-        destination[ 3 ] = '=';
-        return 4;
-
-      default:
-        return 0;
-    }   // end switch
-
-}
-
 Chunk* ASIOSocketWrapper::toBase64ZeroDelim(const MemoryReference&a, const MemoryReference&b, const MemoryReference&c, const MemoryReference*rawBytesToPrepend) {
     const MemoryReference*refs[3]; refs[0]=&a; refs[1]=&b; refs[2]=&c;
-    unsigned int datalen=0;
-    uint8 data[3];
-    Chunk * retval= new Chunk((rawBytesToPrepend?rawBytesToPrepend->size():0)+conservativeBase64Size(a.size()+b.size()+c.size())+2);
-    Chunk::iterator prependStart=retval->begin();
-    *(prependStart++)='\0';//frame start
-    if (rawBytesToPrepend) {
-        memcpy(&*prependStart,rawBytesToPrepend->data(),rawBytesToPrepend->size());
-        prependStart+=rawBytesToPrepend->size();
+    size_t prependSize=(rawBytesToPrepend?rawBytesToPrepend->size():0);
+    Chunk * retval= new Chunk(1+prependSize+Base64::encodedSize(a.size()+b.size()+c.size())+1);
+    uint8*out=&*retval->begin();
+    *(out++)='\0';//frame start
+    if (prependSize) {
+        memcpy(out,rawBytesToPrepend->data(),prependSize);
+        out+=prependSize;
     }
-    size_t retvalSize=retval->size();
-    unsigned int curPlace=(unsigned int)(prependStart-retval->begin());
+    // Groups of 3 bytes can span references, so carry leftovers into the next
+    uint8 carry[3];
+    size_t carryLen=0;
     for (int i=0;i<3;++i) {
         const uint8*dat=(const uint8*)refs[i]->data();
-        uint32 size=refs[i]->size();
-        for (uint32 j=0;j<size;++j) {
-            data[datalen++]=dat[j];
-            if (datalen==3) {
-                if (retvalSize<=curPlace+5) {
-                    retval->resize(curPlace+5);
-                }
-                curPlace+=translateBase64(&*(retval->begin()+curPlace),data,datalen);
-                datalen=0;
-            }
+        size_t size=refs[i]->size();
+        while (carryLen&&carryLen<3&&size) {
+            carry[carryLen++]=*(dat++);
+            --size;
         }
-    }
-    if (datalen) {
-        if (retvalSize<=curPlace+5) {
-            retval->resize(curPlace+5);
-            SILOG(tcpsst,error,"conservative size estimate incorrect");
+        if (carryLen==3) {
+            out+=Base64::encode(carry,3,out);
+            carryLen=0;
+        }
+        size_t whole=size-size%3;
+        out+=Base64::encode(dat,whole,out);
+        for (size_t j=whole;j<size;++j) {
+            carry[carryLen++]=dat[j];
         }
-        curPlace+=translateBase64(&*(retval->begin()+curPlace),data,datalen);
     }
-    (*retval)[curPlace]=0xff;//0xff DELIMITED
-    retval->resize(curPlace+1);
+    if (carryLen) {
+        out+=Base64::encode(carry,carryLen,out);
+    }
+    *(out++)=0xff;//0xff DELIMITED
+    retval->resize(out-&*retval->begin());
     return retval;
 }
 
@@ -184,13 +135,23 @@ void ASIOSocketWrapper::unpauseSendStreams(const MultiplexedSocketPtr&parentMult
 }
 
 
+void ASIOSocketWrapper::popPendingSends(std::deque<TimestampedChunk>*toSend) {
+    mSendQueue.popAll(toSend);
+    if (!mUnsent.empty()) {
+        //leftovers from the last write go out ahead of anything queued since
+        mUnsent.insert(mUnsent.end(),toSend->begin(),toSend->end());
+        toSend->swap(mUnsent);
+        mUnsent.clear();
+    }
+}
+
 void ASIOSocketWrapper::finishAsyncSend(const MultiplexedSocketPtr&parentMultiSocket) {
     //When this function is called, the ASYNCHRONOUS_SEND_FLAG must be set because this particular context is the one finishing up a send
     assert(mSendingStatus.read()&ASYNCHRONOUS_SEND_FLAG);
     //Turn on the information that the queue is being checked and this means that further pushes to the queue may not be heeded if the queue happened to be empty
     mSendingStatus+=QUEUE_CHECK_FLAG;
     std::deque<TimestampedChunk>toSend;
-    mSendQueue.popAll(&toSend);
+    popPendingSends(&toSend);
     std::size_t num_packets=toSend.size();
     if (num_packets==0) {
         //if there are no packets in the queue, some other send() operation will need to take the torch to send further packets
@@ -222,8 +183,8 @@ void ASIOSocketWrapper::sendManyDequeItems(const std::tr1::weak_ptr<MultiplexedS
             size_t total_size=0;
             for (std::deque<TimestampedChunk>::const_iterator i=local_toSend.begin(),ie=local_toSend.end();i!=ie;++i) {
                 finishedSendingChunk(*i);
-                size_t cursize=i->size();
-                total_size+=cursize;
+                size_t cursize=i->chunk->size();
+                total_size+=i->header.size()+cursize;
                 if (cursize) {
                     BufferPrint(this,".sec",&*i->chunk->begin(),cursize);
                     TCPSSTLOG(this,"snd",&*i->begin(),i->size,error);
@@ -243,13 +204,29 @@ void ASIOSocketWrapper::sendToWire(const MultiplexedSocketPtr&parentMultiSocket,
     //sending a single chunk is a straightforward call directly to asio
     mToSend.resize(0);
     mToSend.push_back(toSend);
-    BufferPrint(this,".buw",&*toSend.chunk->begin(),toSend.size());
+    size_t cursize=toSend.chunk->size();
+    if (cursize) {
+        BufferPrint(this,".buw",&*toSend.chunk->begin(),cursize);
+    }
     mOutstandingDataParent=parentMultiSocket;//keep parent alive until send finishes
 
-    boost::asio::async_write(*mSocket,
-                             boost::asio::buffer(&*toSend.chunk->begin(),toSend.size()),
-                             boost::asio::transfer_at_least(toSend.size()),
-                             mSendManyDequeItems);
+    if (toSend.header.empty()) {
+        boost::asio::async_write(*mSocket,
+                                 boost::asio::buffer(&*toSend.chunk->begin(),cursize),
+                                 boost::asio::transfer_at_least(cursize),
+                                 mSendManyDequeItems);
+    }else {
+        //point at the copy in mToSend, which stays put until the write completes
+        const TimestampedChunk&queued=mToSend.front();
+        mGatherBuffers.clear();
+        mGatherBuffers.push_back(boost::asio::buffer(queued.header.data(),queued.header.size()));
+        if (cursize)
+            mGatherBuffers.push_back(boost::asio::buffer(&*queued.chunk->begin(),cursize));
+        boost::asio::async_write(*mSocket,
+                                 mGatherBuffers,
+                                 boost::asio::transfer_at_least(queued.size()),
+                                 mSendManyDequeItems);
+    }
 }
 void ASIOSocketWrapper::bindFunctions(const MultiplexedSocketPtr&parent) {
     mStrand = parent->getStrand();
@@ -265,21 +242,31 @@ void ASIOSocketWrapper::bindFunctions(const MultiplexedSocketPtr&parent) {
         );
 }
 void ASIOSocketWrapper::sendToWire(const MultiplexedSocketPtr&parentMultiSocket, std::deque<TimestampedChunk>&input_toSend){
-    std::vector<boost::asio::mutable_buffer> bufs;
+    if (input_toSend.size()>MAX_GATHER_PACKETS) {
+        //only the sending thread touches mUnsent and it was drained into input_toSend, so order is preserved
+        assert(mUnsent.empty());
+        mUnsent.insert(mUnsent.end(),input_toSend.begin()+MAX_GATHER_PACKETS,input_toSend.end());
+        input_toSend.resize(MAX_GATHER_PACKETS);
+    }
+    //deque::swap leaves the elements in place, so the headers may be referenced before the swap into mToSend
+    mGatherBuffers.clear();
     size_t total_size=0;
     for (std::deque<TimestampedChunk>::const_iterator i=input_toSend.begin(),ie=input_toSend.end();i!=ie;++i) {
+        if (!i->header.empty()) {
+            mGatherBuffers.push_back(boost::asio::buffer(i->header.data(),i->header.size()));
+        }
         size_t cursize=i->chunk->size();
-        bufs.push_back(boost::asio::buffer(&*i->chunk->begin(),cursize));
-        total_size+=cursize;
         if( cursize) {
+            mGatherBuffers.push_back(boost::asio::buffer(&*i->chunk->begin(),cursize));
             BufferPrint(this,".buw",&*i->chunk->begin(),cursize);
         }
+        total_size+=i->header.size()+cursize;
     }
     mToSend.swap(input_toSend);
     mOutstandingDataParent=parentMultiSocket;//keep parent alive until send finishes
     boost::asio::async_write(*mSocket,
-                            bufs,
-                            boost::asio::transfer_at_least(total_size),
+                             mGatherBuffers,
+                             boost::asio::transfer_at_least(total_size),
                              mSendManyDequeItems);
 
 }
@@ -297,7 +284,7 @@ void ASIOSocketWrapper::retryQueuedSend(const MultiplexedSocketPtr&parentMultiSo
                 //then this thread should take the torch, check the queue and if not empty be willing to send
                 mSendingStatus+=(QUEUE_CHECK_FLAG+ASYNCHRONOUS_SEND_FLAG-1);
                 std::deque<TimestampedChunk>toSend;
-                mSendQueue.popAll(&toSend);
+                popPendingSends(&toSend);
                 if (toSend.empty()) {//the chunk that we put on the queue must have been sent by someone else
                     //nothing to send, let another thread take up the torch if something was placed there by it
                     mSendingStatus-=(QUEUE_CHECK_FLAG+ASYNCHRONOUS_SEND_FLAG);
@@ -366,16 +353,16 @@ bool ASIOSocketWrapper::canSend(size_t dataSize) const{
     if (mSendingStatus.read()==0) return true;
     return mSendQueue.getResourceMonitor().filledSize()+dataSize<=(size_t)mSendQueue.getResourceMonitor().maxSize();
 }
-bool ASIOSocketWrapper::rawSend(const MultiplexedSocketPtr&parentMultiSocket, Chunk * chunk, bool force) {
+bool ASIOSocketWrapper::rawSend(const MultiplexedSocketPtr&parentMultiSocket, const FrameHeader&header, Chunk * chunk, bool force) {
     bool retval=true;
     TCPSSTLOG(this,"raw",&*chunk->begin(),chunk->size(),false);
     uint32 current_status=++mSendingStatus;
     if (current_status==1) {//we are teh chosen thread
         mSendingStatus+=(ASYNCHRONOUS_SEND_FLAG-1);//committed to be the sender thread
-        sendToWire(parentMultiSocket, chunk);
+        sendToWire(parentMultiSocket, TimestampedChunk(header,chunk));
     }else {//if someone else is possibly sending a packet
         //push the packet on the queue
-        retval=mSendQueue.push(chunk, force);
+        retval=mSendQueue.push(TimestampedChunk(header,chunk), force);
         current_status=--mSendingStatus;
         if (retval) {
             //the packet is out of our hands now...
@@ -34,6 +34,8 @@
 #include <sirikata/core/util/Time.hpp>
 #include <sirikata/core/util/EWA.hpp>
 #include <sirikata/core/network/IOStrand.hpp>
+#include "FrameHeader.hpp"
+#include "ReceiveBufferPool.hpp"
 
 #define SEND_LATENCY_EWA_ALPHA .10f
 
@@ -60,18 +62,19 @@ class ASIOSocketWrapper {
          : chunk(NULL), time(Time::null())
         {}
 
-        TimestampedChunk(Chunk* _c)
-         : chunk(_c), time(Time::local())
+        TimestampedChunk(const FrameHeader& _h, Chunk* _c)
+         : header(_h), chunk(_c), time(Time::local())
         {}
 
         uint32 size() const {
-            return chunk->size();
+            return header.size()+chunk->size();
         }
 
         Duration sinceCreation() const {
             return Time::local() - time;
         }
 
+        FrameHeader header;
         Chunk* chunk;
         Time time;
     };
@@ -85,10 +88,23 @@ class ASIOSocketWrapper {
 		QUEUE_CHECK_FLAG=(1<<30),
 
 	};
+    /**
+     * The most packets handed to a single async_write. Each packet is a header and a payload buffer, so this keeps
+     * a write within the 64 buffers asio passes to one writev call
+     */
+    enum {
+        MAX_GATHER_PACKETS=32
+    };
     EWA<Duration> mAverageSendLatency;
 
     std::vector<Stream::StreamID> mPausedSendStreams;
     std::deque<TimestampedChunk> mToSend;
+    ///Packets taken off mSendQueue that did not fit in the last async_write, only touched by the sending thread
+    std::deque<TimestampedChunk> mUnsent;
+    ///Gather list handed to async_write, kept around to reuse its storage
+    std::vector<boost::asio::const_buffer> mGatherBuffers;
+    ///Buffers for packets delivered by this socket's ASIOReadBuffer
+    ReceiveBufferPool mReceivePool;
     std::tr1::weak_ptr<MultiplexedSocket>mParent;
     std::tr1::shared_ptr<MultiplexedSocket>mOutstandingDataParent;
     /** Call this any time a chunk finishes being sent so statistics can be collected. */
@@ -97,6 +113,11 @@ class ASIOSocketWrapper {
 
     typedef boost::system::error_code ErrorCode;
     std::tr1::function<void(const ErrorCode &error, std::size_t bytes_sent)>mSendManyDequeItems;
+    /**
+     * Collects the packets which should go out next: those left over from the last async_write followed by anything
+     * on mSendQueue
+     */
+    void popPendingSends(std::deque<TimestampedChunk>*toSend);
     /**
      * This function sets the QUEUE_CHECK_FLAG and checks the sendQueue for additional packets to send out.
      * If nothing is in the queue then it unsets the ASYNCHRONOUS_SEND_FLAG and QUEUE_CHECK_FLAGS
@@ -118,7 +139,8 @@ class ASIOSocketWrapper {
 
 /**
  *  This function sends a while queue of packets to the network
- * The function sends each item using a vector of asio::buffers made from the passed in deque
+ * The function sends up to MAX_GATHER_PACKETS items using a vector of asio::buffers made from the headers and payloads
+ * in the passed in deque. Any further items are kept in mUnsent for the next write
  */
     void sendToWire(const MultiplexedSocketPtr&parentMultiSocket, std::deque<TimestampedChunk>&const_toSend);
 
@@ -175,6 +197,9 @@ public:
             SILOG(tcpsst,error,"Outstanding data left on socket that is being deleted. mOutstandingDataParent is "<<(size_t)mOutstandingDataParent.get());
         }
         assert(mToSend.size()==0);
+        for (std::deque<TimestampedChunk>::iterator i=mUnsent.begin(),ie=mUnsent.end();i!=ie;++i) {
+            delete i->chunk;
+        }
     }
 
     ASIOSocketWrapper&operator=(const ASIOSocketWrapper& socket){
@@ -194,6 +219,9 @@ public:
     }
     TCPSocket&getSocket() {return *mSocket;}
 
+    ReceiveBufferPool&getReceivePool() {return mReceivePool;}
+    const ReceiveBufferPool&getReceivePool()const {return mReceivePool;}
+
     const TCPSocket&getSocket()const {return *mSocket;}
 
     ///close this socket by disallowing sends, then closing
@@ -213,7 +241,14 @@ public:
      * \param force if true, force the data to be enqueued even if the queue
      *              policy indicates no more space is available.
      */
-    bool rawSend(const MultiplexedSocketPtr&parentMultiSocket, Chunk * chunk, bool force);
+    bool rawSend(const MultiplexedSocketPtr&parentMultiSocket, Chunk * chunk, bool force) {
+        return rawSend(parentMultiSocket,FrameHeader(),chunk,force);
+    }
+    /**
+     * Sends chunk preceded by header, which are written to the socket as
+     * separate buffers so the payload need not be copied behind the header
+     */
+    bool rawSend(const MultiplexedSocketPtr&parentMultiSocket, const FrameHeader&header, Chunk * chunk, bool force);
     bool canSend(size_t dataSize)const;
     static Chunk*constructControlPacket(const MultiplexedSocketPtr&parentMultiSocket, TCPStream::TCPStreamControlCodes code,const Stream::StreamID&sid);
     /**
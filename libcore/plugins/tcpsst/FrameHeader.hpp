@@ -0,0 +1,84 @@
+/*  Sirikata Network Utilities
+ *  FrameHeader.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SIRIKATA_TCPSST_FRAME_HEADER_HPP_
+#define _SIRIKATA_TCPSST_FRAME_HEADER_HPP_
+
+#include <sirikata/core/network/Stream.hpp>
+#include "VariableLength.hpp"
+
+namespace Sirikata {
+namespace Network {
+
+/** The length and stream id prefix of a length delimited TCPSST frame.  It is
+ *  stored inline with queued packets so the payload can be handed to the
+ *  socket as a separate buffer instead of being copied in behind the header.
+ *  Zero delimited (base64) frames and control packets carry their framing in
+ *  the payload and use an empty FrameHeader.
+ */
+class FrameHeader {
+public:
+    enum {
+        MAX_SERIALIZED_LENGTH=VariableLength::MAX_SERIALIZED_LENGTH+Stream::StreamID::MAX_SERIALIZED_LENGTH
+    };
+
+    FrameHeader()
+     : mSize(0)
+    {}
+
+    FrameHeader(const Stream::StreamID& sid, size_t payloadSize) {
+        uint8 serializedStreamId[Stream::StreamID::MAX_SERIALIZED_LENGTH];
+        unsigned int streamIdLength=sid.serialize(serializedStreamId,Stream::StreamID::MAX_SERIALIZED_LENGTH);
+        assert(streamIdLength<=Stream::StreamID::MAX_SERIALIZED_LENGTH);
+        VariableLength packetLength=VariableLength((uint32)(payloadSize+streamIdLength));
+        unsigned int packetHeaderLength=packetLength.serialize(mData,VariableLength::MAX_SERIALIZED_LENGTH);
+        std::memcpy(mData+packetHeaderLength,serializedStreamId,streamIdLength);
+        mSize=(uint8)(packetHeaderLength+streamIdLength);
+    }
+
+    const uint8* data() const {
+        return mData;
+    }
+    uint32 size() const {
+        return mSize;
+    }
+    bool empty() const {
+        return mSize==0;
+    }
+private:
+    uint8 mData[MAX_SERIALIZED_LENGTH];
+    uint8 mSize;
+};
+
+} // namespace Network
+} // namespace Sirikata
+
+#endif //_SIRIKATA_TCPSST_FRAME_HEADER_HPP_
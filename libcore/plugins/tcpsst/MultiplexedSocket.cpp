@@ -162,9 +162,9 @@ bool MultiplexedSocket::sendBytesNow(const MultiplexedSocketPtr& thus,const RawR
     if (data.originStream==Stream::StreamID()) {
         unsigned int socket_size=(unsigned int)thus->mSockets.size();
         for(unsigned int i=1;i<socket_size;++i) {
-            thus->mSockets[i].rawSend(thus,new Chunk(*data.data),true);
+            thus->mSockets[i].rawSend(thus,data.header,new Chunk(*data.data),true);
         }
-        thus->mSockets[0].rawSend(thus,data.data,true);
+        thus->mSockets[0].rawSend(thus,data.header,data.data,true);
         return true;
     }else {
         size_t whichStream=hasher(data.originStream)%thus->mSockets.size();
@@ -172,7 +172,7 @@ bool MultiplexedSocket::sendBytesNow(const MultiplexedSocketPtr& thus,const RawR
             whichStream=thus->leastBusyStream(whichStream);
         }
         if (data.unreliable==false||rand()/(float)RAND_MAX>thus->dropChance(data.data,whichStream)) {
-            return thus->mSockets[whichStream].rawSend(thus,data.data,force);
+            return thus->mSockets[whichStream].rawSend(thus,data.header,data.data,force);
         }else {
             return true;
         }
@@ -526,5 +526,19 @@ Duration MultiplexedSocket::averageReceiveLatency() const {
     return avg / (float)nsockets;
 }
 
+Stream::ReceiveBufferStats MultiplexedSocket::receiveBufferStats() const {
+    Stream::ReceiveBufferStats total;
+
+    uint32 nsockets = (uint32)mSockets.size();
+    for(uint32 ii = 0; ii < nsockets; ++ii) {
+        Stream::ReceiveBufferStats sock_stats = mSockets[ii].getReceivePool().stats();
+        total.allocated += sock_stats.allocated;
+        total.reused += sock_stats.reused;
+        total.retainedByUser += sock_stats.retainedByUser;
+    }
+
+    return total;
+}
+
 } // namespace Network
 } // namespace Sirikata
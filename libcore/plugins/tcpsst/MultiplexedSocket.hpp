@@ -36,6 +36,7 @@
 #include <sirikata/core/util/SerializationCheck.hpp>
 #include <boost/thread.hpp>
 #include "TCPSSTDecls.hpp"
+#include "FrameHeader.hpp"
 
 namespace Sirikata {
 namespace Network {
@@ -51,10 +52,12 @@ public:
         bool unordered;
         bool unreliable;
         Stream::StreamID originStream;
+        ///length and stream id prefix, empty if data is already framed
+        FrameHeader header;
         Chunk * data;
 
         uint32 size() const {
-            return data->size();
+            return header.size()+data->size();
         }
     };
     enum SocketConnectionPhase{
@@ -304,6 +307,7 @@ public:
     // -- Statistics
     Duration averageSendLatency() const;
     Duration averageReceiveLatency() const;
+    Stream::ReceiveBufferStats receiveBufferStats() const;
 };
 
 } // namespace Network
@@ -0,0 +1,148 @@
+/*  Sirikata Network Utilities
+ *  ReceiveBufferPool.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SIRIKATA_TCPSST_RECEIVE_BUFFER_POOL_HPP_
+#define _SIRIKATA_TCPSST_RECEIVE_BUFFER_POOL_HPP_
+
+#include <sirikata/core/network/Stream.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+
+namespace Sirikata {
+namespace Network {
+
+/** A per-socket pool of Chunks used to deliver received packets.  Buffers are
+ *  grouped into power of two size classes; a Chunk is filled from the pool
+ *  before being handed to the stream callback and its storage is returned
+ *  afterwards unless the user swapped it out to keep the data.  Packets larger
+ *  than the biggest size class are allocated directly.
+ *
+ *  Only the socket's read strand acquires and releases buffers.  The counters
+ *  are atomic so statistics may be read from other threads.
+ */
+class ReceiveBufferPool {
+public:
+    enum {
+        ///Capacity of the smallest size class is 1<<MIN_CLASS_SHIFT bytes
+        MIN_CLASS_SHIFT=6,
+        ///Size classes run from 64 bytes to 64KB, the size of ASIOReadBuffer's fixed buffer
+        NUM_SIZE_CLASSES=11,
+        ///Free buffers kept per size class, beyond which released buffers are freed
+        MAX_FREE_PER_CLASS=16
+    };
+
+    ReceiveBufferPool()
+     : mAllocated(0),
+       mReused(0),
+       mRetainedByUser(0)
+    {
+        for(int i = 0; i < NUM_SIZE_CLASSES; i++)
+            mFree[i].reserve(MAX_FREE_PER_CLASS);
+    }
+
+    /** Give chunk, which must be empty, capacity for at least size bytes,
+     *  reusing a pooled buffer if one is available. chunk is left empty.
+     */
+    void acquire(size_t size, Chunk* chunk) {
+        assert(chunk->empty());
+        int cls = sizeClassFor(size);
+        if (cls < 0) {
+            chunk->reserve(size);
+            ++mAllocated;
+            return;
+        }
+        std::vector<Chunk>& freelist = mFree[cls];
+        if (!freelist.empty()) {
+            chunk->swap(freelist.back());
+            freelist.pop_back();
+            ++mReused;
+        }
+        else {
+            chunk->reserve(classCapacity(cls));
+            ++mAllocated;
+        }
+    }
+
+    /** Return chunk's storage to the pool once its contents have been
+     *  delivered. If the user swapped the data out of chunk it is counted as
+     *  retained. chunk is left empty.
+     */
+    void release(Chunk* chunk) {
+        if (chunk->capacity() == 0) {
+            ++mRetainedByUser;
+            return;
+        }
+        int cls = sizeClassHolding(chunk->capacity());
+        if (cls < 0 || mFree[cls].size() >= MAX_FREE_PER_CLASS) {
+            Chunk().swap(*chunk);
+            return;
+        }
+        chunk->clear();
+        mFree[cls].push_back(Chunk());
+        mFree[cls].back().swap(*chunk);
+    }
+
+    Stream::ReceiveBufferStats stats() const {
+        Stream::ReceiveBufferStats result;
+        result.allocated = mAllocated.read();
+        result.reused = mReused.read();
+        result.retainedByUser = mRetainedByUser.read();
+        return result;
+    }
+
+private:
+    static size_t classCapacity(int cls) {
+        return ((size_t)1) << (cls + MIN_CLASS_SHIFT);
+    }
+    // Smallest class with room for size bytes, or -1 if it is too large
+    static int sizeClassFor(size_t size) {
+        for(int cls = 0; cls < NUM_SIZE_CLASSES; cls++)
+            if (size <= classCapacity(cls)) return cls;
+        return -1;
+    }
+    // Largest class a buffer with the given capacity can serve, or -1 if it
+    // is too small or too large to be worth keeping
+    static int sizeClassHolding(size_t capacity) {
+        if (capacity > classCapacity(NUM_SIZE_CLASSES-1)*2) return -1;
+        for(int cls = NUM_SIZE_CLASSES-1; cls >= 0; cls--)
+            if (capacity >= classCapacity(cls)) return cls;
+        return -1;
+    }
+
+    std::vector<Chunk> mFree[NUM_SIZE_CLASSES];
+    AtomicValue<uint64> mAllocated;
+    AtomicValue<uint64> mReused;
+    AtomicValue<uint64> mRetainedByUser;
+};
+
+} // namespace Network
+} // namespace Sirikata
+
+#endif //_SIRIKATA_TCPSST_RECEIVE_BUFFER_POOL_HPP_
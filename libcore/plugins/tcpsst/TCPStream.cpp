@@ -70,6 +70,13 @@ Duration TCPStream::averageReceiveLatency() const {
     return mSocket->averageReceiveLatency();
 }
 
+Stream::ReceiveBufferStats TCPStream::receiveBufferStats() const {
+    MultiplexedSocketPtr socket_copy = mSocket;
+    if (socket_copy.get() == NULL)
+        return ReceiveBufferStats();
+    return socket_copy->receiveBufferStats();
+}
+
 void TCPStream::readyRead() {
     MultiplexedSocketPtr socket_copy = mSocket;
     if (socket_copy.get() == NULL) {
@@ -152,32 +159,21 @@ bool TCPStream::send(MemoryReference firstChunk, MemoryReference secondChunk, St
                                                              MemoryReference(NULL,0),
                                                              &streamIdBytes);
     }else {
-        uint8 serializedStreamId[StreamID::MAX_SERIALIZED_LENGTH];
-        unsigned int streamIdLength=StreamID::MAX_SERIALIZED_LENGTH;
-        unsigned int successLengthNeeded=toBeSent.originStream.serialize(serializedStreamId,streamIdLength);
-        assert(successLengthNeeded<=streamIdLength);
-        streamIdLength=successLengthNeeded;
-        size_t totalSize=firstChunk.size()+secondChunk.size();
-        totalSize+=streamIdLength;
-        VariableLength packetLength=VariableLength(totalSize);
-        uint8 packetLengthSerialized[VariableLength::MAX_SERIALIZED_LENGTH];
-        unsigned int packetHeaderLength=packetLength.serialize(packetLengthSerialized,VariableLength::MAX_SERIALIZED_LENGTH);
-        //allocate a packet long enough to take both the length of the packet and the stream id as well as the packet data. totalSize = size of streamID + size of data and
-        //packetHeaderLength = the length of the length component of the packet
-        toBeSent.data=new Chunk(totalSize+packetHeaderLength);
-
-        uint8 *outputBuffer=&(*toBeSent.data)[0];
-        std::memcpy(outputBuffer,packetLengthSerialized,packetHeaderLength);
-        std::memcpy(outputBuffer+packetHeaderLength,serializedStreamId,streamIdLength);
+        //the header is kept inline in the request and written to the socket as
+        //its own buffer, so the payload only needs to be copied once to take
+        //ownership of it
+        toBeSent.header=FrameHeader(toBeSent.originStream,firstChunk.size()+secondChunk.size());
+        toBeSent.data=new Chunk;
+        toBeSent.data->reserve(firstChunk.size()+secondChunk.size());
         if (firstChunk.size()) {
-            std::memcpy(&outputBuffer[packetHeaderLength+streamIdLength],
-                        firstChunk.data(),
-                        firstChunk.size());
+            toBeSent.data->insert(toBeSent.data->end(),
+                                  (const uint8*)firstChunk.data(),
+                                  (const uint8*)firstChunk.data()+firstChunk.size());
         }
         if (secondChunk.size()) {
-            std::memcpy(&outputBuffer[packetHeaderLength+streamIdLength+firstChunk.size()],
-                        secondChunk.data(),
-                        secondChunk.size());
+            toBeSent.data->insert(toBeSent.data->end(),
+                                  (const uint8*)secondChunk.data(),
+                                  (const uint8*)secondChunk.data()+secondChunk.size());
         }
     }
     bool didsend=false;
@@ -207,6 +207,7 @@ public:
 
     virtual Duration averageSendLatency() const;
     virtual Duration averageReceiveLatency() const;
+    virtual ReceiveBufferStats receiveBufferStats() const;
 };
 
 } // namespace Network
@@ -29,6 +29,9 @@
  * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#ifndef _SIRIKATA_TCPSST_VARIABLE_LENGTH_HPP_
+#define _SIRIKATA_TCPSST_VARIABLE_LENGTH_HPP_
+
 namespace Sirikata {
 class VariableLength : protected vuint32 {
     uint8 mDelimiter;
@@ -80,3 +83,5 @@ public:
     };
 };
 }
+
+#endif //_SIRIKATA_TCPSST_VARIABLE_LENGTH_HPP_
@@ -0,0 +1,415 @@
+/*  Sirikata
+ *  ProxCompactEncoding.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sirikata/core/util/Standard.hh>
+#include <sirikata/core/network/ProxCompactEncoding.hpp>
+
+#include "Protocol_Prox.pbj.hpp"
+
+namespace Sirikata {
+namespace Network {
+
+// Message layout, all integers varints unless noted:
+//
+//   magic (byte), version (byte)
+//   t (raw microseconds)
+//   reference x, y, z (raw float32)
+//   quantization step (raw float32)
+//   removal count, then for each: object
+//   addition count, then for each:
+//     object
+//     location t delta from message t (zigzag), position x, y, z and
+//       velocity x, y, z quantized by step (zigzag)
+//     orientation t delta (zigzag), position and velocity as 4 int16 each
+//     bounds center quantized relative to reference (zigzag), radius (raw float32)
+//     flags (byte): HasMesh, HasPhysics
+//     mesh: slot, followed by a length prefixed string if the slot is new
+//     physics: length prefixed string
+//
+// Objects are encoded as a dictionary slot, followed by the 16 UUID bytes if
+// the slot is being (re)assigned. Slots are written as (index << 1) | new.
+// Slots are assigned in the order objects appear in the message, which is why
+// object ids are only written out in finish().
+
+namespace {
+
+enum AdditionFlags {
+    HasMesh = 1,
+    HasPhysics = 2
+};
+
+void writeVarint(std::string& out, uint64 val) {
+    uint8 buf[VInt<uint64>::MAX_SERIALIZED_LENGTH];
+    unsigned int len = VInt<uint64>(val).serialize(buf, sizeof(buf));
+    out.append((const char*)buf, len);
+}
+
+uint64 zigzag(int64 val) {
+    return (val < 0) ? ((((uint64)(-(val + 1))) << 1) | 1) : (((uint64)val) << 1);
+}
+
+int64 unzigzag(uint64 val) {
+    return (val & 1) ? -(int64)(val >> 1) - 1 : (int64)(val >> 1);
+}
+
+void writeSigned(std::string& out, int64 val) {
+    writeVarint(out, zigzag(val));
+}
+
+void writeFloat(std::string& out, float32 val) {
+    out.append((const char*)&val, sizeof(val));
+}
+
+void writeString(std::string& out, const String& val) {
+    writeVarint(out, val.size());
+    out.append(val);
+}
+
+void writeSlot(std::string& out, uint32 idx, bool isnew) {
+    writeVarint(out, (((uint64)idx) << 1) | (isnew ? 1 : 0));
+}
+
+int64 quantize(float32 val, float32 step) {
+    return (int64)floor(val / step + 0.5f);
+}
+
+void writeQuantized(std::string& out, const Vector3f& val, float32 step) {
+    writeSigned(out, quantize(val.x, step));
+    writeSigned(out, quantize(val.y, step));
+    writeSigned(out, quantize(val.z, step));
+}
+
+int16 quantizeUnit(float32 val) {
+    if (val > 1.f) val = 1.f;
+    if (val < -1.f) val = -1.f;
+    return (int16)floor(val * 32767.f + 0.5f);
+}
+
+void writeQuaternion(std::string& out, const Quaternion& q) {
+    int16 vals[4] = { quantizeUnit(q.x), quantizeUnit(q.y), quantizeUnit(q.z), quantizeUnit(q.w) };
+    out.append((const char*)vals, sizeof(vals));
+}
+
+// Bounds checked reader over a message
+class Reader {
+public:
+    Reader(const std::string& data)
+     : mData((const uint8*)data.data()),
+       mSize(data.size()),
+       mPos(0)
+    {}
+
+    bool readByte(uint8* out) {
+        if (mPos + 1 > mSize) return false;
+        *out = mData[mPos++];
+        return true;
+    }
+    bool readVarint(uint64* out) {
+        unsigned int len = mSize - mPos;
+        VInt<uint64> val;
+        if (!val.unserialize(mData + mPos, len)) return false;
+        mPos += len;
+        *out = val.read();
+        return true;
+    }
+    bool readSigned(int64* out) {
+        uint64 val;
+        if (!readVarint(&val)) return false;
+        *out = unzigzag(val);
+        return true;
+    }
+    bool readRaw(void* out, uint32 len) {
+        if (mPos + len > mSize) return false;
+        memcpy(out, mData + mPos, len);
+        mPos += len;
+        return true;
+    }
+    bool readFloat(float32* out) {
+        return readRaw(out, sizeof(float32));
+    }
+    // Reads a dictionary slot. Slots being assigned may be the next unused
+    // one or replace an existing entry, other slots must already be in use.
+    bool readSlot(uint32 size, uint32 capacity, uint32* idx, bool* isnew) {
+        uint64 val;
+        if (!readVarint(&val)) return false;
+        uint64 slot = val >> 1;
+        *isnew = ((val & 1) != 0);
+        if (*isnew ? (slot > size || slot >= capacity) : (slot >= size))
+            return false;
+        *idx = (uint32)slot;
+        return true;
+    }
+    bool readString(String* out) {
+        uint64 len;
+        if (!readVarint(&len) || len > mSize - mPos) return false;
+        out->assign((const char*)mData + mPos, (size_t)len);
+        mPos += (uint32)len;
+        return true;
+    }
+    bool readQuantized(float32 step, Vector3f* out) {
+        int64 x, y, z;
+        if (!readSigned(&x) || !readSigned(&y) || !readSigned(&z)) return false;
+        *out = Vector3f(x * step, y * step, z * step);
+        return true;
+    }
+    bool readQuaternion(Quaternion* out) {
+        int16 vals[4];
+        if (!readRaw(vals, sizeof(vals))) return false;
+        *out = Quaternion(vals[0] / 32767.f, vals[1] / 32767.f, vals[2] / 32767.f, vals[3] / 32767.f, Quaternion::XYZW());
+        return true;
+    }
+    bool done() const {
+        return mPos == mSize;
+    }
+private:
+    const uint8* mData;
+    uint32 mSize;
+    uint32 mPos;
+};
+
+} // namespace
+
+
+std::string ProxCompactEncoding::hello() {
+    std::string result;
+    result.push_back((char)Magic);
+    result.push_back((char)Version);
+    return result;
+}
+
+bool ProxCompactEncoding::isHello(const std::string& msg) {
+    return (msg.size() == 2 && (uint8)msg[0] == Magic && (uint8)msg[1] == Version);
+}
+
+bool ProxCompactEncoding::isCompact(const std::string& msg) {
+    return (msg.size() > 2 && (uint8)msg[0] == Magic);
+}
+
+
+ProxCompactEncoder::ProxCompactEncoder(float32 step, uint32 max_objects, uint32 max_meshes)
+ : mStep(step),
+   mObjects(max_objects),
+   mMeshes(max_meshes),
+   mTime(Time::null()),
+   mReference(0, 0, 0),
+   mAdditionData()
+{
+}
+
+void ProxCompactEncoder::begin(const Time& t, const Vector3f& reference) {
+    mTime = t;
+    mReference = reference;
+    mRemovals.clear();
+    mAdditions.clear();
+    mAdditionData.clear();
+}
+
+void ProxCompactEncoder::writeObject(const UUID& objid, std::string& out) {
+    uint32 idx;
+    bool isnew = mObjects.lookup(objid, &idx);
+    writeSlot(out, idx, isnew);
+    if (isnew)
+        out.append((const char*)objid.getArray().data(), UUID::static_size);
+}
+
+void ProxCompactEncoder::addRemoval(const UUID& objid) {
+    mRemovals.push_back(objid);
+}
+
+void ProxCompactEncoder::addAddition(const UUID& objid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics) {
+    mAdditions.push_back( AdditionList::value_type(objid, mAdditionData.size()) );
+
+    writeSigned(mAdditionData, (loc.updateTime() - mTime).toMicroseconds());
+    writeQuantized(mAdditionData, loc.position() - mReference, mStep);
+    writeQuantized(mAdditionData, loc.velocity(), mStep);
+
+    writeSigned(mAdditionData, (orient.updateTime() - mTime).toMicroseconds());
+    writeQuaternion(mAdditionData, orient.position());
+    writeQuaternion(mAdditionData, orient.velocity());
+
+    writeQuantized(mAdditionData, bounds.center() - mReference, mStep);
+    writeFloat(mAdditionData, bounds.radius());
+
+    uint8 flags = (mesh.empty() ? 0 : HasMesh) | (physics.empty() ? 0 : HasPhysics);
+    mAdditionData.push_back((char)flags);
+    if (!mesh.empty()) {
+        uint32 idx;
+        bool isnew = mMeshes.lookup(mesh, &idx);
+        writeSlot(mAdditionData, idx, isnew);
+        if (isnew)
+            writeString(mAdditionData, mesh);
+    }
+    if (!physics.empty())
+        writeString(mAdditionData, physics);
+}
+
+std::string ProxCompactEncoder::finish() {
+    std::string result;
+    result.reserve(32 + (mRemovals.size() + mAdditions.size()) * 2 + mAdditionData.size());
+
+    result.push_back((char)ProxCompactEncoding::Magic);
+    result.push_back((char)ProxCompactEncoding::Version);
+    writeVarint(result, mTime.raw());
+    writeFloat(result, mReference.x);
+    writeFloat(result, mReference.y);
+    writeFloat(result, mReference.z);
+    writeFloat(result, mStep);
+
+    writeVarint(result, mRemovals.size());
+    for(ObjectList::iterator it = mRemovals.begin(); it != mRemovals.end(); it++)
+        writeObject(*it, result);
+    writeVarint(result, mAdditions.size());
+    for(uint32 i = 0; i < mAdditions.size(); i++) {
+        writeObject(mAdditions[i].first, result);
+        uint32 end = (i + 1 < mAdditions.size()) ? mAdditions[i+1].second : mAdditionData.size();
+        result.append(mAdditionData, mAdditions[i].second, end - mAdditions[i].second);
+    }
+
+    return result;
+}
+
+
+ProxCompactDecoder::ProxCompactDecoder(uint32 max_objects, uint32 max_meshes)
+ : mMaxObjects(max_objects),
+   mMaxMeshes(max_meshes)
+{
+}
+
+namespace {
+bool readObject(Reader& reader, std::vector<UUID>& objects, uint32 max_objects, UUID* out) {
+    uint32 idx;
+    bool isnew;
+    if (!reader.readSlot(objects.size(), max_objects, &idx, &isnew)) return false;
+    if (!isnew) {
+        *out = objects[idx];
+        return true;
+    }
+
+    uint8 data[UUID::static_size];
+    if (!reader.readRaw(data, UUID::static_size)) return false;
+    *out = UUID(data, UUID::static_size);
+    if (idx == objects.size())
+        objects.push_back(*out);
+    else
+        objects[idx] = *out;
+    return true;
+}
+}
+
+bool ProxCompactDecoder::decode(const std::string& msg, Sirikata::Protocol::Prox::ProximityResults* results) {
+    Reader reader(msg);
+
+    uint8 magic, version;
+    if (!reader.readByte(&magic) || magic != ProxCompactEncoding::Magic) return false;
+    if (!reader.readByte(&version) || version != ProxCompactEncoding::Version) return false;
+
+    uint64 traw;
+    Vector3f reference;
+    float32 step;
+    if (!reader.readVarint(&traw) ||
+        !reader.readFloat(&reference.x) || !reader.readFloat(&reference.y) || !reader.readFloat(&reference.z) ||
+        !reader.readFloat(&step))
+        return false;
+    Time t = Time::microseconds(traw);
+    results->set_t(t);
+
+    uint64 nremovals;
+    if (!reader.readVarint(&nremovals)) return false;
+    Sirikata::Protocol::Prox::IProximityUpdate removals = results->add_update();
+    for(uint64 i = 0; i < nremovals; i++) {
+        UUID objid;
+        if (!readObject(reader, mObjects, mMaxObjects, &objid)) return false;
+        Sirikata::Protocol::Prox::IObjectRemoval removal = removals.add_removal();
+        removal.set_object(objid);
+    }
+
+    uint64 nadditions;
+    if (!reader.readVarint(&nadditions)) return false;
+    Sirikata::Protocol::Prox::IProximityUpdate additions = results->add_update();
+    for(uint64 i = 0; i < nadditions; i++) {
+        UUID objid;
+        if (!readObject(reader, mObjects, mMaxObjects, &objid)) return false;
+        Sirikata::Protocol::Prox::IObjectAddition addition = additions.add_addition();
+        addition.set_object(objid);
+
+        int64 loc_dt;
+        Vector3f pos, vel;
+        if (!reader.readSigned(&loc_dt) || !reader.readQuantized(step, &pos) || !reader.readQuantized(step, &vel))
+            return false;
+        Sirikata::Protocol::ITimedMotionVector motion = addition.mutable_location();
+        motion.set_t(t + Duration::microseconds(loc_dt));
+        motion.set_position(pos + reference);
+        motion.set_velocity(vel);
+
+        int64 orient_dt;
+        Quaternion orient_pos, orient_vel;
+        if (!reader.readSigned(&orient_dt) || !reader.readQuaternion(&orient_pos) || !reader.readQuaternion(&orient_vel))
+            return false;
+        Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
+        msg_orient.set_t(t + Duration::microseconds(orient_dt));
+        msg_orient.set_position(orient_pos);
+        msg_orient.set_velocity(orient_vel);
+
+        Vector3f center;
+        float32 radius;
+        if (!reader.readQuantized(step, &center) || !reader.readFloat(&radius))
+            return false;
+        addition.set_bounds(BoundingSphere3f(center + reference, radius));
+
+        uint8 flags;
+        if (!reader.readByte(&flags)) return false;
+        if (flags & HasMesh) {
+            uint32 mesh_idx;
+            bool isnew;
+            if (!reader.readSlot(mMeshes.size(), mMaxMeshes, &mesh_idx, &isnew)) return false;
+            if (isnew) {
+                String mesh;
+                if (!reader.readString(&mesh)) return false;
+                if (mesh_idx == mMeshes.size())
+                    mMeshes.push_back(mesh);
+                else
+                    mMeshes[mesh_idx] = mesh;
+            }
+            addition.set_mesh(mMeshes[mesh_idx]);
+        }
+        if (flags & HasPhysics) {
+            String physics;
+            if (!reader.readString(&physics)) return false;
+            addition.set_physics(physics);
+        }
+    }
+
+    return reader.done();
+}
+
+} // namespace Network
+} // namespace Sirikata
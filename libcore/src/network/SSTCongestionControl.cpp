@@ -0,0 +1,206 @@
+/*  Sirikata
+ *  SSTCongestionControl.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sirikata/core/network/SSTCongestionControl.hpp>
+
+namespace Sirikata {
+
+namespace {
+// Clock granularity term from RFC 6298
+const int64 RTO_GRANULARITY_MICROSECONDS = 1000;
+const uint32 MAX_RTO_BACKOFF = 16;
+// Keeps window arithmetic well away from overflow
+const uint32 MAX_CONGESTION_WINDOW = 1 << 30;
+}
+
+RTTEstimator::RTTEstimator(const Duration& initial_rto, const Duration& min_rto, const Duration& max_rto)
+ : mMinRTO(min_rto.toMicroseconds()),
+   mMaxRTO(max_rto.toMicroseconds()),
+   mInitialRTO(initial_rto.toMicroseconds()),
+   mHasSample(false),
+   mSmoothed(0),
+   mVariance(0),
+   mLatest(0),
+   mMinimum(0),
+   mBackoff(0)
+{
+}
+
+void RTTEstimator::sample(const Duration& rtt) {
+    int64 r = std::max(rtt.toMicroseconds(), (int64)1);
+    mLatest = r;
+
+    if (!mHasSample) {
+        mSmoothed = r;
+        mVariance = r / 2;
+        mMinimum = r;
+        mHasSample = true;
+    }
+    else {
+        // RTTVAR <- 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT <- 7/8 SRTT + 1/8 R
+        int64 err = mSmoothed - r;
+        if (err < 0) err = -err;
+        mVariance = mVariance - mVariance / 4 + err / 4;
+        mSmoothed = mSmoothed - mSmoothed / 8 + r / 8;
+        mMinimum = std::min(mMinimum, r);
+    }
+
+    mBackoff = 0;
+}
+
+void RTTEstimator::backoff() {
+    if (mBackoff < MAX_RTO_BACKOFF)
+        mBackoff++;
+}
+
+Duration RTTEstimator::rto() const {
+    int64 result = mInitialRTO;
+    if (mHasSample)
+        result = mSmoothed + std::max(RTO_GRANULARITY_MICROSECONDS, 4 * mVariance);
+    result = std::max(mMinRTO, std::min(mMaxRTO, result));
+    result = std::min(mMaxRTO, result << mBackoff);
+    return Duration::microseconds(result);
+}
+
+
+SSTCongestionControl* SSTCongestionControl::create(const String& algorithm, uint32 mss) {
+    if (algorithm == "aimd")
+        return new AIMDCongestionControl(mss);
+    else if (algorithm == "delay")
+        return new DelayCongestionControl(mss);
+    else if (algorithm == "none")
+        return new NullCongestionControl(mss);
+    return NULL;
+}
+
+SSTCongestionControl::SSTCongestionControl(uint32 mss)
+ : mMSS(std::max(mss, (uint32)1)),
+   mWindow(0),
+   mSlowStartThreshold(MAX_CONGESTION_WINDOW)
+{
+    mWindow = initialWindow();
+}
+
+uint32 SSTCongestionControl::initialWindow() const {
+    if (mMSS > 2190)
+        return 2 * mMSS;
+    else if (mMSS > 1095)
+        return 3 * mMSS;
+    return 4 * mMSS;
+}
+
+void SSTCongestionControl::onLoss() {
+    mSlowStartThreshold = std::max(mWindow / 2, 2 * mMSS);
+    mWindow = mSlowStartThreshold;
+}
+
+void SSTCongestionControl::onTimeout() {
+    mSlowStartThreshold = std::max(mWindow / 2, 2 * mMSS);
+    mWindow = mMSS;
+}
+
+
+AIMDCongestionControl::AIMDCongestionControl(uint32 mss)
+ : SSTCongestionControl(mss),
+   mAckedBytes(0)
+{
+}
+
+void AIMDCongestionControl::onAck(uint32 acked_bytes, const RTTEstimator& rtt) {
+    if (inSlowStart()) {
+        // Grow by at most one segment per ack, i.e. double every round trip
+        mWindow += std::min(acked_bytes, mMSS);
+        mAckedBytes = 0;
+    }
+    else {
+        // Grow by one segment per window of acknowledged data
+        mAckedBytes += acked_bytes;
+        if (mAckedBytes >= mWindow) {
+            mAckedBytes -= mWindow;
+            mWindow += mMSS;
+        }
+    }
+    mWindow = std::min(mWindow, MAX_CONGESTION_WINDOW);
+}
+
+
+DelayCongestionControl::DelayCongestionControl(uint32 mss)
+ : SSTCongestionControl(mss),
+   mAckedBytes(0)
+{
+}
+
+void DelayCongestionControl::onAck(uint32 acked_bytes, const RTTEstimator& rtt) {
+    // Only adjust once per round trip, approximated as a window's worth of
+    // acknowledged data
+    mAckedBytes += acked_bytes;
+    if (mAckedBytes < mWindow)
+        return;
+    mAckedBytes = 0;
+
+    if (!rtt.hasSample()) {
+        // Nothing to compare against yet, grow as in slow start
+        if (inSlowStart())
+            mWindow = std::min(mWindow * 2, MAX_CONGESTION_WINDOW);
+        return;
+    }
+
+    // (expected - actual) * base_rtt, i.e. the number of segments we estimate
+    // are sitting in queues along the path
+    double base_rtt = (double)rtt.minimum().toMicroseconds();
+    double cur_rtt = std::max((double)rtt.smoothed().toMicroseconds(), base_rtt);
+    double queued = ((double)mWindow / mMSS) * (cur_rtt - base_rtt) / cur_rtt;
+
+    if (inSlowStart()) {
+        if (queued > GAMMA)
+            mSlowStartThreshold = mWindow;
+        else
+            mWindow = std::min(mWindow * 2, MAX_CONGESTION_WINDOW);
+    }
+    else if (queued < ALPHA) {
+        mWindow = std::min(mWindow + mMSS, MAX_CONGESTION_WINDOW);
+    }
+    else if (queued > BETA && mWindow > 2 * mMSS) {
+        mWindow -= mMSS;
+        // Don't let the smaller window put us back in slow start
+        mSlowStartThreshold = std::min(mSlowStartThreshold, mWindow);
+    }
+}
+
+
+NullCongestionControl::NullCongestionControl(uint32 mss)
+ : SSTCongestionControl(mss)
+{
+    mWindow = MAX_CONGESTION_WINDOW;
+}
+
+} // namespace Sirikata
@@ -70,16 +70,176 @@ typedef std::tr1::shared_ptr<SpaceObjectReferenceBaseDatagramLayer> SpaceObjectR
 
 template <>  std::map<SpaceObjectReference, SpaceObjectReferenceBaseDatagramLayerPtr> SpaceObjectReferenceBaseDatagramLayer::sDatagramLayerMap = std::map<SpaceObjectReference, SpaceObjectReferenceBaseDatagramLayerPtr> ();
 
-template <> std::map<EndPoint<SpaceObjectReference>  , std::tr1::shared_ptr< Connection<SpaceObjectReference> > > Connection<SpaceObjectReference>::sConnectionMap = std::map<EndPoint<SpaceObjectReference>  , std::tr1::shared_ptr< Connection<SpaceObjectReference> > > ();
+template <> Connection<SpaceObjectReference>::ConnectionMap Connection<SpaceObjectReference>::sConnectionMap = Connection<SpaceObjectReference>::ConnectionMap();
 
 
-template <> std::map<EndPoint<SpaceObjectReference>  , ConnectionReturnCallbackFunction > Connection<SpaceObjectReference>::sConnectionReturnCallbackMap = std::map<EndPoint<SpaceObjectReference>  , ConnectionReturnCallbackFunction > ();
+template <> Connection<SpaceObjectReference>::ConnectionReturnCallbackMap Connection<SpaceObjectReference>::sConnectionReturnCallbackMap = Connection<SpaceObjectReference>::ConnectionReturnCallbackMap();
 
-template <> std::map<EndPoint<SpaceObjectReference>  , StreamReturnCallbackFunction > Connection<SpaceObjectReference>::sListeningConnectionsCallbackMap = std::map<EndPoint<SpaceObjectReference>  , StreamReturnCallbackFunction > ();
+template <> Connection<SpaceObjectReference>::StreamReturnCallbackMap Connection<SpaceObjectReference>::sListeningConnectionsCallbackMap = Connection<SpaceObjectReference>::StreamReturnCallbackMap();
 
 template <> std::bitset<65536> Connection<SpaceObjectReference>::sAvailableChannels = std::bitset<65536> ();
+template <> std::vector<uint16> Connection<SpaceObjectReference>::sReleasedChannels = std::vector<uint16> ();
+template <> uint32 Connection<SpaceObjectReference>::sNextUnusedChannel = 65535;
 
-template <> std::map<EndPoint<SpaceObjectReference>  , StreamReturnCallbackFunction > Stream<SpaceObjectReference>::mStreamReturnCallbackMap = std::map<EndPoint<SpaceObjectReference>  , StreamReturnCallbackFunction > ();
+template <> Stream<SpaceObjectReference>::StreamReturnCallbackMap Stream<SpaceObjectReference>::mStreamReturnCallbackMap = Stream<SpaceObjectReference>::StreamReturnCallbackMap();
 template <> Mutex Connection<SpaceObjectReference>::sStaticMembersLock = Mutex();
 
+
+namespace {
+// TimeSeries names are dot separated, so endpoints need to be flattened into a
+// single component
+String sanitizeSeriesComponent(const String& orig) {
+    String result = orig;
+    for(String::size_type i = 0; i < result.size(); i++) {
+        char c = result[i];
+        if (!isalnum(c) && c != '-' && c != '_')
+            result[i] = '_';
+    }
+    return result;
+}
+
+// Reported as floating point since local RTTs are often well under a
+// millisecond
+float64 milliseconds(const Duration& dur) {
+    return dur.toMicroseconds() / 1000.0;
+}
+}
+
+SSTConnectionManager::SSTConnectionManager()
+ : mContext(NULL),
+   mStatsPoller(NULL),
+   mReportPerConnection(false)
+{
+}
+
+SSTConnectionManager::SSTConnectionManager(Context* ctx, const Duration& stats_interval, const String& stats_prefix, bool per_connection)
+ : mContext(ctx),
+   mStatsPoller(NULL),
+   mStatsPrefix(stats_prefix),
+   mReportPerConnection(per_connection)
+{
+    if (mContext != NULL && stats_interval != Duration::zero()) {
+        mStatsPoller = new Poller(
+            mContext->mainStrand,
+            std::tr1::bind(&SSTConnectionManager::reportStats, this),
+            stats_interval
+        );
+    }
+}
+
+SSTConnectionManager::~SSTConnectionManager() {
+    delete mStatsPoller;
+    Connection<SpaceObjectReference>::closeConnections();
+}
+
+void SSTConnectionManager::start() {
+    if (mStatsPoller != NULL)
+        mStatsPoller->start();
+}
+
+void SSTConnectionManager::stop() {
+    if (mStatsPoller != NULL)
+        mStatsPoller->stop();
+    Connection<SpaceObjectReference>::closeConnections();
+}
+
+void SSTConnectionManager::getStats(std::vector<SSTConnectionStats>* stats) {
+    Connection<SpaceObjectReference>::getAllStats(stats);
+}
+
+void SSTConnectionManager::reportStats() {
+    Trace::TimeSeries* ts = mContext->timeSeries;
+    if (ts == NULL) return;
+
+    std::vector<SSTConnectionStats> stats;
+    getStats(&stats);
+
+    uint32 num_streams = 0;
+    uint32 outstanding_segments = 0, queued_segments = 0;
+    uint64 outstanding_bytes = 0, queued_bytes = 0;
+    uint64 segments_sent = 0, timeouts = 0, retransmits = 0;
+    Duration max_rtt = Duration::zero();
+    Duration total_rtt = Duration::zero();
+    uint32 num_rtt = 0;
+    std::vector<QueueingDelayStats> queueing_delay;
+
+    for(uint32 ci = 0; ci < stats.size(); ci++) {
+        const SSTConnectionStats& conn = stats[ci];
+
+        uint64 conn_outstanding_bytes = 0, conn_queued_bytes = 0, conn_retransmits = 0;
+        for(uint32 si = 0; si < conn.streams.size(); si++) {
+            const SSTStreamStats& stream = conn.streams[si];
+            conn_outstanding_bytes += stream.outstandingBytes;
+            conn_queued_bytes += stream.queuedBytes;
+            conn_retransmits += stream.numRetransmits;
+        }
+
+        num_streams += conn.streams.size();
+        outstanding_segments += conn.outstandingSegments;
+        queued_segments += conn.queuedSegments;
+        outstanding_bytes += conn_outstanding_bytes;
+        queued_bytes += conn_queued_bytes;
+        segments_sent += conn.segmentsSent;
+        timeouts += conn.numTimeouts;
+        retransmits += conn_retransmits;
+        if (conn.hasRTTSample) {
+            total_rtt += conn.smoothedRTT;
+            num_rtt++;
+            if (conn.smoothedRTT > max_rtt)
+                max_rtt = conn.smoothedRTT;
+        }
+
+        if (queueing_delay.size() < conn.queueingDelay.size())
+            queueing_delay.resize(conn.queueingDelay.size());
+        for(uint32 pi = 0; pi < conn.queueingDelay.size(); pi++) {
+            queueing_delay[pi].count += conn.queueingDelay[pi].count;
+            queueing_delay[pi].total += conn.queueingDelay[pi].total;
+        }
+
+        if (mReportPerConnection) {
+            String conn_prefix = mStatsPrefix + "." + sanitizeSeriesComponent(conn.localEndPoint) + ".";
+            if (conn.hasRTTSample)
+                ts->report(conn_prefix + "rtt", milliseconds(conn.smoothedRTT));
+            ts->report(conn_prefix + "rto", milliseconds(conn.rto));
+            ts->report(conn_prefix + "cwnd", conn.congestionWindow);
+            ts->report(conn_prefix + "outstanding-segments", conn.outstandingSegments);
+            ts->report(conn_prefix + "queued-segments", conn.queuedSegments);
+            ts->report(conn_prefix + "outstanding-bytes", conn_outstanding_bytes);
+            ts->report(conn_prefix + "queued-bytes", conn_queued_bytes);
+            ts->report(conn_prefix + "streams", conn.streams.size());
+            ts->report(conn_prefix + "timeouts", conn.numTimeouts);
+            ts->report(conn_prefix + "retransmits", conn_retransmits);
+        }
+    }
+
+    String prefix = mStatsPrefix + ".";
+    ts->report(prefix + "connections", stats.size());
+    ts->report(prefix + "streams", num_streams);
+    ts->report(prefix + "outstanding-segments", outstanding_segments);
+    ts->report(prefix + "queued-segments", queued_segments);
+    ts->report(prefix + "outstanding-bytes", outstanding_bytes);
+    ts->report(prefix + "queued-bytes", queued_bytes);
+    ts->report(prefix + "segments-sent", segments_sent);
+    ts->report(prefix + "timeouts", timeouts);
+    ts->report(prefix + "retransmits", retransmits);
+    if (num_rtt > 0) {
+        ts->report(prefix + "rtt.avg", milliseconds(total_rtt / (double)num_rtt));
+        ts->report(prefix + "rtt.max", milliseconds(max_rtt));
+    }
+
+    // Average queueing delay per priority over the last interval. Totals can
+    // go backwards when connections close, in which case we skip a report.
+    mLastQueueingDelay.resize(queueing_delay.size());
+    for(uint32 pi = 0; pi < queueing_delay.size(); pi++) {
+        const QueueingDelayStats& cur = queueing_delay[pi];
+        const QueueingDelayStats& last = mLastQueueingDelay[pi];
+        if (cur.count > last.count && cur.total >= last.total) {
+            int priority = (int)pi + SegmentScheduler< std::tr1::shared_ptr<ChannelSegment> >::MIN_PRIORITY;
+            Duration avg = (cur.total - last.total) / (double)(cur.count - last.count);
+            ts->report(prefix + "queueing-delay.priority" + boost::lexical_cast<String>(priority), milliseconds(avg));
+        }
+        mLastQueueingDelay[pi] = cur;
+    }
+}
+
 }
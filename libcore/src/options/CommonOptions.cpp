@@ -85,6 +85,9 @@ void InitOptions() {
 
         .addOption(new OptionValue(OPT_TRACE_TIMESERIES, "null", Sirikata::OptionValueType<String>(), "Service to report TimeSeries data to."))
         .addOption(new OptionValue(OPT_TRACE_TIMESERIES_OPTIONS, "", Sirikata::OptionValueType<String>(), "Options for TimeSeries reporting service."))
+
+        .addOption(new OptionValue(OPT_SST_STATS_INTERVAL, "0s", Sirikata::OptionValueType<Duration>(), "How often to report SST connection statistics to the TimeSeries service, or 0 to disable."))
+        .addOption(new OptionValue(OPT_SST_STATS_PER_CONNECTION, "false", Sirikata::OptionValueType<bool>(), "Whether to report SST statistics for each connection as well as totals."))
       ;
 }
 
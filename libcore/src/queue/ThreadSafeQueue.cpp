@@ -53,6 +53,9 @@ void wait(Lock*lok,Condition *cond, bool (*check) (void*, void*), void * arg1, v
 void notify(Condition *cond){
     cond->notify_one();
 }
+void notifyAll(Condition *cond){
+    cond->notify_all();
+}
 void unlock(Lock*lok){
     lok->unlock();
 }
@@ -36,6 +36,7 @@
 #include <sirikata/core/task/Time.hpp>
 #include <sirikata/core/queue/ThreadSafeQueue.hpp>
 #include <sirikata/core/queue/LockFreeQueue.hpp>
+#include <sirikata/core/queue/RingBufferQueue.hpp>
 #include <sirikata/core/util/Thread.hpp>
 #include <stdio.h>
 
@@ -250,6 +251,8 @@ template class SIRIKATA_EXPORT WorkQueueImpl<ThreadSafeQueue<WorkItem*> >;
 // See sem_init (POSIX/Linux), sem_open (OS X), CreateSemaphore (WIN32)
 template class SIRIKATA_EXPORT WorkQueueImpl<LockFreeQueue<WorkItem*> >;
 
+template class SIRIKATA_EXPORT WorkQueueImpl<RingBufferQueue<WorkItem*> >;
+
 template class SIRIKATA_EXPORT UnsafeWorkQueueImpl<std::queue<WorkItem*> >;
 
 
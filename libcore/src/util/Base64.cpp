@@ -0,0 +1,371 @@
+/*  Sirikata
+ *  Base64.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sirikata/core/util/Standard.hh>
+#include <sirikata/core/util/Base64.hpp>
+
+#if defined(__AVX2__)
+#  define SIRIKATA_BASE64_AVX2 1
+#  define SIRIKATA_BASE64_SSSE3 1
+#  include <immintrin.h>
+#elif defined(__SSSE3__)
+#  define SIRIKATA_BASE64_SSSE3 1
+#  include <tmmintrin.h>
+#endif
+
+namespace Sirikata {
+
+namespace {
+
+const uint8 EncodeAlphabet[] = {
+    'A','B','C','D','E','F','G','H','I','J','K','L','M',
+    'N','O','P','Q','R','S','T','U','V','W','X','Y','Z',
+    'a','b','c','d','e','f','g','h','i','j','k','l','m',
+    'n','o','p','q','r','s','t','u','v','w','x','y','z',
+    '0','1','2','3','4','5','6','7','8','9','-','_'
+};
+
+const signed char WhiteSpaceEnc = -5; // Indicates white space in encoding
+const signed char EqualsSignEnc = -1; // Indicates equals sign in encoding
+
+// Decoding table for both the standard and URL safe alphabets, indexed by the
+// low 7 bits of each character.
+const signed char DecodeAlphabet[] = {
+    -9,-9,-9,-9,-9,-9,-9,-9,-9,                 // Decimal  0 -  8
+    -5,-5,                                      // Whitespace: Tab and Linefeed
+    -9,-9,                                      // Decimal 11 - 12
+    -5,                                         // Whitespace: Carriage Return
+    -9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,     // Decimal 14 - 26
+    -9,-9,-9,-9,-9,                             // Decimal 27 - 31
+    -5,                                         // Whitespace: Space
+    -9,-9,-9,-9,-9,-9,-9,-9,-9,-9,              // Decimal 33 - 42
+    62,                                         // Plus sign at decimal 43
+    -9,62,-9,                                   // Decimal 44 - 46, minus at 45
+    63,                                         // Slash at decimal 47
+    52,53,54,55,56,57,58,59,60,61,              // Numbers zero through nine
+    -9,-9,-9,                                   // Decimal 58 - 60
+    -1,                                         // Equals sign at decimal 61
+    -9,-9,-9,                                   // Decimal 62 - 64
+    0,1,2,3,4,5,6,7,8,9,10,11,12,13,            // Letters 'A' through 'N'
+    14,15,16,17,18,19,20,21,22,23,24,25,        // Letters 'O' through 'Z'
+    -9,-9,-9,-9,63,-9,                          // Decimal 91 - 94, underscore 95
+    26,27,28,29,30,31,32,33,34,35,36,37,38,     // Letters 'a' through 'm'
+    39,40,41,42,43,44,45,46,47,48,49,50,51,     // Letters 'n' through 'z'
+    -9,-9,-9,-9,-9                              // Decimal 123 - 127
+};
+
+// Encodes the final 1 or 2 bytes, with padding
+void encodeTail(const uint8* src, size_t len, uint8* dst) {
+    uint32 inBuff = (src[0] << 16) | (len > 1 ? (src[1] << 8) : 0);
+    dst[0] = EncodeAlphabet[ (inBuff >> 18)        ];
+    dst[1] = EncodeAlphabet[ (inBuff >> 12) & 0x3f ];
+    dst[2] = (len > 1) ? EncodeAlphabet[ (inBuff >> 6) & 0x3f ] : '=';
+    dst[3] = '=';
+}
+
+// Encodes whole groups of 3 bytes, returns the number of input bytes used
+size_t encodeGroupsScalar(const uint8* src, size_t len, uint8* dst) {
+    size_t i = 0;
+    for(; i + 3 <= len; i += 3, dst += 4) {
+        uint32 inBuff = (src[i] << 16) | (src[i+1] << 8) | src[i+2];
+        dst[0] = EncodeAlphabet[ (inBuff >> 18)        ];
+        dst[1] = EncodeAlphabet[ (inBuff >> 12) & 0x3f ];
+        dst[2] = EncodeAlphabet[ (inBuff >>  6) & 0x3f ];
+        dst[3] = EncodeAlphabet[ (inBuff      ) & 0x3f ];
+    }
+    return i;
+}
+
+int decode4to3(const signed char source[4], uint8* destination) {
+    uint32 outBuf=((source[0]<<18)|(source[1]<<12));
+    destination[0]=(uint8)(outBuf/65536);
+    if (source[2]==EqualsSignEnc) {
+        return 1;
+    }
+    outBuf|=(source[2]<<6);
+    destination[1]=(uint8)((outBuf/256)&255);
+    if (source[3]==EqualsSignEnc) {
+        return 2;
+    }
+    outBuf|=source[3];
+    destination[2]=(uint8)(outBuf&255);
+    return 3;
+}
+
+// Scalar decoder state, so the vector kernels can hand off partway through
+struct DecodeState {
+    DecodeState() : b4Posn(0), finished(false) {}
+    signed char b4[4];
+    uint8 b4Posn;
+    bool finished; // Set once padding has been seen
+};
+
+// Decodes characters one at a time, returns the number of bytes written
+size_t decodeScalarStep(const uint8* src, size_t len, uint8* dst, DecodeState* state) {
+    uint8* out = dst;
+    for(size_t i = 0; i < len && !state->finished; i++) {
+        uint8 cur = src[i];
+        uint8 sbiCrop = (uint8)(cur & 0x7f); // Only the low seven bits
+        signed char sbiDecode = DecodeAlphabet[ sbiCrop ];   // Special value
+
+        // White space, Equals sign, or legit Base64 character. Anything else
+        // is skipped.
+        if( sbiDecode >= WhiteSpaceEnc && cur==sbiCrop )  {
+            if( sbiDecode >= EqualsSignEnc ) {
+                state->b4[ state->b4Posn++ ] = sbiDecode;  // Save non-whitespace
+                if( state->b4Posn > 3 ) {                  // Time to decode?
+                    out += decode4to3( state->b4, out );
+                    state->b4Posn = 0;
+                    // If that was the equals sign, we're done
+                    if( sbiDecode == EqualsSignEnc )
+                        state->finished = true;
+                }
+            }
+        }
+    }
+    return out - dst;
+}
+
+#if defined(SIRIKATA_BASE64_SSSE3)
+
+// Splits 12 bytes, arranged by the shuffle below, into 16 6-bit values and
+// maps them to the URL safe alphabet.
+inline __m128i encodeBlock128(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10,11,9,10, 7,8,6,7, 4,5,3,4, 1,2,0,1));
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    const __m128i indices = _mm_or_si128(t1, t3);
+
+    // Pick an offset per value: 0-25 -> 13, 26-51 -> 0, 52-61 -> 1-10,
+    // 62 -> 11, 63 -> 12, then look up what to add to reach ASCII.
+    __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    reduced = _mm_or_si128(reduced, _mm_and_si128(less, _mm_set1_epi8(13)));
+    const __m128i shift_lut = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62,
+        '_' - 63, 'A', 0, 0);
+    return _mm_add_epi8(indices, _mm_shuffle_epi8(shift_lut, reduced));
+}
+
+inline __m128i inRange128(__m128i c, char lo, char hi) {
+    return _mm_and_si128(
+        _mm_cmpgt_epi8(c, _mm_set1_epi8(lo - 1)),
+        _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), c));
+}
+
+// Maps 16 characters to their 6-bit values. Returns false if any of them
+// isn't in the alphabet, in which case the scalar path has to handle them.
+inline bool decodeValues128(__m128i c, __m128i* values) {
+    const __m128i upper = inRange128(c, 'A', 'Z');
+    const __m128i lower = inRange128(c, 'a', 'z');
+    const __m128i digit = inRange128(c, '0', '9');
+    const __m128i v62 = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('+')), _mm_cmpeq_epi8(c, _mm_set1_epi8('-')));
+    const __m128i v63 = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('/')), _mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+    const __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(v62, v63)));
+    if (_mm_movemask_epi8(valid) != 0xFFFF)
+        return false;
+
+    __m128i result = _mm_and_si128(upper, _mm_sub_epi8(c, _mm_set1_epi8('A')));
+    result = _mm_or_si128(result, _mm_and_si128(lower, _mm_sub_epi8(c, _mm_set1_epi8('a' - 26))));
+    result = _mm_or_si128(result, _mm_and_si128(digit, _mm_add_epi8(c, _mm_set1_epi8(52 - '0'))));
+    result = _mm_or_si128(result, _mm_and_si128(v62, _mm_set1_epi8(62)));
+    result = _mm_or_si128(result, _mm_and_si128(v63, _mm_set1_epi8(63)));
+    *values = result;
+    return true;
+}
+
+// Packs 16 6-bit values into 12 bytes, in the low 12 bytes of the result
+inline __m128i packBlock128(__m128i values) {
+    const __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    const __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(packed, _mm_setr_epi8(2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1));
+}
+
+#endif
+
+#if defined(SIRIKATA_BASE64_AVX2)
+
+inline __m256i encodeBlock256(__m256i in) {
+    in = _mm256_shuffle_epi8(in, _mm256_set_epi8(
+            10,11,9,10, 7,8,6,7, 4,5,3,4, 1,2,0,1,
+            10,11,9,10, 7,8,6,7, 4,5,3,4, 1,2,0,1));
+    const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    const __m256i indices = _mm256_or_si256(t1, t3);
+
+    __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    reduced = _mm256_or_si256(reduced, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    const __m256i shift_lut = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62,
+        '_' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62,
+        '_' - 63, 'A', 0, 0);
+    return _mm256_add_epi8(indices, _mm256_shuffle_epi8(shift_lut, reduced));
+}
+
+inline __m256i inRange256(__m256i c, char lo, char hi) {
+    return _mm256_and_si256(
+        _mm256_cmpgt_epi8(c, _mm256_set1_epi8(lo - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), c));
+}
+
+inline bool decodeValues256(__m256i c, __m256i* values) {
+    const __m256i upper = inRange256(c, 'A', 'Z');
+    const __m256i lower = inRange256(c, 'a', 'z');
+    const __m256i digit = inRange256(c, '0', '9');
+    const __m256i v62 = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('+')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('-')));
+    const __m256i v63 = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('/')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')));
+    const __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(v62, v63)));
+    if (_mm256_movemask_epi8(valid) != -1)
+        return false;
+
+    __m256i result = _mm256_and_si256(upper, _mm256_sub_epi8(c, _mm256_set1_epi8('A')));
+    result = _mm256_or_si256(result, _mm256_and_si256(lower, _mm256_sub_epi8(c, _mm256_set1_epi8('a' - 26))));
+    result = _mm256_or_si256(result, _mm256_and_si256(digit, _mm256_add_epi8(c, _mm256_set1_epi8(52 - '0'))));
+    result = _mm256_or_si256(result, _mm256_and_si256(v62, _mm256_set1_epi8(62)));
+    result = _mm256_or_si256(result, _mm256_and_si256(v63, _mm256_set1_epi8(63)));
+    *values = result;
+    return true;
+}
+
+// Packs 32 6-bit values into 12 bytes in the low part of each 128-bit lane
+inline __m256i packBlock256(__m256i values) {
+    const __m256i merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    const __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    return _mm256_shuffle_epi8(packed, _mm256_setr_epi8(
+            2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1,
+            2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1));
+}
+
+#endif
+
+} // namespace
+
+size_t Base64::encodeScalar(const uint8* src, size_t len, uint8* dst) {
+    size_t used = encodeGroupsScalar(src, len, dst);
+    size_t written = (used / 3) * 4;
+    if (used < len) {
+        encodeTail(src + used, len - used, dst + written);
+        written += 4;
+    }
+    return written;
+}
+
+size_t Base64::encode(const uint8* src, size_t len, uint8* dst) {
+    size_t i = 0;
+    uint8* out = dst;
+
+#if defined(SIRIKATA_BASE64_AVX2)
+    // Each lane takes 12 bytes, but loads 16, so stay 4 bytes clear of the end
+    for(; i + 28 <= len; i += 24, out += 32) {
+        __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(src + i))),
+            _mm_loadu_si128((const __m128i*)(src + i + 12)),
+            1);
+        _mm256_storeu_si256((__m256i*)out, encodeBlock256(in));
+    }
+#endif
+#if defined(SIRIKATA_BASE64_SSSE3)
+    for(; i + 16 <= len; i += 12, out += 16)
+        _mm_storeu_si128((__m128i*)out, encodeBlock128(_mm_loadu_si128((const __m128i*)(src + i))));
+#endif
+
+    return (out - dst) + encodeScalar(src + i, len - i, out);
+}
+
+size_t Base64::decodeScalar(const uint8* src, size_t len, uint8* dst) {
+    DecodeState state;
+    return decodeScalarStep(src, len, dst, &state);
+}
+
+size_t Base64::decode(const uint8* src, size_t len, uint8* dst) {
+    DecodeState state;
+    size_t i = 0;
+    uint8* out = dst;
+
+    // The vector kernels only run on block boundaries where the scalar
+    // decoder is between quartets. Blocks with whitespace, padding or invalid
+    // characters go through the scalar decoder. The length checks also
+    // guarantee the full width stores stay within decodedMaxSize(len).
+#if defined(SIRIKATA_BASE64_AVX2)
+    while(i + 48 <= len && !state.finished) {
+        __m256i values;
+        if (state.b4Posn == 0 && decodeValues256(_mm256_loadu_si256((const __m256i*)(src + i)), &values)) {
+            __m256i packed = packBlock256(values);
+            _mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(packed));
+            _mm_storeu_si128((__m128i*)(out + 12), _mm256_extracti128_si256(packed, 1));
+            out += 24;
+        }
+        else {
+            out += decodeScalarStep(src + i, 32, out, &state);
+        }
+        i += 32;
+    }
+#endif
+#if defined(SIRIKATA_BASE64_SSSE3)
+    while(i + 24 <= len && !state.finished) {
+        __m128i values;
+        if (state.b4Posn == 0 && decodeValues128(_mm_loadu_si128((const __m128i*)(src + i)), &values)) {
+            _mm_storeu_si128((__m128i*)out, packBlock128(values));
+            out += 12;
+        }
+        else {
+            out += decodeScalarStep(src + i, 16, out, &state);
+        }
+        i += 16;
+    }
+#endif
+
+    if (i < len && !state.finished)
+        out += decodeScalarStep(src + i, len - i, out, &state);
+    return out - dst;
+}
+
+const char* Base64::implementation() {
+#if defined(SIRIKATA_BASE64_AVX2)
+    return "avx2";
+#elif defined(SIRIKATA_BASE64_SSSE3)
+    return "ssse3";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace Sirikata
@@ -33,6 +33,14 @@
 #include <sirikata/core/util/Standard.hh>
 #include <sirikata/core/util/SolidAngle.hpp>
 
+#if defined(__AVX__)
+#  define SIRIKATA_SOLID_ANGLE_AVX 1
+#  include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  define SIRIKATA_SOLID_ANGLE_SSE 1
+#  include <xmmintrin.h>
+#endif
+
 namespace Sirikata {
 
 const float SolidAngle::Pi = 3.1415926536f;
@@ -80,6 +88,97 @@ float SolidAngle::maxDistance(float obj_radius) const {
     return obj_radius / C;
 }
 
+namespace {
+// Number of bits set in each 4 bit value, for counting movemask results.
+const uint32 NibbleBitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+}
+
+// The batch test avoids the sqrt in fromCenterRadius. With C = 1 - sa/2pi,
+// an object at distance d with radius r satisfies the angle iff it contains
+// the query point (d <= r) or C >= 0 and r^2 >= (1 - C^2) d^2.
+uint32 SolidAngle::visibleBatch(const Vector3<float>& query_pos,
+    const float* cx, const float* cy, const float* cz, const float* radii, uint32 count,
+    uint32* mask_out) const
+{
+    uint32 nwords = (count + 31) / 32;
+    for(uint32 w = 0; w < nwords; w++)
+        mask_out[w] = 0;
+
+    float C = 1.f - mSolidAngle / (2.0f * Pi);
+    bool outside_ok = (C >= 0.f);
+    float K = 1.f - C*C;
+
+    uint32 nvisible = 0;
+    uint32 i = 0;
+
+#if defined(SIRIKATA_SOLID_ANGLE_AVX)
+    {
+        const __m256 qx = _mm256_set1_ps(query_pos.x);
+        const __m256 qy = _mm256_set1_ps(query_pos.y);
+        const __m256 qz = _mm256_set1_ps(query_pos.z);
+        const __m256 k = _mm256_set1_ps(K);
+        const __m256 outside_mask = outside_ok ? _mm256_castsi256_ps(_mm256_set1_epi32(-1)) : _mm256_setzero_ps();
+        for(; i + 8 <= count; i += 8) {
+            __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(cx + i), qx);
+            __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(cy + i), qy);
+            __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(cz + i), qz);
+            __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+            __m256 r = _mm256_loadu_ps(radii + i);
+            __m256 r2 = _mm256_mul_ps(r, r);
+            __m256 inside = _mm256_cmp_ps(d2, r2, _CMP_LE_OQ);
+            __m256 far_vis = _mm256_and_ps(_mm256_cmp_ps(r2, _mm256_mul_ps(k, d2), _CMP_GE_OQ), outside_mask);
+            uint32 bits = (uint32)_mm256_movemask_ps(_mm256_or_ps(inside, far_vis));
+            mask_out[i >> 5] |= bits << (i & 31);
+            nvisible += NibbleBitCount[bits & 0xF] + NibbleBitCount[bits >> 4];
+        }
+    }
+#elif defined(SIRIKATA_SOLID_ANGLE_SSE)
+    {
+        const __m128 qx = _mm_set1_ps(query_pos.x);
+        const __m128 qy = _mm_set1_ps(query_pos.y);
+        const __m128 qz = _mm_set1_ps(query_pos.z);
+        const __m128 k = _mm_set1_ps(K);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 outside_mask = outside_ok ? _mm_cmpeq_ps(zero, zero) : zero;
+        for(; i + 4 <= count; i += 4) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(cx + i), qx);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(cy + i), qy);
+            __m128 dz = _mm_sub_ps(_mm_loadu_ps(cz + i), qz);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 r = _mm_loadu_ps(radii + i);
+            __m128 r2 = _mm_mul_ps(r, r);
+            __m128 inside = _mm_cmple_ps(d2, r2);
+            __m128 far_vis = _mm_and_ps(_mm_cmpge_ps(r2, _mm_mul_ps(k, d2)), outside_mask);
+            uint32 bits = (uint32)_mm_movemask_ps(_mm_or_ps(inside, far_vis));
+            mask_out[i >> 5] |= bits << (i & 31);
+            nvisible += NibbleBitCount[bits];
+        }
+    }
+#endif
+
+    // Scalar fallback and remainder
+    for(; i < count; i++) {
+        float dx = cx[i] - query_pos.x, dy = cy[i] - query_pos.y, dz = cz[i] - query_pos.z;
+        float d2 = dx*dx + dy*dy + dz*dz;
+        float r2 = radii[i] * radii[i];
+        if (d2 <= r2 || (outside_ok && r2 >= K * d2)) {
+            mask_out[i >> 5] |= (1u << (i & 31));
+            nvisible++;
+        }
+    }
+
+    return nvisible;
+}
+
+void SolidAngle::visibleBatch(const float* qx, const float* qy, const float* qz, const SolidAngle* angles, uint32 nqueries,
+    const float* cx, const float* cy, const float* cz, const float* radii, uint32 count,
+    uint32* mask_out)
+{
+    uint32 nwords = (count + 31) / 32;
+    for(uint32 q = 0; q < nqueries; q++)
+        angles[q].visibleBatch(Vector3<float>(qx[q], qy[q], qz[q]), cx, cy, cz, radii, count, mask_out + q * nwords);
+}
+
 SolidAngle SolidAngle::operator+(const SolidAngle& rhs) const {
     return SolidAngle( mSolidAngle + rhs.mSolidAngle );
 }
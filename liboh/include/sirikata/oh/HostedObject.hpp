@@ -61,6 +61,12 @@ namespace Protocol {
 namespace Loc {
 class LocationUpdate;
 }
+namespace Prox {
+class ProximityResults;
+}
+}
+namespace Network {
+class ProxCompactDecoder;
 }
 
 class ProxyObject;
@@ -351,13 +357,14 @@ public:
     void handleProximitySubstream(const SpaceObjectReference& spaceobj, int err, SSTStreamPtr s);
     // Handlers for substream read events for space-managed updates
     void handleLocationSubstreamRead(const SpaceObjectReference& spaceobj, SSTStreamPtr s, std::stringstream* prevdata, uint8* buffer, int length);
-    void handleProximitySubstreamRead(const SpaceObjectReference& spaceobj, SSTStreamPtr s, std::stringstream** prevdata, uint8* buffer, int length);
+    void handleProximitySubstreamRead(const SpaceObjectReference& spaceobj, SSTStreamPtr s, std::stringstream** prevdata, std::tr1::shared_ptr<Network::ProxCompactDecoder> decoder, uint8* buffer, int length);
 
     // Handlers for core space-managed updates
     void processLocationUpdate(const SpaceObjectReference& sporef, ProxyObjectPtr proxy_obj, const Sirikata::Protocol::Loc::LocationUpdate& update);
     void processLocationUpdate(const SpaceID& space, ProxyObjectPtr proxy_obj, uint64 seqno, bool predictive, TimedMotionVector3f* loc, TimedMotionQuaternion* orient, BoundingSphere3f* bounds, String* mesh, String* phy);
     bool handleLocationMessage(const SpaceObjectReference& spaceobj, const std::string& paylod);
     bool handleProximityMessage(const SpaceObjectReference& spaceobj, const std::string& payload);
+    bool handleProximityResults(const SpaceObjectReference& spaceobj, const Sirikata::Protocol::Prox::ProximityResults& contents);
 
     // Helper for creating the correct type of proxy
 
@@ -54,6 +54,7 @@
 #include <vector>
 #include <sirikata/proxyobject/SimulationFactory.hpp>
 #include <sirikata/core/network/Frame.hpp>
+#include <sirikata/core/network/ProxCompactEncoding.hpp>
 #include "PerPresenceData.hpp"
 #include "Protocol_Frame.pbj.hpp"
 
@@ -507,7 +508,14 @@ void HostedObject::handleLocationSubstream(const SpaceObjectReference& spaceobj,
 void HostedObject::handleProximitySubstream(const SpaceObjectReference& spaceobj, int err, SSTStreamPtr s) {
     std::stringstream** prevdataptr = new std::stringstream*;
     *prevdataptr = new std::stringstream();
-    s->registerReadCallback( std::tr1::bind(&HostedObject::handleProximitySubstreamRead, this, spaceobj, s, prevdataptr, _1, _2) );
+    // Owned by the read callback, so it goes away along with it
+    std::tr1::shared_ptr<Network::ProxCompactDecoder> decoder(new Network::ProxCompactDecoder());
+    s->registerReadCallback( std::tr1::bind(&HostedObject::handleProximitySubstreamRead, this, spaceobj, s, prevdataptr, decoder, _1, _2) );
+
+    // Ask for the compact encoding. Spaces that don't support it ignore the
+    // request and keep sending regular results.
+    std::string hello = Network::Frame::write(Network::ProxCompactEncoding::hello());
+    s->write((const uint8*)hello.data(), hello.size());
 }
 
 void HostedObject::handleLocationSubstreamRead(const SpaceObjectReference& spaceobj, SSTStreamPtr s, std::stringstream* prevdata, uint8* buffer, int length) {
@@ -522,7 +530,7 @@ void HostedObject::handleLocationSubstreamRead(const SpaceObjectReference& space
     }
 }
 
-void HostedObject::handleProximitySubstreamRead(const SpaceObjectReference& spaceobj, SSTStreamPtr s, std::stringstream** prevdataptr, uint8* buffer, int length) {
+void HostedObject::handleProximitySubstreamRead(const SpaceObjectReference& spaceobj, SSTStreamPtr s, std::stringstream** prevdataptr, std::tr1::shared_ptr<Network::ProxCompactDecoder> decoder, uint8* buffer, int length) {
     std::stringstream* prevdata = *prevdataptr;
     prevdata->write((const char*)buffer, length);
 
@@ -538,7 +546,25 @@ void HostedObject::handleProximitySubstreamRead(const SpaceObjectReference& spac
         if (msg.empty()) return;
 
         // Otherwise, try to handle it
-        handleProximityMessage(spaceobj, msg);
+        if (Network::ProxCompactEncoding::isCompact(msg)) {
+            Sirikata::Protocol::Prox::ProximityResults contents;
+            if (!decoder->decode(msg, &contents)) {
+                // The decoder's dictionaries no longer match the space's, so
+                // nothing more on this stream can be decoded correctly.
+                SILOG(oh,error,"[HO] Invalid compact proximity results, closing proximity stream.");
+                delete prevdata;
+                delete prevdataptr;
+                // Clear out callback so we aren't responsible for any remaining
+                // references to s
+                s->registerReadCallback(0);
+                s->close(false);
+                return;
+            }
+            handleProximityResults(spaceobj, contents);
+        }
+        else {
+            handleProximityMessage(spaceobj, msg);
+        }
     }
 
     // FIXME we should be getting a callback on stream close so we can clean up!
@@ -658,7 +684,11 @@ bool HostedObject::handleProximityMessage(const SpaceObjectReference& spaceobj,
     bool parse_success = contents.ParseFromString(payload);
     if (!parse_success) return false;
 
+    return handleProximityResults(spaceobj, contents);
+}
 
+bool HostedObject::handleProximityResults(const SpaceObjectReference& spaceobj, const Sirikata::Protocol::Prox::ProximityResults& contents)
+{
     SpaceID space = spaceobj.space();
     for(int32 idx = 0; idx < contents.update_size(); idx++) {
         Sirikata::Protocol::Prox::ProximityUpdate update = contents.update(idx);
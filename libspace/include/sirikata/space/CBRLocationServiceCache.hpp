@@ -47,17 +47,51 @@ namespace Sirikata {
  * work happens in the proximity thread, with the callbacks just storing
  * information to be picked up in the next iteration.
  */
-class CBRLocationServiceCache : public Prox::LocationServiceCache<ObjectProxSimulationTraits>, public LocationServiceListener {
+class SIRIKATA_SPACE_EXPORT CBRLocationServiceCache : public Prox::LocationServiceCache<ObjectProxSimulationTraits>, public LocationServiceListener {
 public:
     typedef Prox::LocationUpdateListener<ObjectProxSimulationTraits> LocationUpdateListener;
 
     /** Constructs a CBRLocationServiceCache which caches entries from locservice.  If
      *  replicas is true, then it caches replica entries from locservice, in addition
-     *  to the local entries it always caches.
+     *  to the local entries it always caches.  If batch_updates is true,
+     *  updates are queued and applied in a single pass in the strand instead
+     *  of being posted individually, with consecutive location, orientation
+     *  and bounds updates to an object merged into one.  locservice may be
+     *  NULL, in which case updates must be fed in directly through the
+     *  LocationServiceListener interface.
      */
-    CBRLocationServiceCache(Network::IOStrand* strand, LocationService* locservice, bool replicas);
+    CBRLocationServiceCache(Network::IOStrand* strand, LocationService* locservice, bool replicas, bool batch_updates = false);
     virtual ~CBRLocationServiceCache();
 
+    /** Stop listening to the LocationService. Must be called from the main
+     *  thread. After this, no new updates will be posted, although updates
+     *  already posted to the strand will still be processed, so the cache
+     *  should only be deleted from the strand.
+     */
+    void detach();
+
+    /** Pause processing of updates. Updates continue to be received but are
+     *  recorded instead of applied, so the object data stays fixed and can be
+     *  read from another thread, e.g. to build a query handler in the
+     *  background. Listeners aren't notified while paused.
+     */
+    void pause();
+    /** Resume processing updates, first replaying any recorded while paused,
+     *  in order. Must be called from the strand.
+     */
+    void resume();
+    /** Copy the current state of all objects from another cache. The objects
+     *  start untracked and listeners aren't notified of them. Must be called
+     *  from the strand, which must be shared with other.
+     */
+    void copyFrom(CBRLocationServiceCache* other);
+    /** Report every object currently in the cache to the listeners as newly
+     *  connected. Copied objects don't generate notifications, so this
+     *  is how listeners added afterwards, e.g. new query handlers, learn
+     *  about them. Safe to call from another thread while paused.
+     */
+    void announceObjects();
+
     /* LocationServiceCache members. */
     virtual Iterator startTracking(const ObjectID& id);
     virtual void stopTracking(const Iterator& id);
@@ -82,6 +116,12 @@ public:
     const String& mesh(const ObjectID& id) const;
     const String& physics(const ObjectID& id) const;
 
+    /** Get the number of objects with entries in the cache, including ones
+     *  only kept around because they are still tracked. Only valid in the prox
+     *  thread.
+     */
+    uint32 numObjects() const { return (uint32)mObjects.size(); }
+
     /* LocationServiceListener members. */
     virtual void localObjectAdded(const UUID& uuid, bool agg, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics);
     virtual void localObjectRemoved(const UUID& uuid, bool agg);
@@ -122,6 +162,56 @@ private:
     void processMeshUpdated(const UUID& uuid, bool agg, const String& newval);
     void processPhysicsUpdated(const UUID& uuid, bool agg, const String& newval);
 
+    // Batched update mode. Every update is recorded in mBatch in arrival
+    // order and a single flush is posted to the strand which applies all of
+    // them at once. Field updates to an object are merged into its last
+    // record as long as no addition or removal of that object came after it,
+    // so per-object ordering is the same as if they had been posted
+    // individually.
+    struct BatchedUpdate {
+        enum Type {
+            Added,
+            Removed,
+            Updated
+        };
+
+        BatchedUpdate()
+         : type(Updated), agg(false), isLocal(false),
+           hasLocation(false), hasOrientation(false), hasBounds(false),
+           hasMesh(false), hasPhysics(false)
+        {}
+
+        Type type;
+        UUID uuid;
+        bool agg;
+        bool isLocal;
+        bool hasLocation;
+        TimedMotionVector3f location;
+        bool hasOrientation;
+        TimedMotionQuaternion orientation;
+        bool hasBounds;
+        BoundingSphere3f bounds;
+        bool hasMesh;
+        String mesh;
+        bool hasPhysics;
+        String physics;
+    };
+    typedef std::vector<BatchedUpdate> BatchedUpdateList;
+    // Index of the last record for each object, only present while that
+    // record is an Updated record which can still absorb more fields.
+    typedef std::tr1::unordered_map<UUID, uint32, UUID::Hasher> BatchIndexMap;
+
+    // Main thread: get the mergeable record for an object, appending one if
+    // its last record was an addition or removal. Must hold mBatchMutex.
+    BatchedUpdate& batchedUpdate(const UUID& uuid, bool agg);
+    // Main thread: append an addition or removal. Must hold mBatchMutex.
+    BatchedUpdate& batchedEvent(const UUID& uuid, BatchedUpdate::Type type, bool agg);
+    // Main thread: post a flush if one isn't already outstanding. Must hold
+    // mBatchMutex.
+    void scheduleBatchFlush();
+    // Prox thread: apply all pending updates, in order.
+    void flushBatchedUpdates();
+
 
     CBRLocationServiceCache();
 
@@ -150,6 +240,8 @@ private:
         float32 maxSize;
         // Whether the object is local or a replica
         bool isLocal;
+        // Aggregates are never reported to listeners
+        bool aggregate;
         String mesh;
         String physics;
         bool exists; // Exists, i.e. xObjectRemoved hasn't been called
@@ -159,6 +251,20 @@ private:
     ObjectDataMap mObjects;
     bool mWithReplicas;
 
+    // Updates recorded while paused, replayed by resume()
+    bool mPaused;
+    typedef std::tr1::function<void()> DeferredUpdate;
+    typedef std::vector<DeferredUpdate> DeferredUpdateList;
+    DeferredUpdateList mDeferred;
+
+    bool mBatchUpdates;
+    boost::mutex mBatchMutex;
+    BatchedUpdateList mBatch;
+    BatchIndexMap mBatchIndex;
+    bool mBatchFlushScheduled;
+    // Reused in the prox thread to avoid reallocating each flush
+    BatchedUpdateList mBatchProcessing;
+
     bool tryRemoveObject(ObjectDataMap::iterator& obj_it);
 
     // Data contained in our Iterators. We maintain both the UUID and the
@@ -58,7 +58,7 @@ namespace Sirikata
   };
 
 
-  class CacheLRUOriginal : public OSegCache
+  class SIRIKATA_SPACE_EXPORT CacheLRUOriginal : public OSegCache
   {
   private:
     Context* mContext;
@@ -87,11 +87,11 @@ namespace Sirikata
       Duration mEntryLifetime; //maximum age of a cache entry
 
   public:
-    CacheLRUOriginal(Context* ctx, uint32 maxSize,uint32 cleanGroupSize,Duration entryLifetime);
+    CacheLRUOriginal(Context* ctx, uint32 maxSize,uint32 cleanGroupSize,Duration entryLifetime,Duration negativeLifetime);
     virtual ~CacheLRUOriginal();
 
     virtual void insert(const UUID& uuid, const OSegEntry& sID);
-    virtual const OSegEntry& get(const UUID& uuid);
+    virtual OSegEntry get(const UUID& uuid);
     virtual void remove(const UUID& uuid);
   };
 }
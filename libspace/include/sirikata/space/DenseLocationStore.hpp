@@ -0,0 +1,236 @@
+/*  Sirikata
+ *  DenseLocationStore.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_DENSE_LOCATION_STORE_HPP_
+#define _SIRIKATA_DENSE_LOCATION_STORE_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/UUID.hpp>
+#include <sirikata/core/util/MotionVector.hpp>
+
+namespace Sirikata {
+
+/** DenseLocationStore keeps the hot, per-tick state of a set of objects --
+ *  position, velocity, update time and radius -- in parallel contiguous
+ *  arrays (structure-of-arrays) instead of one record per object. Each object
+ *  is assigned a slot which remains stable until the object is removed, and a
+ *  UUID -> slot index is maintained for lookups.  This lets code which needs
+ *  to touch every object, e.g. extrapolating all positions to the current
+ *  time, walk the arrays linearly without pulling in cold data like mesh
+ *  URLs.
+ *
+ *  Removed slots are recycled through a free list, so the arrays may contain
+ *  dead entries; use valid() or the alive() array to skip them.
+ *
+ *  The space server doesn't keep one of these. The prox query handlers come
+ *  from libprox and keep their own per-object state, filled from
+ *  CBRLocationServiceCache, so a copy kept alongside the cache was never
+ *  read. For now the layout is only measured by the loc-extrapolation
+ *  benchmark.
+ */
+class DenseLocationStore {
+public:
+    typedef uint32 Slot;
+    static const Slot InvalidSlot = 0xFFFFFFFF;
+
+    DenseLocationStore()
+     : mLiveCount(0)
+    {}
+
+    /** Add an object, returning its slot. If the object is already present
+     *  its existing slot is updated and returned.
+     */
+    Slot add(const UUID& id, const TimedMotionVector3f& loc, float32 radius) {
+        SlotMap::iterator it = mSlots.find(id);
+        if (it != mSlots.end()) {
+            updateLocation(it->second, loc);
+            updateRadius(it->second, radius);
+            return it->second;
+        }
+
+        Slot slot;
+        if (!mFreeSlots.empty()) {
+            slot = mFreeSlots.back();
+            mFreeSlots.pop_back();
+        }
+        else {
+            slot = (Slot)mIDs.size();
+            mIDs.push_back(UUID::null());
+            mPosX.push_back(0.f); mPosY.push_back(0.f); mPosZ.push_back(0.f);
+            mVelX.push_back(0.f); mVelY.push_back(0.f); mVelZ.push_back(0.f);
+            mTimes.push_back(0);
+            mRadii.push_back(0.f);
+            mAlive.push_back(0);
+        }
+
+        mIDs[slot] = id;
+        mAlive[slot] = 1;
+        updateLocation(slot, loc);
+        updateRadius(slot, radius);
+        mSlots[id] = slot;
+        mLiveCount++;
+        return slot;
+    }
+
+    void remove(const UUID& id) {
+        SlotMap::iterator it = mSlots.find(id);
+        if (it == mSlots.end()) return;
+        Slot slot = it->second;
+        mSlots.erase(it);
+
+        mAlive[slot] = 0;
+        mIDs[slot] = UUID::null();
+        // Zero out the motion so dead slots extrapolate to something harmless
+        mPosX[slot] = mPosY[slot] = mPosZ[slot] = 0.f;
+        mVelX[slot] = mVelY[slot] = mVelZ[slot] = 0.f;
+        mRadii[slot] = 0.f;
+        mFreeSlots.push_back(slot);
+        mLiveCount--;
+    }
+
+    /** Get the slot for an object, or InvalidSlot if it isn't stored. */
+    Slot slot(const UUID& id) const {
+        SlotMap::const_iterator it = mSlots.find(id);
+        if (it == mSlots.end()) return InvalidSlot;
+        return it->second;
+    }
+
+    void updateLocation(Slot slot, const TimedMotionVector3f& loc) {
+        assert(valid(slot));
+        const Vector3f& pos = loc.position();
+        const Vector3f& vel = loc.velocity();
+        mPosX[slot] = pos.x; mPosY[slot] = pos.y; mPosZ[slot] = pos.z;
+        mVelX[slot] = vel.x; mVelY[slot] = vel.y; mVelZ[slot] = vel.z;
+        mTimes[slot] = loc.updateTime().raw();
+    }
+
+    void updateRadius(Slot slot, float32 radius) {
+        assert(valid(slot));
+        mRadii[slot] = radius;
+    }
+
+    /** Number of live objects. */
+    uint32 size() const { return mLiveCount; }
+    /** Number of slots, including dead ones. Arrays have this length. */
+    uint32 capacity() const { return (uint32)mIDs.size(); }
+
+    bool valid(Slot slot) const {
+        return (slot < mAlive.size() && mAlive[slot] != 0);
+    }
+
+    const UUID& id(Slot slot) const { return mIDs[slot]; }
+    float32 radius(Slot slot) const { return mRadii[slot]; }
+
+    Vector3f position(Slot slot, const Time& t) const {
+        float32 dt = deltaSeconds(mTimes[slot], t.raw());
+        return Vector3f(
+            mPosX[slot] + mVelX[slot] * dt,
+            mPosY[slot] + mVelY[slot] * dt,
+            mPosZ[slot] + mVelZ[slot] * dt
+        );
+    }
+
+    /** Extrapolate every slot to time t, writing the coordinates into the
+     *  output arrays, which must have room for capacity() elements. Dead
+     *  slots produce the origin.
+     */
+    void extrapolate(const Time& t, float32* out_x, float32* out_y, float32* out_z) const {
+        const uint32 n = capacity();
+        const uint64 traw = t.raw();
+        const uint64* times = n ? &mTimes[0] : NULL;
+        const float32 *px = n ? &mPosX[0] : NULL, *py = n ? &mPosY[0] : NULL, *pz = n ? &mPosZ[0] : NULL;
+        const float32 *vx = n ? &mVelX[0] : NULL, *vy = n ? &mVelY[0] : NULL, *vz = n ? &mVelZ[0] : NULL;
+        for(uint32 i = 0; i < n; i++) {
+            float32 dt = deltaSeconds(times[i], traw);
+            out_x[i] = px[i] + vx[i] * dt;
+            out_y[i] = py[i] + vy[i] * dt;
+            out_z[i] = pz[i] + vz[i] * dt;
+        }
+    }
+
+    /** Evaluate a solid angle query from query_pos at time t against every
+     *  object, using the batched SolidAngle::visibleBatch test. mask_out is
+     *  resized to (capacity()+31)/32 words, with bit (slot % 32) of word
+     *  (slot / 32) set for each visible object. Dead slots are never
+     *  reported. scratch holds the extrapolated positions; passing the same
+     *  one each time avoids reallocating it, but concurrent callers each
+     *  need their own.
+     *
+     *  \returns the number of visible objects
+     */
+    uint32 visible(const Vector3f& query_pos, const SolidAngle& angle, const Time& t, std::vector<float32>& scratch, std::vector<uint32>& mask_out) const {
+        const uint32 n = capacity();
+        mask_out.resize((n + 31) / 32);
+        if (n == 0) return 0;
+
+        scratch.resize(3 * n);
+        float32* xs = &scratch[0];
+        float32* ys = xs + n;
+        float32* zs = ys + n;
+        extrapolate(t, xs, ys, zs);
+        uint32 nvisible = angle.visibleBatch(query_pos, xs, ys, zs, &mRadii[0], n, &mask_out[0]);
+
+        for(std::vector<Slot>::const_iterator it = mFreeSlots.begin(); it != mFreeSlots.end(); it++) {
+            uint32 bit = (1u << (*it & 31));
+            if (mask_out[*it >> 5] & bit) {
+                mask_out[*it >> 5] &= ~bit;
+                nvisible--;
+            }
+        }
+        return nvisible;
+    }
+
+    // Raw array access for linear iteration. All have capacity() elements.
+    const uint8* alive() const { return mAlive.empty() ? NULL : &mAlive[0]; }
+    const float32* radii() const { return mRadii.empty() ? NULL : &mRadii[0]; }
+
+private:
+    static float32 deltaSeconds(uint64 from, uint64 to) {
+        return (float32)((int64)to - (int64)from) * 0.000001f;
+    }
+
+    typedef std::tr1::unordered_map<UUID, Slot, UUID::Hasher> SlotMap;
+    SlotMap mSlots;
+    std::vector<Slot> mFreeSlots;
+    uint32 mLiveCount;
+
+    std::vector<UUID> mIDs;
+    std::vector<float32> mPosX, mPosY, mPosZ;
+    std::vector<float32> mVelX, mVelY, mVelZ;
+    std::vector<uint64> mTimes; // Raw Time values, i.e. microseconds
+    std::vector<float32> mRadii;
+    std::vector<uint8> mAlive;
+}; // class DenseLocationStore
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_DENSE_LOCATION_STORE_HPP_
@@ -35,19 +35,99 @@
 
 #include <sirikata/core/service/Context.hpp>
 #include <sirikata/core/util/UUID.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
 #include <sirikata/space/ObjectSegmentation.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace Sirikata
 {
 
-  class OSegCache
+  /** Base class for OSeg caches.  Implementations provide storage for
+   *  positive entries through insert/get/remove.  On top of that, this class
+   *  tracks short-lived negative entries for objects the OSeg reported as
+   *  missing, tracks backend requests in flight so concurrent lookups for the
+   *  same object can share one request, and keeps counters for both.  All
+   *  of the non-virtual methods are thread safe.
+   */
+  class SIRIKATA_SPACE_EXPORT OSegCache
   {
     public:
+      struct Stats {
+          Stats()
+           : hits(0), misses(0), negativeHits(0), coalesced(0)
+          {}
+
+          uint64 hits;
+          uint64 misses;
+          uint64 negativeHits;
+          uint64 coalesced;
+      };
+
+      /** \param ctx context used as the time source for negative entries
+       *  \param negative_lifetime how long an object reported missing keeps
+       *         being answered from the cache, 0 disables negative caching
+       */
+      OSegCache(Context* ctx, const Duration& negative_lifetime);
       virtual ~OSegCache() {}
 
       virtual void insert(const UUID& uuid, const OSegEntry& sID) = 0;
-      virtual const OSegEntry& get(const UUID& uuid)              = 0;
+      virtual OSegEntry get(const UUID& uuid)                     = 0;
       virtual void remove(const UUID& uuid)                       = 0;
+
+      /** Look up an object, checking both positive and negative entries and
+       *  updating the hit/miss counters.
+       *  \param negative if non-NULL, set to true if the object is known to
+       *         be missing, in which case the OSeg shouldn't be asked for it
+       *  \returns the cached entry or null
+       */
+      OSegEntry lookup(const UUID& uuid, bool* negative = NULL);
+      /** Record that the OSeg couldn't find the object. */
+      void insertNegative(const UUID& uuid);
+      /** Forget that the object was missing. OSegs call this whenever they
+       *  learn the object exists, e.g. when it is added or migrates to this
+       *  server, so lookups don't keep failing for the rest of the negative
+       *  lifetime.
+       */
+      void removeNegative(const UUID& uuid);
+
+      /** Mark the start of a backend lookup for the object.
+       *  \returns true if the caller should issue the request, false if one
+       *           is already in flight and the caller can wait on its result
+       */
+      bool beginLookup(const UUID& uuid);
+      /** Mark the end of a backend lookup started with beginLookup. */
+      void finishLookup(const UUID& uuid);
+
+      Stats stats();
+      /** Number of negative entries currently stored, including expired ones
+       *  which haven't been swept yet.
+       */
+      size_t negativeSize();
+
+      // In flight requests which don't finish in this time are assumed lost
+      // and no longer absorb new lookups.
+      static const Duration InFlightTimeout;
+
+    protected:
+      // Time source for negative entries and in flight requests
+      virtual Time now() const;
+
+    private:
+      void sweepNegative(const Time& curtime);
+
+      Context* mCacheContext;
+      Duration mNegativeLifetime;
+
+      typedef std::tr1::unordered_map<UUID, Time, UUID::Hasher> TimeMap;
+      TimeMap mNegative; // Object -> expiration time
+      size_t mNegativeSweepSize;
+      TimeMap mInFlight; // Object -> request start time
+
+      // Hits are counted outside the lock so the common case doesn't
+      // serialize concurrent lookups.
+      AtomicValue<uint64> mHits;
+      Stats mStats;
+      boost::mutex mMutex;
   };
 
 }
@@ -96,6 +96,9 @@ namespace Sirikata
 
     uint64 osegQLenPostQuery;
 
+    //Number of objects in the backend request this lookup was part of
+    uint32 batchSize;
+
     //CraqObjectSegmentation::beginning of beginCraqLookup //anything that gets to beginCraqLookupGets to here
     uint64 craqLookupBegin;
 
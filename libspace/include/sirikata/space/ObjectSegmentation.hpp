@@ -157,6 +157,14 @@ public:
       }
 
     virtual OSegEntry lookup(const UUID& obj_id) = 0;
+    /** Look up a batch of objects at once.  On return, results has one entry
+     *  per requested object: a non-null entry means the lookup was satisfied
+     *  immediately, a null entry means the result will be delivered through
+     *  the OSegLookupListener.  The default implementation just issues
+     *  individual lookups; implementations whose backing store supports
+     *  multi-gets should override it to save round trips.
+     */
+    virtual void lookupBatch(const std::vector<UUID>& obj_ids, std::vector<OSegEntry>* results);
     virtual OSegEntry cacheLookup(const UUID& obj_id) = 0;
     virtual void migrateObject(const UUID& obj_id, const OSegEntry& new_server_id) = 0;
     virtual void addNewObject(const UUID& obj_id, float radius) = 0;
@@ -0,0 +1,130 @@
+/*  Sirikata
+ *  SegmentationLookupCache.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SIRIKATA_SEGMENTATION_LOOKUP_CACHE_HPP_
+#define _SIRIKATA_SEGMENTATION_LOOKUP_CACHE_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/space/SegmentationSnapshot.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Sirikata {
+
+/** The part of the coordinate segmentation a server knows about locally,
+ *  answering lookups without asking the CSeg server. Known regions are
+ *  published as SegmentationSnapshots, so lookups they cover don't lock.
+ *  Regions learned from lookup responses are checked under a lock until the
+ *  next service() publishes them, rather than rebuilding the snapshot for
+ *  every response.
+ */
+class SegmentationLookupCache {
+public:
+    SegmentationLookupCache()
+    {
+    }
+
+    /** Find the server whose region contains pos, or NullServerID if it
+     *  isn't known locally.
+     */
+    ServerID lookup(const Vector3f& pos) {
+        {
+            SegmentationSnapshot::Publisher::Reader snapshot(mSnapshot);
+            ServerID server = snapshot->lookup(pos);
+            if (server != NullServerID)
+                return server;
+        }
+
+        boost::mutex::scoped_lock lock(mMutex);
+        for(uint32 i = 0; i < mUnpublished.size(); i++) {
+            if (mUnpublished[i].second.contains(pos))
+                return mUnpublished[i].first;
+        }
+        return NullServerID;
+    }
+
+    /** Add a region from a lookup response. lookup() finds it right away,
+     *  but it only goes into the snapshot on the next service().
+     */
+    void addRegion(ServerID server, const BoundingBox3f& bbox) {
+        boost::mutex::scoped_lock lock(mMutex);
+        mRegions[server].push_back(bbox);
+        mUnpublished.push_back( std::make_pair(server, bbox) );
+    }
+
+    /** Replace all the regions of each of the given servers, e.g. after a
+     *  segmentation change, and publish them immediately.
+     */
+    void replaceRegions(const std::map<ServerID, BoundingBoxList>& regions) {
+        boost::mutex::scoped_lock lock(mMutex);
+        for(std::map<ServerID, BoundingBoxList>::const_iterator it = regions.begin(); it != regions.end(); it++)
+            mRegions[it->first] = it->second;
+        publish();
+    }
+
+    /** Publish regions added since the last call and free snapshots readers
+     *  are done with. Should be called regularly, e.g. every tick.
+     */
+    void service() {
+        boost::mutex::scoped_lock lock(mMutex);
+        if (!mUnpublished.empty())
+            publish();
+        else
+            mSnapshot.reclaim();
+    }
+
+private:
+    // Rebuilds the snapshot from mRegions. mMutex must be held.
+    void publish() {
+        std::vector<SegmentationInfo> segmentation;
+        segmentation.reserve(mRegions.size());
+        for(std::map<ServerID, BoundingBoxList>::const_iterator it = mRegions.begin(); it != mRegions.end(); it++) {
+            SegmentationInfo info;
+            info.server = it->first;
+            info.region = it->second;
+            segmentation.push_back(info);
+        }
+
+        mSnapshot.publish(new SegmentationSnapshot(segmentation));
+        mUnpublished.clear();
+    }
+
+    // Guards everything but lookups in the published snapshot
+    boost::mutex mMutex;
+    std::map<ServerID, BoundingBoxList> mRegions;
+    SegmentationSnapshot::Publisher mSnapshot;
+    std::vector< std::pair<ServerID, BoundingBox3f> > mUnpublished;
+}; // class SegmentationLookupCache
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SEGMENTATION_LOOKUP_CACHE_HPP_
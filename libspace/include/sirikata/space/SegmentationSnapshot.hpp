@@ -0,0 +1,498 @@
+/*  Sirikata
+ *  SegmentationSnapshot.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_SEGMENTATION_SNAPSHOT_HPP_
+#define _SIRIKATA_SEGMENTATION_SNAPSHOT_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/BoundingBox.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+
+namespace Sirikata {
+
+/** An immutable copy of a coordinate segmentation, answering position ->
+ *  ServerID lookups. The regions are indexed by a BSP tree flattened into a
+ *  single array of small nodes, with a coarse grid over the covered space in
+ *  front of it: grid cells lying entirely inside one region answer lookups
+ *  directly, and only positions near region boundaries walk the tree.
+ *
+ *  Since a snapshot never changes once built, any number of threads can read
+ *  it without locking. To change the segmentation, build a new snapshot and
+ *  publish it through a SegmentationSnapshot::Publisher.
+ */
+class SegmentationSnapshot {
+public:
+    class Publisher;
+
+    enum {
+        GRID_DIM = 16,      // Grid cells per axis
+        MAX_LEAF_SIZE = 4,  // Regions per tree leaf before it gets split
+        MAX_DEPTH = 32
+    };
+
+    /** An empty snapshot, which covers nothing. */
+    SegmentationSnapshot()
+     : mStorage(NULL),
+       mRegions(NULL),
+       mNumRegions(0),
+       mNodes(NULL),
+       mNumNodes(0),
+       mLeafRegions(NULL),
+       mNumLeafRegions(0),
+       mBounds(BoundingBox3f::null())
+    {
+        for(int i = 0; i < GRID_DIM*GRID_DIM*GRID_DIM; i++)
+            mGrid[i] = NO_REGION;
+    }
+
+    /** A snapshot of the given segmentation. Regions are expected not to
+     *  overlap; where they do, lookups may return either server.
+     */
+    explicit SegmentationSnapshot(const std::vector<SegmentationInfo>& segmentation)
+     : mStorage(NULL),
+       mRegions(NULL),
+       mNumRegions(0),
+       mNodes(NULL),
+       mNumNodes(0),
+       mLeafRegions(NULL),
+       mNumLeafRegions(0),
+       mBounds(BoundingBox3f::null())
+    {
+        for(int i = 0; i < GRID_DIM*GRID_DIM*GRID_DIM; i++)
+            mGrid[i] = NO_REGION;
+        build(segmentation);
+    }
+
+    ~SegmentationSnapshot() {
+        delete[] mStorage;
+    }
+
+    /** Find the server whose region contains pos, or NullServerID if no
+     *  region does.
+     */
+    ServerID lookup(const Vector3f& pos) const {
+        if (mNumRegions == 0) return NullServerID;
+
+        int32 cell = gridCell(pos);
+        if (cell >= 0) {
+            uint32 idx = mGrid[cell];
+            // Rounding can put positions right at the edge of a cell into it
+            // without them being inside the region, so double check
+            if (idx != NO_REGION && mRegions[idx].bbox.contains(pos))
+                return mRegions[idx].server;
+        }
+
+        uint32 node_idx = 0;
+        while(mNodes[node_idx].axis != LEAF) {
+            const Node& node = mNodes[node_idx];
+            node_idx = (pos[node.axis] < node.split) ? node.first : node.second;
+        }
+
+        const Node& leaf = mNodes[node_idx];
+        for(uint32 i = leaf.first; i < leaf.first + leaf.second; i++) {
+            const Region& region = mRegions[mLeafRegions[i]];
+            if (region.bbox.contains(pos))
+                return region.server;
+        }
+        return NullServerID;
+    }
+
+    uint32 numRegions() const {
+        return mNumRegions;
+    }
+
+    uint32 numNodes() const {
+        return mNumNodes;
+    }
+
+    /** Bounds of the union of all regions. */
+    const BoundingBox3f& bounds() const {
+        return mBounds;
+    }
+
+private:
+    // Noncopyable
+    SegmentationSnapshot(const SegmentationSnapshot&);
+    SegmentationSnapshot& operator=(const SegmentationSnapshot&);
+
+    enum {
+        CACHE_LINE_SIZE = 64,
+        LEAF = 3,
+        NO_REGION = 0xFFFFFFFF
+    };
+
+    // Padded so two share a cache line
+    struct Region {
+        BoundingBox3f bbox;
+        ServerID server;
+        uint32 padding;
+    };
+
+    // Interior nodes send positions below split on axis to first and the rest
+    // to second. Leaves (axis == LEAF) hold second regions starting at
+    // mLeafRegions[first]. Four nodes share a cache line.
+    struct Node {
+        float32 split;
+        uint32 axis;
+        uint32 first;
+        uint32 second;
+    };
+
+    void build(const std::vector<SegmentationInfo>& segmentation) {
+        std::vector<Region> regions;
+        for(uint32 si = 0; si < segmentation.size(); si++) {
+            for(uint32 ri = 0; ri < segmentation[si].region.size(); ri++) {
+                Region region;
+                region.bbox = segmentation[si].region[ri];
+                region.server = segmentation[si].server;
+                region.padding = 0;
+                if (regions.empty())
+                    mBounds = region.bbox;
+                else
+                    mBounds.mergeIn(region.bbox);
+                regions.push_back(region);
+            }
+        }
+        if (regions.empty()) return;
+
+        std::vector<Node> nodes;
+        std::vector<uint32> leaf_regions;
+        std::vector<uint32> all(regions.size());
+        for(uint32 i = 0; i < all.size(); i++)
+            all[i] = i;
+        buildNode(regions, all, 0, nodes, leaf_regions);
+
+        // Lay everything out in one block, each array starting on its own
+        // cache line
+        size_t regions_bytes = roundUp(regions.size() * sizeof(Region));
+        size_t nodes_bytes = roundUp(nodes.size() * sizeof(Node));
+        size_t leaf_bytes = roundUp(leaf_regions.size() * sizeof(uint32));
+        mStorage = new uint8[regions_bytes + nodes_bytes + leaf_bytes + CACHE_LINE_SIZE];
+        uint8* base = (uint8*)roundUp((size_t)mStorage);
+
+        mRegions = (Region*)base;
+        mNumRegions = regions.size();
+        memcpy(mRegions, &regions[0], regions.size() * sizeof(Region));
+
+        mNodes = (Node*)(base + regions_bytes);
+        mNumNodes = nodes.size();
+        memcpy(mNodes, &nodes[0], nodes.size() * sizeof(Node));
+
+        mLeafRegions = (uint32*)(base + regions_bytes + nodes_bytes);
+        mNumLeafRegions = leaf_regions.size();
+        if (!leaf_regions.empty())
+            memcpy(mLeafRegions, &leaf_regions[0], leaf_regions.size() * sizeof(uint32));
+
+        buildGrid();
+    }
+
+    static size_t roundUp(size_t val) {
+        return (val + CACHE_LINE_SIZE - 1) & ~((size_t)CACHE_LINE_SIZE - 1);
+    }
+
+    // Appends the subtree for the given regions to nodes, returning its index
+    static uint32 buildNode(const std::vector<Region>& regions, const std::vector<uint32>& members, uint32 depth,
+        std::vector<Node>& nodes, std::vector<uint32>& leaf_regions)
+    {
+        uint32 node_idx = nodes.size();
+        nodes.push_back(Node());
+
+        float32 best_split = 0;
+        int best_axis = -1;
+        uint32 best_cost = members.size();
+        if (members.size() > MAX_LEAF_SIZE && depth < MAX_DEPTH) {
+            // Try splitting at each region's lower edge on each axis, keeping
+            // the split that leaves the larger side smallest. Regions
+            // straddling the split end up on both sides. The sides are
+            // counted by binary searching the sorted region edges, using the
+            // same tests as onLeft/onRight, rather than rescanning every
+            // region for each candidate.
+            std::vector<float64> lows(members.size()), highs(members.size());
+            for(int axis = 0; axis < 3; axis++) {
+                for(uint32 mi = 0; mi < members.size(); mi++) {
+                    lows[mi] = regions[members[mi]].bbox.min()[axis] - BBOX_CONTAINS_EPSILON;
+                    highs[mi] = regions[members[mi]].bbox.max()[axis] + BBOX_CONTAINS_EPSILON;
+                }
+                std::sort(lows.begin(), lows.end());
+                std::sort(highs.begin(), highs.end());
+
+                for(uint32 ci = 0; ci < members.size(); ci++) {
+                    float32 split = regions[members[ci]].bbox.min()[axis];
+                    uint32 nleft = std::lower_bound(lows.begin(), lows.end(), split) - lows.begin();
+                    uint32 nright = highs.end() - std::lower_bound(highs.begin(), highs.end(), split);
+                    uint32 cost = std::max(nleft, nright);
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_split = split;
+                    }
+                }
+            }
+        }
+
+        if (best_axis == -1) {
+            Node& leaf = nodes[node_idx];
+            leaf.split = 0;
+            leaf.axis = LEAF;
+            leaf.first = leaf_regions.size();
+            leaf.second = members.size();
+            leaf_regions.insert(leaf_regions.end(), members.begin(), members.end());
+            return node_idx;
+        }
+
+        std::vector<uint32> left, right;
+        for(uint32 mi = 0; mi < members.size(); mi++) {
+            if (onLeft(regions[members[mi]], best_axis, best_split)) left.push_back(members[mi]);
+            if (onRight(regions[members[mi]], best_axis, best_split)) right.push_back(members[mi]);
+        }
+
+        uint32 first = buildNode(regions, left, depth+1, nodes, leaf_regions);
+        uint32 second = buildNode(regions, right, depth+1, nodes, leaf_regions);
+        // nodes may have been reallocated, don't hold a reference across the
+        // recursion
+        Node& node = nodes[node_idx];
+        node.split = best_split;
+        node.axis = best_axis;
+        node.first = first;
+        node.second = second;
+        return node_idx;
+    }
+
+    // Whether a region can contain positions below/at or above split, using
+    // the same tolerance as BoundingBox3f::contains
+    static bool onLeft(const Region& region, int axis, float32 split) {
+        return region.bbox.min()[axis] - BBOX_CONTAINS_EPSILON < split;
+    }
+    static bool onRight(const Region& region, int axis, float32 split) {
+        return region.bbox.max()[axis] + BBOX_CONTAINS_EPSILON >= split;
+    }
+
+    void buildGrid() {
+        Vector3f extents = mBounds.max() - mBounds.min();
+        for(int axis = 0; axis < 3; axis++) {
+            mGridScale[axis] = (extents[axis] > 0) ? (GRID_DIM / extents[axis]) : 0;
+            mCellSize[axis] = extents[axis] / GRID_DIM;
+        }
+
+        // Mark the cells lying completely within each region
+        for(uint32 ri = 0; ri < mNumRegions; ri++) {
+            const BoundingBox3f& bbox = mRegions[ri].bbox;
+            int32 lo[3], hi[3];
+            for(int axis = 0; axis < 3; axis++) {
+                if (mCellSize[axis] <= 0) {
+                    lo[axis] = 0; hi[axis] = 0;
+                    continue;
+                }
+                // First cell starting at or after the region's min, last cell
+                // ending at or before its max
+                lo[axis] = (int32)ceil((bbox.min()[axis] - mBounds.min()[axis]) / mCellSize[axis]);
+                hi[axis] = (int32)floor((bbox.max()[axis] - mBounds.min()[axis]) / mCellSize[axis]) - 1;
+                lo[axis] = std::max(lo[axis], 0);
+                hi[axis] = std::min(hi[axis], (int32)GRID_DIM-1);
+            }
+            for(int32 x = lo[0]; x <= hi[0]; x++)
+                for(int32 y = lo[1]; y <= hi[1]; y++)
+                    for(int32 z = lo[2]; z <= hi[2]; z++)
+                        mGrid[(x*GRID_DIM + y)*GRID_DIM + z] = ri;
+        }
+    }
+
+    // Index of the grid cell containing pos, or -1 if it is outside the grid
+    int32 gridCell(const Vector3f& pos) const {
+        int32 idx = 0;
+        for(int axis = 0; axis < 3; axis++) {
+            float32 offset = (pos[axis] - mBounds.min()[axis]) * mGridScale[axis];
+            if (!(offset >= 0 && offset < GRID_DIM)) return -1;
+            idx = idx*GRID_DIM + (int32)offset;
+        }
+        return idx;
+    }
+
+    uint8* mStorage;
+    Region* mRegions;
+    uint32 mNumRegions;
+    Node* mNodes;
+    uint32 mNumNodes;
+    uint32* mLeafRegions;
+    uint32 mNumLeafRegions;
+
+    BoundingBox3f mBounds;
+    Vector3f mGridScale;
+    Vector3f mCellSize;
+    uint32 mGrid[GRID_DIM*GRID_DIM*GRID_DIM];
+}; // class SegmentationSnapshot
+
+
+/** Holds the current SegmentationSnapshot for concurrent readers, RCU
+ *  style. A writer publishes a replacement with a single atomic pointer
+ *  update and readers pick up the current one with an atomic load.
+ *
+ *  Replaced snapshots are freed using epochs. While a Reader is using a
+ *  snapshot it pins the epoch it started in, in one of a fixed set of
+ *  slots, and a replaced snapshot is only freed once no slot is pinned at
+ *  or before the epoch it was replaced in. Readers never lock or share a
+ *  reference count, they just claim a slot which normally no other thread
+ *  is using.
+ *
+ *  Publishing and reclaim() must be serialized by the caller.
+ */
+class SegmentationSnapshot::Publisher {
+public:
+    /** Pins the current snapshot for its lifetime. Create one per lookup
+     *  rather than keeping it around, since it keeps every snapshot replaced
+     *  in the meantime from being freed.
+     */
+    class Reader {
+    public:
+        explicit Reader(const Publisher& publisher)
+         : mSlot(publisher.enter()),
+           mSnapshot(publisher.mCurrent.read())
+        {
+        }
+
+        ~Reader() {
+            // Finish using the snapshot before letting go of it
+            memory_barrier();
+            *mSlot = 0;
+        }
+
+        const SegmentationSnapshot* operator->() const {
+            return mSnapshot;
+        }
+        const SegmentationSnapshot& operator*() const {
+            return *mSnapshot;
+        }
+
+    private:
+        // Noncopyable
+        Reader(const Reader&);
+        Reader& operator=(const Reader&);
+
+        volatile uint32* mSlot;
+        const SegmentationSnapshot* mSnapshot;
+    };
+
+    Publisher()
+     : mCurrent(new SegmentationSnapshot()),
+       mEpoch(1)
+    {
+        for(uint32 i = 0; i < NUM_SLOTS; i++)
+            mSlots[i].epoch = 0;
+    }
+
+    /** Readers must be done before the Publisher goes away. */
+    ~Publisher() {
+        delete mCurrent.read();
+        for(RetiredList::iterator it = mRetired.begin(); it != mRetired.end(); it++)
+            delete it->second;
+    }
+
+    /** Make snapshot the current one, taking ownership of it. */
+    void publish(SegmentationSnapshot* snapshot) {
+        // Make sure the snapshot is fully written before it becomes visible
+        memory_barrier();
+        mRetired.push_back( std::make_pair(mEpoch.read(), mCurrent.read()) );
+        mCurrent = (const SegmentationSnapshot*)snapshot;
+        // Readers that got the old snapshot pinned an epoch no later than the
+        // one it was retired in. The increment is a full barrier, so
+        // reclaim() sees their slots.
+        if (++mEpoch == 0) ++mEpoch;
+        reclaim();
+    }
+
+    /** Free replaced snapshots no reader can be using anymore. publish()
+     *  does this too, but snapshots that were still pinned then are only
+     *  freed by a later call.
+     */
+    void reclaim() {
+        if (mRetired.empty()) return;
+
+        memory_barrier();
+        uint32 oldest = mEpoch.read();
+        for(uint32 i = 0; i < NUM_SLOTS; i++) {
+            uint32 pinned = mSlots[i].epoch;
+            if (pinned != 0 && (int32)(pinned - oldest) < 0)
+                oldest = pinned;
+        }
+        while(!mRetired.empty() && (int32)(mRetired.front().first - oldest) < 0) {
+            delete mRetired.front().second;
+            mRetired.pop_front();
+        }
+    }
+
+    /** Number of replaced snapshots which haven't been freed yet. */
+    uint32 numRetired() const {
+        return mRetired.size();
+    }
+
+private:
+    // Noncopyable
+    Publisher(const Publisher&);
+    Publisher& operator=(const Publisher&);
+
+    enum {
+        NUM_SLOTS = 64
+    };
+
+    // Claims a free slot, pinning the current epoch. Threads start looking
+    // at a slot picked from their stack address so they rarely collide.
+    volatile uint32* enter() const {
+        uint32 start = (uint32)((size_t)&start >> 12);
+        for(uint32 i = start; ; i++) {
+            Slot& slot = mSlots[i % NUM_SLOTS];
+            if (slot.epoch != 0) continue;
+            // The compare and swap is a full barrier, so the snapshot is
+            // only loaded once reclaim() can see the slot
+            if (SizedAtomicValue<sizeof(uint32)>::cas(&slot.epoch, (uint32)0, mEpoch.read()))
+                return &slot.epoch;
+        }
+    }
+
+    // One per cache line so readers in different slots don't contend
+    struct Slot {
+        // The epoch pinned by the reader using this slot, or 0 if it's free
+        volatile uint32 epoch;
+        uint8 padding[CACHE_LINE_SIZE - sizeof(uint32)];
+    };
+
+    typedef std::deque< std::pair<uint32, const SegmentationSnapshot*> > RetiredList;
+
+    AtomicValue<const SegmentationSnapshot*> mCurrent;
+    AtomicValue<uint32> mEpoch;
+    mutable Slot mSlots[NUM_SLOTS];
+    // Replaced snapshots and the epochs they were replaced in, oldest first
+    RetiredList mRetired;
+}; // class SegmentationSnapshot::Publisher
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SEGMENTATION_SNAPSHOT_HPP_
@@ -37,6 +37,7 @@
 
 #include <sirikata/core/network/Message.hpp>
 #include <sirikata/core/network/ObjectMessage.hpp>
+#include <sirikata/core/network/SharedBuffer.hpp>
 
 #include "Protocol_ServerMessage.pbj.hpp"
 
@@ -61,12 +62,17 @@ typedef uint16 ServerMessagePort;
 
 /** Base class for messages that go over the network.  Must provide
  *  message type and serialization methods.
+ *
+ *  The payload is held in a reference counted buffer separate from the rest
+ *  of the message so it never needs to be copied after it is serialized: use
+ *  serializeHeader() to get the bytes which precede it on the wire.
  */
 class SIRIKATA_SPACE_EXPORT Message {
 public:
     Message(const ServerID& origin);
     Message(ServerID src, uint16 src_port, ServerID dest, ServerID dest_port);
     Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const std::string& pl);
+    Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const Network::SharedBuffer& pl);
     Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const Sirikata::Protocol::Object::ObjectMessage* pl);
 
     ServerID source_server() const { return mImpl.source_server(); }
@@ -88,16 +94,19 @@ public:
     // NOTE: We don't expose set_id() so we guarantee it gets created properly.
     // Use the constructor taking an ObjectMessage to ensure this works properly.
 
-    std::string payload() const { return mImpl.payload(); }
-    void set_payload(const std::string& pl) { mImpl.set_payload(pl); }
+    const std::string& payload() const { return mPayload.str(); }
+    void set_payload(const std::string& pl) { set_payload(Network::SharedBuffer(pl)); }
+    void set_payload(const Network::SharedBuffer& pl) { mPayload = pl; mCachedSize = 0; }
+    const Network::SharedBuffer& payloadBuffer() const { return mPayload; }
+
 
+    bool ParseFromString(const std::string& data);
+    bool ParseFromArray(const void* data, int size);
 
-    bool ParseFromString(const std::string& data) {
-        return mImpl.ParseFromString(data);
-    }
-    bool ParseFromArray(const void* data, int size) {
-        return mImpl.ParseFromArray(data, size);
-    }
+    /** Serialize everything except the payload bytes. The serialized message
+     *  is the result followed by payloadBuffer().
+     */
+    bool serializeHeader(std::string* result) const;
 
     // Deprecated. Remains for backwards compatibility.
     bool serialize(Network::Chunk* result) const;
@@ -117,8 +126,14 @@ private:
     // Helper methods to fill in message data
     void fillMessage(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port);
     void fillMessage(ServerID src, uint16 src_port, ServerID dest, ServerID dest_port, const std::string& pl);
+    // Moves the payload out of mImpl after parsing
+    void extractPayload();
+    // Size of the payload field, including its tag and length
+    uint32 payloadFieldSize() const;
 
+    // Never holds the payload, see mPayload
     Sirikata::Protocol::Server::ServerMessage mImpl;
+    Network::SharedBuffer mPayload;
     mutable uint32 mCachedSize;
 }; // class Message
 
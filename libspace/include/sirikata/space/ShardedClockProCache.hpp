@@ -0,0 +1,76 @@
+/*  Sirikata
+ *  ShardedClockProCache.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_SHARDED_CLOCKPRO_CACHE_HPP_
+#define _SIRIKATA_SHARDED_CLOCKPRO_CACHE_HPP_
+
+#include <sirikata/space/OSegCache.hpp>
+#include <sirikata/core/service/Context.hpp>
+#include <vector>
+
+namespace Sirikata
+{
+
+  /** OSeg cache split into independently locked shards by UUID, each managed
+   *  with CLOCK-Pro replacement.  Lookups only take their shard's lock and
+   *  only set a reference bit, so concurrent lookups rarely contend.
+   *  CLOCK-Pro keeps recently evicted cold entries around as non-resident
+   *  test entries, and uses re-references to them to adapt how much of the
+   *  shard is reserved for frequently used (hot) entries, so a burst of
+   *  one-off lookups doesn't flush the working set.
+   */
+  class SIRIKATA_SPACE_EXPORT ShardedClockProCache : public OSegCache
+  {
+  public:
+    /** \param maxSize total number of entries across all shards
+     *  \param numShards number of independently locked shards
+     *  \param entryLifetime how long an entry is used after being inserted
+     */
+    ShardedClockProCache(Context* ctx, uint32 maxSize, uint32 numShards, Duration entryLifetime, Duration negativeLifetime);
+    virtual ~ShardedClockProCache();
+
+    virtual void insert(const UUID& uuid, const OSegEntry& sID);
+    virtual OSegEntry get(const UUID& uuid);
+    virtual void remove(const UUID& uuid);
+
+  private:
+    class Shard;
+
+    Shard* shard(const UUID& uuid);
+
+    Duration mEntryLifetime;
+    std::vector<Shard*> mShards;
+  };
+
+}
+
+#endif //_SIRIKATA_SHARDED_CLOCKPRO_CACHE_HPP_
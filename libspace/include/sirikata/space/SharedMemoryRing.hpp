@@ -0,0 +1,112 @@
+/*  Sirikata
+ *  SharedMemoryRing.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_SPACE_SHARED_MEMORY_RING_HPP_
+#define _SIRIKATA_SPACE_SHARED_MEMORY_RING_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/space/Platform.hpp>
+
+namespace boost {
+namespace interprocess {
+class mapped_region;
+}
+}
+
+namespace Sirikata {
+
+/** A mapped, named shared memory segment, removed when destroyed if this side
+ *  created it.
+ */
+class SIRIKATA_SPACE_EXPORT SharedMemorySegment {
+public:
+    enum OpenMode {
+        OpenExisting, // Map an existing segment, size is ignored
+        OpenOrCreate, // Map the segment, creating it if necessary
+        CreateNew // Replace any existing segment with a new one
+    };
+    // Maps the named segment, removing the name when destroyed if
+    // remove_on_destroy is set. New segments are zero filled. Throws
+    // boost::interprocess::interprocess_exception on failure.
+    SharedMemorySegment(const String& name, OpenMode mode, size_t size, bool remove_on_destroy);
+    ~SharedMemorySegment();
+
+    uint8* data() const;
+    size_t size() const;
+private:
+    String mName;
+    bool mOwner;
+    boost::interprocess::mapped_region* mRegion;
+};
+
+/** Single producer, single consumer ring buffer of messages in a shared memory
+ *  segment.  One process writes, another reads, and the positions in the
+ *  ring's header are the only state shared between them.  A zero filled
+ *  segment is a valid empty ring.
+ */
+class SIRIKATA_SPACE_EXPORT SharedMemoryRing {
+public:
+    /** Takes ownership of the segment. */
+    SharedMemoryRing(SharedMemorySegment* seg);
+    ~SharedMemoryRing();
+
+    /** Size of a segment holding a ring with the given capacity, which should
+     *  be a power of two.
+     */
+    static size_t segmentSize(size_t capacity);
+
+    // Sender side
+    bool write(MemoryReference first, MemoryReference second);
+    bool hasSpaceFor(size_t msg_size) const;
+    // Larger records could need more than the whole ring once padding to
+    // the end of the buffer is included
+    uint64 maxRecordSize() const { return mCapacity / 2; }
+    // Receiver side. read() returns NULL if no data is available.
+    bool empty() const;
+    Network::Chunk* read();
+
+    uint64 capacity() const { return mCapacity; }
+
+    // Space a message takes up in the ring, including its length
+    static size_t recordSize(size_t msg_size);
+
+    struct Header;
+private:
+    SharedMemorySegment* mSegment;
+    Header* mHeader;
+    uint8* mData;
+    uint64 mCapacity;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SPACE_SHARED_MEMORY_RING_HPP_
@@ -66,6 +66,19 @@ public:
 
         virtual ServerID id() const = 0;
         virtual bool send(const Chunk&) = 0;
+        /** Send first and second back to back as a single message. This
+         *  allows a header and a separately stored payload to be sent
+         *  without joining them first. The default implementation just
+         *  joins them, implementations should override it to avoid the copy.
+         */
+        virtual bool send(MemoryReference first, MemoryReference second) {
+            Chunk joined(first.size() + second.size());
+            if (first.size() != 0)
+                memcpy(&joined[0], first.data(), first.size());
+            if (second.size() != 0)
+                memcpy(&joined[first.size()], second.data(), second.size());
+            return send(joined);
+        }
     };
 
     /** The Network::SendListener interface should be implemented by the object
@@ -93,6 +106,21 @@ public:
         virtual ServerID id() const = 0;
         virtual Chunk* front() = 0;
         virtual Chunk* pop() = 0;
+        /** Pop up to max_chunks chunks, appending them to chunks, and return
+         *  the number popped. The default implementation just calls pop()
+         *  repeatedly; implementations should override it to avoid
+         *  synchronizing for every chunk.
+         */
+        virtual uint32 popBatch(std::vector<Chunk*>& chunks, uint32 max_chunks) {
+            uint32 npopped = 0;
+            while(npopped < max_chunks) {
+                Chunk* c = pop();
+                if (c == NULL) break;
+                chunks.push_back(c);
+                npopped++;
+            }
+            return npopped;
+        }
     };
 
     /** The Network::ReceiveListener interface should be implemented by the
@@ -122,15 +122,6 @@ CraqObjectSegmentation::CraqObjectSegmentation (SpaceContext* con, Network::IOSt
   */
   CraqObjectSegmentation::~CraqObjectSegmentation()
   {
-    //    should delete not found queue;
-    while (mNfData.size() != 0)
-    {
-      NotFoundData* nfd = mNfData.front();
-      mNfData.pop();
-      delete nfd;
-    }
-
-
     for (TrackedMessageMapAdded::iterator tmessmapit  = trackedAddMessages.begin(); tmessmapit != trackedAddMessages.end(); ++tmessmapit)
       delete tmessmapit->second.msgAdded;
 
@@ -138,6 +129,7 @@ CraqObjectSegmentation::CraqObjectSegmentation (SpaceContext* con, Network::IOSt
 
 
 
+    OSegCache::Stats cacheStats = mCraqCache->stats();
     CONTEXT_SPACETRACE(processOSegShutdownEvents,
         mContext->id(),
         numLookups,
@@ -145,7 +137,10 @@ CraqObjectSegmentation::CraqObjectSegmentation (SpaceContext* con, Network::IOSt
         numCacheHits,
         numCraqLookups,
         numTimeElapsedCacheEviction,
-        numMigrationNotCompleteYet);
+        numMigrationNotCompleteYet,
+        cacheStats.misses,
+        cacheStats.negativeHits,
+        cacheStats.coalesced);
 
   }
 
@@ -230,16 +225,18 @@ bool CraqObjectSegmentation::checkMigratingFromNotCompleteYet(const UUID& obj_id
   }
 
 
-  //checks value against cache.
+  //checks value against cache.  negative is set if the cache knows that the
+  //object doesn't exist.
   //should only be called from the "postingStrand"
-  CraqEntry CraqObjectSegmentation::satisfiesCache(const UUID& obj_id)
+  CraqEntry CraqObjectSegmentation::satisfiesCache(const UUID& obj_id, bool* negative)
   {
+    *negative = false;
 
 #ifndef CRAQ_CACHE
     return CraqEntry::null();
 #endif
 
-    return mCraqCache->get(obj_id);
+    return mCraqCache->lookup(obj_id, negative);
   }
 
 
@@ -262,6 +259,8 @@ bool CraqObjectSegmentation::checkMigratingFromNotCompleteYet(const UUID& obj_id
     if (mStopping)
       return ;
 
+    mCraqCache->removeNegative(obj_id);
+
     CraqDataKey cdk;
     convert_obj_id_to_dht_key(obj_id,cdk);
     CraqDataSetGet cdSetGet(cdk, CraqEntry(mContext->id(),radius) ,true,CraqDataSetGet::SET);
@@ -291,8 +290,9 @@ Sirikata::Protocol::OSeg::AddedObjectMessage* CraqObjectSegmentation::generateAd
   OSegEntry CraqObjectSegmentation::cacheLookup(const UUID& obj_id)
   {
       // NOTE: This must be thread safe, so don't access most state.  Don't
-      // bother with local/migration checks.  Just check the cache and move on.
-    CraqEntry cacheReturn = satisfiesCache(obj_id);
+      // bother with local/migration checks.  Just peek at the cache and move
+      // on, leaving the cache's counters to the real lookup.
+    CraqEntry cacheReturn = mCraqCache->get(obj_id);
     if ((cacheReturn.notNull()) && (cacheReturn.server() != mContext->id())) //have to perform second check to prevent accidentally infinitely re-routing to this server when the object doesn't reside here: if the object resided here, then one of the first two conditions would have triggered.
     {
       ++numCacheHits;
@@ -329,13 +329,98 @@ int CraqObjectSegmentation::getPushback()
     OSegLookupTraceToken* traceToken = new OSegLookupTraceToken(obj_id,shouldLog());
     traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_INITIAL_LOOKUP_TIME);
 
+    bool negative = false;
+    CraqEntry localReturn = localLookup(obj_id, traceToken, &negative);
+    if (localReturn.notNull())
+    {
+      delete traceToken;
+      return localReturn;
+    }
+    if (negative)
+    {
+      //craq recently told us the object doesn't exist, don't ask again.
+      delete traceToken;
+      mLookupListener->osegLookupCompleted(obj_id, CraqEntry::null());
+      return CraqEntry::null();
+    }
+
+    ++mOSegQueueLen;
+    traceToken->osegQLenPostQuery = mOSegQueueLen;
+    oStrand->post(boost::bind(&CraqObjectSegmentation::beginCraqLookup,this,obj_id, traceToken));
+
+    return CraqEntry::null();
+  }
+
+  /*
+    Same checks as lookup, but everything that has to go to craq is handed to
+    the dht as a single pipelined request rather than one request per object.
+    Only called from postingStrand
+  */
+  void CraqObjectSegmentation::lookupBatch(const std::vector<UUID>& obj_ids, std::vector<OSegEntry>* results)
+  {
+    results->clear();
+    results->reserve(obj_ids.size());
+
+    std::vector<UUID> toQuery;
+    std::vector<OSegLookupTraceToken*> traceTokens;
+    for (std::vector<UUID>::const_iterator it = obj_ids.begin(); it != obj_ids.end(); ++it)
+    {
+      if (mStopping)
+      {
+        results->push_back(CraqEntry::null());
+        continue;
+      }
+
+      OSegLookupTraceToken* traceToken = new OSegLookupTraceToken(*it,shouldLog());
+      traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_INITIAL_LOOKUP_TIME);
+
+      bool negative = false;
+      CraqEntry localReturn = localLookup(*it, traceToken, &negative);
+      results->push_back(localReturn);
+      if (localReturn.notNull())
+      {
+        delete traceToken;
+        continue;
+      }
+      if (negative)
+      {
+        delete traceToken;
+        mLookupListener->osegLookupCompleted(*it, CraqEntry::null());
+        continue;
+      }
+
+      toQuery.push_back(*it);
+      traceTokens.push_back(traceToken);
+    }
+
+    if (toQuery.empty())
+      return;
+
+    mOSegQueueLen += (int)toQuery.size();
+    for (int s=0; s < (int)traceTokens.size(); ++s)
+    {
+      traceTokens[s]->osegQLenPostQuery = mOSegQueueLen;
+      traceTokens[s]->batchSize = toQuery.size();
+    }
+    oStrand->post(boost::bind(&CraqObjectSegmentation::beginCraqLookupBatch,this,toQuery, traceTokens));
+  }
+
+
+  /*
+    Tries to satisfy a lookup without going to craq: the object may live on
+    this server, be in the middle of migrating away, or be in the cache.
+    Returns a null entry if craq needs to be queried, unless negative is set,
+    in which case craq recently reported that the object doesn't exist.
+  */
+  CraqEntry CraqObjectSegmentation::localLookup(const UUID& obj_id, OSegLookupTraceToken* traceToken, bool* negative)
+  {
+    *negative = false;
 
     ++numLookups;
     float radius=0;
     if (checkOwn(obj_id,&radius))  //this call just checks through to see whether the object is on this space server.
     {
       ++numOnThisServer;
-      delete traceToken;
       return CraqEntry(mContext->id(),radius);
     }
 
@@ -348,14 +433,13 @@ int CraqObjectSegmentation::getPushback()
     if (checkMigratingFromNotCompleteYet(obj_id,&radius))//this call just checks to see whether the object is migrating from this server to another server.  If it is, but hasn't yet received an ack message to disconnect the object connection.
     {
       ++numMigrationNotCompleteYet;
-      delete traceToken;
       return CraqEntry(mContext->id(),radius);
     }
 
 
     traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CHECK_CACHE_LOCAL_BEGIN);
 
-    CraqEntry cacheReturn = satisfiesCache(obj_id);
+    CraqEntry cacheReturn = satisfiesCache(obj_id, negative);
     if ((cacheReturn.notNull()) && (cacheReturn.server() != mContext->id())) //have to perform second check to prevent accidentally infinitely re-routing to this server when the object doesn't reside here: if the object resided here, then one of the first two conditions would have triggered.
     {
         CONTEXT_SPACETRACE(osegCacheResponse,
@@ -367,17 +451,12 @@ int CraqObjectSegmentation::getPushback()
 
       traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CHECK_CACHE_LOCAL_END);
 
-      delete traceToken;
       return cacheReturn;
     }
 
 
     traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CHECK_CACHE_LOCAL_END);
 
-    ++mOSegQueueLen;
-    traceToken->osegQLenPostQuery = mOSegQueueLen;
-    oStrand->post(boost::bind(&CraqObjectSegmentation::beginCraqLookup,this,obj_id, traceToken));
-
     return CraqEntry::null();
   }
 
@@ -393,62 +472,112 @@ int CraqObjectSegmentation::getPushback()
           return;
       }
 
+    std::string indexer;
+    if (!startCraqLookup(obj_id, traceToken, &indexer))
+      return;
+
+    CraqDataSetGet cdSetGet (indexer,CraqEntry::null(),false,CraqDataSetGet::GET); //bftm modified
+
+    if ((numCraqLookups %2) == 0)
+      craqDhtGet1.get(cdSetGet,traceToken); //calling the craqDht to do a get
+    else
+      craqDhtGet2.get(cdSetGet,traceToken); //calling the craqDht to do a get.
+  }
+
+
+  void CraqObjectSegmentation::beginCraqLookupBatch(const std::vector<UUID>& obj_ids, const std::vector<OSegLookupTraceToken*>& traceTokens)
+  {
+    mOSegQueueLen -= (int)obj_ids.size();
+    if (mStopping)
+    {
+      for (int s=0; s < (int)traceTokens.size(); ++s)
+        delete traceTokens[s];
+      return;
+    }
+
+    std::vector<CraqDataSetGet> cdSetGets;
+    std::vector<OSegLookupTraceToken*> toGetTokens;
+    for (int s=0; s < (int)obj_ids.size(); ++s)
+    {
+      std::string indexer;
+      if (!startCraqLookup(obj_ids[s], traceTokens[s], &indexer))
+        continue;
+
+      cdSetGets.push_back(CraqDataSetGet(indexer,CraqEntry::null(),false,CraqDataSetGet::GET));
+      toGetTokens.push_back(traceTokens[s]);
+    }
+
+    if (cdSetGets.empty())
+      return;
+
+    //whole batch goes to one dht so it can be pipelined on its connections.
+    if ((numCraqLookups %2) == 0)
+      craqDhtGet1.getBatch(cdSetGets,toGetTokens);
+    else
+      craqDhtGet2.getBatch(cdSetGets,toGetTokens);
+  }
+
+
+  /*
+    Registers obj_id as being looked up and fills in the craq key to query.
+    Returns false, and finishes off traceToken, if the object is already being
+    looked up or is in transit.
+  */
+  bool CraqObjectSegmentation::startCraqLookup(const UUID& obj_id, OSegLookupTraceToken* traceToken, std::string* indexer)
+  {
     traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CRAQ_LOOKUP_BEGIN);
 
     UUID tmper = obj_id;
+    bool first = mCraqCache->beginLookup(tmper); //false if another get for this object is outstanding; its result will answer this lookup too.
     InTransitMap::const_iterator iter = mInTransitOrLookup.find(tmper);
 
-    if (iter == mInTransitOrLookup.end()) //means that the object isn't already being looked up and the object isn't already in transit
+    if (!first || (iter != mInTransitOrLookup.end())) //means that the object is already being looked up or is already in transit
     {
-        //Duration beginCraqLookupNotAlreadyLookingUpDur = Time::local() - Time::epoch();
-        //traceToken->craqLookupNotAlreadyLookingUpBegin  = beginCraqLookupNotAlreadyLookingUpDur.toMicroseconds();
-        traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CRAQ_LOOKUP_NOT_ALREADY_LOOKING_UP_BEGIN);
+      if (first)
+        mCraqCache->finishLookup(tmper);
+      ++numAlreadyLookingUp;
+      traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CRAQ_LOOKUP_END);
+      CONTEXT_SPACETRACE(osegCumulativeResponse, traceToken);
+      delete traceToken;
+      return false;
+    }
 
-      //if object is not in transit, lookup its location in the dht.  returns -1 if object doesn't exist.
-      //add the mapping of a craqData Key to a uuid.
+    //Duration beginCraqLookupNotAlreadyLookingUpDur = Time::local() - Time::epoch();
+    //traceToken->craqLookupNotAlreadyLookingUpBegin  = beginCraqLookupNotAlreadyLookingUpDur.toMicroseconds();
+    traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CRAQ_LOOKUP_NOT_ALREADY_LOOKING_UP_BEGIN);
 
-      ++numCraqLookups;
+    //if object is not in transit, lookup its location in the dht.  returns -1 if object doesn't exist.
+    //add the mapping of a craqData Key to a uuid.
 
-      std::string indexer = "";
-      indexer.append(1,myUniquePrefixKey);
-      indexer.append(tmper.rawHexData());
+    ++numCraqLookups;
 
-      CraqDataSetGet cdSetGet (indexer,CraqEntry::null(),false,CraqDataSetGet::GET); //bftm modified
+    indexer->clear();
+    indexer->append(1,myUniquePrefixKey);
+    indexer->append(tmper.rawHexData());
 
-      mapDataKeyToUUID[indexer] = tmper; //changed here.
+    mapDataKeyToUUID[*indexer] = tmper; //changed here.
 
 
-      CONTEXT_SPACETRACE(objectSegmentationCraqLookupRequest,
-          obj_id,
-          mContext->id());
+    CONTEXT_SPACETRACE(objectSegmentationCraqLookupRequest,
+        obj_id,
+        mContext->id());
 
-      ++numLookingUpDebug;
+    ++numLookingUpDebug;
 
-      //puts object in transit or lookup.
-      //Duration timerDur =  Time::local() - Time::epoch();
+    //puts object in transit or lookup.
+    //Duration timerDur =  Time::local() - Time::epoch();
 
-      TransLookup tmpTransLookup;
-      tmpTransLookup.sID = CraqEntry::null();  //means that we're performing a lookup, rather than a migrate.
-      //tmpTransLookup.timeAdmitted = (int)timerDur.toMilliseconds();
-      tmpTransLookup.timeAdmitted = 0;
+    TransLookup tmpTransLookup;
+    tmpTransLookup.sID = CraqEntry::null();  //means that we're performing a lookup, rather than a migrate.
+    //tmpTransLookup.timeAdmitted = (int)timerDur.toMilliseconds();
+    tmpTransLookup.timeAdmitted = 0;
 
-      mInTransitOrLookup[tmper] = tmpTransLookup; //just says that we are performing a lookup on the object
+    mInTransitOrLookup[tmper] = tmpTransLookup; //just says that we are performing a lookup on the object
 
-      traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CRAQ_LOOKUP_END);
-      traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CRAQ_LOOKUP_NOT_ALREADY_LOOKING_UP_END);
+    traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CRAQ_LOOKUP_END);
+    traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CRAQ_LOOKUP_NOT_ALREADY_LOOKING_UP_END);
 
-      if ((numCraqLookups %2) == 0)
-          craqDhtGet1.get(cdSetGet,traceToken); //calling the craqDht to do a get
-      else
-          craqDhtGet2.get(cdSetGet,traceToken); //calling the craqDht to do a get.
-    }
-    else
-    {
-      ++numAlreadyLookingUp;
-      traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_CRAQ_LOOKUP_END);
-      CONTEXT_SPACETRACE(osegCumulativeResponse, traceToken);
-      delete traceToken;
-    }
+    return true;
   }
 
   /*
@@ -477,6 +606,7 @@ void CraqObjectSegmentation::addMigratedObject(const UUID& obj_id, float radius,
     if (mStopping)
       return;
 
+    mCraqCache->removeNegative(obj_id);
 
     if (generateAck)
     {
@@ -602,6 +732,7 @@ void CraqObjectSegmentation::handleUpdateOSegMessage(const Sirikata::Protocol::O
       return;
 
     mCraqCache->insert(update_oseg_msg.m_objid(), CraqEntry(update_oseg_msg.servid_obj_on(),update_oseg_msg.m_objradius()));
+    mCraqCache->removeNegative(update_oseg_msg.m_objid());
   }
 
 void CraqObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::OSeg::MigrateMessageAcknowledge& msg) {
@@ -626,6 +757,7 @@ void CraqObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::O
     InTransitMap::iterator inTransIt;
 
     mCraqCache->insert(obj_id, serv_from);
+    mCraqCache->removeNegative(obj_id);
 
     inTransOrLookup_m.lock();
     inTransIt = mInTransitOrLookup.find(obj_id);
@@ -652,70 +784,6 @@ void CraqObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::O
   }
 
 
-  //this function tells us what to do with all the ids that just weren't found in craq.
-  void CraqObjectSegmentation::notFoundFunction(CraqOperationResult* nf)
-  {
-    if (mStopping)
-      return;
-
-    //turn the id into a uuid and then push it onto the end of  mNfData queue.
-    if (mapDataKeyToUUID.find(nf->idToString()) == mapDataKeyToUUID.end())
-      return; //means that we really have no record of this objects' even having been requested.
-
-    NotFoundData* nfd = new NotFoundData();
-    nfd->obj_id =  mapDataKeyToUUID[nf->idToString()];
-    nfd->dur = Time::local() - Time::epoch();
-    nfd->traceToken = nf->traceToken;
-
-
-    mNfData.push(nfd);
-  }
-
-
-  //this function tells us if there are any ids that have waited long enough for it to be safe to query for the again.
-  void CraqObjectSegmentation::checkNotFoundData()
-  {
-    if (mStopping)
-      return;
-
-    //look at the first element of the queue.  if the time hasn't been sufficiently long, return.  if the time has been sufficiently long, then go ahead and directly request asyncCraq to perform another lookup.
-
-    if (mNfData.size() == 0)
-      return;
-
-    std::cout<<"\n\nGOT NOT FOUND\n\n";
-
-    Duration tmpDur = Time::local() - Time::epoch();
-
-
-    bool queueDataOldEnough = true;
-    NotFoundData* nfd;
-
-    while (queueDataOldEnough)
-    {
-      nfd = mNfData.front();
-      queueDataOldEnough = false;
-
-      if ((tmpDur.toMilliseconds() - nfd->dur.toMilliseconds()) > CRAQ_NOT_FOUND_SIT_OUT) //we wait 500 ms.
-      {
-        queueDataOldEnough = true;
-
-        //perform a direct craq get call
-        std::string indexer = "";
-        indexer.append(1,myUniquePrefixKey);
-        indexer.append(nfd->obj_id.rawHexData());
-
-        CraqDataSetGet cdSetGet (indexer,CraqEntry(NullServerID,0),false,CraqDataSetGet::GET); //bftm modified
-        craqDhtGet1.get(cdSetGet, nfd->traceToken); //calling the craqDht to do a get.
-
-        mNfData.pop(); //remove the item from the queue.
-
-        delete nfd; //memory managment
-      }
-      queueDataOldEnough = queueDataOldEnough && (mNfData.size() > 0);  //don't keep going if you're out of objects.
-    }
-  }
-
   //gets posted to from asyncCraqGet.  Should get inside of o_strand from the post.
   void CraqObjectSegmentation::craqGetResult(CraqOperationResult* cor)
   {
@@ -735,18 +803,26 @@ void CraqObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::O
 
     if (cor->servID.isNull())
     {
-      notFoundFunction(cor);
+      //the object isn't in craq: it never existed or has already
+      //disconnected.  Remember that for a little while so that lookups for it
+      //don't keep going back to craq, and tell the requester.
+      std::map<std::string, UUID>::iterator keyIter = mapDataKeyToUUID.find(cor->idToString());
+      if (keyIter == mapDataKeyToUUID.end())
+      {
+        //means that we really have no record of this objects' even having been requested.
+        if(cor->traceToken!= NULL)
+          delete cor->traceToken;
+        delete cor;
+        return;
+      }
+      UUID missing = keyIter->second;
 
-      if(cor->traceToken!= NULL)
-        delete cor->traceToken;
+      mCraqCache->insertNegative(missing);
+      mCraqCache->finishLookup(missing);
+      removeLookupFromInTransOrLookup(missing);
 
+      callOsegLookupCompleted(missing, CraqEntry::null(), cor->traceToken);
       delete cor;
-
-      std::cout<<"\n\nWe have an object that does not exist in craq system.  This shouldn't have really been called.\n\n";
-
-      std::cout<<"Object:  "<<cor->objID<<"  server id:  "<<cor->servID.server()<<"  radius  "<<cor->servID.radius()<<"  tracking  "<<cor->tracking<<"  suceeded: "<<cor->succeeded<<"  GET or set:   "<<(int)cor->whichOperation<<"\n\n";
-
-      assert(false);
       return;
     }
 
@@ -754,9 +830,21 @@ void CraqObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::O
 
     //put the value in the cache!
     mCraqCache->insert(tmper, cor->servID);
+    mCraqCache->finishLookup(tmper);
+
+    removeLookupFromInTransOrLookup(tmper);
 
+    callOsegLookupCompleted(tmper,cor->servID, cor->traceToken);
+    delete cor;
+  }
+
+
+  //clears the entry for a finished lookup, leaving it alone if the object
+  //started migrating in the meantime.
+  void CraqObjectSegmentation::removeLookupFromInTransOrLookup(const UUID& obj_id)
+  {
     inTransOrLookup_m.lock();
-    InTransitMap::iterator iter = mInTransitOrLookup.find(tmper);
+    InTransitMap::iterator iter = mInTransitOrLookup.find(obj_id);
 
     if (iter != mInTransitOrLookup.end()) //means that the object was already being looked up or in transit
     {
@@ -768,11 +856,6 @@ void CraqObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::O
       }
     }
     inTransOrLookup_m.unlock();
-
-
-
-    callOsegLookupCompleted(tmper,cor->servID, cor->traceToken);
-    delete cor;
   }
 
 
@@ -838,6 +921,8 @@ void CraqObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::O
 
       //add this to the cache
       mCraqCache->insert(obj_id, CraqEntry(mContext->id(),radius));
+      //a lookup that raced with the write may have recorded it as missing
+      mCraqCache->removeNegative(obj_id);
 
       //add tomObjects the uuid associated with trackedMessage (ie, now we know that we own the object.)
       mObjects.insert(ObjectSet::value_type(obj_id,CraqEntry(mContext->id(),radius)));
@@ -861,6 +946,7 @@ void CraqObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::O
                                                          awhere->second.msgAdded->m_objradius())));//need to add obj_id
 
       UUID written_obj = awhere->second.msgAdded->m_objid();
+      mCraqCache->removeNegative(written_obj);
       mWriteListener->osegWriteFinished(written_obj);
     }
 
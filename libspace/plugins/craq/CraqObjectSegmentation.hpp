@@ -68,7 +68,6 @@ namespace Sirikata
   };
 
 
-  static const int CRAQ_NOT_FOUND_SIT_OUT   =  500; //that's ms
 
 class CraqObjectSegmentation : public ObjectSegmentation
   {
@@ -117,19 +116,6 @@ class CraqObjectSegmentation : public ObjectSegmentation
     boost::mutex receivingObjects_m;
 
 
-    //what to do when craq can't find the object
-    void notFoundFunction(CraqOperationResult* nf); //this function tells us what to do with all the ids that just weren't found in craq.
-
-    struct NotFoundData
-    {
-      Duration dur;
-      UUID obj_id;
-      OSegLookupTraceToken* traceToken;
-    };
-    typedef std::queue<NotFoundData*> NfDataQ;
-    NfDataQ mNfData;
-    void checkNotFoundData();
-    //end what to do when craq can't find the object
 
 
     //for lookups and sets respectively
@@ -154,6 +140,7 @@ class CraqObjectSegmentation : public ObjectSegmentation
     bool checkMigratingFromNotCompleteYet(const UUID& obj_id,float*radius);
 
     void removeFromInTransOrLookup(const UUID& obj_id);
+    void removeLookupFromInTransOrLookup(const UUID& obj_id);
     void removeFromReceivingObjects(const UUID& obj_id);
 
     //for message addition. when add an object, send a message to the server that you can now finish adding it to forwarder, loc services, etc.
@@ -170,11 +157,14 @@ class CraqObjectSegmentation : public ObjectSegmentation
 
 
     //building for the cache
-    CraqEntry satisfiesCache(const UUID& obj_id);
+    CraqEntry satisfiesCache(const UUID& obj_id, bool* negative);
     OSegCache* mCraqCache;
     //end building for the cache
 
+    CraqEntry localLookup(const UUID& obj_id, OSegLookupTraceToken* traceToken, bool* negative);
     void beginCraqLookup(const UUID& obj_id, OSegLookupTraceToken* traceToken);
+    void beginCraqLookupBatch(const std::vector<UUID>& obj_ids, const std::vector<OSegLookupTraceToken*>& traceTokens);
+    bool startCraqLookup(const UUID& obj_id, OSegLookupTraceToken* traceToken, std::string* indexer);
     void callOsegLookupCompleted(const UUID& obj_id, const CraqEntry& sID, OSegLookupTraceToken* traceToken);
 
       bool shouldLog();
@@ -187,6 +177,7 @@ class CraqObjectSegmentation : public ObjectSegmentation
 
       virtual ~CraqObjectSegmentation();
       virtual OSegEntry lookup(const UUID& obj_id);
+      virtual void lookupBatch(const std::vector<UUID>& obj_ids, std::vector<OSegEntry>* results);
       virtual OSegEntry cacheLookup(const UUID& obj_id);
       virtual void migrateObject(const UUID& obj_id, const OSegEntry& new_server_id);
       virtual void addNewObject(const UUID& obj_id, float radius);
@@ -78,6 +78,11 @@ namespace Sirikata
     mGetStrand->post(std::tr1::bind(&AsyncCraqGet::get,&aCraqGet, cdGet, traceToken));
   }
 
+  void AsyncCraqHybrid::getBatch(const std::vector<CraqDataSetGet>& cdGets, const std::vector<OSegLookupTraceToken*>& traceTokens)
+  {
+    mGetStrand->post(std::tr1::bind(&AsyncCraqGet::getBatch,&aCraqGet, cdGets, traceTokens));
+  }
+
   int AsyncCraqHybrid::queueSize()
   {
     return aCraqSet.queueSize() + aCraqGet.queueSize();
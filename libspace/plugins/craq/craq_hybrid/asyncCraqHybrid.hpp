@@ -56,6 +56,7 @@ public:
 
   void set(CraqDataSetGet cdSet, uint64 tracking_number = 0);
   void get(CraqDataSetGet cdGet, OSegLookupTraceToken* traceToken);
+  void getBatch(const std::vector<CraqDataSetGet>& cdGets, const std::vector<OSegLookupTraceToken*>& traceTokens);
 
   int queueSize();
   int numStillProcessing();
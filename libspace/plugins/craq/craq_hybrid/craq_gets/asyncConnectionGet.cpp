@@ -379,6 +379,59 @@ void AsyncConnectionGet::get(const CraqDataKey& dataToGet, OSegLookupTraceToken*
 
   assert(mReady==PROCESSING);
 
+  addOutstandingQuery(dataToGet, traceToken);
+
+  getQuery(dataToGet);
+
+
+  traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_GET_CONNECTION_NETWORK_GET_END);
+
+}
+
+
+  void AsyncConnectionGet::getBound(const CraqObjectID& obj_dataToGet, OSegLookupTraceToken* traceToken)
+  {
+    get(obj_dataToGet.cdk, traceToken);
+  }
+
+
+//pipelines all of the gets: each is tracked as its own outstanding query, but
+//the requests go out in a single write.  responses are matched up by key as
+//usual.
+void AsyncConnectionGet::getBatchBound(const std::vector<CraqObjectID>& obj_dataToGet, const std::vector<OSegLookupTraceToken*>& traceTokens)
+{
+  if( mReceivedStopRequest)
+  {
+    for (int s=0; s < (int)traceTokens.size(); ++s)
+    {
+      if (traceTokens[s] != NULL)
+        delete traceTokens[s];
+    }
+    return;
+  }
+
+  assert(mReady==PROCESSING);
+
+  std::tr1::shared_ptr<std::string> query(new std::string());
+  for (int s=0; s < (int)obj_dataToGet.size(); ++s)
+  {
+    traceTokens[s]->stamp(OSegLookupTraceToken::OSEG_TRACE_GET_CONNECTION_NETWORK_GET_BEGIN);
+    addOutstandingQuery(obj_dataToGet[s].cdk, traceTokens[s]);
+    appendQuery(obj_dataToGet[s].cdk, *query);
+  }
+
+  //query is bound to the handler so it stays alive until the write finishes.
+  async_write((*mSocket),
+              boost::asio::buffer(*query),
+              std::tr1::bind(&AsyncConnectionGet::write_handler_get_batch,this,_1,_2,query));
+
+  for (int s=0; s < (int)traceTokens.size(); ++s)
+    traceTokens[s]->stamp(OSegLookupTraceToken::OSEG_TRACE_GET_CONNECTION_NETWORK_GET_END);
+}
+
+
+void AsyncConnectionGet::addOutstandingQuery(const CraqDataKey& dataToGet, OSegLookupTraceToken* traceToken)
+{
   IndividualQueryData* iqd = new IndividualQueryData;
   iqd->is_tracking = false;
   iqd->tracking_number = 0;
@@ -401,27 +454,22 @@ void AsyncConnectionGet::get(const CraqDataKey& dataToGet, OSegLookupTraceToken*
   iqd->deadline_timer->async_wait(mStrand->wrap(std::tr1::bind(&AsyncConnectionGet::queryTimedOutCallbackGet, this, _1, bind_this_currently_searching_for)));
 
   iqd->traceToken = traceToken;
-
-
-  getQuery(dataToGet);
-
-
-  traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_GET_CONNECTION_NETWORK_GET_END);
-
 }
 
 
-  void AsyncConnectionGet::getBound(const CraqObjectID& obj_dataToGet, OSegLookupTraceToken* traceToken)
-  {
-    get(obj_dataToGet.cdk, traceToken);
-  }
-
-
 void AsyncConnectionGet::setProcessing()
 {
     mReady=PROCESSING;
 }
 
+void AsyncConnectionGet::appendQuery(const CraqDataKey& dataToGet, std::string& query)
+{
+  query.append(CRAQ_DATA_KEY_QUERY_PREFIX);
+  query.append(dataToGet); //this is the re
+  query += STREAM_DATA_KEY_SUFFIX; //bftm changed here.
+  query.append(CRAQ_DATA_KEY_QUERY_SUFFIX);
+}
+
 bool AsyncConnectionGet::getQuery(const CraqDataKey& dataToGet)
 {
   if ( mReceivedStopRequest)
@@ -429,10 +477,7 @@ bool AsyncConnectionGet::getQuery(const CraqDataKey& dataToGet)
   assert(mReady == PROCESSING);
   //crafts query
   std::string query;
-  query.append(CRAQ_DATA_KEY_QUERY_PREFIX);
-  query.append(dataToGet); //this is the re
-  query += STREAM_DATA_KEY_SUFFIX; //bftm changed here.
-  query.append(CRAQ_DATA_KEY_QUERY_SUFFIX);
+  appendQuery(dataToGet, query);
 
   //sets write handler
   async_write((*mSocket),
@@ -459,6 +504,12 @@ void AsyncConnectionGet::write_some_handler_get(  const boost::system::error_cod
 }
 
 
+void AsyncConnectionGet::write_handler_get_batch(  const boost::system::error_code& error, std::size_t bytes_transferred, std::tr1::shared_ptr<std::string> query)
+{
+  write_some_handler_get(error, bytes_transferred);
+}
+
+
 //This sequence needs to load all of its outstanding queries into the error results vector.
 //
 void AsyncConnectionGet::killSequence()
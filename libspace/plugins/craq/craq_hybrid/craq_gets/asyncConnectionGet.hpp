@@ -79,6 +79,7 @@ public:
 
   void get(const CraqDataKey& dataToGet, OSegLookupTraceToken* traceToken);
   void getBound(const CraqObjectID& obj_dataToGet, OSegLookupTraceToken* traceToken);
+  void getBatchBound(const std::vector<CraqObjectID>& obj_dataToGet, const std::vector<OSegLookupTraceToken*>& traceTokens);
 
 
   ~AsyncConnectionGet();
@@ -117,6 +118,8 @@ private:
   volatile ConnectionState mReady;
 
   bool getQuery(const CraqDataKey& dataToGet);
+  void addOutstandingQuery(const CraqDataKey& dataToGet, OSegLookupTraceToken* traceToken);
+  void appendQuery(const CraqDataKey& dataToGet, std::string& query);
 
 
   void queryTimedOutCallbackGet(const boost::system::error_code& e, const std::string&searchFor);
@@ -163,6 +166,7 @@ private:
   void write_some_handler_set( const boost::system::error_code& error, std::size_t bytes_transferred);
   //get handler
   void write_some_handler_get(  const boost::system::error_code& error, std::size_t bytes_transferred);
+  void write_handler_get_batch( const boost::system::error_code& error, std::size_t bytes_transferred, std::tr1::shared_ptr<std::string> query);
   void read_handler_get      (  const boost::system::error_code& error, std::size_t bytes_transferred, boost::asio::streambuf* sBuff);
 
 
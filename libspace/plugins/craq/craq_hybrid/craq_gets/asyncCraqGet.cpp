@@ -45,6 +45,8 @@
 #include <sirikata/core/network/Asio.hpp>
 
 #define CRAQ_MAX_PUSH_GET 10
+//maximum number of queued gets written to a connection in one go.
+#define CRAQ_MAX_PIPELINE_GET 64
 
 namespace Sirikata
 {
@@ -218,6 +220,33 @@ namespace Sirikata
   }
 
 
+  //enqueues every get before trying the connections so that they can be
+  //pipelined instead of going out one write per get.
+  void AsyncCraqGet::getBatch(const std::vector<CraqDataSetGet>& dataToGet, const std::vector<OSegLookupTraceToken*>& traceTokens)
+  {
+    for (int s=0; s < (int)dataToGet.size(); ++s)
+    {
+      traceTokens[s]->stamp(OSegLookupTraceToken::OSEG_TRACE_GET_MANAGER_ENQUEUE_BEGIN);
+
+      CraqDataSetGet* cdQuery = new CraqDataSetGet(dataToGet[s].dataKey,dataToGet[s].dataKeyValue,dataToGet[s].trackMessage,CraqDataSetGet::GET);
+      QueueValue* qValue = new QueueValue;
+      qValue->cdQuery = cdQuery;
+      qValue->traceToken = traceTokens[s];
+      mQueue.push(qValue);
+
+      traceTokens[s]->stamp(OSegLookupTraceToken::OSEG_TRACE_GET_MANAGER_ENQUEUE_END);
+    }
+
+    int numTries = 0;
+    while((mQueue.size()!= 0) && (numTries < CRAQ_MAX_PUSH_GET))
+    {
+      ++numTries;
+      int rand_connection = rand() % STREAM_CRAQ_NUM_CONNECTIONS_GET;
+      checkConnections(rand_connection);
+    }
+  }
+
+
   void AsyncCraqGet::erroredSetValue(CraqOperationResult* cor)
   {
 #ifdef ASYNC_CRAQ_GET_DEBUG
@@ -288,35 +317,46 @@ bool AsyncCraqGet::checkConnections(int s)
   {
     if (mQueue.size() != 0)
     {
-      //need to put in another
-      QueueValue* qVal  = mQueue.front();
-      CraqDataSetGet* cdSG = qVal->cdQuery;
-      mQueue.pop();
-
-      ++numOperations;
-
-      // Duration dequeueManager  = Time::local() - Time::epoch();
-      // qVal->traceToken->getManagerDequeued = dequeueManager.toMicroseconds();
-      qVal->traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_GET_MANAGER_DEQUEUED);
-      
-      if (cdSG->messageType == CraqDataSetGet::GET)
+      //need to put in more.  everything waiting (up to
+      //CRAQ_MAX_PIPELINE_GET) goes out in a single write.
+      std::vector<CraqObjectID> craqIDs;
+      std::vector<OSegLookupTraceToken*> traceTokens;
+      while ((mQueue.size() != 0) && (numOperations < CRAQ_MAX_PIPELINE_GET))
       {
-        //perform a get in  connections.
-        CraqObjectID tmpCraqID;
-        memcpy(tmpCraqID.cdk, cdSG->dataKey, CRAQ_DATA_KEY_SIZE);
-        mConnections[s]->setProcessing();
-        mConnectionsStrands[s]->post(std::tr1::bind(&AsyncConnectionGet::getBound,mConnections[s],tmpCraqID, qVal->traceToken));
+        QueueValue* qVal  = mQueue.front();
+        CraqDataSetGet* cdSG = qVal->cdQuery;
+        mQueue.pop();
 
-      }
-      else if (cdSG->messageType == CraqDataSetGet::SET)
-      {
+        ++numOperations;
+
+        // Duration dequeueManager  = Time::local() - Time::epoch();
+        // qVal->traceToken->getManagerDequeued = dequeueManager.toMicroseconds();
+        qVal->traceToken->stamp(OSegLookupTraceToken::OSEG_TRACE_GET_MANAGER_DEQUEUED);
+
+        if (cdSG->messageType == CraqDataSetGet::GET)
+        {
+          //perform a get in  connections.
+          CraqObjectID tmpCraqID;
+          memcpy(tmpCraqID.cdk, cdSG->dataKey, CRAQ_DATA_KEY_SIZE);
+          craqIDs.push_back(tmpCraqID);
+          traceTokens.push_back(qVal->traceToken);
+        }
+        else if (cdSG->messageType == CraqDataSetGet::SET)
+        {
 #ifdef ASYNC_CRAQ_GET_DEBUG
-        std::cout<<"\n\nShould be incapable of performing a set from asyncCraqGet\n\n";
+          std::cout<<"\n\nShould be incapable of performing a set from asyncCraqGet\n\n";
 #endif
-        assert(false);
+          assert(false);
+        }
+        delete cdSG;
+        delete qVal;
       }
-      delete cdSG;
-      delete qVal;
+
+      mConnections[s]->setProcessing();
+      if (craqIDs.size() == 1)
+        mConnectionsStrands[s]->post(std::tr1::bind(&AsyncConnectionGet::getBound,mConnections[s],craqIDs[0], traceTokens[0]));
+      else
+        mConnectionsStrands[s]->post(std::tr1::bind(&AsyncConnectionGet::getBatchBound,mConnections[s],craqIDs, traceTokens));
     }
   }
   else if (mConnections[s]->ready() == AsyncConnectionGet::NEED_NEW_SOCKET)
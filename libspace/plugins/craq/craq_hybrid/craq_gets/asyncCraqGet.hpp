@@ -76,6 +76,7 @@ class AsyncCraqGet : public AsyncCraqScheduler
 
 
     void get(const CraqDataSetGet& cdGet, OSegLookupTraceToken* traceToken);
+    void getBatch(const std::vector<CraqDataSetGet>& cdGets, const std::vector<OSegLookupTraceToken*>& traceTokens);
 
     int queueSize();
     int numStillProcessing();
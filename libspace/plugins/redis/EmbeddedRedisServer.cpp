@@ -0,0 +1,448 @@
+/*  Sirikata
+ *  EmbeddedRedisServer.cpp
+ *
+ *  Copyright (c) 2011, Ewen Cheslack-Postava
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "EmbeddedRedisServer.hpp"
+#include <sirikata/core/network/IOStrandImpl.hpp>
+#include <sirikata/core/util/Random.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+#define EMBEDDEDREDIS_LOG(lvl,msg) SILOG(embedded_redis, lvl, msg)
+
+namespace Sirikata {
+
+/** A single client connection to an EmbeddedRedisServer. All handlers run on
+ *  the server's strand, so access to the server's data needs no locking.
+ *  Once closed, the connection forgets the server and its handlers do
+ *  nothing, so they can safely outlive it.
+ */
+class EmbeddedRedisConnection : public std::tr1::enable_shared_from_this<EmbeddedRedisConnection> {
+public:
+    EmbeddedRedisConnection(EmbeddedRedisServer* server, const EmbeddedRedisServer::StrandPtr& strand)
+     : mServer(server),
+       mStrand(strand),
+       mSocket(strand->service()),
+       mLastReady(Time::null()),
+       mWriting(false),
+       mClosed(false)
+    {
+    }
+
+    Network::TCPSocket& socket() { return mSocket; }
+
+    void start() {
+        readSome();
+    }
+
+    // Handler for the server's accept on this connection's socket
+    void accepted(const boost::system::error_code& ec) {
+        if (mClosed) return;
+        mServer->handleAccept(shared_from_this(), ec);
+    }
+
+    void close() {
+        if (mClosed) return;
+        mClosed = true;
+        mServer = NULL;
+        boost::system::error_code ec;
+        mSocket.close(ec);
+    }
+
+private:
+    struct PendingReply {
+        Time ready;
+        String data;
+    };
+    typedef std::deque<PendingReply> PendingReplyQueue;
+
+    void readSome() {
+        if (mClosed) return;
+        using std::tr1::placeholders::_1;
+        using std::tr1::placeholders::_2;
+        mSocket.async_read_some(
+            boost::asio::buffer(mReadBuffer, sizeof(mReadBuffer)),
+            mStrand->wrap(std::tr1::bind(&EmbeddedRedisConnection::handleRead, shared_from_this(), _1, _2))
+        );
+    }
+
+    void handleRead(const boost::system::error_code& ec, std::size_t bytes_transferred) {
+        if (mClosed) return;
+
+        if (ec) {
+            if (ec != boost::asio::error::eof && ec != boost::asio::error::operation_aborted)
+                EMBEDDEDREDIS_LOG(detailed, "Error reading from client: " << ec.message());
+            closeAndRemove();
+            return;
+        }
+
+        mInput.append(mReadBuffer, bytes_transferred);
+
+        std::vector<String> args;
+        bool protocol_error = false;
+        while(parseCommand(&args, &protocol_error))
+            queueReply(handleCommand(args));
+
+        if (protocol_error) {
+            EMBEDDEDREDIS_LOG(error, "Protocol error from client, closing connection.");
+            closeAndRemove();
+            return;
+        }
+
+        readSome();
+    }
+
+    // Reads a CRLF terminated line starting at pos. Returns false if the
+    // complete line isn't available yet.
+    bool readLine(std::size_t* pos, String* line) {
+        std::size_t end = mInput.find("\r\n", *pos);
+        if (end == String::npos) return false;
+        *line = mInput.substr(*pos, end - *pos);
+        *pos = end + 2;
+        return true;
+    }
+
+    // Extracts one complete command from the input buffer, either in the
+    // multi-bulk format hiredis uses or the inline format used by
+    // interactive clients. Returns false if no complete command is buffered.
+    bool parseCommand(std::vector<String>* args, bool* protocol_error) {
+        args->clear();
+        if (mInput.empty()) return false;
+
+        std::size_t pos = 0;
+        String line;
+        if (!readLine(&pos, &line)) return false;
+
+        if (line.empty() || line[0] != '*') {
+            boost::split(*args, line, boost::is_any_of(" "), boost::token_compress_on);
+            if (!args->empty() && args->back().empty()) args->pop_back();
+            mInput.erase(0, pos);
+            return true;
+        }
+
+        int32 nargs = atoi(line.c_str() + 1);
+        if (nargs < 0) {
+            *protocol_error = true;
+            return false;
+        }
+        for(int32 i = 0; i < nargs; i++) {
+            if (!readLine(&pos, &line)) return false;
+            if (line.empty() || line[0] != '$') {
+                *protocol_error = true;
+                return false;
+            }
+            int32 len = atoi(line.c_str() + 1);
+            if (len < 0) {
+                *protocol_error = true;
+                return false;
+            }
+            if (mInput.size() < pos + len + 2) return false;
+            args->push_back(mInput.substr(pos, len));
+            pos += len + 2;
+        }
+
+        mInput.erase(0, pos);
+        return true;
+    }
+
+    static String bulkReply(const String& val) {
+        std::ostringstream os;
+        os << '$' << val.size() << "\r\n" << val << "\r\n";
+        return os.str();
+    }
+
+    static String arityError(const String& cmd) {
+        return "-ERR wrong number of arguments for '" + cmd + "' command\r\n";
+    }
+
+    String handleCommand(const std::vector<String>& args) {
+        if (args.empty())
+            return "-ERR empty command\r\n";
+
+        String cmd = boost::to_upper_copy(args[0]);
+        if (cmd == "PING") {
+            return "+PONG\r\n";
+        }
+        else if (cmd == "GET") {
+            if (args.size() != 2) return arityError(args[0]);
+            if (!mServer->exists(args[1])) return "$-1\r\n";
+            return bulkReply(mServer->get(args[1]));
+        }
+        else if (cmd == "MGET") {
+            if (args.size() < 2) return arityError(args[0]);
+            std::ostringstream os;
+            os << '*' << (args.size()-1) << "\r\n";
+            for(uint32 i = 1; i < args.size(); i++) {
+                if (mServer->exists(args[i]))
+                    os << bulkReply(mServer->get(args[i]));
+                else
+                    os << "$-1\r\n";
+            }
+            return os.str();
+        }
+        else if (cmd == "SET") {
+            if (args.size() != 3) return arityError(args[0]);
+            mServer->set(args[1], args[2]);
+            return "+OK\r\n";
+        }
+        else if (cmd == "DEL") {
+            if (args.size() < 2) return arityError(args[0]);
+            uint32 ndeleted = 0;
+            for(uint32 i = 1; i < args.size(); i++)
+                ndeleted += mServer->del(args[i]);
+            std::ostringstream os;
+            os << ':' << ndeleted << "\r\n";
+            return os.str();
+        }
+
+        return "-ERR unknown command '" + args[0] + "'\r\n";
+    }
+
+    // Replies are released in order, so each one becomes ready no earlier
+    // than the one before it, even if it drew a smaller jitter.
+    void queueReply(const String& reply) {
+        Duration delay = mServer->replyDelay();
+        if (delay == Duration::zero() && mPending.empty()) {
+            mOutput.append(reply);
+            writeSome();
+            return;
+        }
+
+        Time now = Timer::now();
+        PendingReply pending;
+        pending.ready = std::max(mLastReady, now + delay);
+        pending.data = reply;
+        mPending.push_back(pending);
+        mLastReady = pending.ready;
+
+        mStrand->post(
+            pending.ready - now,
+            std::tr1::bind(&EmbeddedRedisConnection::releaseReplies, shared_from_this())
+        );
+    }
+
+    void releaseReplies() {
+        if (mClosed) return;
+
+        Time now = Timer::now();
+        while(!mPending.empty() && mPending.front().ready <= now) {
+            mOutput.append(mPending.front().data);
+            mPending.pop_front();
+        }
+        writeSome();
+    }
+
+    void writeSome() {
+        if (mClosed || mWriting || mOutput.empty()) return;
+
+        mWriting = true;
+        mWriteBuffer.swap(mOutput);
+        mOutput.clear();
+
+        using std::tr1::placeholders::_1;
+        using std::tr1::placeholders::_2;
+        boost::asio::async_write(
+            mSocket,
+            boost::asio::buffer(mWriteBuffer),
+            mStrand->wrap(std::tr1::bind(&EmbeddedRedisConnection::handleWrite, shared_from_this(), _1, _2))
+        );
+    }
+
+    void handleWrite(const boost::system::error_code& ec, std::size_t bytes_transferred) {
+        mWriting = false;
+        if (mClosed) return;
+
+        if (ec) {
+            if (ec != boost::asio::error::operation_aborted)
+                EMBEDDEDREDIS_LOG(detailed, "Error writing to client: " << ec.message());
+            closeAndRemove();
+            return;
+        }
+
+        mWriteBuffer.clear();
+        writeSome();
+    }
+
+    void closeAndRemove() {
+        if (mClosed) return;
+        EmbeddedRedisServer* server = mServer;
+        close();
+        server->connectionClosed(shared_from_this());
+    }
+
+    EmbeddedRedisServer* mServer;
+    // Shared with the server so wrapped and delayed handlers can still be
+    // dispatched after it is gone
+    EmbeddedRedisServer::StrandPtr mStrand;
+    Network::TCPSocket mSocket;
+
+    char mReadBuffer[4096];
+    String mInput;
+
+    PendingReplyQueue mPending;
+    Time mLastReady;
+
+    // Replies ready to go out and the ones currently being written
+    String mOutput;
+    String mWriteBuffer;
+    bool mWriting;
+    bool mClosed;
+};
+
+
+EmbeddedRedisServer::EmbeddedRedisServer(SpaceContext* ctx, const String& host, uint16 port, const Duration& latency, const Duration& jitter)
+ : mContext(ctx),
+   mStrand(ctx->ioService->createStrand()),
+   mHost(host),
+   mPort(port),
+   mLatency(latency),
+   mJitter(jitter),
+   mListener(NULL)
+{
+}
+
+EmbeddedRedisServer::~EmbeddedRedisServer() {
+    // Connections and queued handlers hold their own references to the
+    // strand, so it is freed once the last of them is gone
+    stop();
+}
+
+bool EmbeddedRedisServer::start() {
+    using boost::asio::ip::tcp;
+
+    tcp::endpoint endpoint;
+    try {
+        Network::TCPResolver resolver(*mContext->ioService);
+        Network::TCPResolver::query query(tcp::v4(), mHost, boost::lexical_cast<String>(mPort));
+        endpoint = *resolver.resolve(query);
+    }
+    catch(boost::system::system_error& e) {
+        EMBEDDEDREDIS_LOG(error, "Couldn't resolve host " << mHost << ": " << e.what());
+        return false;
+    }
+
+    try {
+        mListener = new Network::TCPListener(mContext->ioService, endpoint);
+    }
+    catch(boost::system::system_error& e) {
+        mListener = NULL;
+        if (e.code() == boost::asio::error::address_in_use) {
+            // Most likely another space server in this deployment already
+            // started an embedded server on this port. We'll just be one of
+            // its clients.
+            EMBEDDEDREDIS_LOG(info, "Couldn't listen on " << endpoint << " (" << e.what() << "), using existing server.");
+            return true;
+        }
+        EMBEDDEDREDIS_LOG(error, "Couldn't listen on " << endpoint << ": " << e.what());
+        return false;
+    }
+
+    EMBEDDEDREDIS_LOG(info, "Listening on " << endpoint << " with " << mLatency << " latency, " << mJitter << " jitter.");
+    acceptConnection();
+    return true;
+}
+
+void EmbeddedRedisServer::stop() {
+    if (mListener != NULL) {
+        boost::system::error_code ec;
+        mListener->close(ec);
+        delete mListener;
+        mListener = NULL;
+    }
+
+    if (mAccepting) {
+        mAccepting->close();
+        mAccepting.reset();
+    }
+
+    // Copy since closing may remove connections from the set
+    ConnectionSet conns;
+    conns.swap(mConnections);
+    for(ConnectionSet::iterator it = conns.begin(); it != conns.end(); it++)
+        (*it)->close();
+}
+
+void EmbeddedRedisServer::acceptConnection() {
+    if (mListener == NULL) return;
+
+    mAccepting = EmbeddedRedisConnectionPtr(new EmbeddedRedisConnection(this, mStrand));
+    using std::tr1::placeholders::_1;
+    mListener->async_accept(
+        mAccepting->socket(),
+        mStrand->wrap(std::tr1::bind(&EmbeddedRedisConnection::accepted, mAccepting, _1))
+    );
+}
+
+void EmbeddedRedisServer::handleAccept(EmbeddedRedisConnectionPtr conn, const boost::system::error_code& ec) {
+    mAccepting.reset();
+    if (ec) {
+        // Aborted means we're stopping. Anything else only affects this
+        // connection, so keep listening for others.
+        if (ec == boost::asio::error::operation_aborted) return;
+        EMBEDDEDREDIS_LOG(error, "Error accepting connection: " << ec.message());
+        acceptConnection();
+        return;
+    }
+
+    mConnections.insert(conn);
+    conn->start();
+    acceptConnection();
+}
+
+void EmbeddedRedisServer::connectionClosed(EmbeddedRedisConnectionPtr conn) {
+    mConnections.erase(conn);
+}
+
+String EmbeddedRedisServer::get(const String& key) const {
+    DataMap::const_iterator it = mData.find(key);
+    if (it == mData.end()) return String();
+    return it->second;
+}
+
+bool EmbeddedRedisServer::exists(const String& key) const {
+    return (mData.find(key) != mData.end());
+}
+
+void EmbeddedRedisServer::set(const String& key, const String& value) {
+    mData[key] = value;
+}
+
+uint32 EmbeddedRedisServer::del(const String& key) {
+    return mData.erase(key);
+}
+
+Duration EmbeddedRedisServer::replyDelay() const {
+    if (mJitter == Duration::zero()) return mLatency;
+    return mLatency + mJitter * randFloat();
+}
+
+} // namespace Sirikata
@@ -0,0 +1,108 @@
+/*  Sirikata
+ *  EmbeddedRedisServer.hpp
+ *
+ *  Copyright (c) 2011, Ewen Cheslack-Postava
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_EMBEDDED_REDIS_SERVER_HPP_
+#define _SIRIKATA_EMBEDDED_REDIS_SERVER_HPP_
+
+#include <sirikata/space/SpaceContext.hpp>
+#include <sirikata/core/network/Asio.hpp>
+
+namespace Sirikata {
+
+class EmbeddedRedisConnection;
+typedef std::tr1::shared_ptr<EmbeddedRedisConnection> EmbeddedRedisConnectionPtr;
+
+/** EmbeddedRedisServer is a small, in-process stand-in for a real redis
+ *  server. It speaks just the subset of the protocol RedisObjectSegmentation
+ *  uses (PING, GET, MGET, SET, DEL) over TCP, so the OSeg exercises the same
+ *  hiredis code path it would against a real deployment. Replies can be held
+ *  back by a fixed latency plus uniform jitter to emulate a remote store,
+ *  but are always delivered in request order, as redis would.
+ *
+ *  The server listens on the OSeg's host and port, so the host must be an
+ *  address of this machine. If the port is already taken, e.g. by another
+ *  space server in the same deployment running its own embedded server, this
+ *  one stays idle and all the spaces share the first.
+ *
+ *  Connections keep the strand alive and are detached from the server when
+ *  it stops, so handlers still queued when the server is destroyed are
+ *  harmless. Stopping and destroying the server shouldn't race with those
+ *  handlers running, i.e. should happen after the IO service stops.
+ */
+class EmbeddedRedisServer {
+public:
+    typedef std::tr1::shared_ptr<Network::IOStrand> StrandPtr;
+
+    EmbeddedRedisServer(SpaceContext* ctx, const String& host, uint16 port, const Duration& latency, const Duration& jitter);
+    ~EmbeddedRedisServer();
+
+    /** Start listening.
+     *  \returns false if the server can't listen on its host, e.g. because
+     *           it isn't an address of this machine
+     */
+    bool start();
+    void stop();
+
+    bool listening() const { return mListener != NULL; }
+
+    // Invoked by connections, on mStrand
+    String get(const String& key) const;
+    bool exists(const String& key) const;
+    void set(const String& key, const String& value);
+    uint32 del(const String& key);
+    Duration replyDelay() const;
+    void handleAccept(EmbeddedRedisConnectionPtr conn, const boost::system::error_code& ec);
+    void connectionClosed(EmbeddedRedisConnectionPtr conn);
+
+private:
+    void acceptConnection();
+
+    SpaceContext* mContext;
+    StrandPtr mStrand;
+    String mHost;
+    uint16 mPort;
+    Duration mLatency;
+    Duration mJitter;
+
+    Network::TCPListener* mListener;
+    // The connection waiting to be accepted
+    EmbeddedRedisConnectionPtr mAccepting;
+    typedef std::set<EmbeddedRedisConnectionPtr> ConnectionSet;
+    ConnectionSet mConnections;
+
+    typedef std::tr1::unordered_map<String, String> DataMap;
+    DataMap mData;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_EMBEDDED_REDIS_SERVER_HPP_
@@ -34,6 +34,7 @@
 #include <sirikata/core/options/Options.hpp>
 #include <sirikata/space/ObjectSegmentation.hpp>
 #include "RedisObjectSegmentation.hpp"
+#include "EmbeddedRedisServer.hpp"
 
 static int space_redis_plugin_refcount = 0;
 
@@ -44,6 +45,9 @@ static void InitPluginOptions() {
         new OptionValue("host","127.0.0.1",Sirikata::OptionValueType<String>(),"Redis host to connect to."),
         new OptionValue("port","6379",Sirikata::OptionValueType<uint32>(),"Redis port to connect to."),
         new OptionValue("prefix","",Sirikata::OptionValueType<String>(),"Prefix for redis keys, allowing you to provide 'namespaces' so multiple spaces can share the same redis database."),
+        new OptionValue("embedded","false",Sirikata::OptionValueType<bool>(),"If true, run a minimal in-process redis server on the given host and port instead of using an external one. The host must be an address of this machine. Intended for testing and benchmarking."),
+        new OptionValue("embedded-latency","0s",Sirikata::OptionValueType<Duration>(),"Latency the embedded redis server adds to each reply."),
+        new OptionValue("embedded-jitter","0s",Sirikata::OptionValueType<Duration>(),"Maximum random jitter the embedded redis server adds on top of embedded-latency."),
         NULL
     );
 }
@@ -56,7 +60,22 @@ static ObjectSegmentation* createRedisOSeg(SpaceContext* ctx, Network::IOStrand*
     uint32 redis_port = optionsSet->referenceOption("port")->as<uint32>();
     String redis_prefix = optionsSet->referenceOption("prefix")->as<String>();
 
-    return new RedisObjectSegmentation(ctx, oseg_strand, cseg, cache, redis_host, redis_port, redis_prefix);
+    EmbeddedRedisServer* embedded_server = NULL;
+    if (optionsSet->referenceOption("embedded")->as<bool>()) {
+        embedded_server = new EmbeddedRedisServer(
+            ctx, redis_host, redis_port,
+            optionsSet->referenceOption("embedded-latency")->as<Duration>(),
+            optionsSet->referenceOption("embedded-jitter")->as<Duration>()
+        );
+        // Start listening now so it's ready by the time the OSeg connects
+        if (!embedded_server->start()) {
+            SILOG(redis, fatal, "Can't run an embedded redis server for host " << redis_host << ", it must be an address of this machine.");
+            assert(false);
+            exit(-1);
+        }
+    }
+
+    return new RedisObjectSegmentation(ctx, oseg_strand, cseg, cache, redis_host, redis_port, redis_prefix, embedded_server);
 }
 
 } // namespace Sirikata
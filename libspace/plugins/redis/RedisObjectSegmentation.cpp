@@ -31,6 +31,7 @@
  */
 
 #include "RedisObjectSegmentation.hpp"
+#include "EmbeddedRedisServer.hpp"
 #include <boost/algorithm/string.hpp>
 
 #define REDISOSEG_LOG(lvl,msg) SILOG(redis_oseg, lvl, msg)
@@ -80,6 +81,12 @@ struct RedisObjectOperationInfo {
     RedisObjectSegmentation* oseg;
     UUID obj;
 };
+// State tracking for batched reads, which cover a list of objects in the same
+// order as the keys passed to MGET
+struct RedisObjectBatchOperationInfo {
+    RedisObjectSegmentation* oseg;
+    std::vector<UUID> objs;
+};
 // State tracking for migrate changes. If we need to generate an ack, this
 // requires additional info
 struct RedisObjectMigratedOperationInfo {
@@ -100,8 +107,7 @@ void globalRedisLookupObjectReadFinished(redisAsyncContext* c, void* _reply, voi
         wi->oseg->failReadObject(wi->obj);
     }
     else if (reply->type == REDIS_REPLY_NIL) {
-        REDISOSEG_LOG(error, "Redis got nil when reading object.");
-        wi->oseg->failReadObject(wi->obj);
+        wi->oseg->missingReadObject(wi->obj);
     }
     else if (reply->type == REDIS_REPLY_STRING) {
         wi->oseg->finishReadObject(wi->obj, String(reply->str, reply->len));
@@ -116,6 +122,41 @@ void globalRedisLookupObjectReadFinished(redisAsyncContext* c, void* _reply, voi
         freeReplyObject(reply);
 }
 
+void globalRedisLookupObjectBatchReadFinished(redisAsyncContext* c, void* _reply, void* privdata) {
+    redisReply *reply = (redisReply*)_reply;
+    RedisObjectBatchOperationInfo* wi = (RedisObjectBatchOperationInfo*)privdata;
+
+    if (reply == NULL) {
+        REDISOSEG_LOG(error, "Unknown redis error when reading batch of " << wi->objs.size() << " objects");
+    }
+    else if (reply->type == REDIS_REPLY_ERROR) {
+        REDISOSEG_LOG(error, "Redis error when reading batch of " << wi->objs.size() << " objects: " << String(reply->str, reply->len));
+        for(uint32 i = 0; i < wi->objs.size(); i++)
+            wi->oseg->failReadObject(wi->objs[i]);
+    }
+    else if (reply->type == REDIS_REPLY_ARRAY) {
+        if (reply->elements != wi->objs.size())
+            REDISOSEG_LOG(error, "Redis returned " << reply->elements << " values for batch of " << wi->objs.size() << " objects");
+        for(uint32 i = 0; i < wi->objs.size(); i++) {
+            redisReply* elem = (i < reply->elements ? reply->element[i] : NULL);
+            if (elem != NULL && elem->type == REDIS_REPLY_STRING)
+                wi->oseg->finishReadObject(wi->objs[i], String(elem->str, elem->len));
+            else if (elem != NULL && elem->type == REDIS_REPLY_NIL)
+                wi->oseg->missingReadObject(wi->objs[i]);
+            else
+                wi->oseg->failReadObject(wi->objs[i]);
+        }
+    }
+    else {
+        REDISOSEG_LOG(error, "Unexpected redis reply type when reading batch of " << wi->objs.size() << " objects: " << reply->type);
+    }
+
+    delete wi;
+
+    if (reply != NULL)
+        freeReplyObject(reply);
+}
+
 void globalRedisAddNewObjectWriteFinished(redisAsyncContext* c, void* _reply, void* privdata) {
     redisReply *reply = (redisReply*)_reply;
     RedisObjectOperationInfo* wi = (RedisObjectOperationInfo*)privdata;
@@ -195,7 +236,7 @@ void globalRedisDeleteFinished(redisAsyncContext* c, void* _reply, void* privdat
 
 } // namespace
 
-RedisObjectSegmentation::RedisObjectSegmentation(SpaceContext* con, Network::IOStrand* o_strand, CoordinateSegmentation* cseg, OSegCache* cache, const String& redis_host, uint32 redis_port, const String& redis_prefix)
+RedisObjectSegmentation::RedisObjectSegmentation(SpaceContext* con, Network::IOStrand* o_strand, CoordinateSegmentation* cseg, OSegCache* cache, const String& redis_host, uint32 redis_port, const String& redis_prefix, EmbeddedRedisServer* embedded_server)
  : ObjectSegmentation(con, o_strand),
    mCSeg(cseg),
    mCache(cache),
@@ -205,12 +246,24 @@ RedisObjectSegmentation::RedisObjectSegmentation(SpaceContext* con, Network::IOS
    mRedisContext(NULL),
    mRedisFD(NULL),
    mReading(false),
-   mWriting(false)
+   mWriting(false),
+   mEmbeddedServer(embedded_server)
 {
 }
 
 RedisObjectSegmentation::~RedisObjectSegmentation() {
     cleanup();
+    delete mEmbeddedServer;
+
+    OSegCache::Stats cacheStats = mCache->stats();
+    CONTEXT_SPACETRACE(processOSegShutdownEvents,
+        mContext->id(),
+        0, 0,
+        cacheStats.hits,
+        0, 0, 0,
+        cacheStats.misses,
+        cacheStats.negativeHits,
+        cacheStats.coalesced);
 }
 
 void RedisObjectSegmentation::start() {
@@ -340,13 +393,37 @@ OSegEntry RedisObjectSegmentation::cacheLookup(const UUID& obj_id) {
     return mCache->get(obj_id);
 }
 
-OSegEntry RedisObjectSegmentation::lookup(const UUID& obj_id) {
+bool RedisObjectSegmentation::startLookup(const UUID& obj_id, OSegEntry* result) {
+    *result = OSegEntry::null();
+
     // Check locally
     OSegMap::const_iterator it = mOSeg.find(obj_id);
-    if (it != mOSeg.end()) return it->second;
+    if (it != mOSeg.end()) {
+        *result = it->second;
+        return false;
+    }
+
+    if (mStopping) return false;
+
+    bool negative = false;
+    *result = mCache->lookup(obj_id, &negative);
+    if (result->notNull()) return false;
+    if (negative) {
+        // Redis recently told us there's no such object, don't ask again
+        mLookupListener->osegLookupCompleted(obj_id, OSegEntry::null());
+        return false;
+    }
+
+    // If a request is already outstanding, its result will satisfy this
+    // lookup as well.
+    return mCache->beginLookup(obj_id);
+}
+
+OSegEntry RedisObjectSegmentation::lookup(const UUID& obj_id) {
+    OSegEntry result;
+    if (!startLookup(obj_id, &result)) return result;
 
     // Otherwise, kick off the lookup process and return null
-    if (mStopping) return OSegEntry::null();
     RedisObjectOperationInfo* ri = new RedisObjectOperationInfo();
     ri->oseg = this;
     ri->obj = obj_id;
@@ -355,8 +432,48 @@ OSegEntry RedisObjectSegmentation::lookup(const UUID& obj_id) {
     return OSegEntry::null();
 }
 
+void RedisObjectSegmentation::lookupBatch(const std::vector<UUID>& obj_ids, std::vector<OSegEntry>* results) {
+    results->clear();
+    results->reserve(obj_ids.size());
+
+    RedisObjectBatchOperationInfo* ri = new RedisObjectBatchOperationInfo();
+    ri->oseg = this;
+    std::vector<String> keys;
+    for(std::vector<UUID>::const_iterator id_it = obj_ids.begin(); id_it != obj_ids.end(); id_it++) {
+        OSegEntry result;
+        bool needs_request = startLookup(*id_it, &result);
+        results->push_back(result);
+        if (!needs_request) continue;
+
+        ri->objs.push_back(*id_it);
+        keys.push_back(mRedisPrefix + id_it->toString());
+    }
+
+    if (ri->objs.empty()) {
+        delete ri;
+        return;
+    }
+
+    // Everything else goes out as a single MGET, which is answered in one
+    // round trip with an array of values in the same order as the keys.
+    std::vector<const char*> argv;
+    std::vector<size_t> argvlen;
+    argv.reserve(keys.size()+1);
+    argvlen.reserve(keys.size()+1);
+    argv.push_back("MGET");
+    argvlen.push_back(4);
+    for(uint32 i = 0; i < keys.size(); i++) {
+        argv.push_back(keys[i].c_str());
+        argvlen.push_back(keys[i].size());
+    }
+    REDISOSEG_LOG(detailed, "MGET for batch of " << ri->objs.size() << " objects");
+    ensureConnected();
+    redisAsyncCommandArgv(mRedisContext, globalRedisLookupObjectBatchReadFinished, ri, argv.size(), &argv[0], &argvlen[0]);
+}
+
 void RedisObjectSegmentation::finishReadObject(const UUID& obj_id, const String& data_str) {
     REDISOSEG_LOG(detailed, "Finished reading OSEG entry for object " << obj_id.toString());
+    mCache->finishLookup(obj_id);
     if (mStopping) return;
 
     OSegEntry data(OSegEntry::null());
@@ -380,6 +497,15 @@ void RedisObjectSegmentation::finishReadObject(const UUID& obj_id, const String&
 
 void RedisObjectSegmentation::failReadObject(const UUID& obj_id) {
     REDISOSEG_LOG(error, "Failed to read OSEG entry for object " << obj_id.toString());
+    mCache->finishLookup(obj_id);
+    if (mStopping) return;
+    mLookupListener->osegLookupCompleted(obj_id, OSegEntry::null());
+}
+
+void RedisObjectSegmentation::missingReadObject(const UUID& obj_id) {
+    REDISOSEG_LOG(detailed, "No OSEG entry for object " << obj_id.toString());
+    mCache->insertNegative(obj_id);
+    mCache->finishLookup(obj_id);
     if (mStopping) return;
     mLookupListener->osegLookupCompleted(obj_id, OSegEntry::null());
 }
@@ -388,6 +514,7 @@ void RedisObjectSegmentation::addNewObject(const UUID& obj_id, float radius) {
     if (mStopping) return;
 
     mOSeg[obj_id] = OSegEntry(mContext->id(), radius);
+    mCache->removeNegative(obj_id);
 
     RedisObjectOperationInfo* wi = new RedisObjectOperationInfo();
     wi->oseg = this;
@@ -415,6 +542,7 @@ void RedisObjectSegmentation::addMigratedObject(const UUID& obj_id, float radius
     if (mStopping) return;
 
     mOSeg[obj_id] = OSegEntry(mContext->id(), radius);
+    mCache->removeNegative(obj_id);
 
     RedisObjectMigratedOperationInfo* wi = new RedisObjectMigratedOperationInfo();
     wi->oseg = this;
@@ -485,6 +613,7 @@ void RedisObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::
     UUID obj_id = msg.m_objid();
 
     mCache->insert(obj_id, data);
+    mCache->removeNegative(obj_id);
 
     // Finally, this lets the server know the migration has been acked and the
     // object can disconnect
@@ -494,6 +623,7 @@ void RedisObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::
 void RedisObjectSegmentation::handleUpdateOSegMessage(const Sirikata::Protocol::OSeg::UpdateOSegMessage& update_oseg_msg) {
     // Just a cache invalidation/update
     mCache->insert(update_oseg_msg.m_objid(), OSegEntry(update_oseg_msg.servid_obj_on(), update_oseg_msg.m_objradius()));
+    mCache->removeNegative(update_oseg_msg.m_objid());
 }
 
 } // namespace Sirikata
@@ -38,15 +38,18 @@
 
 namespace Sirikata {
 
+class EmbeddedRedisServer;
+
 class RedisObjectSegmentation : public ObjectSegmentation {
 public:
-    RedisObjectSegmentation(SpaceContext* con, Network::IOStrand* o_strand, CoordinateSegmentation* cseg, OSegCache* cache, const String& redis_host, uint32 redis_port, const String& redis_prefix);
+    RedisObjectSegmentation(SpaceContext* con, Network::IOStrand* o_strand, CoordinateSegmentation* cseg, OSegCache* cache, const String& redis_host, uint32 redis_port, const String& redis_prefix, EmbeddedRedisServer* embedded_server = NULL);
     ~RedisObjectSegmentation();
 
     virtual void start();
 
     virtual OSegEntry cacheLookup(const UUID& obj_id);
     virtual OSegEntry lookup(const UUID& obj_id);
+    virtual void lookupBatch(const std::vector<UUID>& obj_ids, std::vector<OSegEntry>* results);
 
     virtual void addNewObject(const UUID& obj_id, float radius);
     virtual void addMigratedObject(const UUID& obj_id, float radius, ServerID idServerAckTo, bool);
@@ -71,10 +74,16 @@ public:
     // then invoke these to complete operations.
     void finishReadObject(const UUID& obj_id, const String& data_str);
     void failReadObject(const UUID& obj_id);
+    void missingReadObject(const UUID& obj_id);
     void finishWriteNewObject(const UUID& obj_id);
     void finishWriteMigratedObject(const UUID& obj_id, ServerID ackTo);
 
 private:
+    // Checks the local map and the cache. Returns true if a request needs to
+    // be sent to redis, otherwise result holds the answer (null if it will
+    // be delivered through the listener).
+    bool startLookup(const UUID& obj_id, OSegEntry* result);
+
     void connect();
     void ensureConnected();
 
@@ -98,6 +107,9 @@ private:
     redisAsyncContext* mRedisContext;
     boost::asio::posix::stream_descriptor* mRedisFD; // Wrapped hiredis file descriptor
     bool mReading, mWriting;
+
+    // Optional in-process server we're talking to, owned by us
+    EmbeddedRedisServer* mEmbeddedServer;
 };
 
 } // namespace Sirikata
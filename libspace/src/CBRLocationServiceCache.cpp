@@ -30,32 +30,83 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "CBRLocationServiceCache.hpp"
+#include <sirikata/space/CBRLocationServiceCache.hpp>
 
 namespace Sirikata {
 
 typedef Prox::LocationServiceCache<ObjectProxSimulationTraits> LocationServiceCache;
 
-CBRLocationServiceCache::CBRLocationServiceCache(Network::IOStrand* strand, LocationService* locservice, bool replicas)
+CBRLocationServiceCache::CBRLocationServiceCache(Network::IOStrand* strand, LocationService* locservice, bool replicas, bool batch_updates)
  : LocationServiceCache(),
    LocationServiceListener(),
    mStrand(strand),
    mLoc(locservice),
    mListeners(),
    mObjects(),
-   mWithReplicas(replicas)
+   mWithReplicas(replicas),
+   mPaused(false),
+   mBatchUpdates(batch_updates),
+   mBatchFlushScheduled(false)
 {
-    assert(mLoc != NULL);
-    mLoc->addListener(this, true);
+    if (mLoc != NULL)
+        mLoc->addListener(this, true);
 }
 
 CBRLocationServiceCache::~CBRLocationServiceCache() {
-    mLoc->removeListener(this);
-    mLoc = NULL;
+    if (mLoc != NULL)
+        detach();
     mListeners.clear();
     mObjects.clear();
 }
 
+void CBRLocationServiceCache::detach() {
+    assert(mLoc != NULL);
+    mLoc->removeListener(this);
+    mLoc = NULL;
+}
+
+void CBRLocationServiceCache::pause() {
+    Lock lck(mMutex);
+    mPaused = true;
+}
+
+void CBRLocationServiceCache::resume() {
+    Lock lck(mMutex);
+
+    mPaused = false;
+    DeferredUpdateList deferred;
+    deferred.swap(mDeferred);
+    for(DeferredUpdateList::iterator it = deferred.begin(); it != deferred.end(); it++)
+        (*it)();
+}
+
+void CBRLocationServiceCache::copyFrom(CBRLocationServiceCache* other) {
+    Lock lck(mMutex);
+    Lock other_lck(other->mMutex);
+
+    for(ObjectDataMap::const_iterator it = other->mObjects.begin(); it != other->mObjects.end(); it++) {
+        // Objects only kept around because they are still tracked are already
+        // gone as far as a new user of the cache is concerned.
+        if (!it->second.exists) continue;
+        if (mObjects.find(it->first) != mObjects.end()) continue;
+
+        ObjectData data = it->second;
+        data.tracking = 0;
+        mObjects[it->first] = data;
+    }
+}
+
+void CBRLocationServiceCache::announceObjects() {
+    Lock lck(mMutex);
+
+    for(ObjectDataMap::const_iterator it = mObjects.begin(); it != mObjects.end(); it++) {
+        const ObjectData& data = it->second;
+        if (!data.exists || data.aggregate) continue;
+        for(ListenerSet::iterator listen_it = mListeners.begin(); listen_it != mListeners.end(); listen_it++)
+            (*listen_it)->locationConnected(it->first, data.isLocal, data.location, data.region, data.maxSize);
+    }
+}
+
 LocationServiceCache::Iterator CBRLocationServiceCache::startTracking(const UUID& id) {
     Lock lck(mMutex);
 
@@ -251,6 +302,19 @@ void CBRLocationServiceCache::replicaPhysicsUpdated(const UUID& uuid, const Stri
 
 
 void CBRLocationServiceCache::objectAdded(const UUID& uuid, bool islocal, bool agg, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& phy) {
+    if (mBatchUpdates) {
+        boost::lock_guard<boost::mutex> lck(mBatchMutex);
+        BatchedUpdate& upd = batchedEvent(uuid, BatchedUpdate::Added, agg);
+        upd.isLocal = islocal;
+        upd.location = loc;
+        upd.orientation = orient;
+        upd.bounds = bounds;
+        upd.mesh = mesh;
+        upd.physics = phy;
+        scheduleBatchFlush();
+        return;
+    }
+
     mStrand->post(
         std::tr1::bind(
             &CBRLocationServiceCache::processObjectAdded, this,
@@ -262,6 +326,16 @@ void CBRLocationServiceCache::objectAdded(const UUID& uuid, bool islocal, bool a
 void CBRLocationServiceCache::processObjectAdded(const UUID& uuid, bool islocal, bool agg, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& phy) {
     Lock lck(mMutex);
 
+    if (mPaused) {
+        mDeferred.push_back(
+            std::tr1::bind(
+                &CBRLocationServiceCache::processObjectAdded, this,
+                uuid, islocal, agg, loc, orient, bounds, mesh, phy
+            )
+        );
+        return;
+    }
+
     if (mObjects.find(uuid) != mObjects.end())
         return;
 
@@ -274,6 +348,7 @@ void CBRLocationServiceCache::processObjectAdded(const UUID& uuid, bool islocal,
     data.mesh = mesh;
     data.physics = phy;
     data.isLocal = islocal;
+    data.aggregate = agg;
     data.exists = true;
     data.tracking = 0;
     mObjects[uuid] = data;
@@ -284,6 +359,21 @@ void CBRLocationServiceCache::processObjectAdded(const UUID& uuid, bool islocal,
 }
 
 void CBRLocationServiceCache::objectRemoved(const UUID& uuid, bool agg) {
+    if (mBatchUpdates) {
+        boost::lock_guard<boost::mutex> lck(mBatchMutex);
+        // Field updates still pending for the object would only be applied
+        // just before it disappears, so drop them.
+        BatchIndexMap::iterator it = mBatchIndex.find(uuid);
+        if (it != mBatchIndex.end()) {
+            BatchedUpdate& pending = mBatch[it->second];
+            pending.hasLocation = pending.hasOrientation = pending.hasBounds = false;
+            pending.hasMesh = pending.hasPhysics = false;
+        }
+        batchedEvent(uuid, BatchedUpdate::Removed, agg);
+        scheduleBatchFlush();
+        return;
+    }
+
     mStrand->post(
         std::tr1::bind(
             &CBRLocationServiceCache::processObjectRemoved, this,
@@ -295,6 +385,16 @@ void CBRLocationServiceCache::objectRemoved(const UUID& uuid, bool agg) {
 void CBRLocationServiceCache::processObjectRemoved(const UUID& uuid, bool agg) {
     Lock lck(mMutex);
 
+    if (mPaused) {
+        mDeferred.push_back(
+            std::tr1::bind(
+                &CBRLocationServiceCache::processObjectRemoved, this,
+                uuid, agg
+            )
+        );
+        return;
+    }
+
     ObjectDataMap::iterator data_it = mObjects.find(uuid);
     if (data_it == mObjects.end()) return;
 
@@ -309,6 +409,15 @@ void CBRLocationServiceCache::processObjectRemoved(const UUID& uuid, bool agg) {
 }
 
 void CBRLocationServiceCache::locationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval) {
+    if (mBatchUpdates) {
+        boost::lock_guard<boost::mutex> lck(mBatchMutex);
+        BatchedUpdate& upd = batchedUpdate(uuid, agg);
+        upd.hasLocation = true;
+        upd.location = newval;
+        scheduleBatchFlush();
+        return;
+    }
+
     mStrand->post(
         std::tr1::bind(
             &CBRLocationServiceCache::processLocationUpdated, this,
@@ -320,6 +429,16 @@ void CBRLocationServiceCache::locationUpdated(const UUID& uuid, bool agg, const
 void CBRLocationServiceCache::processLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval) {
     Lock lck(mMutex);
 
+    if (mPaused) {
+        mDeferred.push_back(
+            std::tr1::bind(
+                &CBRLocationServiceCache::processLocationUpdated, this,
+                uuid, agg, newval
+            )
+        );
+        return;
+    }
+
     ObjectDataMap::iterator it = mObjects.find(uuid);
     if (it == mObjects.end()) return;
 
@@ -332,6 +451,15 @@ void CBRLocationServiceCache::processLocationUpdated(const UUID& uuid, bool agg,
 }
 
 void CBRLocationServiceCache::orientationUpdated(const UUID& uuid, bool agg, const TimedMotionQuaternion& newval) {
+    if (mBatchUpdates) {
+        boost::lock_guard<boost::mutex> lck(mBatchMutex);
+        BatchedUpdate& upd = batchedUpdate(uuid, agg);
+        upd.hasOrientation = true;
+        upd.orientation = newval;
+        scheduleBatchFlush();
+        return;
+    }
+
     mStrand->post(
         std::tr1::bind(
             &CBRLocationServiceCache::processOrientationUpdated, this,
@@ -343,6 +471,16 @@ void CBRLocationServiceCache::orientationUpdated(const UUID& uuid, bool agg, con
 void CBRLocationServiceCache::processOrientationUpdated(const UUID& uuid, bool agg, const TimedMotionQuaternion& newval) {
     Lock lck(mMutex);
 
+    if (mPaused) {
+        mDeferred.push_back(
+            std::tr1::bind(
+                &CBRLocationServiceCache::processOrientationUpdated, this,
+                uuid, agg, newval
+            )
+        );
+        return;
+    }
+
     ObjectDataMap::iterator it = mObjects.find(uuid);
     if (it == mObjects.end()) return;
 
@@ -351,6 +489,15 @@ void CBRLocationServiceCache::processOrientationUpdated(const UUID& uuid, bool a
 }
 
 void CBRLocationServiceCache::boundsUpdated(const UUID& uuid, bool agg, const BoundingSphere3f& newval) {
+    if (mBatchUpdates) {
+        boost::lock_guard<boost::mutex> lck(mBatchMutex);
+        BatchedUpdate& upd = batchedUpdate(uuid, agg);
+        upd.hasBounds = true;
+        upd.bounds = newval;
+        scheduleBatchFlush();
+        return;
+    }
+
     mStrand->post(
         std::tr1::bind(
             &CBRLocationServiceCache::processBoundsUpdated, this,
@@ -362,6 +509,16 @@ void CBRLocationServiceCache::boundsUpdated(const UUID& uuid, bool agg, const Bo
 void CBRLocationServiceCache::processBoundsUpdated(const UUID& uuid, bool agg, const BoundingSphere3f& newval) {
     Lock lck(mMutex);
 
+    if (mPaused) {
+        mDeferred.push_back(
+            std::tr1::bind(
+                &CBRLocationServiceCache::processBoundsUpdated, this,
+                uuid, agg, newval
+            )
+        );
+        return;
+    }
+
     ObjectDataMap::iterator it = mObjects.find(uuid);
     if (it == mObjects.end()) return;
 
@@ -382,6 +539,15 @@ void CBRLocationServiceCache::processBoundsUpdated(const UUID& uuid, bool agg, c
 }
 
 void CBRLocationServiceCache::meshUpdated(const UUID& uuid, bool agg, const String& newval) {
+    if (mBatchUpdates) {
+        boost::lock_guard<boost::mutex> lck(mBatchMutex);
+        BatchedUpdate& upd = batchedUpdate(uuid, agg);
+        upd.hasMesh = true;
+        upd.mesh = newval;
+        scheduleBatchFlush();
+        return;
+    }
+
     mStrand->post(
         std::tr1::bind(
             &CBRLocationServiceCache::processMeshUpdated, this,
@@ -393,6 +559,16 @@ void CBRLocationServiceCache::meshUpdated(const UUID& uuid, bool agg, const Stri
 void CBRLocationServiceCache::processMeshUpdated(const UUID& uuid, bool agg, const String& newval) {
     Lock lck(mMutex);
 
+    if (mPaused) {
+        mDeferred.push_back(
+            std::tr1::bind(
+                &CBRLocationServiceCache::processMeshUpdated, this,
+                uuid, agg, newval
+            )
+        );
+        return;
+    }
+
     ObjectDataMap::iterator it = mObjects.find(uuid);
     if (it == mObjects.end()) return;
     String oldval = it->second.mesh;
@@ -400,6 +576,15 @@ void CBRLocationServiceCache::processMeshUpdated(const UUID& uuid, bool agg, con
 }
 
 void CBRLocationServiceCache::physicsUpdated(const UUID& uuid, bool agg, const String& newval) {
+    if (mBatchUpdates) {
+        boost::lock_guard<boost::mutex> lck(mBatchMutex);
+        BatchedUpdate& upd = batchedUpdate(uuid, agg);
+        upd.hasPhysics = true;
+        upd.physics = newval;
+        scheduleBatchFlush();
+        return;
+    }
+
     mStrand->post(
         std::tr1::bind(
             &CBRLocationServiceCache::processPhysicsUpdated, this,
@@ -411,12 +596,93 @@ void CBRLocationServiceCache::physicsUpdated(const UUID& uuid, bool agg, const S
 void CBRLocationServiceCache::processPhysicsUpdated(const UUID& uuid, bool agg, const String& newval) {
     Lock lck(mMutex);
 
+    if (mPaused) {
+        mDeferred.push_back(
+            std::tr1::bind(
+                &CBRLocationServiceCache::processPhysicsUpdated, this,
+                uuid, agg, newval
+            )
+        );
+        return;
+    }
+
     ObjectDataMap::iterator it = mObjects.find(uuid);
     if (it == mObjects.end()) return;
     String oldval = it->second.physics;
     it->second.physics = newval;
 }
 
+CBRLocationServiceCache::BatchedUpdate& CBRLocationServiceCache::batchedUpdate(const UUID& uuid, bool agg) {
+    BatchIndexMap::iterator it = mBatchIndex.find(uuid);
+    if (it != mBatchIndex.end())
+        return mBatch[it->second];
+
+    mBatchIndex[uuid] = mBatch.size();
+    mBatch.push_back(BatchedUpdate());
+    BatchedUpdate& upd = mBatch.back();
+    upd.uuid = uuid;
+    upd.agg = agg;
+    return upd;
+}
+
+CBRLocationServiceCache::BatchedUpdate& CBRLocationServiceCache::batchedEvent(const UUID& uuid, BatchedUpdate::Type type, bool agg) {
+    // Anything after this must come after it, so the previous record can't
+    // absorb further updates.
+    mBatchIndex.erase(uuid);
+
+    mBatch.push_back(BatchedUpdate());
+    BatchedUpdate& upd = mBatch.back();
+    upd.type = type;
+    upd.uuid = uuid;
+    upd.agg = agg;
+    return upd;
+}
+
+void CBRLocationServiceCache::scheduleBatchFlush() {
+    if (mBatchFlushScheduled) return;
+    mBatchFlushScheduled = true;
+    mStrand->post(
+        std::tr1::bind(&CBRLocationServiceCache::flushBatchedUpdates, this)
+    );
+}
+
+void CBRLocationServiceCache::flushBatchedUpdates() {
+    // Grab everything queued so far. Anything arriving after this will
+    // schedule another flush.
+    {
+        boost::lock_guard<boost::mutex> lck(mBatchMutex);
+        mBatchProcessing.swap(mBatch);
+        mBatchIndex.clear();
+        mBatchFlushScheduled = false;
+    }
+
+    Lock lck(mMutex);
+    for(BatchedUpdateList::iterator it = mBatchProcessing.begin(); it != mBatchProcessing.end(); it++) {
+        switch(it->type) {
+          case BatchedUpdate::Added:
+            processObjectAdded(it->uuid, it->isLocal, it->agg, it->location, it->orientation, it->bounds, it->mesh, it->physics);
+            break;
+          case BatchedUpdate::Removed:
+            processObjectRemoved(it->uuid, it->agg);
+            break;
+          case BatchedUpdate::Updated:
+            if (it->hasLocation)
+                processLocationUpdated(it->uuid, it->agg, it->location);
+            if (it->hasOrientation)
+                processOrientationUpdated(it->uuid, it->agg, it->orientation);
+            if (it->hasBounds)
+                processBoundsUpdated(it->uuid, it->agg, it->bounds);
+            if (it->hasMesh)
+                processMeshUpdated(it->uuid, it->agg, it->mesh);
+            if (it->hasPhysics)
+                processPhysicsUpdated(it->uuid, it->agg, it->physics);
+            break;
+        }
+    }
+    // Keep the capacity around for the next swap
+    mBatchProcessing.clear();
+}
+
 bool CBRLocationServiceCache::tryRemoveObject(ObjectDataMap::iterator& obj_it) {
     if (obj_it->second.tracking > 0  || obj_it->second.exists)
         return false;
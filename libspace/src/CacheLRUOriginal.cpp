@@ -31,7 +31,7 @@
  */
 
 
-#include "CacheLRUOriginal.hpp"
+#include <sirikata/space/CacheLRUOriginal.hpp>
 #include <algorithm>
 #include <map>
 #include <list>
@@ -46,8 +46,9 @@
 namespace Sirikata
 {
 
-  CacheLRUOriginal::CacheLRUOriginal(Context* ctx, uint32 maxSize,uint32 cleanGroupSize,Duration entryLifetime)
-    : mContext(ctx),
+  CacheLRUOriginal::CacheLRUOriginal(Context* ctx, uint32 maxSize,uint32 cleanGroupSize,Duration entryLifetime,Duration negativeLifetime)
+    : OSegCache(ctx, negativeLifetime),
+      mContext(ctx),
       mMaxCacheSize(maxSize),
       mCleanGroupSize(cleanGroupSize),
       mEntryLifetime(entryLifetime)
@@ -189,7 +190,7 @@ namespace Sirikata
   }
 
 
-  const OSegEntry& CacheLRUOriginal::get(const UUID& uuid)
+  OSegEntry CacheLRUOriginal::get(const UUID& uuid)
   {
       boost::lock_guard<boost::mutex> lck(mMutex);
 
@@ -0,0 +1,132 @@
+/*  Sirikata
+ *  OSegCache.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sirikata/space/OSegCache.hpp>
+
+namespace Sirikata {
+
+const Duration OSegCache::InFlightTimeout = Duration::seconds(5);
+
+OSegCache::OSegCache(Context* ctx, const Duration& negative_lifetime)
+ : mCacheContext(ctx),
+   mNegativeLifetime(negative_lifetime),
+   mNegativeSweepSize(1024),
+   mHits(0)
+{
+}
+
+OSegEntry OSegCache::lookup(const UUID& uuid, bool* negative) {
+    if (negative != NULL) *negative = false;
+
+    OSegEntry result = get(uuid);
+    if (result.notNull()) {
+        ++mHits;
+        return result;
+    }
+
+    boost::lock_guard<boost::mutex> lck(mMutex);
+
+    TimeMap::iterator it = mNegative.find(uuid);
+    if (it != mNegative.end()) {
+        if (now() < it->second) {
+            mStats.negativeHits++;
+            if (negative != NULL) *negative = true;
+            return result;
+        }
+        mNegative.erase(it);
+    }
+
+    mStats.misses++;
+    return result;
+}
+
+void OSegCache::insertNegative(const UUID& uuid) {
+    if (mNegativeLifetime == Duration::zero()) return;
+
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    Time curtime = now();
+    mNegative[uuid] = curtime + mNegativeLifetime;
+    if (mNegative.size() >= mNegativeSweepSize)
+        sweepNegative(curtime);
+}
+
+void OSegCache::removeNegative(const UUID& uuid) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    mNegative.erase(uuid);
+}
+
+void OSegCache::sweepNegative(const Time& curtime) {
+    for(TimeMap::iterator it = mNegative.begin(); it != mNegative.end(); ) {
+        if (it->second <= curtime)
+            mNegative.erase(it++);
+        else
+            it++;
+    }
+    // Entries are short lived, so only sweep again once we've grown
+    // substantially past what is still live.
+    mNegativeSweepSize = std::max((size_t)1024, mNegative.size() * 2);
+}
+
+bool OSegCache::beginLookup(const UUID& uuid) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    Time curtime = now();
+    TimeMap::iterator it = mInFlight.find(uuid);
+    if (it != mInFlight.end() && curtime - it->second < InFlightTimeout) {
+        mStats.coalesced++;
+        return false;
+    }
+    mInFlight[uuid] = curtime;
+    return true;
+}
+
+void OSegCache::finishLookup(const UUID& uuid) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    mInFlight.erase(uuid);
+}
+
+Time OSegCache::now() const {
+    return mCacheContext->recentSimTime();
+}
+
+size_t OSegCache::negativeSize() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    return mNegative.size();
+}
+
+OSegCache::Stats OSegCache::stats() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    Stats result = mStats;
+    result.hits = mHits.read();
+    return result;
+}
+
+} // namespace Sirikata
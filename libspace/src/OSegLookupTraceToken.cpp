@@ -66,6 +66,7 @@ OSegLookupTraceToken::OSegLookupTraceToken(bool loggingOn)
 
     osegQLenPostReturn                  = 1000;
     osegQLenPostQuery                   = 1000;
+    batchSize                           = 1;
 
     mLoggingOn = loggingOn;
 }
@@ -100,6 +101,7 @@ OSegLookupTraceToken::OSegLookupTraceToken(const UUID& uID, bool loggingOn)
 
     osegQLenPostReturn                  = 1000;
     osegQLenPostQuery                   = 1000;
+    batchSize                           = 1;
 
     mLoggingOn = loggingOn;
   }
@@ -207,6 +209,7 @@ void OSegLookupTraceToken::stamp(OSegTraceStage osts)
     std::cout<<"lookupReturnEnd:\t\t"<<lookupReturnEnd<<"\n";
     std::cout<<"osegQLenPostReturn:\t\t"<<osegQLenPostReturn<<"\n";
     std::cout<<"osegQLenPostQuery:\t\t"<<osegQLenPostQuery<<"\n";
+    std::cout<<"batchSize:\t\t"<<batchSize<<"\n";
     std::cout<<"\n\n";
   }
 
@@ -76,6 +76,13 @@ ObjectSegmentation::~ObjectSegmentation() {
     delete mOSegServerMessageService;
 }
 
+void ObjectSegmentation::lookupBatch(const std::vector<UUID>& obj_ids, std::vector<OSegEntry>* results) {
+    results->clear();
+    results->reserve(obj_ids.size());
+    for(std::vector<UUID>::const_iterator it = obj_ids.begin(); it != obj_ids.end(); it++)
+        results->push_back( lookup(*it) );
+}
+
 void ObjectSegmentation::receiveMessage(Message* msg)
 {
     if (msg->dest_port() == SERVER_PORT_OSEG_MIGRATE_ACKNOWLEDGE) {
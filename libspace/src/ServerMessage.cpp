@@ -34,6 +34,29 @@
 
 namespace Sirikata {
 
+namespace {
+// Wire tag for ServerMessage.payload: field 7, length delimited. Must match
+// ServerMessage.pbj.
+const uint8 PayloadFieldTag = (7 << 3) | 2;
+
+uint32 varintSize(uint64 val) {
+    uint32 result = 1;
+    while(val >= 0x80) {
+        val >>= 7;
+        result++;
+    }
+    return result;
+}
+
+void appendVarint(std::string* output, uint64 val) {
+    while(val >= 0x80) {
+        output->push_back( (char)((val & 0x7F) | 0x80) );
+        val >>= 7;
+    }
+    output->push_back( (char)val );
+}
+}
+
 
 void Message::fillMessage(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port) {
     set_source_server(src);
@@ -71,10 +94,19 @@ Message::Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port,
     fillMessage(src, src_port, dest, dest_port, pl);
 }
 
+Message::Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const Network::SharedBuffer& pl)
+ : mCachedSize(0)
+{
+    fillMessage(src, src_port, dest, dest_port);
+    set_payload(pl);
+}
+
 Message::Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const Sirikata::Protocol::Object::ObjectMessage* pl)
  : mCachedSize(0)
 {
-    fillMessage(src, src_port, dest, dest_port, serializePBJMessage(*pl));
+    fillMessage(src, src_port, dest, dest_port);
+    std::string serialized = serializePBJMessage(*pl);
+    set_payload(Network::SharedBuffer::take(&serialized));
     set_payload_id(pl->unique());
 }
 
@@ -83,13 +115,58 @@ void Message::set_source_server(const ServerID sid) {
     set_id( GenerateUniqueID(sid) );
 }
 
+bool Message::ParseFromString(const std::string& data) {
+    if (!mImpl.ParseFromString(data))
+        return false;
+    extractPayload();
+    return true;
+}
+
+bool Message::ParseFromArray(const void* data, int size) {
+    if (!mImpl.ParseFromArray(data, size))
+        return false;
+    extractPayload();
+    return true;
+}
+
+void Message::extractPayload() {
+    if (mImpl.has_payload()) {
+        mPayload = Network::SharedBuffer(mImpl.payload());
+        mImpl.clear_payload();
+    }
+    else {
+        mPayload = Network::SharedBuffer();
+    }
+    mCachedSize = 0;
+}
+
+uint32 Message::payloadFieldSize() const {
+    if (mPayload.empty())
+        return 0;
+    return 1 + varintSize(mPayload.size()) + mPayload.size();
+}
+
+bool Message::serializeHeader(std::string* result) const {
+    // Since the payload is the last field, the header is just the rest of
+    // the fields followed by the payload's tag and length
+    bool success = serializePBJMessage(result, mImpl);
+    if (!success) return false;
+    if (!mPayload.empty()) {
+        result->push_back( (char)PayloadFieldTag );
+        appendVarint(result, mPayload.size());
+    }
+    return true;
+}
+
 bool Message::serialize(Network::Chunk* output) const {
-    // FIXME having to copy here sucks
-    std::string result;
-    bool success = serializePBJMessage(&result, mImpl);
+    std::string header;
+    bool success = serializeHeader(&header);
     if (!success) return false;
-    output->resize( result.size() );
-    memcpy(&((*output)[0]), &(result[0]), sizeof(uint8)*result.size());
+    output->resize( header.size() + mPayload.size() );
+    if (!header.empty())
+        memcpy(&((*output)[0]), header.data(), header.size());
+    if (!mPayload.empty())
+        memcpy(&((*output)[header.size()]), mPayload.data(), mPayload.size());
     return true;
 }
 static char toHex(unsigned char u) {
@@ -123,7 +200,7 @@ uint32 Message::serializedSize() const {
     if (mCachedSize != 0)
         return mCachedSize;
 
-    return (mCachedSize = mImpl.ByteSize());
+    return (mCachedSize = mImpl.ByteSize() + payloadFieldSize());
 }
 
 
@@ -0,0 +1,304 @@
+/*  Sirikata
+ *  ShardedClockProCache.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sirikata/space/ShardedClockProCache.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+
+namespace Sirikata
+{
+
+/** A single CLOCK-Pro managed shard.  All pages, resident or not, live on one
+ *  circular list swept by three hands:
+ *   - the cold hand promotes referenced cold pages to hot and turns
+ *     unreferenced ones into non-resident test pages,
+ *   - the hot hand clears reference bits and demotes unreferenced hot pages,
+ *   - the test hand drops test pages which were never re-referenced.
+ *  A miss on a test page means it was evicted too early, so the space for
+ *  cold pages grows; a test page expiring means it shrinks.
+ */
+class ShardedClockProCache::Shard {
+public:
+    Shard(uint32 capacity)
+     : mHandHot(NULL),
+       mHandCold(NULL),
+       mHandTest(NULL),
+       mCapacity(std::max(capacity, (uint32)1)),
+       mColdTarget(mCapacity),
+       mHotCount(0),
+       mColdCount(0),
+       mTestCount(0)
+    {}
+
+    ~Shard() {
+        for(PageMap::iterator it = mPages.begin(); it != mPages.end(); it++)
+            delete it->second;
+    }
+
+    bool get(const UUID& uuid, const Time& now, const Duration& lifetime, OSegEntry* result) {
+        boost::lock_guard<boost::mutex> lck(mMutex);
+
+        PageMap::iterator it = mPages.find(uuid);
+        if (it == mPages.end() || it->second->type == Test)
+            return false;
+
+        Page* page = it->second;
+        if (now - page->inserted > lifetime) {
+            // Stale, let the clock reclaim it
+            page->referenced = false;
+            return false;
+        }
+
+        page->referenced = true;
+        *result = page->entry;
+        return true;
+    }
+
+    void insert(const UUID& uuid, const OSegEntry& entry, const Time& now) {
+        boost::lock_guard<boost::mutex> lck(mMutex);
+
+        PageMap::iterator it = mPages.find(uuid);
+        if (it == mPages.end()) {
+            add(uuid, entry, now, Cold);
+            return;
+        }
+
+        Page* page = it->second;
+        if (page->type != Test) {
+            page->entry = entry;
+            page->inserted = now;
+            page->referenced = true;
+            return;
+        }
+
+        // Re-referenced during its test period, so cold pages aren't being
+        // kept long enough.
+        if (mColdTarget < mCapacity)
+            mColdTarget++;
+        mTestCount--;
+        erase(page);
+        add(uuid, entry, now, Hot);
+    }
+
+    void remove(const UUID& uuid) {
+        boost::lock_guard<boost::mutex> lck(mMutex);
+
+        PageMap::iterator it = mPages.find(uuid);
+        if (it == mPages.end()) return;
+
+        Page* page = it->second;
+        switch(page->type) {
+          case Hot: mHotCount--; break;
+          case Cold: mColdCount--; break;
+          case Test: mTestCount--; break;
+        }
+        erase(page);
+    }
+
+private:
+    enum PageType {
+        Hot,
+        Cold,
+        Test
+    };
+
+    struct Page {
+        UUID id;
+        OSegEntry entry;
+        Time inserted;
+        PageType type;
+        bool referenced;
+        Page* prev;
+        Page* next;
+    };
+    typedef std::tr1::unordered_map<UUID, Page*, UUID::Hasher> PageMap;
+
+    // Makes room for and adds a new resident page at the head of the list,
+    // just behind the hot hand.
+    void add(const UUID& uuid, const OSegEntry& entry, const Time& now, PageType type) {
+        while(mHotCount + mColdCount >= mCapacity)
+            runHandCold();
+
+        Page* page = new Page;
+        page->id = uuid;
+        page->entry = entry;
+        page->inserted = now;
+        page->type = type;
+        page->referenced = false;
+
+        if (mHandHot == NULL) {
+            page->prev = page->next = page;
+            mHandHot = mHandCold = mHandTest = page;
+        }
+        else {
+            page->next = mHandHot;
+            page->prev = mHandHot->prev;
+            mHandHot->prev->next = page;
+            mHandHot->prev = page;
+        }
+        mPages[uuid] = page;
+
+        if (type == Hot)
+            mHotCount++;
+        else
+            mColdCount++;
+    }
+
+    // Unlinks and frees a page, backing up any hand pointing at it. The
+    // caller is responsible for the counts.
+    void erase(Page* page) {
+        if (page->next == page) {
+            mHandHot = mHandCold = mHandTest = NULL;
+        }
+        else {
+            if (mHandHot == page) mHandHot = page->prev;
+            if (mHandCold == page) mHandCold = page->prev;
+            if (mHandTest == page) mHandTest = page->prev;
+            page->prev->next = page->next;
+            page->next->prev = page->prev;
+        }
+        mPages.erase(page->id);
+        delete page;
+    }
+
+    // The hands never call back into each other; the cold hand drives the
+    // other two only when their limits are exceeded.
+    void runHandCold() {
+        Page* page = mHandCold;
+        if (page->type == Cold) {
+            mColdCount--;
+            if (page->referenced) {
+                page->type = Hot;
+                page->referenced = false;
+                mHotCount++;
+            }
+            else {
+                page->type = Test;
+                page->entry = OSegEntry::null();
+                mTestCount++;
+            }
+        }
+        mHandCold = mHandCold->next;
+
+        while(mTestCount > mCapacity)
+            runHandTest();
+        while(mCapacity - mColdTarget < mHotCount)
+            runHandHot();
+    }
+
+    void runHandHot() {
+        Page* page = mHandHot;
+        if (page->type == Hot) {
+            if (page->referenced) {
+                page->referenced = false;
+            }
+            else {
+                page->type = Cold;
+                mHotCount--;
+                mColdCount++;
+            }
+        }
+        else if (page->type == Test) {
+            // Passing the hot hand ends a page's test period
+            expire(page);
+        }
+        mHandHot = mHandHot->next;
+    }
+
+    // Advances until one test page has been dropped
+    void runHandTest() {
+        while(true) {
+            Page* page = mHandTest;
+            bool test = (page->type == Test);
+            if (test)
+                expire(page);
+            mHandTest = mHandTest->next;
+            if (test) return;
+        }
+    }
+
+    void expire(Page* page) {
+        mTestCount--;
+        erase(page);
+        if (mColdTarget > 1)
+            mColdTarget--;
+    }
+
+    boost::mutex mMutex;
+    PageMap mPages;
+
+    Page* mHandHot;
+    Page* mHandCold;
+    Page* mHandTest;
+
+    uint32 mCapacity; // Maximum number of resident pages
+    uint32 mColdTarget; // Resident pages reserved for cold pages
+    uint32 mHotCount;
+    uint32 mColdCount;
+    uint32 mTestCount;
+};
+
+
+ShardedClockProCache::ShardedClockProCache(Context* ctx, uint32 maxSize, uint32 numShards, Duration entryLifetime, Duration negativeLifetime)
+ : OSegCache(ctx, negativeLifetime),
+   mEntryLifetime(entryLifetime)
+{
+    numShards = std::max(numShards, (uint32)1);
+    uint32 shardSize = (maxSize + numShards - 1) / numShards;
+    for(uint32 i = 0; i < numShards; i++)
+        mShards.push_back(new Shard(shardSize));
+}
+
+ShardedClockProCache::~ShardedClockProCache() {
+    for(uint32 i = 0; i < mShards.size(); i++)
+        delete mShards[i];
+}
+
+ShardedClockProCache::Shard* ShardedClockProCache::shard(const UUID& uuid) {
+    return mShards[uuid.hash() % mShards.size()];
+}
+
+void ShardedClockProCache::insert(const UUID& uuid, const OSegEntry& sID) {
+    shard(uuid)->insert(uuid, sID, now());
+}
+
+OSegEntry ShardedClockProCache::get(const UUID& uuid) {
+    OSegEntry result(OSegEntry::null());
+    shard(uuid)->get(uuid, now(), mEntryLifetime, &result);
+    return result;
+}
+
+void ShardedClockProCache::remove(const UUID& uuid) {
+    shard(uuid)->remove(uuid);
+}
+
+} // namespace Sirikata
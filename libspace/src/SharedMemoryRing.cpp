@@ -0,0 +1,207 @@
+/*  Sirikata
+ *  SharedMemoryRing.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sirikata/space/SharedMemoryRing.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace Sirikata {
+
+namespace bip = boost::interprocess;
+
+struct SharedMemoryRing::Header {
+    // Total bytes ever written, only modified by the sender
+    volatile uint64 head;
+    uint8 headPadding[64 - sizeof(uint64)];
+    // Total bytes ever consumed, only modified by the receiver
+    volatile uint64 tail;
+    uint8 tailPadding[64 - sizeof(uint64)];
+};
+
+namespace {
+// Ring records are a 32 bit length followed by the message, padded to keep
+// lengths aligned. A WRAP_MARKER length means the rest of the buffer is unused
+// and the next record is at the start.
+const uint32 WRAP_MARKER = 0xFFFFFFFF;
+const uint32 RECORD_ALIGNMENT = 8;
+}
+
+
+SharedMemorySegment::SharedMemorySegment(const String& name, OpenMode mode, size_t size, bool remove_on_destroy)
+ : mName(name),
+   mOwner(remove_on_destroy),
+   mRegion(NULL)
+{
+    if (mode == OpenExisting) {
+        bip::shared_memory_object shm(bip::open_only, name.c_str(), bip::read_write);
+        mRegion = new bip::mapped_region(shm, bip::read_write);
+        return;
+    }
+
+    if (mode == CreateNew)
+        bip::shared_memory_object::remove(name.c_str());
+    bip::shared_memory_object shm(bip::open_or_create, name.c_str(), bip::read_write);
+    bip::offset_t cur_size = 0;
+    if (!shm.get_size(cur_size) || cur_size < (bip::offset_t)size)
+        shm.truncate(size);
+    mRegion = new bip::mapped_region(shm, bip::read_write);
+}
+
+SharedMemorySegment::~SharedMemorySegment() {
+    delete mRegion;
+    if (mOwner)
+        bip::shared_memory_object::remove(mName.c_str());
+}
+
+uint8* SharedMemorySegment::data() const {
+    return (uint8*)mRegion->get_address();
+}
+
+size_t SharedMemorySegment::size() const {
+    return mRegion->get_size();
+}
+
+
+SharedMemoryRing::SharedMemoryRing(SharedMemorySegment* seg)
+ : mSegment(seg),
+   mHeader((Header*)seg->data()),
+   mData(seg->data() + sizeof(Header)),
+   mCapacity(0)
+{
+    // Senders always create power of two rings, but round down in case the
+    // mapping was padded
+    size_t avail = seg->size() - sizeof(Header);
+    mCapacity = 1;
+    while(mCapacity * 2 <= avail) mCapacity *= 2;
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+    delete mSegment;
+}
+
+size_t SharedMemoryRing::segmentSize(size_t capacity) {
+    return sizeof(Header) + capacity;
+}
+
+size_t SharedMemoryRing::recordSize(size_t msg_size) {
+    return (sizeof(uint32) + msg_size + RECORD_ALIGNMENT - 1) & ~(size_t)(RECORD_ALIGNMENT - 1);
+}
+
+bool SharedMemoryRing::hasSpaceFor(size_t msg_size) const {
+    uint64 head = mHeader->head;
+    uint64 tail = mHeader->tail;
+    uint64 rec = recordSize(msg_size);
+    uint64 to_end = mCapacity - (head & (mCapacity - 1));
+    uint64 pad = (rec > to_end) ? to_end : 0;
+    return (pad + rec) <= mCapacity - (head - tail);
+}
+
+bool SharedMemoryRing::write(MemoryReference first, MemoryReference second) {
+    size_t msg_size = first.size() + second.size();
+    uint64 rec = recordSize(msg_size);
+    if (rec > maxRecordSize())
+        return false;
+
+    uint64 head = mHeader->head;
+    uint64 tail = mHeader->tail;
+    memory_barrier();
+
+    uint64 offset = head & (mCapacity - 1);
+    uint64 to_end = mCapacity - offset;
+    uint64 pad = (rec > to_end) ? to_end : 0;
+    if (pad + rec > mCapacity - (head - tail))
+        return false;
+
+    if (pad != 0) {
+        *(uint32*)(mData + offset) = WRAP_MARKER;
+        head += pad;
+        offset = 0;
+    }
+
+    *(uint32*)(mData + offset) = (uint32)msg_size;
+    uint8* dest = mData + offset + sizeof(uint32);
+    if (first.size() != 0)
+        memcpy(dest, first.data(), first.size());
+    if (second.size() != 0)
+        memcpy(dest + first.size(), second.data(), second.size());
+
+    // Publish only after the record is completely written
+    memory_barrier();
+    mHeader->head = head + rec;
+    return true;
+}
+
+bool SharedMemoryRing::empty() const {
+    return mHeader->head == mHeader->tail;
+}
+
+Network::Chunk* SharedMemoryRing::read() {
+    uint64 tail = mHeader->tail;
+    uint64 head = mHeader->head;
+    memory_barrier();
+
+    if (head == tail)
+        return NULL;
+
+    uint64 offset = tail & (mCapacity - 1);
+    uint32 msg_size = *(uint32*)(mData + offset);
+    if (msg_size == WRAP_MARKER) {
+        // The writer only publishes a wrap together with the record after it
+        tail += mCapacity - offset;
+        offset = 0;
+        msg_size = *(uint32*)(mData + offset);
+    }
+
+    // The other process can write anything into the segment, so never trust
+    // a length which would take us past what has been published or off the
+    // end of the buffer. There's no way to find the next valid record, so
+    // discard everything that's been written.
+    if (tail > head || msg_size > maxRecordSize() ||
+        recordSize(msg_size) > head - tail ||
+        offset + recordSize(msg_size) > mCapacity)
+    {
+        SILOG(shm, error, "Corrupt record in shared memory ring, discarding " << (head - mHeader->tail) << " bytes");
+        mHeader->tail = head;
+        return NULL;
+    }
+
+    const uint8* src = mData + offset + sizeof(uint32);
+    Network::Chunk* result = new Network::Chunk(src, src + msg_size);
+
+    // Don't release the space until the data has been copied out
+    memory_barrier();
+    mHeader->tail = tail + recordSize(msg_size);
+    return result;
+}
+
+} // namespace Sirikata
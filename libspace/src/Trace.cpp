@@ -116,13 +116,16 @@ CREATE_TRACE_DEF(SpaceTrace, processOSegTrackedSetResults, mLogOSeg, const Time
     mTrace->writeRecord(OSegTrackedSetResultAnalysisTag, rec);
 }
 
-CREATE_TRACE_DEF(SpaceTrace, processOSegShutdownEvents, mLogOSeg, const Time &t, const ServerID& sID, const int& num_lookups, const int& num_on_this_server, const int& num_cache_hits, const int& num_craq_lookups, const int& num_time_elapsed_cache_eviction, const int& num_migration_not_complete_yet)
+CREATE_TRACE_DEF(SpaceTrace, processOSegShutdownEvents, mLogOSeg, const Time &t, const ServerID& sID, const int& num_lookups, const int& num_on_this_server, const int& num_cache_hits, const int& num_craq_lookups, const int& num_time_elapsed_cache_eviction, const int& num_migration_not_complete_yet, uint64 num_cache_misses, uint64 num_negative_cache_hits, uint64 num_coalesced_lookups)
 {
   std::cout<<"\n\n**********oseg shutdown:  \n";
   std::cout<<"\tsid:                              "<<sID<<"\n";
   std::cout<<"\tnum lookups:                      "<<num_lookups<<"\n";
   std::cout<<"\tnum_on_this_server:               "<<num_on_this_server<<"\n";
   std::cout<<"\tnum_cache_hits:                   "<<num_cache_hits<<"\n";
+  std::cout<<"\tnum_cache_misses:                 "<<num_cache_misses<<"\n";
+  std::cout<<"\tnum_negative_cache_hits:          "<<num_negative_cache_hits<<"\n";
+  std::cout<<"\tnum_coalesced_lookups:            "<<num_coalesced_lookups<<"\n";
   std::cout<<"\tnum_craq_lookups:                 "<<num_craq_lookups<<"\n";
   std::cout<<"\tnum_migration_not_complete_yet:   "<< num_migration_not_complete_yet<<"\n\n";
   std::cout<<"***************************\n\n";
@@ -135,6 +138,9 @@ CREATE_TRACE_DEF(SpaceTrace, processOSegShutdownEvents, mLogOSeg, const Time &t,
   rec.set_craq_lookups(num_craq_lookups);
   rec.set_cache_eviction_elapsed(num_time_elapsed_cache_eviction);
   rec.set_outstanding_migrations(num_migration_not_complete_yet);
+  rec.set_cache_misses(num_cache_misses);
+  rec.set_negative_cache_hits(num_negative_cache_hits);
+  rec.set_coalesced_lookups(num_coalesced_lookups);
 
   mTrace->writeRecord(OSegShutdownEventTag, rec);
 }
@@ -153,6 +159,29 @@ CREATE_TRACE_DEF(SpaceTrace, osegCacheResponse, mLogOSeg, const Time &t, const S
 }
 
 
+CREATE_TRACE_DEF(SpaceTrace, osegBatchLookup, mLogOSeg, const Time &t, const ServerID& sID, uint32 batch_size, uint32 immediate)
+{
+    Sirikata::Trace::OSeg::BatchLookup rec;
+    rec.set_t(t);
+    rec.set_server(sID);
+    rec.set_batch_size(batch_size);
+    rec.set_immediate(immediate);
+
+    mTrace->writeRecord(OSegBatchLookupTag, rec);
+}
+
+CREATE_TRACE_DEF(SpaceTrace, osegLookupLatency, mLogOSeg, const Time &t, const ServerID& sID, const UUID& obj_id, const Duration& latency)
+{
+    Sirikata::Trace::OSeg::LookupLatency rec;
+    rec.set_t(t);
+    rec.set_server(sID);
+    rec.set_object(obj_id);
+    rec.set_latency(latency);
+
+    mTrace->writeRecord(OSegLookupLatencyTag, rec);
+}
+
+
 CREATE_TRACE_DEF(SpaceTrace, objectSegmentationLookupNotOnServerRequest, mLogOSeg, const Time& t, const UUID& obj_id, const ServerID &sID_lookerupper)
 {
     Sirikata::Trace::OSeg::InvalidLookup rec;
@@ -200,6 +229,8 @@ CREATE_TRACE_DEF(SpaceTrace, osegCumulativeResponse, mLogOSegCumulative, const T
     rec.set_lookup_return_begin(traceToken->lookupReturnBegin);
     rec.set_lookup_return_end(traceToken->lookupReturnEnd);
 
+    rec.set_batch_size(traceToken->batchSize);
+
     mTrace->writeRecord(OSegCumulativeTraceAnalysisTag, rec);
 }
 
@@ -0,0 +1,152 @@
+#!/usr/bin/python
+
+# oseg_redis.py
+#
+# Runs the OSeg flood scenario with drifting objects against the redis
+# OSeg backed by its embedded, in-process redis server. Each run injects a
+# different amount of latency into the server's replies, and reports the
+# OSeg lookup latency percentiles and migration rate observed by the space
+# servers. No external redis deployment is required.
+#
+# Usage: oseg_redis.py latency1 [latency2 ...]
+# where each latency is a duration, e.g. 0ms 1ms 5ms
+
+import sys
+import subprocess
+import os.path
+
+# FIXME It would be nice to have a better way of making this script able to find
+# other modules in sibling packages
+sys.path.insert(0, sys.path[0]+"/..")
+
+import util.stdio
+from cluster.config import ClusterConfig
+from cluster.sim import ClusterSimSettings,ClusterSim
+from flow_fairness import run_trial
+
+def get_latency_filename(latency):
+    return 'oseg_redis.lookup_latency.' + str(latency)
+
+def get_migration_filename(latency):
+    return 'oseg_redis.migration.' + str(latency)
+
+# Pulls "key: value" style summary lines out of an oseg analysis output file
+def read_summary(filename, keys):
+    results = {}
+    if not os.path.exists(filename): return results
+    for line in open(filename):
+        for key in keys:
+            if line.strip().startswith(key):
+                results[key] = line.split(':')[-1].strip()
+    return results
+
+class OSegRedis:
+    def __init__(self, cc, cs, rate=10, jitter='0ms'):
+        """
+        cc - ClusterConfig
+        cs - ClusterSimSettings
+        rate - pings per second generated by each object
+        jitter - maximum random jitter the embedded server adds to each reply
+        """
+        self.cc = cc
+        self.cs = cs
+        self.rate = rate
+        self.jitter = jitter
+        self._all_latencies = []
+
+    def _setup_cluster_sim(self, latency, io):
+        self.cs.scenario = 'osegflood'
+        self.cs.scenario_options = ' '.join(
+            ['--num-pings-per-second=' + str(self.rate),
+             '--prob-messages-uniform=1.0',
+             '--num-objects-per-server=20',
+             ]
+            )
+
+        self.cs.oseg = 'redis'
+        self.cs.oseg_options = ' '.join(
+            ['--embedded=true',
+             '--embedded-latency=' + str(latency),
+             '--embedded-jitter=' + str(self.jitter),
+             ]
+            )
+        if 'space-redis' not in self.cc.space_plugins.split(','):
+            self.cc.space_plugins += ',space-redis'
+
+        if 'oseg' not in self.cs.traces['space']: self.cs.traces['space'].append('oseg')
+        if 'migration' not in self.cs.traces['space']: self.cs.traces['space'].append('migration')
+
+        cluster_sim = ClusterSim(self.cc, self.cs, io=io)
+        return cluster_sim
+
+    def run(self, latency, io=util.stdio.StdIO()):
+        self._all_latencies.append(latency)
+
+        cluster_sim = self._setup_cluster_sim(latency, io)
+        run_trial(cluster_sim)
+        cluster_sim.oseg_analysis()
+
+        if os.path.exists('oseg_lookup_latency_file.dat'):
+            subprocess.call(['cp', 'oseg_lookup_latency_file.dat', get_latency_filename(latency)])
+        if os.path.exists('oseg_migration_round_trip_times_file.dat'):
+            subprocess.call(['cp', 'oseg_migration_round_trip_times_file.dat', get_migration_filename(latency)])
+
+    def report(self):
+        print 'latency', 'lookups', 'mean(ms)', 'p50(ms)', 'p90(ms)', 'p99(ms)', 'max(ms)', 'migrations/s'
+        for latency in self._all_latencies:
+            lookup = read_summary(get_latency_filename(latency),
+                                  ['Num lookups', 'Mean', 'p50', 'p90', 'p99', 'Max'])
+            migration = read_summary(get_migration_filename(latency),
+                                     ['Migrations per second'])
+            print latency, \
+                lookup.get('Num lookups', '-'), lookup.get('Mean', '-'), \
+                lookup.get('p50', '-'), lookup.get('p90', '-'), \
+                lookup.get('p99', '-'), lookup.get('Max', '-'), \
+                migration.get('Migrations per second', '-')
+
+
+if __name__ == "__main__":
+    nss=4
+    nobjects = 500*nss
+    numoh = 1
+
+    cc = ClusterConfig()
+    cs = ClusterSimSettings(cc, nss, (nss,1), numoh)
+
+    cs.debug = True
+    cs.valgrind = False
+    cs.profile = False
+    cs.oprofile = False
+    cs.loc = 'standard'
+    cs.blocksize = 100
+    cs.tx_bandwidth = 50000000
+    cs.rx_bandwidth = 5000000
+
+    cs.oseg_cache_size = 200
+    cs.oseg_cache_entry_lifetime = "8s"
+    cs.oseg_analyze_after = '20'
+
+    cs.num_random_objects = nobjects / cs.num_oh
+    cs.num_pack_objects = 0
+    cs.object_connect_phase = '10s'
+
+    # Drifting objects continually cross server boundaries, generating
+    # migrations and invalidating cached OSeg entries.
+    cs.object_static = 'drift'
+    cs.object_drift_x = '-10'
+    cs.object_drift_y = '0'
+    cs.object_drift_z = '0'
+    cs.object_simple = 'true'
+    cs.object_2d = 'true'
+    cs.object_query_frac = 0.0
+
+    cs.duration = '100s'
+
+    latencies = sys.argv[1:]
+    if len(latencies) == 0:
+        latencies = ['0ms']
+
+    plan = OSegRedis(cc, cs)
+    for latency in latencies:
+        plan.run(latency)
+    plan.report()
@@ -183,6 +183,8 @@ class ClusterSimSettings:
     def oseg_options_param(self):
         if (self.oseg == 'craq'):
             return '--oseg-options=' + "--oseg_unique_craq_prefix=" + self.unique(),
+        if (len(self.oseg_options) > 0):
+            return '--oseg-options=' + self.oseg_options
         return ''
 
     # Options to space about pinto
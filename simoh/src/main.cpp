@@ -106,7 +106,12 @@ int main(int argc, char** argv) {
     ObjectHost* obj_host = new ObjectHost(ctx, gTrace, server_id_map);
     Scenario* scenario = ScenarioFactory::getSingleton().getConstructor(GetOptionValue<String>("scenario"))(GetOptionValue<String>("scenario-options"));
 
-    SSTConnectionManager* sstConnMgr = new SSTConnectionManager();
+    SSTConnectionManager* sstConnMgr = new SSTConnectionManager(
+        ctx,
+        GetOptionValue<Duration>(OPT_SST_STATS_INTERVAL),
+        String("oh") + boost::lexical_cast<String>(oh_id) + ".sst",
+        GetOptionValue<bool>(OPT_SST_STATS_PER_CONNECTION)
+    );
 
     // If we're one of the initial nodes, we'll have to wait until we hit the start time
     {
@@ -94,12 +94,8 @@ void CoordinateSegmentationClient::accept_handler() {
 
   mSocket->close();
 
-  boost::mutex::scoped_lock lock(mCacheMutex);
-  mLookupCache.clear();
-  mTopLevelRegion.destroy();
-  mServerRegionCache.clear();
-  lock.unlock();
- 
+  csegChangeMessage(csegMessage.change_message());
+
   std::map<ServerID, SegmentationInfo> segmentationInfoMap;
 
   for (int i=0; i < csegMessage.change_message().region_size(); i++) {  
@@ -214,22 +210,9 @@ boost::shared_ptr<TCPSocket> CoordinateSegmentationClient::getLeasedSocket() {
 }
 
 ServerID CoordinateSegmentationClient::lookup(const Vector3f& pos)  {
-  {
-    boost::mutex::scoped_lock cachelock(mCacheMutex);
-
-    for (uint32 i=0 ; i<mLookupCache.size(); i++) {
-      if (mLookupCache[i].bbox.contains(pos)) {
-        
-        assert(mLookupCache[i].sid >= 1 && mLookupCache[i].sid <= 5);
-        
-        //std::cout << "pos=" << pos   <<" , mLookupCache[i].sid: " << mLookupCache[i].sid << "\n";
-        //fflush(stdout);
-        
-        return mLookupCache[i].sid;
-      }
-    }
-  }
-  
+  ServerID cached = mLookupCache.lookup(pos);
+  if (cached != NullServerID)
+    return cached;
 
   Sirikata::Protocol::CSeg::CSegMessage csegMessage;
 
@@ -251,11 +234,8 @@ ServerID CoordinateSegmentationClient::lookup(const Vector3f& pos)  {
 
   ServerID retval = csegMessage.lookup_response_message().server_id();
 
-  if (retval != 0 && csegMessage.lookup_response_message().has_server_bbox()) {
-    boost::mutex::scoped_lock cachelock(mCacheMutex);
-    
-    mLookupCache.push_back( LookupCacheEntry(retval, csegMessage.lookup_response_message().server_bbox()) );    
-  }
+  if (retval != 0 && csegMessage.lookup_response_message().has_server_bbox())
+    mLookupCache.addRegion(retval, csegMessage.lookup_response_message().server_bbox());
   
   return retval;
 }
@@ -416,6 +396,8 @@ std::vector<ServerID> CoordinateSegmentationClient::lookupBoundingBox(const Boun
 void CoordinateSegmentationClient::service() {
     mIOService->poll();
 
+    mLookupCache.service();
+
     boost::mutex::scoped_lock scopedLock(mMutex);
     if (mLeasedSocket.get() != 0 && mLeasedSocket->is_open() && Timer::now() > mLeaseExpiryTime ) {
       std::cout << "EXPIRED LEASE; CLOSED CONNECTION AT CLIENT\n"; fflush(stdout);
@@ -427,8 +409,19 @@ void CoordinateSegmentationClient::service() {
 void CoordinateSegmentationClient::receiveMessage(Message* msg) {
 }
 
-void CoordinateSegmentationClient::csegChangeMessage(Sirikata::Protocol::CSeg::ChangeMessage* ccMsg) {
+void CoordinateSegmentationClient::csegChangeMessage(const Sirikata::Protocol::CSeg::ChangeMessage& ccMsg) {
+  boost::mutex::scoped_lock lock(mCacheMutex);
+
+  mTopLevelRegion.destroy();
+  mServerRegionCache.clear();
 
+  // The change message only carries the servers whose regions changed, with
+  // every region for each of them (a server left without a region gets an
+  // empty box), so replace just their entries.
+  std::map<ServerID, BoundingBoxList> changed;
+  for (int i=0; i < ccMsg.region_size(); i++)
+    changed[ccMsg.region(i).id()].push_back(ccMsg.region(i).bounds());
+  mLookupCache.replaceRegions(changed);
 }
 
 void CoordinateSegmentationClient::migrationHint( std::vector<ServerLoadInfo>& svrLoadInfo ) {
@@ -39,6 +39,7 @@
 #include <sirikata/core/network/Asio.hpp>
 #include <sirikata/space/CoordinateSegmentation.hpp>
 #include <sirikata/space/SegmentedRegion.hpp>
+#include <sirikata/space/SegmentationLookupCache.hpp>
 
 #include "Protocol_CSeg.pbj.hpp"
 
@@ -72,7 +73,7 @@ public:
 private:
     virtual void service();
     
-    void csegChangeMessage(Sirikata::Protocol::CSeg::ChangeMessage* ccMsg);
+    void csegChangeMessage(const Sirikata::Protocol::CSeg::ChangeMessage& ccMsg);
 
     void downloadUpdatedBSPTree();
     
@@ -80,19 +81,13 @@ private:
 
     Trace::Trace* mTrace;    
 
-    typedef struct LookupCacheEntry {
-      LookupCacheEntry(ServerID sid, const BoundingBox3f& bbox) {
-        this->bbox = bbox;
-        this->sid = sid;
-      }
-
-      BoundingBox3f bbox;
-      ServerID sid;
-
-    } LookupCacheEntry;
+    // Regions we know the servers for, either from segmentation changes or
+    // from lookup responses. Answers lookup() without contacting the server
+    // whenever it can.
+    SegmentationLookupCache mLookupCache;
 
+    // Guards the caches below
     boost::mutex mCacheMutex;
-    std::vector<LookupCacheEntry> mLookupCache;
     uint16 mAvailableServersCount;
     std::map<ServerID, BoundingBoxList> mServerRegionCache;
     SegmentedRegion mTopLevelRegion;
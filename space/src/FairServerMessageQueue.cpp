@@ -80,6 +80,11 @@ FairServerMessageQueue::~FairServerMessageQueue() {
         "FSMQ: underflow: " << mStoppedUnderflow <<
         ", blocked: " << mStoppedBlocked
     );
+    SILOG(fsmq,info,
+        "FSMQ: sent " << mSentMessages << " messages, " <<
+        mSentHeaderBytes << " header bytes copied, " <<
+        mSentPayloadBytes << " payload bytes sent without copying"
+    );
 }
 
 void FairServerMessageQueue::scheduleServicing() {
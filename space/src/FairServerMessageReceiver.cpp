@@ -31,7 +31,12 @@
  */
 
 #include "FairServerMessageReceiver.hpp"
+#include "Options.hpp"
 #include <sirikata/core/network/IOStrandImpl.hpp>
+#include <sirikata/core/options/CommonOptions.hpp>
+#include <boost/lexical_cast.hpp>
+
+#define MAX_MESSAGES_PER_ROUND 100
 
 namespace Sirikata {
 
@@ -48,8 +53,11 @@ FairServerMessageReceiver::FairServerMessageReceiver(SpaceContext* ctx, SpaceNet
           mServiceScheduled(false),
           mStoppedUnderflow(0),
           mStoppedMaxMessages(0),
-          mBytesUsed(0)
+          mBytesUsed(0),
+          mBatchSize(GetOptionValue<uint32>(SERVER_RECEIVER_BATCH_SIZE)),
+          mTimeSeriesBatchSize(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".receiver.batch-size")
 {
+    mReceivedBatch.reserve(MAX_MESSAGES_PER_ROUND);
 }
 
 FairServerMessageReceiver::~FairServerMessageReceiver() {
@@ -79,8 +87,6 @@ void FairServerMessageReceiver::scheduleServicing() {
 }
 
 void FairServerMessageReceiver::service() {
-#define MAX_MESSAGES_PER_ROUND 100
-
     boost::mutex::scoped_try_lock lock(mServiceMutex);
     if (!lock.owns_lock()) return;
 
@@ -111,11 +117,16 @@ void FairServerMessageReceiver::service() {
         cum_recv_size += next_recv_msg->size();
 
         CONTEXT_SPACETRACE(serverDatagramReceived, mContext->simTime(), next_recv_msg->source_server(), next_recv_msg->id(), next_recv_msg->serializedSize());
-        mListener->serverMessageReceived(next_recv_msg);
+        mReceivedBatch.push_back(next_recv_msg);
 
         num_recv++;
     }
 
+    if (!mReceivedBatch.empty()) {
+        mListener->serverMessagesReceived(mReceivedBatch);
+        mReceivedBatch.clear();
+    }
+
     mBytesUsed += cum_recv_size;
     mCapacityEstimator.estimate_rate(tcur, cum_recv_size);
 
@@ -157,7 +168,7 @@ void FairServerMessageReceiver::networkReceivedConnection(SpaceNetwork::ReceiveS
         }
 
         mReceiveQueues.addQueue(
-            new NetworkQueueWrapper(mContext, strm, Trace::SPACE_TO_SPACE_READ_FROM_NET),
+            new NetworkQueueWrapper(mContext, strm, Trace::SPACE_TO_SPACE_READ_FROM_NET, mBatchSize, mTimeSeriesBatchSize),
             from,
             wt
             );
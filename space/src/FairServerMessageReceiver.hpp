@@ -80,6 +80,13 @@ private:
 
     uint32 mBytesUsed;
 
+    // Maximum number of chunks NetworkQueueWrappers pull from the network at
+    // once
+    uint32 mBatchSize;
+    String mTimeSeriesBatchSize;
+    // Messages received in the current service round
+    std::vector<Message*> mReceivedBatch;
+
     // Protects mReceiveQueues, mReceiveSet
     boost::mutex mMutex;
     // Protects processing code
@@ -153,7 +153,7 @@ void Forwarder::initialize(ObjectSegmentation* oseg, ServerMessageQueue* smq, Se
 {
     addODPServerMessageService(loc);
 
-    mOSegLookups = new OSegLookupQueue(mContext->mainStrand, oseg);
+    mOSegLookups = new OSegLookupQueue(mContext, mContext->mainStrand, oseg);
     mServerMessageQueue = smq;
     mServerMessageReceiver = smr;
 }
@@ -623,55 +623,73 @@ void Forwarder::serverConnectionReceived(ServerID sid) {
     mOutgoingMessages->prePush(sid);
 }
 
-void Forwarder::serverMessageReceived(Message* msg) {
-    assert(msg != NULL);
-    TIMESTAMP_PAYLOAD(msg, Trace::SPACE_TO_SPACE_SMR_DEQUEUED);
+bool Forwarder::tryRouteReceivedMessage(Message* msg) {
+    if (msg->dest_port() != SERVER_PORT_OBJECT_MESSAGE_ROUTING)
+        return false;
 
-    // Routing, check if we can route immediately.
-    if (msg->dest_port() == SERVER_PORT_OBJECT_MESSAGE_ROUTING) {
-        Sirikata::Protocol::Object::ObjectMessage* obj_msg = new Sirikata::Protocol::Object::ObjectMessage();
-        bool parsed = parsePBJMessage(obj_msg, msg->payload());
-        if (!parsed) {
-            LOG_INVALID_MESSAGE(forwarder, error, msg->payload());
-            delete obj_msg;
-            delete msg;
-            return;
-        }
+    Sirikata::Protocol::Object::ObjectMessage* obj_msg = new Sirikata::Protocol::Object::ObjectMessage();
+    bool parsed = parsePBJMessage(obj_msg, msg->payload());
+    if (!parsed) {
+        LOG_INVALID_MESSAGE(forwarder, error, msg->payload());
+        delete obj_msg;
+        delete msg;
+        return true;
+    }
+
+    // This process is very similar to the one followed in Server for
+    // handling OH messages.  We should probably merge them....
 
-        // This process is very similar to the one followed in Server for
-        // handling OH messages.  We should probably merge them....
+    // Local
+    if (mLocalForwarder->tryForward(obj_msg))
+        return true;
 
-        // Local
-        if (mLocalForwarder->tryForward(obj_msg))
-            return;
+    // OSeg Cache
+    // 4. Try to shortcut them main thread. Use forwarder to try to forward
+    // using the cache. FIXME when we do this, we skip over some checks that
+    // happen during the full forwarding
+    if (tryCacheForward(obj_msg)) {
+        delete msg;
+        return true;
+    }
 
-        // OSeg Cache
-        // 4. Try to shortcut them main thread. Use forwarder to try to forward
-        // using the cache. FIXME when we do this, we skip over some checks that
-        // happen during the full forwarding
-        if (tryCacheForward(obj_msg)) {
-            delete msg;
-            return;
-        }
+    // Couldn't get rid of it, forward normally.
+    delete obj_msg;
+    return false;
+}
 
-        // Couldn't get rid of it, forward normally.
-        delete obj_msg;
+void Forwarder::serverMessagesReceived(const std::vector<Message*>& msgs) {
+    // Routing, check if we can route immediately. Everything else gets queued
+    // for the main strand under a single lock.
+    mUnroutedReceivedMessages.clear();
+    for(uint32 i = 0; i < msgs.size(); i++) {
+        Message* msg = msgs[i];
+        assert(msg != NULL);
+        TIMESTAMP_PAYLOAD(msg, Trace::SPACE_TO_SPACE_SMR_DEQUEUED);
+
+        if (!tryRouteReceivedMessage(msg))
+            mUnroutedReceivedMessages.push_back(msg);
     }
 
+    if (mUnroutedReceivedMessages.empty())
+        return;
+
     bool got_empty;
-    bool push_success;
+    uint32 npushed = 0;
     {
         boost::lock_guard<boost::mutex> lock(mReceivedMessagesMutex);
         got_empty = mReceivedMessages.probablyEmpty();
-        push_success = mReceivedMessages.push(msg, false);
+        while(npushed < mUnroutedReceivedMessages.size() &&
+            mReceivedMessages.push(mUnroutedReceivedMessages[npushed], false))
+            npushed++;
     }
 
-    if (!push_success) {
+    for(uint32 i = npushed; i < mUnroutedReceivedMessages.size(); i++) {
         SILOG(forwarder,fatal,"FATAL: Unhandled drop in Forwarder.");
-        delete msg;
+        delete mUnroutedReceivedMessages[i];
     }
+    mUnroutedReceivedMessages.clear();
 
-    if (got_empty && push_success)
+    if (got_empty && npushed > 0)
         scheduleProcessReceivedServerMessages();
 }
 
@@ -132,6 +132,9 @@ private:
     // notification.
     boost::mutex mReceivedMessagesMutex;
     Sirikata::SizedThreadSafeQueue<Message*> mReceivedMessages;
+    // Scratch space for serverMessagesReceived, only used on the receiver
+    // strand
+    std::vector<Message*> mUnroutedReceivedMessages;
 
     // -- Boiler plate stuff - initialization, destruction, methods to satisfy interfaces
   public:
@@ -213,7 +216,10 @@ private:
     virtual bool serverMessageEmpty(ServerID dest);
     // ServerMessageReceiver::Listener Interface
     virtual void serverConnectionReceived(ServerID sid);
-    virtual void serverMessageReceived(Message* msg);
+    virtual void serverMessagesReceived(const std::vector<Message*>& msgs);
+    // Tries to route an object message received from another server without
+    // going through the main strand. Returns true if msg was consumed.
+    bool tryRouteReceivedMessage(Message* msg);
 
     void scheduleProcessReceivedServerMessages();
     void processReceivedServerMessages();
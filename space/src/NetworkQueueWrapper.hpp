@@ -36,27 +36,39 @@
 #include <sirikata/space/SpaceNetwork.hpp>
 #include <sirikata/space/ServerMessage.hpp>
 #include <sirikata/core/trace/Trace.hpp>
+#include <sirikata/core/trace/TimeSeries.hpp>
+#include <sirikata/core/service/Context.hpp>
 
 namespace Sirikata {
+
+/** NetworkQueueWrapper adapts a SpaceNetwork::ReceiveStream to the queue
+ *  interface FairQueue expects. Chunks are pulled from the network in batches
+ *  of up to batch_size, so the network only has to synchronize once per batch,
+ *  and parsed into Messages which are handed out one at a time.
+ */
 class NetworkQueueWrapper {
     Context* mContext;
     SpaceNetwork::ReceiveStream* mReceiveStream;
-    Message* mFront;
     Trace::MessagePath mPathTag;
+    uint32 mBatchSize;
+    // TimeSeries key the size of each batch pulled from the network is
+    // reported under
+    String mBatchSizeSeries;
+    // Messages parsed from the network but not yet popped
+    std::deque<Message*> mMessages;
     typedef Network::Chunk Chunk;
+    std::vector<Chunk*> mChunks;
 
     Message* parse(Chunk* c) {
         Message* msg = Message::deserialize(*c);
 
         if (msg == NULL) {
-            // FIXME if this happens we're probably going to never remove the chunk from the network...
-            SILOG(net,warning,"[NET] Couldn't parse message.");
+            SILOG(net,warning,"[NET] Couldn't parse message, dropping it.");
             return NULL;
         }
 
         if (msg->source_server() != mReceiveStream->id()) {
-            // FIXME if this happens we're probably going to never remove the chunk from the network...
-            SILOG(net,warning,"[NET] Message source doesn't match connection's ID");
+            SILOG(net,warning,"[NET] Message source doesn't match connection's ID, dropping it.");
             delete msg;
             return NULL;
         }
@@ -65,55 +77,66 @@ class NetworkQueueWrapper {
 
         return msg;
     }
+
+    // Pull the next batch of chunks from the network, returning false if none
+    // were available.
+    bool refill() {
+        mChunks.clear();
+        uint32 nchunks = mReceiveStream->popBatch(mChunks, mBatchSize);
+        if (nchunks == 0)
+            return false;
+
+        mContext->timeSeries->report(mBatchSizeSeries, nchunks);
+
+        for(uint32 i = 0; i < nchunks; i++) {
+            Message* msg = parse(mChunks[i]);
+            delete mChunks[i];
+            if (msg != NULL)
+                mMessages.push_back(msg);
+        }
+        mChunks.clear();
+        return true;
+    }
 public:
     typedef Message* ElementType;
 
-    NetworkQueueWrapper(Context* ctx, SpaceNetwork::ReceiveStream* rstrm, Trace::MessagePath tag)
+    NetworkQueueWrapper(Context* ctx, SpaceNetwork::ReceiveStream* rstrm, Trace::MessagePath tag, uint32 batch_size, const String& batch_size_series)
      : mContext(ctx),
        mReceiveStream(rstrm),
-       mFront(NULL),
-       mPathTag(tag)
-    {}
+       mPathTag(tag),
+       mBatchSize(std::max(batch_size, (uint32)1)),
+       mBatchSizeSeries(batch_size_series)
+    {
+        mChunks.reserve(mBatchSize);
+    }
 
-    ~NetworkQueueWrapper(){}
+    ~NetworkQueueWrapper(){
+        for(std::deque<Message*>::iterator it = mMessages.begin(); it != mMessages.end(); it++)
+            delete *it;
+    }
 
     QueueEnum::PushResult push(const Message *msg){
         return QueueEnum::PushExceededMaximumSize;
     }
 
     Message* front() {
-        if (mFront == NULL) {
-            Chunk* c = mReceiveStream->front();
-            if (c != NULL)
-                mFront = parse(c);
+        // Keep going if an entire batch failed to parse
+        while(mMessages.empty()) {
+            if (!refill())
+                return NULL;
         }
-
-        return mFront;
+        return mMessages.front();
     }
 
     Message* pop(){
-        Chunk* c = mReceiveStream->pop();
-
-        if (c == NULL) {
-            assert(mFront == NULL);
-            return NULL;
-        }
-
-        Message* result = NULL;
-        if (mFront != NULL) {
-            result = mFront;
-            mFront = NULL;
-        }
-        else {
-            result = parse(c);
-        }
-
-        delete c;
+        Message* result = front();
+        if (result != NULL)
+            mMessages.pop_front();
         return result;
     }
 
     bool empty() const {
-        return mFront == NULL && mReceiveStream->front() == NULL;
+        return mMessages.empty() && mReceiveStream->front() == NULL;
     }
 };
 }
@@ -34,11 +34,19 @@
 #include <sirikata/space/ObjectSegmentation.hpp>
 #include "Options.hpp"
 #include <sirikata/core/options/CommonOptions.hpp>
+#include <sirikata/space/Trace.hpp>
+#include <sirikata/core/network/IOStrandImpl.hpp>
 
 namespace Sirikata {
 
 // OSegLookupList Implementation
 
+OSegLookupQueue::OSegLookupList::OSegLookupList()
+ : mTotalSize(0),
+   start(Time::null())
+{
+}
+
 size_t OSegLookupQueue::OSegLookupList::ByteSize() const{
     return mTotalSize;
 }
@@ -68,15 +76,27 @@ OSegLookupQueue::OSegLookupList::iterator OSegLookupQueue::OSegLookupList::end()
 // OSegLookupQueue Implementation
 
 
-OSegLookupQueue::OSegLookupQueue(Network::IOStrand* net_strand, ObjectSegmentation* oseg)
- : mNetworkStrand(net_strand),
+OSegLookupQueue::OSegLookupQueue(SpaceContext* ctx, Network::IOStrand* net_strand, ObjectSegmentation* oseg)
+ : mContext(ctx),
+   mNetworkStrand(net_strand),
    mOSeg(oseg),
-   mTotalSize(0)
+   mTotalSize(0),
+   mBatchTimerActive(false)
 {
     mMaxLookups = GetOptionValue<uint32>(OSEG_LOOKUP_QUEUE_SIZE);
+    mBatchWindow = GetOptionValue<Duration>(OSEG_LOOKUP_BATCH_WINDOW);
+    mMaxBatchSize = std::max((uint32)1, GetOptionValue<uint32>(OSEG_LOOKUP_BATCH_SIZE));
+    mBatchTimer = Network::IOTimer::create(
+        mNetworkStrand->service(),
+        mNetworkStrand->wrap( std::tr1::bind(&OSegLookupQueue::flushBatch, this) )
+    );
     mOSeg->setLookupListener(this);
 }
 
+OSegLookupQueue::~OSegLookupQueue() {
+    mBatchTimer->cancel();
+}
+
 OSegEntry OSegLookupQueue::cacheLookup(const UUID& destid) const {
     //if get a cache hit from oseg, do not return;
     return mOSeg->cacheLookup(destid);
@@ -121,11 +141,13 @@ bool OSegLookupQueue::lookup(Sirikata::Protocol::Object::ObjectMessage* msg, con
       return false;
   
   //  otherwise, do full oseg lookup;
-  destServer = mOSeg->lookup(dest_obj);
-  // If we already have a server, handle the callback right away
-  if (destServer.notNull()) {
-    cb(msg, destServer, ResolvedFromCache);
-    return true;
+  if (mBatchWindow == Duration::zero()) {
+    destServer = mOSeg->lookup(dest_obj);
+    // If we already have a server, handle the callback right away
+    if (destServer.notNull()) {
+      cb(msg, destServer, ResolvedFromCache);
+      return true;
+    }
   }
 
   // And if we do, stick it on a list and wait
@@ -134,10 +156,50 @@ bool OSegLookupQueue::lookup(Sirikata::Protocol::Object::ObjectMessage* msg, con
   lu.msg = msg;
   lu.cb = cb;
   lu.size = cursize;
-  mLookups[dest_obj].push_back(lu);
+  OSegLookupList& lookups = mLookups[dest_obj];
+  lookups.start = mContext->simTime();
+  lookups.push_back(lu);
+
+  if (mBatchWindow != Duration::zero()) {
+    // Hold on to the miss until the batch fills up or the window closes
+    mPendingBatch.push_back(dest_obj);
+    if (mPendingBatch.size() >= mMaxBatchSize) {
+      flushBatch();
+    }
+    else if (!mBatchTimerActive) {
+      mBatchTimerActive = true;
+      mBatchTimer->wait(mBatchWindow);
+    }
+  }
   return true;
 }
 
+void OSegLookupQueue::flushBatch() {
+    if (mBatchTimerActive) {
+        mBatchTimer->cancel();
+        mBatchTimerActive = false;
+    }
+    if (mPendingBatch.empty())
+        return;
+
+    // Swap out the batch first since completing lookups can queue up new ones.
+    std::vector<UUID> batch;
+    batch.swap(mPendingBatch);
+
+    std::vector<OSegEntry> results;
+    mOSeg->lookupBatch(batch, &results);
+    assert(results.size() == batch.size());
+
+    uint32 immediate = 0;
+    for(uint32 i = 0; i < batch.size(); i++) {
+        if (results[i].isNull()) continue;
+        immediate++;
+        finishLookups(batch[i], results[i], ResolvedFromCache);
+    }
+
+    CONTEXT_SPACETRACE(osegBatchLookup, mContext->id(), batch.size(), immediate);
+}
+
 void OSegLookupQueue::osegLookupCompleted(const UUID& id, const OSegEntry& dest) {
     mNetworkStrand->post(
         std::tr1::bind(&OSegLookupQueue::handleLookupCompleted, this, id, dest)
@@ -145,15 +207,24 @@ void OSegLookupQueue::osegLookupCompleted(const UUID& id, const OSegEntry& dest)
 }
 
 void OSegLookupQueue::handleLookupCompleted(const UUID& id, const OSegEntry& dest) {
+    finishLookups(id, dest, ResolvedFromServer);
+}
+
+void OSegLookupQueue::finishLookups(const UUID& id, const OSegEntry& dest, ResolvedFrom resolved_from) {
     //Now sending messages that we had saved up from oseg lookup calls.
     LookupMap::iterator iterQueueMap = mLookups.find(id);
     if (iterQueueMap == mLookups.end())
         return;
 
+    CONTEXT_SPACETRACE(osegLookupLatency,
+        mContext->id(),
+        id,
+        mContext->simTime() - iterQueueMap->second.start);
+
     for (int s=0; s < (signed) ((iterQueueMap->second).size()); ++ s) {
         const OSegLookup& lu = (iterQueueMap->second[s]);
         mTotalSize -= lu.size;
-        lu.cb(lu.msg, dest, ResolvedFromServer);
+        lu.cb(lu.msg, dest, resolved_from);
     }
     mLookups.erase(iterQueueMap);
 }
@@ -36,6 +36,7 @@
 #include <sirikata/core/util/Platform.hpp>
 #include <sirikata/space/ServerMessage.hpp>
 #include <sirikata/space/ObjectSegmentation.hpp>
+#include <sirikata/core/network/IOTimer.hpp>
 
 namespace Sirikata {
 
@@ -72,6 +73,12 @@ private:
         typedef std::vector<OSegLookup> OSegLookupVector;
         size_t mTotalSize;
     public:
+        OSegLookupList();
+
+        // When the OSeg was first asked about the object, for tracing
+        // lookup latency
+        Time start;
+
         size_t ByteSize() const;
         size_t size() const;
         OSegLookup& operator[] (size_t where);
@@ -83,6 +90,7 @@ private:
     typedef std::tr1::unordered_map<UUID, OSegLookupList, UUID::Hasher> LookupMap;
 
 
+    SpaceContext* mContext;
     Network::IOStrand* mNetworkStrand;
     ObjectSegmentation* mOSeg; // The OSeg that does the heavy lifting
 
@@ -91,6 +99,20 @@ private:
     uint32 mMaxLookups; // Total number of unique OSeg lookups (i.e. number of
                         // UUIDs, not number of requests).
 
+    // Misses are collected for up to mBatchWindow (or until mMaxBatchSize
+    // objects are waiting) and then handed to the OSeg as a single batched
+    // lookup so backends can resolve them in one round trip.
+    Duration mBatchWindow;
+    uint32 mMaxBatchSize;
+    std::vector<UUID> mPendingBatch;
+    Network::IOTimerPtr mBatchTimer;
+    bool mBatchTimerActive;
+
+    /* Issue all pending lookups to the OSeg as a single batch. */
+    void flushBatch();
+    /* Invoke the callbacks for all messages waiting on id. */
+    void finishLookups(const UUID& id, const OSegEntry& dest, ResolvedFrom resolved_from);
+
     /* OSegLookupListener Interface */
     virtual void osegLookupCompleted(const UUID& id, const OSegEntry& dest);
     /* Main thread handler for lookups. */
@@ -98,13 +120,14 @@ private:
 public:
     /** Create an OSegLookupQueue which uses the specified ObjectSegmentation to resolve queries and
      *  the specified predicate to determine if new lookups are accepted.
+     *  \param ctx the SpaceContext, used for tracing
      *  \param net_strand the strand used for networking, i.e. the one which should handle lookup
      *                    results
      *  \param oseg the ObjectSegmentation which resolves queries
      */
-    OSegLookupQueue(Network::IOStrand* net_strand, ObjectSegmentation* oseg);
+    OSegLookupQueue(SpaceContext* ctx, Network::IOStrand* net_strand, ObjectSegmentation* oseg);
 
-    virtual ~OSegLookupQueue() {}
+    virtual ~OSegLookupQueue();
 
     /** Perform an OSeg cache lookup, returning the ServerID or NullServerID if
      *  the cache doesn't contain an entry for the object.
@@ -113,6 +136,8 @@ public:
     /** Perform an OSeg lookup, calling the specified callback when the result is available.
      *  If the result is available immediately, the callback may be triggered during this
      *  call.  Otherwise, it will be triggered when a service() call produces a result.
+     *  Lookups which miss the cache may be held for a short window so they
+     *  can be issued to the OSeg together with other misses.
      *  Note that if the request is accepted, the message is owned by the OSegLookupQueue until
      *  the callback is invoked, at which time control is passed back to the caller.
      *  \param msg the ObjectMessage to perform the lookup for
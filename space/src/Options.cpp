@@ -53,26 +53,35 @@ void InitSpaceOptions() {
         .addOption(new OptionValue(SERVER_QUEUE, "fair", Sirikata::OptionValueType<String>(), "The type of ServerMessageQueue to use for routing."))
         .addOption(new OptionValue(SERVER_QUEUE_LENGTH, "8192", Sirikata::OptionValueType<uint32>(), "Length of queue for each server."))
         .addOption(new OptionValue(SERVER_RECEIVER, "fair", Sirikata::OptionValueType<String>(), "The type of ServerMessageReceiver to use for routing."))
+        .addOption(new OptionValue(SERVER_RECEIVER_BATCH_SIZE, "16", Sirikata::OptionValueType<uint32>(), "Maximum number of messages to pull from a network connection at once."))
         .addOption(new OptionValue(SERVER_ODP_FLOW_SCHEDULER, "region", Sirikata::OptionValueType<String>(), "The type of ODPFlowScheduler to use for routing."))
         .addOption(new OptionValue(FORWARDER_RECEIVE_QUEUE_SIZE, "16384", Sirikata::OptionValueType<uint32>(), "The type of ODPFlowScheduler to use for routing."))
         .addOption(new OptionValue(FORWARDER_SEND_QUEUE_SIZE, "65536", Sirikata::OptionValueType<uint32>(), "The type of ODPFlowScheduler to use for routing."))
 
-        .addOption(new OptionValue(NETWORK_TYPE, "tcp", Sirikata::OptionValueType<String>(), "The networking subsystem to use."))
+        .addOption(new OptionValue(NETWORK_TYPE, "tcp", Sirikata::OptionValueType<String>(), "The networking subsystem to use, tcp or shm."))
+        .addOption(new OptionValue(SHM_NETWORK_NAME, "sirikata", Sirikata::OptionValueType<String>(), "Prefix for shared memory segment names, must match between servers which should talk through shared memory."))
+        .addOption(new OptionValue(SHM_NETWORK_RING_SIZE, "4194304", Sirikata::OptionValueType<uint32>(), "Size in bytes of each shared memory ring, rounded up to a power of two."))
+        .addOption(new OptionValue(SHM_NETWORK_POLL_INTERVAL, "100us", Sirikata::OptionValueType<Duration>(), "How often to poll shared memory rings for new data and free space while they're busy."))
+        .addOption(new OptionValue(SHM_NETWORK_MAX_POLL_INTERVAL, "5ms", Sirikata::OptionValueType<Duration>(), "Longest interval polling of idle shared memory rings backs off to."))
 
         .addOption(new OptionValue(OSEG,"local",Sirikata::OptionValueType<String>(),"Specifies which type of oseg to use."))
         .addOption(new OptionValue(OSEG_OPTIONS,"",Sirikata::OptionValueType<String>(),"Specifies arguments to OSeg."))
 
         .addOption(new OptionValue(OSEG_LOOKUP_QUEUE_SIZE, "2000", Sirikata::OptionValueType<uint32>(), "Number of new lookups you can have on oseg lookup queue."))
+        .addOption(new OptionValue(OSEG_LOOKUP_BATCH_WINDOW, "1ms", Sirikata::OptionValueType<Duration>(), "How long to collect OSeg cache misses before issuing them to the OSeg as a single batched lookup. 0 issues each lookup immediately."))
+        .addOption(new OptionValue(OSEG_LOOKUP_BATCH_SIZE, "256", Sirikata::OptionValueType<uint32>(), "Maximum number of objects in a batched OSeg lookup. A batch is issued early if it fills up before the batch window ends."))
 
         .addOption(new OptionValue(OSEG_CACHE_SIZE, "200", Sirikata::OptionValueType<uint32>(), "Maximum number of entries in the OSeg cache."))
 
-        .addOption(new OptionValue(CACHE_SELECTOR,CACHE_TYPE_ORIGINAL_LRU,Sirikata::OptionValueType<String>(),"Which caching algorithm to use."))
+        .addOption(new OptionValue(CACHE_SELECTOR,CACHE_TYPE_ORIGINAL_LRU,Sirikata::OptionValueType<String>(),"Which caching algorithm to use: " CACHE_TYPE_ORIGINAL_LRU ", " CACHE_TYPE_COMMUNICATION " or " CACHE_TYPE_SHARDED_CLOCKPRO "."))
 
          .addOption(new OptionValue(CACHE_COMM_SCALING,"1.0",Sirikata::OptionValueType<double>(),"What the communication falloff function scaling factor is."))
          .addOption(new OptionValue("send-capacity-overestimate","80000",Sirikata::OptionValueType<double>(),"How much to overestimate send capacity when queue is not blocked."))
          .addOption(new OptionValue("receive-capacity-overestimate","1",Sirikata::OptionValueType<double>(),"How much to overestimate recv capacity when queue is not blocked."))
         .addOption(new OptionValue(OSEG_CACHE_CLEAN_GROUP_SIZE, "25", Sirikata::OptionValueType<uint32>(), "Number of items to remove from the OSeg cache when it reaches the maximum size."))
         .addOption(new OptionValue(OSEG_CACHE_ENTRY_LIFETIME, "8s", Sirikata::OptionValueType<Duration>(), "Maximum lifetime for an OSeg cache entry."))
+        .addOption(new OptionValue(OSEG_CACHE_SHARDS, "16", Sirikata::OptionValueType<uint32>(), "Number of independently locked shards the " CACHE_TYPE_SHARDED_CLOCKPRO " OSeg cache is split into."))
+        .addOption(new OptionValue(OSEG_CACHE_NEGATIVE_LIFETIME, "500ms", Sirikata::OptionValueType<Duration>(), "How long an object the OSeg couldn't find is remembered as missing. 0 disables negative caching."))
 
         .addOption(new OptionValue(CSEG, "uniform", Sirikata::OptionValueType<String>(), "Type of Coordinate Segmentation implementation to use."))
         .addOption(new OptionValue("cseg-service-host", "meru00", Sirikata::OptionValueType<String>(), "Hostname of machine running the CSEG service (running with --cseg=distributed)"))
@@ -89,6 +98,10 @@ void InitSpaceOptions() {
         .addOption(new OptionValue(PROX_MAX_PER_RESULT, "5", Sirikata::OptionValueType<uint32>(), "Maximum number of changes to report in each result message."))
 
         .addOption(new OptionValue(OPT_PROX_SPLIT_DYNAMIC, "false", Sirikata::OptionValueType<bool>(), "If true, separate query handlers will be used for static and dynamic objects."))
+        .addOption(new OptionValue(OPT_PROX_SHARDS, "1", Sirikata::OptionValueType<uint32>(), "Number of proximity worker threads. Queries are partitioned across them by the querier's ID."))
+        .addOption(new OptionValue(OPT_PROX_BATCH_UPDATES, "false", Sirikata::OptionValueType<bool>(), "If true, location updates are coalesced per object and delivered to the proximity threads in batches instead of individually."))
+        .addOption(new OptionValue(OPT_PROX_MAX_OBJECT_RESULTS, "10000", Sirikata::OptionValueType<uint32>(), "Maximum number of unsent result entries queued for each object. Beyond this, new additions are dropped. 0 means unlimited."))
+        .addOption(new OptionValue(OPT_PROX_COMPACT_RESULTS, "false", Sirikata::OptionValueType<bool>(), "If true, objects which request it receive prox results in a compact, quantized encoding instead of protocol buffers."))
 
         .addOption(new OptionValue(OPT_PROX_QUERY_RANGE, "100", Sirikata::OptionValueType<float32>(), "The range of queries when using range queries instead of solid angle queries."))
 
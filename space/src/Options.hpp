@@ -40,9 +40,14 @@
 #define SERVER_QUEUE         "server.queue"
 #define SERVER_QUEUE_LENGTH  "server.queue.length"
 #define SERVER_RECEIVER      "server.receiver"
+#define SERVER_RECEIVER_BATCH_SIZE "server.receiver.batch-size"
 #define SERVER_ODP_FLOW_SCHEDULER   "server.odp.flowsched"
 
 #define NETWORK_TYPE         "net"
+#define SHM_NETWORK_NAME              "shm-net.name"
+#define SHM_NETWORK_RING_SIZE         "shm-net.ring-size"
+#define SHM_NETWORK_POLL_INTERVAL     "shm-net.poll-interval"
+#define SHM_NETWORK_MAX_POLL_INTERVAL "shm-net.max-poll-interval"
 
 #define CSEG                "cseg"
 
@@ -59,10 +64,13 @@
 #define OSEG_CACHE_SIZE              "oseg-cache-size"
 #define OSEG_CACHE_CLEAN_GROUP_SIZE  "oseg-cache-clean-group-size"
 #define OSEG_CACHE_ENTRY_LIFETIME    "oseg-cache-entry-lifetime"
+#define OSEG_CACHE_NEGATIVE_LIFETIME "oseg-cache-negative-lifetime"
+#define OSEG_CACHE_SHARDS            "oseg-cache-shards"
 
 #define CACHE_SELECTOR              "oseg-cache-selector"
 #define CACHE_TYPE_COMMUNICATION    "cache_communication"
 #define CACHE_TYPE_ORIGINAL_LRU     "cache_originallru"
+#define CACHE_TYPE_SHARDED_CLOCKPRO "cache_shardedclockpro"
 
 
 #define CACHE_COMM_SCALING          "oseg-cache-scaling"
@@ -71,6 +79,8 @@
 #define FORWARDER_RECEIVE_QUEUE_SIZE "forwarder.receive-queue-size"
 
 #define OSEG_LOOKUP_QUEUE_SIZE     "oseg_lookup_queue_size"
+#define OSEG_LOOKUP_BATCH_WINDOW   "oseg-lookup-batch-window"
+#define OSEG_LOOKUP_BATCH_SIZE     "oseg-lookup-batch-size"
 
 #define OPT_PINTO                  "pinto"
 #define OPT_PINTO_OPTIONS          "pinto-options"
@@ -78,6 +88,10 @@
 #define OPT_PROX_QUERY_RANGE       "prox.range"
 #define PROX_MAX_PER_RESULT        "prox.max-per-result"
 #define OPT_PROX_SPLIT_DYNAMIC     "prox.split-dynamic"
+#define OPT_PROX_SHARDS            "prox.shards"
+#define OPT_PROX_BATCH_UPDATES     "prox.batch-updates"
+#define OPT_PROX_MAX_OBJECT_RESULTS "prox.max-object-results"
+#define OPT_PROX_COMPACT_RESULTS   "prox.compact-results"
 
 #define OPT_PROX_SERVER_QUERY_HANDLER_TYPE         "prox.server.handler"
 #define OPT_PROX_SERVER_QUERY_HANDLER_OPTIONS      "prox.server.handler-options"
@@ -90,29 +90,19 @@ Proximity::Proximity(SpaceContext* ctx, LocationService* locservice, SpaceNetwor
    mDistanceQueryDistance(0.f),
    mMaxObject(0.0f),
    mMinObjectQueryAngle(SolidAngle::Max),
-   mProxThread(NULL),
-   mProxService(NULL),
-   mProxStrand(NULL),
-   mLocCache(NULL),
-   mServerQueries(),
+   mMaxObjectResults(0),
+   mCompactResults(false),
+   mObjectResultsCoalesced(0),
+   mObjectResultsDropped(0),
+   mShards(),
    mServerDistance(false),
-   mObjectQueries(),
-   mObjectDistance(false)
+   mObjectDistance(false),
+   mBatchUpdates(false)
 {
     net->addListener(this);
 
-    using std::tr1::placeholders::_1;
-    using std::tr1::placeholders::_2;
-    using std::tr1::placeholders::_3;
-    using std::tr1::placeholders::_4;
-    using std::tr1::placeholders::_5;
     mAggregateManager = new AggregateManager(locservice);
 
-    // Do some necessary initialization for the prox thread, needed to let main thread
-    // objects know about it's strand/service
-    mProxService = Network::IOServiceFactory::makeIOService();
-    mProxStrand = mProxService->createStrand();
-
     // Server Querier (discover other servers)
     String pinto_type = GetOptionValue<String>(OPT_PINTO);
     String pinto_options = GetOptionValue<String>(OPT_PINTO_OPTIONS);
@@ -128,44 +118,38 @@ Proximity::Proximity(SpaceContext* ctx, LocationService* locservice, SpaceNetwor
     // Generic query parameters
     mDistanceQueryDistance = GetOptionValue<float32>(OPT_PROX_QUERY_RANGE);
 
-    // Location cache, for both types of queries
-    mLocCache = new CBRLocationServiceCache(mProxStrand, locservice, true);
+    // Server and object query handler setup, shared by all shards
+    mServerHandlerType = GetOptionValue<String>(OPT_PROX_SERVER_QUERY_HANDLER_TYPE);
+    mServerHandlerOptions = GetOptionValue<String>(OPT_PROX_SERVER_QUERY_HANDLER_OPTIONS);
+    if (mServerHandlerType == "dist") mServerDistance = true;
+    mObjectHandlerType = GetOptionValue<String>(OPT_PROX_OBJECT_QUERY_HANDLER_TYPE);
+    mObjectHandlerOptions = GetOptionValue<String>(OPT_PROX_OBJECT_QUERY_HANDLER_OPTIONS);
+    if (mObjectHandlerType == "dist") mObjectDistance = true;
 
-    // Server Queries
-    String server_handler_type = GetOptionValue<String>(OPT_PROX_SERVER_QUERY_HANDLER_TYPE);
-    String server_handler_options = GetOptionValue<String>(OPT_PROX_SERVER_QUERY_HANDLER_OPTIONS);
-    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (i >= mNumQueryHandlers) {
-            mServerQueryHandler[i] = NULL;
-            continue;
-        }
-        mServerQueryHandler[i] = QueryHandlerFactory<ObjectProxSimulationTraits>(server_handler_type, server_handler_options);
-        mServerQueryHandler[i]->setAggregateListener(this); // *Must* be before handler->initialize
-        bool server_static_objects = (mSeparateDynamicObjects && i == OBJECT_CLASS_STATIC);
-        mServerQueryHandler[i]->initialize(
-            mLocCache, mLocCache, server_static_objects,
-            std::tr1::bind(&Proximity::handlerShouldHandleObject, this, server_static_objects, false, _1, _2, _3, _4, _5)
-        );
-    }
-    if (server_handler_type == "dist") mServerDistance = true;
+    mBatchUpdates = GetOptionValue<bool>(OPT_PROX_BATCH_UPDATES);
+    mMaxObjectResults = GetOptionValue<uint32>(OPT_PROX_MAX_OBJECT_RESULTS);
+    mCompactResults = GetOptionValue<bool>(OPT_PROX_COMPACT_RESULTS);
 
-    // Object Queries
-    String object_handler_type = GetOptionValue<String>(OPT_PROX_OBJECT_QUERY_HANDLER_TYPE);
-    String object_handler_options = GetOptionValue<String>(OPT_PROX_OBJECT_QUERY_HANDLER_OPTIONS);
-    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (i >= mNumQueryHandlers) {
-            mObjectQueryHandler[i] = NULL;
-            continue;
-        }
-        mObjectQueryHandler[i] = QueryHandlerFactory<ObjectProxSimulationTraits>(object_handler_type, object_handler_options);
-        mObjectQueryHandler[i]->setAggregateListener(this); // *Must* be before handler->initialize
-        bool object_static_objects = (mSeparateDynamicObjects && i == OBJECT_CLASS_STATIC);
-        mObjectQueryHandler[i]->initialize(
-            mLocCache, mLocCache, object_static_objects,
-            std::tr1::bind(&Proximity::handlerShouldHandleObject, this, object_static_objects, true, _1, _2, _3, _4, _5)
-        );
+    uint32 nshards = std::max(GetOptionValue<uint32>(OPT_PROX_SHARDS), (uint32)1);
+    for(uint32 si = 0; si < nshards; si++) {
+        ProxShard* shard = new ProxShard(this);
+        shard->index = si;
+
+        // Do some necessary initialization for the prox thread, needed to let main thread
+        // objects know about it's strand/service
+        shard->service = Network::IOServiceFactory::makeIOService();
+        shard->strand = shard->service->createStrand();
+
+        // Location cache, for both types of queries. Each shard gets its own
+        // so that updates are applied in that shard's thread.
+        shard->locCache = new CBRLocationServiceCache(shard->strand, locservice, true, mBatchUpdates);
+
+        createQueryHandlers(shard->serverQueryHandler, shard->objectQueryHandler);
+        initializeQueryHandlers(shard->locCache, shard->serverQueryHandler, shard->objectQueryHandler);
+
+        mShards.push_back(shard);
     }
-    if (object_handler_type == "dist") mObjectDistance = true;
+    PROXLOG(info, "Running proximity with " << mShards.size() << " shard(s)");
 
     mLocService->addListener(this, false);
 
@@ -173,8 +157,9 @@ Proximity::Proximity(SpaceContext* ctx, LocationService* locservice, SpaceNetwor
 
     mProxServerMessageService = mContext->serverRouter()->createServerMessageService("proximity");
 
-    // Start the processing thread
-    mProxThread = new Thread( std::tr1::bind(&Proximity::proxThreadMain, this) );
+    // Start the processing threads
+    for(ProxShardList::iterator it = mShards.begin(); it != mShards.end(); it++)
+        (*it)->thread = new Thread( std::tr1::bind(&Proximity::proxThreadMain, this, *it) );
 }
 
 Proximity::~Proximity() {
@@ -182,22 +167,31 @@ Proximity::~Proximity() {
 
     mContext->serverDispatcher()->unregisterMessageRecipient(SERVER_PORT_PROX, this);
 
-    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        delete mObjectQueryHandler[i];
-        delete mServerQueryHandler[i];
-    }
+    for(ProxShardList::iterator it = mShards.begin(); it != mShards.end(); it++) {
+        ProxShard* shard = *it;
+        for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+            delete shard->objectQueryHandler[i];
+            delete shard->serverQueryHandler[i];
+            delete shard->rebuildObjectQueryHandler[i];
+            delete shard->rebuildServerQueryHandler[i];
+        }
 
-    delete mLocCache;
+        delete shard->locCache;
+        delete shard->rebuildCache;
+        delete shard->rebuildThread;
 
-    delete mServerQuerier;
+        delete shard->strand;
+        Network::IOServiceFactory::destroyIOService(shard->service);
+        shard->service = NULL;
 
-    delete mProxStrand;
-    Network::IOServiceFactory::destroyIOService(mProxService);
-    mProxService = NULL;
+        delete shard->thread;
+        delete shard;
+    }
+    mShards.clear();
 
-    delete mAggregateManager;
+    delete mServerQuerier;
 
-    delete mProxThread;
+    delete mAggregateManager;
 }
 
 
@@ -215,14 +209,87 @@ void Proximity::initialize(CoordinateSegmentation* cseg) {
 }
 
 void Proximity::shutdown() {
-    // Shut down the main processing thread
-    if (mProxThread != NULL) {
-        if (mProxService != NULL)
-            mProxService->stop();
-        mProxThread->join();
+    PROXLOG(info, "Object results coalesced: " << mObjectResultsCoalesced << ", dropped: " << mObjectResultsDropped);
+
+    // Shut down the processing threads. Stop them all first so they wind down
+    // in parallel.
+    for(ProxShardList::iterator it = mShards.begin(); it != mShards.end(); it++) {
+        if ((*it)->service != NULL)
+            (*it)->service->stop();
+    }
+    for(ProxShardList::iterator it = mShards.begin(); it != mShards.end(); it++) {
+        if ((*it)->thread != NULL)
+            (*it)->thread->join();
+        // A rebuild may still be running. It doesn't need the prox thread
+        // until it finishes, so just wait for it.
+        if ((*it)->rebuildThread != NULL)
+            (*it)->rebuildThread->join();
     }
 }
 
+Proximity::ProxShard* Proximity::shardFor(const UUID& obj) {
+    return mShards[ UUID::Hasher()(obj) % mShards.size() ];
+}
+
+Proximity::ProxShard* Proximity::shardFor(ServerID sid) {
+    return mShards[ sid % mShards.size() ];
+}
+
+void Proximity::createQueryHandlers(ProxQueryHandler* server_handlers[NUM_OBJECT_CLASSES], ProxQueryHandler* object_handlers[NUM_OBJECT_CLASSES]) {
+    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+        if (i >= mNumQueryHandlers) continue;
+        server_handlers[i] = QueryHandlerFactory<ObjectProxSimulationTraits>(mServerHandlerType, mServerHandlerOptions);
+        object_handlers[i] = QueryHandlerFactory<ObjectProxSimulationTraits>(mObjectHandlerType, mObjectHandlerOptions);
+        // Every shard's handlers report aggregates, since each only sees
+        // the observers for its own queries. *Must* be before
+        // handler->initialize
+        server_handlers[i]->setAggregateListener(this);
+        object_handlers[i]->setAggregateListener(this);
+    }
+}
+
+void Proximity::initializeQueryHandlers(CBRLocationServiceCache* loccache, ProxQueryHandler* server_handlers[NUM_OBJECT_CLASSES], ProxQueryHandler* object_handlers[NUM_OBJECT_CLASSES]) {
+    using std::tr1::placeholders::_1;
+    using std::tr1::placeholders::_2;
+    using std::tr1::placeholders::_3;
+    using std::tr1::placeholders::_4;
+    using std::tr1::placeholders::_5;
+
+    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+        if (i >= mNumQueryHandlers) continue;
+        bool static_objects = (mSeparateDynamicObjects && i == OBJECT_CLASS_STATIC);
+        // Server Queries
+        server_handlers[i]->initialize(
+            loccache, loccache, static_objects,
+            std::tr1::bind(&Proximity::handlerShouldHandleObject, this, static_objects, false, _1, _2, _3, _4, _5)
+        );
+        // Object Queries
+        object_handlers[i]->initialize(
+            loccache, loccache, static_objects,
+            std::tr1::bind(&Proximity::handlerShouldHandleObject, this, static_objects, true, _1, _2, _3, _4, _5)
+        );
+    }
+}
+
+void Proximity::handleRebuildCreateCache(ProxShard* shard) {
+    // Paused until the rebuild finishes, so the snapshot stays consistent
+    // while updates that arrive in the meantime are still captured.
+    CBRLocationServiceCache* cache = new CBRLocationServiceCache(shard->strand, mLocService, true, mBatchUpdates);
+    cache->pause();
+    shard->strand->post(
+        std::tr1::bind(&Proximity::handleRebuildSnapshot, this, shard, cache)
+    );
+}
+
+void Proximity::handleRetireLocCache(ProxShard* shard, CBRLocationServiceCache* cache) {
+    cache->detach();
+    // Updates may have been queued for the prox thread before detaching, so
+    // the delete has to go through the same strand.
+    shard->strand->post(
+        std::tr1::bind(&Proximity::handleDeleteLocCache, this, cache)
+    );
+}
+
 void Proximity::newSession(ObjectSession* session) {
     using std::tr1::placeholders::_1;
     using std::tr1::placeholders::_2;
@@ -545,27 +612,31 @@ void Proximity::aggregateObserved(ProxQueryHandler* handler, const UUID& objid,
 }
 
 void Proximity::onSpaceNetworkConnected(ServerID sid) {
-    mProxStrand->post(
+    ProxShard* shard = shardFor(sid);
+    shard->strand->post(
         std::tr1::bind(&Proximity::handleConnectedServer, this, sid)
     );
 }
 
 void Proximity::onSpaceNetworkDisconnected(ServerID sid) {
-    mProxStrand->post(
-        std::tr1::bind(&Proximity::handleDisconnectedServer, this, sid)
+    ProxShard* shard = shardFor(sid);
+    shard->strand->post(
+        std::tr1::bind(&Proximity::handleDisconnectedServer, this, shard, sid)
     );
 }
 
 
 void Proximity::updateQuery(ServerID sid, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& sa) {
-    mProxStrand->post(
-        std::tr1::bind(&Proximity::handleUpdateServerQuery, this, sid, loc, bounds, sa)
+    ProxShard* shard = shardFor(sid);
+    shard->strand->post(
+        std::tr1::bind(&Proximity::handleUpdateServerQuery, this, shard, sid, loc, bounds, sa)
     );
 }
 
 void Proximity::removeQuery(ServerID sid) {
-    mProxStrand->post(
-        std::tr1::bind(&Proximity::handleRemoveServerQuery, this, sid)
+    ProxShard* shard = shardFor(sid);
+    shard->strand->post(
+        std::tr1::bind(&Proximity::handleRemoveServerQuery, this, shard, sid)
     );
 }
 
@@ -575,9 +646,15 @@ void Proximity::addQuery(UUID obj, SolidAngle sa) {
 
 void Proximity::updateQuery(UUID obj, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, SolidAngle sa) {
     // Update the prox thread
-    mProxStrand->post(
-        std::tr1::bind(&Proximity::handleUpdateObjectQuery, this, obj, loc, bounds, sa)
-    );
+    ProxShard* shard = shardFor(obj);
+    if (mBatchUpdates) {
+        queueObjectQueryUpdate(shard, PendingQueryUpdate::Update, obj, loc, bounds, sa);
+    }
+    else {
+        shard->strand->post(
+            std::tr1::bind(&Proximity::handleUpdateObjectQuery, this, shard, obj, loc, bounds, sa)
+        );
+    }
 
     if (sa != NoUpdateSolidAngle) {
         // Update the main thread's record
@@ -599,9 +676,15 @@ void Proximity::removeQuery(UUID obj) {
     mObjectQueryAngles.erase(obj);
 
     // Update the prox thread
-    mProxStrand->post(
-        std::tr1::bind(&Proximity::handleRemoveObjectQuery, this, obj)
-    );
+    ProxShard* shard = shardFor(obj);
+    if (mBatchUpdates) {
+        queueObjectQueryUpdate(shard, PendingQueryUpdate::Remove, obj, TimedMotionVector3f(), BoundingSphere3f(), NoUpdateSolidAngle);
+    }
+    else {
+        shard->strand->post(
+            std::tr1::bind(&Proximity::handleRemoveObjectQuery, this, shard, obj)
+        );
+    }
 
     // Update min query angle, and update remote queries if necessary
     if (sa == mMinObjectQueryAngle) {
@@ -650,9 +733,12 @@ void Proximity::removeObjectSize(const UUID& obj) {
 }
 
 void Proximity::checkObjectClass(bool is_local, const UUID& objid, const TimedMotionVector3f& newval) {
-    mProxStrand->post(
-        std::tr1::bind(&Proximity::handleCheckObjectClass, this, is_local, objid, newval)
-    );
+    // Every shard indexes every object, so they all need to reclassify it.
+    for(ProxShardList::iterator it = mShards.begin(); it != mShards.end(); it++) {
+        (*it)->strand->post(
+            std::tr1::bind(&Proximity::handleCheckObjectClass, this, *it, is_local, objid, newval)
+        );
+    }
 }
 
 void Proximity::requestProxSubstream(const UUID& objid, ProxStreamInfoPtr prox_stream) {
@@ -699,10 +785,33 @@ void Proximity::proxSubstreamCallback(int x, ProxStreamPtr parent_stream, ProxSt
     }
 
     prox_stream_info->iostream = substream;
+    if (mCompactResults) {
+        substream->registerReadCallback(
+            std::tr1::bind(&Proximity::handleProxSubstreamRead, this, ProxStreamInfoWPtr(prox_stream_info), _1, _2)
+        );
+    }
     assert(!prox_stream_info->writing);
     writeSomeObjectResults(prox_stream_info);
 }
 
+void Proximity::handleProxSubstreamRead(ProxStreamInfoWPtr w_prox_stream, uint8* buffer, int length) {
+    ProxStreamInfoPtr prox_stream = w_prox_stream.lock();
+    if (!prox_stream) return;
+
+    prox_stream->readbuf.append((const char*)buffer, length);
+    while(true) {
+        std::string msg = Network::Frame::parse(prox_stream->readbuf);
+        if (msg.empty()) return;
+
+        // Results already queued haven't been encoded yet, so we can switch
+        // immediately.
+        if (Network::ProxCompactEncoding::isHello(msg) && !prox_stream->compact) {
+            PROXLOG(debug, "Using compact prox results for " << prox_stream->id.toString());
+            prox_stream->compact = true;
+        }
+    }
+}
+
 void Proximity::writeSomeObjectResults(ProxStreamInfoWPtr w_prox_stream) {
     static Duration retry_rate = Duration::milliseconds((int64)1);
 
@@ -718,9 +827,11 @@ void Proximity::writeSomeObjectResults(ProxStreamInfoWPtr w_prox_stream) {
         return;
     }
 
-    // Otherwise, keep sending until we run out or
-    while(!prox_stream->outstanding.empty()) {
-        std::string& framed_prox_msg = prox_stream->outstanding.front();
+    // Otherwise, keep sending until we run out or the stream backs up.
+    // Results are only encoded once they can be written, so anything still
+    // queued can be merged with later results.
+    while(!prox_stream->partial.empty() || encodeObjectResults(prox_stream, &prox_stream->partial)) {
+        std::string& framed_prox_msg = prox_stream->partial;
         int bytes_written = prox_stream->iostream->write((const uint8*)framed_prox_msg.data(), framed_prox_msg.size());
         if (bytes_written < 0) {
             // FIXME
@@ -731,16 +842,209 @@ void Proximity::writeSomeObjectResults(ProxStreamInfoWPtr w_prox_stream) {
             break;
         }
         else {
-            prox_stream->outstanding.pop();
+            framed_prox_msg.clear();
         }
     }
 
-    if (prox_stream->outstanding.empty())
+    if (prox_stream->partial.empty() && prox_stream->pending.empty())
         prox_stream->writing = false;
     else
         mContext->mainStrand->post(retry_rate, prox_stream->writecb);
 }
 
+void Proximity::queueObjectAddition(ProxStreamInfoPtr prox_stream, const UUID& objid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics) {
+    prox_stream->results.insert(objid);
+    // The resync will pick it up
+    if (prox_stream->resync) {
+        mObjectResultsDropped++;
+        return;
+    }
+
+    ProxStreamInfo::PendingResultMap::iterator it = prox_stream->pending.find(objid);
+    if (it == prox_stream->pending.end()) {
+        if (mMaxObjectResults > 0 && prox_stream->pending.size() >= mMaxObjectResults) {
+            // Stop queueing results until the queue drains, then catch up
+            // from the result set instead.
+            mObjectResultsDropped++;
+            prox_stream->resync = true;
+            return;
+        }
+        it = prox_stream->pending.insert( ProxStreamInfo::PendingResultMap::value_type(objid, ProxStreamInfo::PendingResult()) ).first;
+        prox_stream->pendingOrder.push_back(objid);
+    }
+    else {
+        // Either turns a pending removal into a refresh or replaces a stale
+        // pending addition.
+        mObjectResultsCoalesced++;
+    }
+
+    ProxStreamInfo::PendingResult& result = it->second;
+    result.add = true;
+    result.location = loc;
+    result.orientation = orient;
+    result.bounds = bounds;
+    result.mesh = mesh;
+    result.physics = physics;
+}
+
+void Proximity::queueObjectRemoval(ProxStreamInfoPtr prox_stream, const UUID& objid) {
+    prox_stream->results.erase(objid);
+    if (prox_stream->resync) {
+        mObjectResultsDropped++;
+        return;
+    }
+
+    ProxStreamInfo::PendingResultMap::iterator it = prox_stream->pending.find(objid);
+    if (it == prox_stream->pending.end()) {
+        // The client never heard about it, so it doesn't need to hear it's
+        // gone
+        if (prox_stream->sent.find(objid) == prox_stream->sent.end())
+            return;
+        it = prox_stream->pending.insert( ProxStreamInfo::PendingResultMap::value_type(objid, ProxStreamInfo::PendingResult()) ).first;
+        prox_stream->pendingOrder.push_back(objid);
+        it->second.remove = true;
+        return;
+    }
+
+    ProxStreamInfo::PendingResult& result = it->second;
+    if (result.add && !result.remove) {
+        // Addition never sent, both cancel out
+        mObjectResultsCoalesced += 2;
+        prox_stream->pending.erase(it);
+
+        // Stale entries pile up if results keep cancelling out, so compact
+        // the order list if it gets much larger than the set of results.
+        if (prox_stream->pendingOrder.size() > 2 * prox_stream->pending.size() + 64) {
+            std::deque<UUID> order;
+            ObjectSet seen;
+            for(std::deque<UUID>::iterator oit = prox_stream->pendingOrder.begin(); oit != prox_stream->pendingOrder.end(); oit++) {
+                if (prox_stream->pending.find(*oit) != prox_stream->pending.end() && seen.insert(*oit).second)
+                    order.push_back(*oit);
+            }
+            prox_stream->pendingOrder.swap(order);
+        }
+        return;
+    }
+    // Pending refresh becomes a plain removal, or duplicate removal
+    mObjectResultsCoalesced++;
+    result.add = false;
+    result.remove = true;
+}
+
+void Proximity::resyncObjectResults(ProxStreamInfoPtr prox_stream) {
+    // Everything queued has been sent, so sent is exactly what the client
+    // knows about.
+    prox_stream->resync = false;
+
+    for(std::set<UUID>::iterator it = prox_stream->sent.begin(); it != prox_stream->sent.end(); it++) {
+        if (prox_stream->results.find(*it) == prox_stream->results.end())
+            queueObjectRemoval(prox_stream, *it);
+    }
+    for(std::set<UUID>::iterator it = prox_stream->results.begin(); it != prox_stream->results.end(); it++) {
+        if (prox_stream->sent.find(*it) != prox_stream->sent.end()) continue;
+        // Its removal is on the way
+        if (!mLocService->contains(*it)) continue;
+
+        queueObjectAddition(
+            prox_stream, *it,
+            mLocService->location(*it), mLocService->orientation(*it), mLocService->bounds(*it),
+            mLocService->mesh(*it), mLocService->physics(*it)
+        );
+        // Full again, the rest waits for the next time the queue drains
+        if (prox_stream->resync) break;
+    }
+}
+
+bool Proximity::encodeObjectResults(ProxStreamInfoPtr prox_stream, std::string* framed_out) {
+    if (prox_stream->pending.empty()) {
+        prox_stream->pendingOrder.clear();
+        if (prox_stream->resync)
+            resyncObjectResults(prox_stream);
+        if (prox_stream->pending.empty())
+            return false;
+    }
+
+    uint32 max_count = GetOptionValue<uint32>(PROX_MAX_PER_RESULT);
+
+    if (prox_stream->compact) {
+        // Positions are relative to the querier to keep them small
+        Vector3f reference(0, 0, 0);
+        if (mLocService->contains(prox_stream->id))
+            reference = mLocService->currentPosition(prox_stream->id);
+        prox_stream->encoder.begin(mContext->simTime(), reference);
+    }
+
+    Sirikata::Protocol::Prox::ProximityResults prox_results;
+    prox_results.set_t(mContext->simTime());
+    // Removals go in an earlier update than additions so refreshed objects
+    // are removed before they are added back.
+    Sirikata::Protocol::Prox::IProximityUpdate removals = prox_results.add_update();
+    Sirikata::Protocol::Prox::IProximityUpdate additions = prox_results.add_update();
+
+    uint32 count = 0;
+    while(count < max_count && !prox_stream->pendingOrder.empty()) {
+        UUID objid = prox_stream->pendingOrder.front();
+        prox_stream->pendingOrder.pop_front();
+
+        ProxStreamInfo::PendingResultMap::iterator it = prox_stream->pending.find(objid);
+        if (it == prox_stream->pending.end()) continue; // Cancelled or already sent
+
+        const ProxStreamInfo::PendingResult& result = it->second;
+        if (result.remove)
+            prox_stream->sent.erase(objid);
+        if (result.add)
+            prox_stream->sent.insert(objid);
+        if (prox_stream->compact) {
+            if (result.remove) {
+                count++;
+                prox_stream->encoder.addRemoval(objid);
+            }
+            if (result.add) {
+                count++;
+                prox_stream->encoder.addAddition(objid, result.location, result.orientation, result.bounds, result.mesh, result.physics);
+            }
+            prox_stream->pending.erase(it);
+            continue;
+        }
+
+        if (result.remove) {
+            count++;
+            Sirikata::Protocol::Prox::IObjectRemoval removal = removals.add_removal();
+            removal.set_object(objid);
+        }
+        if (result.add) {
+            count++;
+            Sirikata::Protocol::Prox::IObjectAddition addition = additions.add_addition();
+            addition.set_object(objid);
+
+            Sirikata::Protocol::ITimedMotionVector motion = addition.mutable_location();
+            motion.set_t(result.location.updateTime());
+            motion.set_position(result.location.position());
+            motion.set_velocity(result.location.velocity());
+
+            Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
+            msg_orient.set_t(result.orientation.updateTime());
+            msg_orient.set_position(result.orientation.position());
+            msg_orient.set_velocity(result.orientation.velocity());
+
+            addition.set_bounds(result.bounds);
+            if (result.mesh.size() > 0)
+                addition.set_mesh(result.mesh);
+            if (result.physics.size() > 0)
+                addition.set_physics(result.physics);
+        }
+        prox_stream->pending.erase(it);
+    }
+
+    if (count == 0) return false;
+
+    if (prox_stream->compact)
+        *framed_out = Network::Frame::write(prox_stream->encoder.finish());
+    else
+        *framed_out = Network::Frame::write(serializePBJMessage(prox_results));
+    return true;
+}
+
 void Proximity::sendObjectResult(Sirikata::Protocol::Object::ObjectMessage* msg) {
     using std::tr1::placeholders::_1;
     using std::tr1::placeholders::_2;
@@ -748,7 +1052,7 @@ void Proximity::sendObjectResult(Sirikata::Protocol::Object::ObjectMessage* msg)
     // Try to find stream info for the object
     ObjectProxStreamMap::iterator prox_stream_it = mObjectProxStreams.find(msg->dest_object());
     if (prox_stream_it == mObjectProxStreams.end()) {
-        prox_stream_it = mObjectProxStreams.insert( ObjectProxStreamMap::value_type(msg->dest_object(), ProxStreamInfoPtr(new ProxStreamInfo())) ).first;
+        prox_stream_it = mObjectProxStreams.insert( ObjectProxStreamMap::value_type(msg->dest_object(), ProxStreamInfoPtr(new ProxStreamInfo(msg->dest_object()))) ).first;
         prox_stream_it->second->writecb = std::tr1::bind(
             &Proximity::writeSomeObjectResults, this, ProxStreamInfoWPtr(prox_stream_it->second)
         );
@@ -759,10 +1063,26 @@ void Proximity::sendObjectResult(Sirikata::Protocol::Object::ObjectMessage* msg)
     if (!prox_stream->iostream_requested)
         requestProxSubstream(msg->dest_object(), prox_stream);
 
-    // Build the result and push it into the stream
-    // FIXME this is an infinite sized queue, but we don't really want to drop
-    // proximity results....
-    prox_stream->outstanding.push(Network::Frame::write(msg->payload()));
+    // Unpack the results and merge them into the queue
+    Sirikata::Protocol::Prox::ProximityResults contents;
+    bool parse_success = contents.ParseFromString(msg->payload());
+    assert(parse_success);
+    for(int32 idx = 0; idx < contents.update_size(); idx++) {
+        Sirikata::Protocol::Prox::ProximityUpdate update = contents.update(idx);
+        for(int32 aidx = 0; aidx < update.addition_size(); aidx++) {
+            Sirikata::Protocol::Prox::ObjectAddition addition = update.addition(aidx);
+            queueObjectAddition(
+                prox_stream, addition.object(),
+                TimedMotionVector3f(addition.location().t(), MotionVector3f(addition.location().position(), addition.location().velocity())),
+                TimedMotionQuaternion(addition.orientation().t(), MotionQuaternion(addition.orientation().position(), addition.orientation().velocity())),
+                addition.bounds(),
+                (addition.has_mesh() ? addition.mesh() : ""),
+                (addition.has_physics() ? addition.physics() : "")
+            );
+        }
+        for(int32 ridx = 0; ridx < update.removal_size(); ridx++)
+            queueObjectRemoval(prox_stream, update.removal(ridx).object());
+    }
 
     // If writing isn't already in progress, start it up
     if (!prox_stream->writing)
@@ -828,17 +1148,6 @@ void Proximity::handleRemoveAllServerLocSubscription(const ServerID& subscriber)
     mLocService->unsubscribe(subscriber);
 }
 
-void Proximity::queryHasEvents(Query* query) {
-    if (
-        query->handler() == mServerQueryHandler[OBJECT_CLASS_STATIC] ||
-        query->handler() == mServerQueryHandler[OBJECT_CLASS_DYNAMIC]
-    )
-        generateServerQueryEvents(query);
-    else
-        generateObjectQueryEvents(query);
-}
-
-
 // Note: LocationServiceListener interface is only used in order to get updates on objects which have
 // registered queries, allowing us to update those queries as appropriate.  All updating of objects
 // in the prox data structure happens via the LocationServiceCache
@@ -889,22 +1198,22 @@ void Proximity::updatedSegmentation(CoordinateSegmentation* cseg, const std::vec
 
 // PROX Thread: Everything after this should only be called from within the prox thread.
 
-// The main loop for the prox processing thread
-void Proximity::proxThreadMain() {
+// The main loop for a prox processing thread
+void Proximity::proxThreadMain(ProxShard* shard) {
     Duration max_rate = Duration::milliseconds((int64)100);
 
-    Poller mServerHandlerPoller(mProxStrand, std::tr1::bind(&Proximity::tickQueryHandler, this, mServerQueryHandler), max_rate);
-    Poller mObjectHandlerPoller(mProxStrand, std::tr1::bind(&Proximity::tickQueryHandler, this, mObjectQueryHandler), max_rate);
+    Poller mServerHandlerPoller(shard->strand, std::tr1::bind(&Proximity::tickQueryHandler, this, shard->serverQueryHandler), max_rate);
+    Poller mObjectHandlerPoller(shard->strand, std::tr1::bind(&Proximity::tickQueryHandler, this, shard->objectQueryHandler), max_rate);
 
-    Poller staticRebuilder(mProxStrand, std::tr1::bind(&Proximity::rebuildHandler, this, OBJECT_CLASS_STATIC), Duration::seconds(3600.f));
-    Poller dynamicRebuilder(mProxStrand, std::tr1::bind(&Proximity::rebuildHandler, this, OBJECT_CLASS_DYNAMIC), Duration::seconds(3600.f));
+    Poller resyncPoller(shard->strand, std::tr1::bind(&Proximity::checkResync, this, shard), max_rate);
+    Poller rebuilder(shard->strand, std::tr1::bind(&Proximity::startRebuild, this, shard), Duration::seconds(3600.f));
 
     mServerHandlerPoller.start();
     mObjectHandlerPoller.start();
-    staticRebuilder.start();
-    dynamicRebuilder.start();
+    resyncPoller.start();
+    rebuilder.start();
 
-    mProxService->run();
+    shard->service->run();
 }
 
 void Proximity::tickQueryHandler(ProxQueryHandler* qh[NUM_OBJECT_CLASSES]) {
@@ -915,20 +1224,171 @@ void Proximity::tickQueryHandler(ProxQueryHandler* qh[NUM_OBJECT_CLASSES]) {
     }
 }
 
-void Proximity::rebuildHandler(ObjectClass objtype) {
-    if (mServerQueryHandler[objtype] != NULL)
-        mServerQueryHandler[objtype]->rebuild();
-    if (mObjectQueryHandler[objtype] != NULL)
-        mObjectQueryHandler[objtype]->rebuild();
+void Proximity::startRebuild(ProxShard* shard) {
+    if (shard->rebuilding) return;
+    // Nothing to gain from rebuilding empty handlers, e.g. on startup
+    if (shard->locCache->numObjects() == 0) return;
+
+    PROXLOG(debug, "Starting background rebuild of query handlers for shard " << shard->index);
+    shard->rebuilding = true;
+    // Attaching a new cache to the location service must happen in the main
+    // thread.
+    mContext->mainStrand->post(
+        std::tr1::bind(&Proximity::handleRebuildCreateCache, this, shard)
+    );
+}
+
+void Proximity::handleRebuildSnapshot(ProxShard* shard, CBRLocationServiceCache* cache) {
+    // Everything the current cache knows about, plus the updates the new
+    // cache has deferred since it was attached, covers every update.
+    // Duplicates are harmless: adds of objects that were already copied are
+    // ignored and the rest are just replayed updates.
+    cache->copyFrom(shard->locCache);
+    shard->rebuildCache = cache;
+
+    createQueryHandlers(shard->rebuildServerQueryHandler, shard->rebuildObjectQueryHandler);
+    shard->rebuildThread = new Thread( std::tr1::bind(&Proximity::rebuildThreadMain, this, shard) );
+}
+
+void Proximity::rebuildThreadMain(ProxShard* shard) {
+    // This is the expensive part: inserting every object into fresh
+    // handlers. Initializing only registers the handlers as listeners, and
+    // the copied objects never generated notifications, so they have to be
+    // announced explicitly. The cache is paused so it won't change
+    // underneath us.
+    initializeQueryHandlers(shard->rebuildCache, shard->rebuildServerQueryHandler, shard->rebuildObjectQueryHandler);
+    shard->rebuildCache->announceObjects();
+
+    shard->strand->post(
+        std::tr1::bind(&Proximity::handleRebuildFinished, this, shard)
+    );
+}
+
+void Proximity::handleRebuildFinished(ProxShard* shard) {
+    shard->rebuildThread->join();
+    delete shard->rebuildThread;
+    shard->rebuildThread = NULL;
+
+    // Catch up on updates received during the build. The new handlers are
+    // listening now, so they see them as normal updates.
+    shard->rebuildCache->resume();
+
+    // Swap in the new handlers and cache, holding onto the old ones until
+    // queries have been moved over.
+    CBRLocationServiceCache* old_cache = shard->locCache;
+    shard->locCache = shard->rebuildCache;
+    shard->rebuildCache = NULL;
+
+    ServerQueryMap old_server_queries[NUM_OBJECT_CLASSES];
+    ObjectQueryMap old_object_queries[NUM_OBJECT_CLASSES];
+    ProxQueryHandler* old_server_handlers[NUM_OBJECT_CLASSES];
+    ProxQueryHandler* old_object_handlers[NUM_OBJECT_CLASSES];
+    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+        old_server_queries[i].swap(shard->serverQueries[i]);
+        old_object_queries[i].swap(shard->objectQueries[i]);
+        old_server_handlers[i] = shard->serverQueryHandler[i];
+        old_object_handlers[i] = shard->objectQueryHandler[i];
+        shard->serverQueryHandler[i] = shard->rebuildServerQueryHandler[i];
+        shard->objectQueryHandler[i] = shard->rebuildObjectQueryHandler[i];
+        shard->rebuildServerQueryHandler[i] = NULL;
+        shard->rebuildObjectQueryHandler[i] = NULL;
+    }
+    shard->invertedServerQueries.clear();
+    shard->invertedObjectQueries.clear();
+
+    // Everything reported so far needs to be confirmed by the new queries,
+    // including anything a previous resync hasn't gotten to yet.
+    for(ProxShard::ServerResultsMap::iterator it = shard->serverResync.begin(); it != shard->serverResync.end(); it++)
+        shard->serverResults[it->first].insert(it->second.begin(), it->second.end());
+    for(ProxShard::ObjectResultsMap::iterator it = shard->objectResync.begin(); it != shard->objectResync.end(); it++)
+        shard->objectResults[it->first].insert(it->second.begin(), it->second.end());
+    shard->serverResync.swap(shard->serverResults);
+    shard->serverResults.clear();
+    shard->objectResync.swap(shard->objectResults);
+    shard->objectResults.clear();
+    shard->resyncRemaining = 0;
+
+    // Register the same queries with the new handlers and get their initial
+    // results.
+    ProxShard::ServerQueryParamsMap server_params = shard->serverQueryParams;
+    for(ProxShard::ServerQueryParamsMap::iterator it = server_params.begin(); it != server_params.end(); it++)
+        handleUpdateServerQuery(shard, it->first, it->second.loc, it->second.bounds, it->second.angle);
+    ProxShard::ObjectQueryParamsMap object_params = shard->objectQueryParams;
+    for(ProxShard::ObjectQueryParamsMap::iterator it = object_params.begin(); it != object_params.end(); it++)
+        handleUpdateObjectQuery(shard, it->first, it->second.loc, it->second.bounds, it->second.angle);
+    // The remaining results are confirmed as they come in and anything left
+    // over is removed by checkResync.
+    tickQueryHandler(shard->serverQueryHandler);
+    tickQueryHandler(shard->objectQueryHandler);
+
+    // And clean up the old state. The old cache stops notifying anyone so
+    // updates still queued for it can't reach the deleted handlers. Queries
+    // must go before their handlers.
+    old_cache->pause();
+    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+        for(ServerQueryMap::iterator it = old_server_queries[i].begin(); it != old_server_queries[i].end(); it++)
+            delete it->second;
+        for(ObjectQueryMap::iterator it = old_object_queries[i].begin(); it != old_object_queries[i].end(); it++)
+            delete it->second;
+        delete old_server_handlers[i];
+        delete old_object_handlers[i];
+    }
+    mContext->mainStrand->post(
+        std::tr1::bind(&Proximity::handleRetireLocCache, this, shard, old_cache)
+    );
+
+    shard->rebuilding = false;
+    PROXLOG(debug, "Finished background rebuild of query handlers for shard " << shard->index);
+}
+
+void Proximity::checkResync(ProxShard* shard) {
+    uint32 remaining = 0;
+    for(ProxShard::ServerResultsMap::iterator it = shard->serverResync.begin(); it != shard->serverResync.end(); it++)
+        remaining += it->second.size();
+    for(ProxShard::ObjectResultsMap::iterator it = shard->objectResync.begin(); it != shard->objectResync.end(); it++)
+        remaining += it->second.size();
+
+    if (remaining == 0) {
+        shard->serverResync.clear();
+        shard->objectResync.clear();
+    }
+    else if (remaining == shard->resyncRemaining) {
+        // Nothing was confirmed since the last check, so the new handlers
+        // have settled and whatever is left is really gone.
+        finishResync(shard);
+        remaining = 0;
+    }
+    shard->resyncRemaining = remaining;
+}
+
+void Proximity::finishResync(ProxShard* shard) {
+    for(ProxShard::ServerResultsMap::iterator it = shard->serverResync.begin(); it != shard->serverResync.end(); it++) {
+        if (!it->second.empty())
+            sendServerRemovals(it->first, it->second);
+    }
+    shard->serverResync.clear();
+
+    for(ProxShard::ObjectResultsMap::iterator it = shard->objectResync.begin(); it != shard->objectResync.end(); it++) {
+        if (!it->second.empty())
+            sendObjectRemovals(it->first, it->second);
+    }
+    shard->objectResync.clear();
 }
 
-void Proximity::generateServerQueryEvents(Query* query) {
+void Proximity::handleDeleteLocCache(CBRLocationServiceCache* cache) {
+    delete cache;
+}
+
+void Proximity::generateServerQueryEvents(ProxShard* shard, Query* query) {
     typedef std::deque<QueryEvent> QueryEventList;
 
     Time t = mContext->simTime();
     uint32 max_count = GetOptionValue<uint32>(PROX_MAX_PER_RESULT);
 
-    ServerID sid = mInvertedServerQueries[query];
+    ServerID sid = shard->invertedServerQueries[query];
+    ObjectSet& results = shard->serverResults[sid];
+    ProxShard::ServerResultsMap::iterator resync_it = shard->serverResync.find(sid);
+    ObjectSet* resync = (resync_it != shard->serverResync.end() ? &resync_it->second : NULL);
 
     QueryEventList evts;
     query->popEvents(evts);
@@ -945,8 +1405,14 @@ void Proximity::generateServerQueryEvents(Query* query) {
             // removals
             for(uint32 aidx = 0; aidx < evt.additions().size(); aidx++) {
                 UUID objid = evt.additions()[aidx].id();
-                if (mLocCache->tracking(objid)) { // If the cache already lost it, we can't do anything
+                // Already reported before a rebuild, just confirm it
+                if (resync != NULL && resync->erase(objid) > 0) {
+                    results.insert(objid);
+                    continue;
+                }
+                if (shard->locCache->tracking(objid)) { // If the cache already lost it, we can't do anything
                     count++;
+                    results.insert(objid);
 
                     mContext->mainStrand->post(
                         std::tr1::bind(&Proximity::handleAddServerLocSubscription, this, sid, objid)
@@ -955,23 +1421,23 @@ void Proximity::generateServerQueryEvents(Query* query) {
                     Sirikata::Protocol::Prox::IObjectAddition addition = event_results.add_addition();
                     addition.set_object( objid );
 
-                    TimedMotionVector3f loc = mLocCache->location(objid);
+                    TimedMotionVector3f loc = shard->locCache->location(objid);
                     Sirikata::Protocol::ITimedMotionVector msg_loc = addition.mutable_location();
                     msg_loc.set_t(loc.updateTime());
                     msg_loc.set_position(loc.position());
                     msg_loc.set_velocity(loc.velocity());
 
-                    TimedMotionQuaternion orient = mLocCache->orientation(objid);
+                    TimedMotionQuaternion orient = shard->locCache->orientation(objid);
                     Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
                     msg_orient.set_t(orient.updateTime());
                     msg_orient.set_position(orient.position());
                     msg_orient.set_velocity(orient.velocity());
 
-                    addition.set_bounds( mLocCache->bounds(objid) );
-                    const String& mesh = mLocCache->mesh(objid);
+                    addition.set_bounds( shard->locCache->bounds(objid) );
+                    const String& mesh = shard->locCache->mesh(objid);
                     if (mesh.size() > 0)
                         addition.set_mesh(mesh);
-                    const String& phy = mLocCache->physics(objid);
+                    const String& phy = shard->locCache->physics(objid);
                     if (phy.size() > 0)
                         addition.set_physics(phy);
                 }
@@ -979,6 +1445,8 @@ void Proximity::generateServerQueryEvents(Query* query) {
             for(uint32 ridx = 0; ridx < evt.removals().size(); ridx++) {
                 UUID objid = evt.removals()[ridx].id();
                 count++;
+                results.erase(objid);
+                if (resync != NULL) resync->erase(objid);
                 mContext->mainStrand->post(
                     std::tr1::bind(&Proximity::handleRemoveServerLocSubscription, this, sid, objid)
                 );
@@ -989,6 +1457,9 @@ void Proximity::generateServerQueryEvents(Query* query) {
             evts.pop_front();
         }
 
+        // Everything may have been confirmations of existing results
+        if (count == 0) continue;
+
         //PROXLOG(insane,"Reporting " << contents.addition_size() << " additions, " << contents.removal_size() << " removals to server " << sid);
 
         Message* msg = new Message(
@@ -1002,12 +1473,15 @@ void Proximity::generateServerQueryEvents(Query* query) {
     }
 }
 
-void Proximity::generateObjectQueryEvents(Query* query) {
+void Proximity::generateObjectQueryEvents(ProxShard* shard, Query* query) {
     typedef std::deque<QueryEvent> QueryEventList;
 
     uint32 max_count = GetOptionValue<uint32>(PROX_MAX_PER_RESULT);
 
-    UUID query_id = mInvertedObjectQueries[query];
+    UUID query_id = shard->invertedObjectQueries[query];
+    ObjectSet& results = shard->objectResults[query_id];
+    ProxShard::ObjectResultsMap::iterator resync_it = shard->objectResync.find(query_id);
+    ObjectSet* resync = (resync_it != shard->objectResync.end() ? &resync_it->second : NULL);
 
     QueryEventList evts;
     query->popEvents(evts);
@@ -1023,8 +1497,14 @@ void Proximity::generateObjectQueryEvents(Query* query) {
 
             for(uint32 aidx = 0; aidx < evt.additions().size(); aidx++) {
                 UUID objid = evt.additions()[aidx].id();
-                if (mLocCache->tracking(objid)) { // If the cache already lost it, we can't do anything
+                // Already reported before a rebuild, just confirm it
+                if (resync != NULL && resync->erase(objid) > 0) {
+                    results.insert(objid);
+                    continue;
+                }
+                if (shard->locCache->tracking(objid)) { // If the cache already lost it, we can't do anything
                     count++;
+                    results.insert(objid);
 
                     mContext->mainStrand->post(
                         std::tr1::bind(&Proximity::handleAddObjectLocSubscription, this, query_id, objid)
@@ -1034,22 +1514,22 @@ void Proximity::generateObjectQueryEvents(Query* query) {
                     addition.set_object( objid );
 
                     Sirikata::Protocol::ITimedMotionVector motion = addition.mutable_location();
-                    TimedMotionVector3f loc = mLocCache->location(objid);
+                    TimedMotionVector3f loc = shard->locCache->location(objid);
                     motion.set_t(loc.updateTime());
                     motion.set_position(loc.position());
                     motion.set_velocity(loc.velocity());
 
-                    TimedMotionQuaternion orient = mLocCache->orientation(objid);
+                    TimedMotionQuaternion orient = shard->locCache->orientation(objid);
                     Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
                     msg_orient.set_t(orient.updateTime());
                     msg_orient.set_position(orient.position());
                     msg_orient.set_velocity(orient.velocity());
 
-                    addition.set_bounds( mLocCache->bounds(objid) );
-                    const String& mesh = mLocCache->mesh(objid);
+                    addition.set_bounds( shard->locCache->bounds(objid) );
+                    const String& mesh = shard->locCache->mesh(objid);
                     if (mesh.size() > 0)
                         addition.set_mesh(mesh);
-                    const String& phy = mLocCache->physics(objid);
+                    const String& phy = shard->locCache->physics(objid);
                     if (phy.size() > 0)
                         addition.set_physics(phy);
                 }
@@ -1057,6 +1537,8 @@ void Proximity::generateObjectQueryEvents(Query* query) {
             for(uint32 ridx = 0; ridx < evt.removals().size(); ridx++) {
                 UUID objid = evt.removals()[ridx].id();
                 count++;
+                results.erase(objid);
+                if (resync != NULL) resync->erase(objid);
                 mContext->mainStrand->post(
                     std::tr1::bind(&Proximity::handleRemoveObjectLocSubscription, this, query_id, objid)
                 );
@@ -1068,6 +1550,8 @@ void Proximity::generateObjectQueryEvents(Query* query) {
             evts.pop_front();
         }
 
+        if (count == 0) continue;
+
         Sirikata::Protocol::Object::ObjectMessage* obj_msg = createObjectMessage(
             mContext->id(),
             UUID::null(), OBJECT_PORT_PROXIMITY,
@@ -1079,25 +1563,84 @@ void Proximity::generateObjectQueryEvents(Query* query) {
     }
 }
 
+void Proximity::sendServerRemovals(ServerID sid, const ObjectSet& objects) {
+    uint32 max_count = GetOptionValue<uint32>(PROX_MAX_PER_RESULT);
 
+    ObjectSet::const_iterator it = objects.begin();
+    while(it != objects.end()) {
+        Sirikata::Protocol::Prox::Container container;
+        Sirikata::Protocol::Prox::IProximityResults contents = container.mutable_result();
+        contents.set_t(mContext->simTime());
+        Sirikata::Protocol::Prox::IProximityUpdate event_results = contents.add_update();
+        for(uint32 count = 0; count < max_count && it != objects.end(); count++, it++) {
+            mContext->mainStrand->post(
+                std::tr1::bind(&Proximity::handleRemoveServerLocSubscription, this, sid, *it)
+            );
+            Sirikata::Protocol::Prox::IObjectRemoval removal = event_results.add_removal();
+            removal.set_object(*it);
+        }
+
+        Message* msg = new Message(
+            mContext->id(),
+            SERVER_PORT_PROX,
+            sid,
+            SERVER_PORT_PROX,
+            serializePBJMessage(container)
+        );
+        mServerResults.push(msg);
+    }
+}
 
-void Proximity::handleUpdateServerQuery(const ServerID& server, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle) {
+void Proximity::sendObjectRemovals(const UUID& query_id, const ObjectSet& objects) {
+    uint32 max_count = GetOptionValue<uint32>(PROX_MAX_PER_RESULT);
+
+    ObjectSet::const_iterator it = objects.begin();
+    while(it != objects.end()) {
+        Sirikata::Protocol::Prox::ProximityResults prox_results;
+        prox_results.set_t(mContext->simTime());
+        Sirikata::Protocol::Prox::IProximityUpdate event_results = prox_results.add_update();
+        for(uint32 count = 0; count < max_count && it != objects.end(); count++, it++) {
+            mContext->mainStrand->post(
+                std::tr1::bind(&Proximity::handleRemoveObjectLocSubscription, this, query_id, *it)
+            );
+            Sirikata::Protocol::Prox::IObjectRemoval removal = event_results.add_removal();
+            removal.set_object(*it);
+        }
+
+        Sirikata::Protocol::Object::ObjectMessage* obj_msg = createObjectMessage(
+            mContext->id(),
+            UUID::null(), OBJECT_PORT_PROXIMITY,
+            query_id, OBJECT_PORT_PROXIMITY,
+            serializePBJMessage(prox_results)
+        );
+        mObjectResults.push(obj_msg);
+    }
+}
+
+
+
+void Proximity::handleUpdateServerQuery(ProxShard* shard, const ServerID& server, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle) {
     BoundingSphere3f region(bounds.center(), 0);
     float ms = bounds.radius();
 
+    ProxShard::QueryParams& params = shard->serverQueryParams[server];
+    params.loc = loc;
+    params.bounds = bounds;
+    params.angle = angle;
+
     for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (mServerQueryHandler[i] == NULL) continue;
+        if (shard->serverQueryHandler[i] == NULL) continue;
 
-        ServerQueryMap::iterator it = mServerQueries[i].find(server);
-        if (it == mServerQueries[i].end()) {
+        ServerQueryMap::iterator it = shard->serverQueries[i].find(server);
+        if (it == shard->serverQueries[i].end()) {
             PROXLOG(debug,"Add server query from " << server << ", min angle " << angle.asFloat() << ", object class " << ObjectClassToString((ObjectClass)i));
 
             Query* q = mServerDistance ?
-                mServerQueryHandler[i]->registerQuery(loc, region, ms, SolidAngle::Min, mDistanceQueryDistance) :
-                mServerQueryHandler[i]->registerQuery(loc, region, ms, angle) ;
-            q->setEventListener(this);
-            mServerQueries[i][server] = q;
-            mInvertedServerQueries[q] = server;
+                shard->serverQueryHandler[i]->registerQuery(loc, region, ms, SolidAngle::Min, mDistanceQueryDistance) :
+                shard->serverQueryHandler[i]->registerQuery(loc, region, ms, angle) ;
+            q->setEventListener(&shard->serverQueryListener);
+            shard->serverQueries[i][server] = q;
+            shard->invertedServerQueries[q] = server;
         }
         else {
             PROXLOG(debug,"Update server query from " << server << ", min angle " << angle.asFloat() << ", object class " << ObjectClassToString((ObjectClass)i));
@@ -1111,18 +1654,22 @@ void Proximity::handleUpdateServerQuery(const ServerID& server, const TimedMotio
     }
 }
 
-void Proximity::handleRemoveServerQuery(const ServerID& server) {
+void Proximity::handleRemoveServerQuery(ProxShard* shard, const ServerID& server) {
     PROXLOG(debug,"Remove server query from " << server);
 
+    shard->serverQueryParams.erase(server);
+    shard->serverResults.erase(server);
+    shard->serverResync.erase(server);
+
     for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (mServerQueryHandler[i] == NULL) continue;
+        if (shard->serverQueryHandler[i] == NULL) continue;
 
-        ServerQueryMap::iterator it = mServerQueries[i].find(server);
-        if (it == mServerQueries[i].end()) continue;
+        ServerQueryMap::iterator it = shard->serverQueries[i].find(server);
+        if (it == shard->serverQueries[i].end()) continue;
 
         Query* q = it->second;
-        mServerQueries[i].erase(it);
-        mInvertedServerQueries.erase(q);
+        shard->serverQueries[i].erase(it);
+        shard->invertedServerQueries.erase(q);
         delete q; // Note: Deleting query notifies QueryHandler and unsubscribes.
     }
 
@@ -1144,13 +1691,13 @@ void Proximity::handleConnectedServer(ServerID sid) {
         mNeedServerQueryUpdate.insert(sid);
 }
 
-void Proximity::handleDisconnectedServer(ServerID sid) {
+void Proximity::handleDisconnectedServer(ProxShard* shard, ServerID sid) {
     // When we lose a connection, we need to clear out everything related to
     // that server.
     PROXLOG(debug, "Handling unexpected disconnection from " << sid << " by clearing out proximity state.");
 
     // Clear out remote server's query to us
-    handleRemoveServerQuery(sid);
+    handleRemoveServerQuery(shard, sid);
 
     // And our query (and associated state) to them
     // They clear out our query (as we do for them above), but we need to also
@@ -1163,26 +1710,37 @@ void Proximity::handleDisconnectedServer(ServerID sid) {
         mLocService->removeReplicaObject(t, *it);
 }
 
-void Proximity::handleUpdateObjectQuery(const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle) {
+void Proximity::handleUpdateObjectQuery(ProxShard* shard, const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle) {
     BoundingSphere3f region(bounds.center(), 0);
     float ms = bounds.radius();
 
+    // Same rule as below: position-only updates don't create queries
+    ProxShard::ObjectQueryParamsMap::iterator params_it = shard->objectQueryParams.find(object);
+    if (params_it == shard->objectQueryParams.end() && angle != NoUpdateSolidAngle)
+        params_it = shard->objectQueryParams.insert( std::make_pair(object, ProxShard::QueryParams()) ).first;
+    if (params_it != shard->objectQueryParams.end()) {
+        params_it->second.loc = loc;
+        params_it->second.bounds = bounds;
+        if (angle != NoUpdateSolidAngle)
+            params_it->second.angle = angle;
+    }
+
     for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (mObjectQueryHandler[i] == NULL) continue;
+        if (shard->objectQueryHandler[i] == NULL) continue;
 
-        ObjectQueryMap::iterator it = mObjectQueries[i].find(object);
+        ObjectQueryMap::iterator it = shard->objectQueries[i].find(object);
 
-        if (it == mObjectQueries[i].end()) {
+        if (it == shard->objectQueries[i].end()) {
             // We only add if we actually have all the necessary info, most importantly a real minimum angle.
             // This is necessary because we get this update for all location updates, even those for objects
             // which don't have subscriptions.
             if (angle != NoUpdateSolidAngle) {
                 Query* q = mObjectDistance ?
-                    mObjectQueryHandler[i]->registerQuery(loc, region, ms, SolidAngle::Min, mDistanceQueryDistance) :
-                    mObjectQueryHandler[i]->registerQuery(loc, region, ms, angle);
-                q->setEventListener(this);
-                mObjectQueries[i][object] = q;
-                mInvertedObjectQueries[q] = object;
+                    shard->objectQueryHandler[i]->registerQuery(loc, region, ms, SolidAngle::Min, mDistanceQueryDistance) :
+                    shard->objectQueryHandler[i]->registerQuery(loc, region, ms, angle);
+                q->setEventListener(&shard->objectQueryListener);
+                shard->objectQueries[i][object] = q;
+                shard->invertedObjectQueries[q] = object;
             }
         }
         else {
@@ -1196,16 +1754,83 @@ void Proximity::handleUpdateObjectQuery(const UUID& object, const TimedMotionVec
     }
 }
 
-void Proximity::handleRemoveObjectQuery(const UUID& object) {
+void Proximity::queueObjectQueryUpdate(ProxShard* shard, PendingQueryUpdate::Type type, const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle) {
+    boost::lock_guard<boost::mutex> lck(shard->queryUpdatesMutex);
+
+    ProxShard::PendingQueryIndexMap::iterator idx_it = shard->queryUpdateIndex.find(object);
+    if (idx_it != shard->queryUpdateIndex.end()) {
+        PendingQueryUpdate& last = shard->queryUpdates[idx_it->second];
+        if (type == PendingQueryUpdate::Update && angle == NoUpdateSolidAngle) {
+            // Another plain position update, only the latest matters
+            last.loc = loc;
+            last.bounds = bounds;
+            return;
+        }
+        // The position would only be applied right before the query goes
+        // away, so skip it.
+        if (type == PendingQueryUpdate::Remove)
+            last.type = PendingQueryUpdate::Discarded;
+        shard->queryUpdateIndex.erase(idx_it);
+    }
+
+    PendingQueryUpdate upd;
+    upd.type = type;
+    upd.object = object;
+    upd.loc = loc;
+    upd.bounds = bounds;
+    upd.angle = angle;
+    shard->queryUpdates.push_back(upd);
+    if (type == PendingQueryUpdate::Update && angle == NoUpdateSolidAngle)
+        shard->queryUpdateIndex[object] = shard->queryUpdates.size() - 1;
+
+    if (!shard->queryUpdatesFlushScheduled) {
+        shard->queryUpdatesFlushScheduled = true;
+        shard->strand->post(
+            std::tr1::bind(&Proximity::handleBatchedObjectQueryUpdates, this, shard)
+        );
+    }
+}
+
+void Proximity::handleBatchedObjectQueryUpdates(ProxShard* shard) {
+    ProxShard::PendingQueryUpdateList updates;
+    {
+        boost::lock_guard<boost::mutex> lck(shard->queryUpdatesMutex);
+        updates.swap(shard->queryUpdates);
+        shard->queryUpdateIndex.clear();
+        shard->queryUpdatesFlushScheduled = false;
+    }
+
+    // Applied in arrival order, so a removal followed by a new query and a
+    // position update for the same object comes out the same as if each had
+    // been posted individually.
+    for(ProxShard::PendingQueryUpdateList::iterator it = updates.begin(); it != updates.end(); it++) {
+        switch(it->type) {
+          case PendingQueryUpdate::Update:
+            handleUpdateObjectQuery(shard, it->object, it->loc, it->bounds, it->angle);
+            break;
+          case PendingQueryUpdate::Remove:
+            handleRemoveObjectQuery(shard, it->object);
+            break;
+          case PendingQueryUpdate::Discarded:
+            break;
+        }
+    }
+}
+
+void Proximity::handleRemoveObjectQuery(ProxShard* shard, const UUID& object) {
+    shard->objectQueryParams.erase(object);
+    shard->objectResults.erase(object);
+    shard->objectResync.erase(object);
+
     for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (mServerQueryHandler[i] == NULL) continue;
+        if (shard->serverQueryHandler[i] == NULL) continue;
 
-        ObjectQueryMap::iterator it = mObjectQueries[i].find(object);
-        if (it == mObjectQueries[i].end()) continue;
+        ObjectQueryMap::iterator it = shard->objectQueries[i].find(object);
+        if (it == shard->objectQueries[i].end()) continue;
 
         Query* q = it->second;
-        mObjectQueries[i].erase(it);
-        mInvertedObjectQueries.erase(q);
+        shard->objectQueries[i].erase(it);
+        shard->invertedObjectQueries.erase(q);
         delete q; // Note: Deleting query notifies QueryHandler and unsubscribes.
     }
 
@@ -1250,16 +1875,16 @@ void Proximity::handleCheckObjectClassForHandlers(const UUID& objid, bool is_sta
     handlers[swap_in]->addObject(objid);
 }
 
-void Proximity::handleCheckObjectClass(bool is_local, const UUID& objid, const TimedMotionVector3f& newval) {
+void Proximity::handleCheckObjectClass(ProxShard* shard, bool is_local, const UUID& objid, const TimedMotionVector3f& newval) {
     assert(mSeparateDynamicObjects == true);
 
     // Basic approach: we need to check if the object has switched between
     // static/dynamic. We need to do this for both the local (object query) and
     // global (server query) handlers.
     bool is_static = velocityIsStatic(newval.velocity());
-    handleCheckObjectClassForHandlers(objid, is_static, mObjectQueryHandler);
+    handleCheckObjectClassForHandlers(objid, is_static, shard->objectQueryHandler);
     if (is_local)
-        handleCheckObjectClassForHandlers(objid, is_static, mServerQueryHandler);
+        handleCheckObjectClassForHandlers(objid, is_static, shard->serverQueryHandler);
 }
 
 } // namespace Sirikata
@@ -34,7 +34,7 @@
 #define _SIRIKATA_PROXIMITY_HPP_
 
 #include <sirikata/space/ProxSimulationTraits.hpp>
-#include "CBRLocationServiceCache.hpp"
+#include <sirikata/space/CBRLocationServiceCache.hpp>
 #include <sirikata/space/CoordinateSegmentation.hpp>
 #include "MigrationDataClient.hpp"
 #include <prox/QueryHandler.hpp>
@@ -43,6 +43,7 @@
 #include <sirikata/core/service/PollingService.hpp>
 
 #include <sirikata/core/network/SSTImpl.hpp>
+#include <sirikata/core/network/ProxCompactEncoding.hpp>
 #include <sirikata/core/queue/ThreadSafeQueue.hpp>
 
 #include <sirikata/space/PintoServerQuerier.hpp>
@@ -58,7 +59,6 @@ class ProximityInputEvent;
 class ProximityOutputEvent;
 
 class Proximity :
-        Prox::QueryEventListener<ObjectProxSimulationTraits>,
         LocationServiceListener,
         CoordinateSegmentation::Listener,
         MessageRecipient,
@@ -94,9 +94,6 @@ public:
     void addQuery(UUID obj, SolidAngle sa);
     void removeQuery(UUID obj);
 
-    // QueryEventListener Interface
-    void queryHasEvents(Query* query);
-
     // LocationServiceListener Interface
     virtual void localObjectAdded(const UUID& uuid, bool agg, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics);
     virtual void localObjectRemoved(const UUID& uuid, bool agg);
@@ -152,19 +149,59 @@ private:
     typedef Stream<SpaceObjectReference>::Ptr ProxStreamPtr;
     struct ProxStreamInfo {
     public:
-        ProxStreamInfo()
-         : iostream_requested(false), writing(false) {}
+        ProxStreamInfo(const UUID& _id)
+         : id(_id), iostream_requested(false), compact(false), resync(false), writing(false) {}
 
         void disable() {
             if (iostream)
                 iostream->close(false);
         }
+
+        // A result for a single observed object which hasn't been sent
+        // yet. Results for the same object are merged: an addition
+        // followed by a removal cancels out, and a removal followed by an
+        // addition becomes a remove-then-add so the client refreshes it.
+        struct PendingResult {
+            PendingResult() : remove(false), add(false) {}
+
+            bool remove;
+            bool add;
+            // Addition data, only valid if add is set
+            TimedMotionVector3f location;
+            TimedMotionQuaternion orientation;
+            BoundingSphere3f bounds;
+            String mesh;
+            String physics;
+        };
+        typedef std::tr1::unordered_map<UUID, PendingResult, UUID::Hasher> PendingResultMap;
+
+        // The object we're sending results to
+        UUID id;
         // The actual stream we send on
         ProxStreamPtr iostream;
         // Whether we've requested the iostream
         bool iostream_requested;
-        // Outstanding data to be sent. FIXME efficiency
-        std::queue<std::string> outstanding;
+        // Whether the client asked for the compact encoding, and the
+        // encoder state, which has to persist for the life of the stream.
+        bool compact;
+        Network::ProxCompactEncoder encoder;
+        // Partial frames read from the client
+        std::string readbuf;
+        // Outstanding results, bounded by OPT_PROX_MAX_OBJECT_RESULTS. The
+        // order list may contain stale entries for results which were
+        // cancelled, they are skipped when sending.
+        PendingResultMap pending;
+        std::deque<UUID> pendingOrder;
+        // The objects currently in the query's results and the ones the
+        // client has been sent. They differ only by what's pending unless
+        // the queue fills up. Then results stop being queued and, once the
+        // queue drains, the client is brought up to date from the
+        // difference, see resyncObjectResults.
+        std::set<UUID> results;
+        std::set<UUID> sent;
+        bool resync;
+        // Remainder of the framed message currently being written
+        std::string partial;
         // If writing is currently in progress
         bool writing;
         // Stored callback for writing
@@ -185,6 +222,15 @@ private:
     // Utility for poll.  Queues a message for delivery, encoding it and putting
     // it on the send stream.  If necessary, starts send processing on the stream.
     void sendObjectResult(Sirikata::Protocol::Object::ObjectMessage*);
+    // Merge individual results into a stream's pending queue.
+    void queueObjectAddition(ProxStreamInfoPtr prox_stream, const UUID& objid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics);
+    void queueObjectRemoval(ProxStreamInfoPtr prox_stream, const UUID& objid);
+    // Queues whatever the client is missing after the queue overflowed. Only
+    // valid once the queue has drained.
+    void resyncObjectResults(ProxStreamInfoPtr prox_stream);
+    // Encode the next message's worth of pending results. Returns false if
+    // there was nothing to send.
+    bool encodeObjectResults(ProxStreamInfoPtr prox_stream, std::string* framed_out);
     // The driver for getting data to the OH, initially triggered by sendObjectResults
     void writeSomeObjectResults(ProxStreamInfoWPtr prox_stream);
     // Helper for setting up the initial proximity stream. Retries automatically
@@ -192,6 +238,9 @@ private:
     void requestProxSubstream(const UUID& objid, ProxStreamInfoPtr prox_stream);
     // Helper that handles callbacks about prox stream setup
     void proxSubstreamCallback(int x, ProxStreamPtr parent_stream, ProxStreamPtr substream, ProxStreamInfoPtr prox_stream_info);
+    // Handles data from the client on the prox stream, i.e. requests for the
+    // compact encoding.
+    void handleProxSubstreamRead(ProxStreamInfoWPtr w_prox_stream, uint8* buffer, int length);
 
     // Server queries requests, generated by receiving messages
     void updateQuery(ServerID sid, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& sa);
@@ -223,24 +272,53 @@ private:
     void handleRemoveAllServerLocSubscription(const ServerID& subscriber);
 
 
-    // PROX Thread: These are utility methods which should only be called from the prox thread.
-    // The main loop for the prox processing thread
-    void proxThreadMain();
+    // PROX Thread: These are utility methods which should only be called from a
+    // prox thread. Each takes the shard it is running in.
+    struct ProxShard;
+    // An object query update or removal queued for a shard, see
+    // queueObjectQueryUpdate.
+    struct PendingQueryUpdate {
+        enum Type {
+            Update,
+            Remove,
+            Discarded
+        };
+        Type type;
+        UUID object;
+        TimedMotionVector3f loc;
+        BoundingSphere3f bounds;
+        SolidAngle angle;
+    };
+    // Shard selection. Queries are partitioned by the ID of their owner so
+    // that all events for a query are generated by a single thread.
+    ProxShard* shardFor(const UUID& obj);
+    ProxShard* shardFor(ServerID sid);
+    // The main loop for a prox processing thread
+    void proxThreadMain(ProxShard* shard);
     // Handle various query events from the main thread
-    void handleUpdateServerQuery(const ServerID& server, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle);
-    void handleRemoveServerQuery(const ServerID& server);
+    void handleUpdateServerQuery(ProxShard* shard, const ServerID& server, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle);
+    void handleRemoveServerQuery(ProxShard* shard, const ServerID& server);
     void handleConnectedServer(ServerID sid);
-    void handleDisconnectedServer(ServerID sid);
-    void handleUpdateObjectQuery(const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle);
-    void handleRemoveObjectQuery(const UUID& object);
+    void handleDisconnectedServer(ProxShard* shard, ServerID sid);
+    void handleUpdateObjectQuery(ProxShard* shard, const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle);
+    // Main thread: queue an object query update or removal for the shard
+    // when batching, see mBatchUpdates
+    void queueObjectQueryUpdate(ProxShard* shard, PendingQueryUpdate::Type type, const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle);
+    // Applies queued query updates and removals in order, see mBatchUpdates
+    void handleBatchedObjectQueryUpdates(ProxShard* shard);
+    void handleRemoveObjectQuery(ProxShard* shard, const UUID& object);
     // Generate query events based on results collected from query handlers
-    void generateServerQueryEvents(Query* query);
-    void generateObjectQueryEvents(Query* query);
+    void generateServerQueryEvents(ProxShard* shard, Query* query);
+    void generateObjectQueryEvents(ProxShard* shard, Query* query);
+    // Generate removal events for a set of objects, without a Query. Used to
+    // reconcile results after swapping in rebuilt handlers.
+    void sendServerRemovals(ServerID sid, const std::set<UUID>& objects);
+    void sendObjectRemovals(const UUID& query_id, const std::set<UUID>& objects);
 
     // Decides whether a query handler should handle a particular object.
     bool handlerShouldHandleObject(bool is_static_handler, bool is_global_handler, const UUID& obj_id, bool local, const TimedMotionVector3f& pos, const BoundingSphere3f& region, float maxSize);
     // The real handler for moving objects between static/dynamic
-    void handleCheckObjectClass(bool is_local, const UUID& objid, const TimedMotionVector3f& newval);
+    void handleCheckObjectClass(ProxShard* shard, bool is_local, const UUID& objid, const TimedMotionVector3f& newval);
     void handleCheckObjectClassForHandlers(const UUID& objid, bool is_static, ProxQueryHandler* handlers[NUM_OBJECT_CLASSES]);
 
 
@@ -306,41 +384,190 @@ private:
 
     typedef std::tr1::unordered_map<UUID, ProxStreamInfoPtr, UUID::Hasher> ObjectProxStreamMap;
     ObjectProxStreamMap mObjectProxStreams;
+    uint32 mMaxObjectResults;
+    // Whether clients are allowed to use the compact result encoding
+    bool mCompactResults;
+    // Results which never had to be sent because they were merged with
+    // another result for the same object, and results which weren't queued
+    // because a queue was full and were caught up on later instead.
+    uint64 mObjectResultsCoalesced;
+    uint64 mObjectResultsDropped;
 
     typedef std::tr1::function<void()> AggregateEventHandler;
     Sirikata::ThreadSafeQueue<AggregateEventHandler> mAggregateEventHandlers;
     void scheduleAggregateEventHandler(); // Schedule main thread to handle events
     void invokeAggregateEventHandler(); // Worker which invokes handler events
 
-    // PROX Thread - Should only be accessed in methods used by the main thread
+    // PROX Threads - Each shard is only accessed by its own prox thread
 
     void tickQueryHandler(ProxQueryHandler* qh[NUM_OBJECT_CLASSES]);
-    void rebuildHandler(ObjectClass objtype);
 
-    Thread* mProxThread;
-    Network::IOService* mProxService;
-    Network::IOStrand* mProxStrand;
-    Sirikata::AtomicValue<bool> mShutdownProxThread;
+    // Query handler setup, split so initialization, which inserts every
+    // object, can happen in another thread.
+    void createQueryHandlers(ProxQueryHandler* server_handlers[NUM_OBJECT_CLASSES], ProxQueryHandler* object_handlers[NUM_OBJECT_CLASSES]);
+    void initializeQueryHandlers(CBRLocationServiceCache* loccache, ProxQueryHandler* server_handlers[NUM_OBJECT_CLASSES], ProxQueryHandler* object_handlers[NUM_OBJECT_CLASSES]);
+
+    // Rebuilding is double buffered so the prox thread never stalls: a new
+    // location cache is attached (MAIN thread) and paused, it is filled from
+    // a snapshot of the current cache (PROX thread), new handlers are built
+    // from it in a separate thread, and finally the updates received in the
+    // meantime are replayed and the new handlers swapped in (PROX thread).
+    void startRebuild(ProxShard* shard);
+    void handleRebuildCreateCache(ProxShard* shard);
+    void handleRebuildSnapshot(ProxShard* shard, CBRLocationServiceCache* cache);
+    void rebuildThreadMain(ProxShard* shard);
+    void handleRebuildFinished(ProxShard* shard);
+    // After a swap, the new handlers may take several ticks to report all
+    // their initial results. This waits until they stop confirming old
+    // results, then reports removals for results reported by the old
+    // handlers which the new handlers didn't report.
+    void checkResync(ProxShard* shard);
+    void finishResync(ProxShard* shard);
+    // Retiring the old cache: detach in the main thread, then delete in the
+    // prox thread after any updates it had already queued.
+    void handleRetireLocCache(ProxShard* shard, CBRLocationServiceCache* cache);
+    void handleDeleteLocCache(CBRLocationServiceCache* cache);
+
+    // Receives events for the queries of one shard and one query type, so
+    // they are handled knowing which shard they belong to without looking at
+    // any other shard's state.
+    class ShardQueryListener : public Prox::QueryEventListener<ObjectProxSimulationTraits> {
+    public:
+        ShardQueryListener(Proximity* parent, ProxShard* shard, bool server_queries)
+         : mParent(parent),
+           mShard(shard),
+           mServerQueries(server_queries)
+        {}
+
+        virtual void queryHasEvents(Query* query) {
+            if (mServerQueries)
+                mParent->generateServerQueryEvents(mShard, query);
+            else
+                mParent->generateObjectQueryEvents(mShard, query);
+        }
+
+    private:
+        Proximity* mParent;
+        ProxShard* mShard;
+        bool mServerQueries;
+    };
+
+    // A shard is an independent slice of the proximity work: it has its own
+    // thread, its own view of the location cache and its own set of query
+    // handlers. Every shard tracks all objects, but only evaluates the
+    // queries which hash to it.
+    struct ProxShard {
+        ProxShard(Proximity* parent)
+         : index(0),
+           thread(NULL),
+           service(NULL),
+           strand(NULL),
+           locCache(NULL),
+           serverQueries(),
+           serverQueryListener(parent, this, true),
+           objectQueries(),
+           objectQueryListener(parent, this, false),
+           queryUpdatesFlushScheduled(false),
+           resyncRemaining(0),
+           rebuilding(false),
+           rebuildThread(NULL),
+           rebuildCache(NULL)
+        {
+            for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+                serverQueryHandler[i] = NULL;
+                objectQueryHandler[i] = NULL;
+                rebuildServerQueryHandler[i] = NULL;
+                rebuildObjectQueryHandler[i] = NULL;
+            }
+        }
 
-    CBRLocationServiceCache* mLocCache;
+        uint32 index;
+
+        Thread* thread;
+        Network::IOService* service;
+        Network::IOStrand* strand;
+
+        CBRLocationServiceCache* locCache;
+
+        // These track local objects and answer queries from other
+        // servers.
+        ServerQueryMap serverQueries[NUM_OBJECT_CLASSES];
+        InvertedServerQueryMap invertedServerQueries;
+        ProxQueryHandler* serverQueryHandler[NUM_OBJECT_CLASSES];
+        ShardQueryListener serverQueryListener;
+
+        // These track all objects being reported to this server and
+        // answer queries for objects connected to this server.
+        ObjectQueryMap objectQueries[NUM_OBJECT_CLASSES];
+        InvertedObjectQueryMap invertedObjectQueries;
+        ProxQueryHandler* objectQueryHandler[NUM_OBJECT_CLASSES];
+        ShardQueryListener objectQueryListener;
+
+        // Object query updates and removals, filled in by the main thread in
+        // arrival order and drained by this shard's thread. A position-only
+        // update replaces the previous one for the same object as long as
+        // nothing else for that object was queued in between.
+        typedef std::vector<PendingQueryUpdate> PendingQueryUpdateList;
+        // Index of each object's last queued update, only while it is a
+        // position-only update that can still be replaced.
+        typedef std::tr1::unordered_map<UUID, uint32, UUID::Hasher> PendingQueryIndexMap;
+        boost::mutex queryUpdatesMutex;
+        PendingQueryUpdateList queryUpdates;
+        PendingQueryIndexMap queryUpdateIndex;
+        bool queryUpdatesFlushScheduled;
+
+        // Parameters for each registered query so they can be registered
+        // again with rebuilt handlers.
+        struct QueryParams {
+            TimedMotionVector3f loc;
+            BoundingSphere3f bounds;
+            SolidAngle angle;
+        };
+        typedef std::tr1::unordered_map<ServerID, QueryParams> ServerQueryParamsMap;
+        typedef std::tr1::unordered_map<UUID, QueryParams, UUID::Hasher> ObjectQueryParamsMap;
+        ServerQueryParamsMap serverQueryParams;
+        ObjectQueryParamsMap objectQueryParams;
+
+        // Results which have been reported for each query. After a rebuild,
+        // these are moved to the resync maps and are removed from them as
+        // the new queries report them again, so we neither report duplicate
+        // additions nor miss removals.
+        typedef std::tr1::unordered_map<ServerID, ObjectSet> ServerResultsMap;
+        typedef std::tr1::unordered_map<UUID, ObjectSet, UUID::Hasher> ObjectResultsMap;
+        ServerResultsMap serverResults;
+        ObjectResultsMap objectResults;
+        ServerResultsMap serverResync;
+        ObjectResultsMap objectResync;
+        // Resync results left unconfirmed at the last checkResync
+        uint32 resyncRemaining;
+
+        // Background rebuild state
+        bool rebuilding;
+        Thread* rebuildThread;
+        CBRLocationServiceCache* rebuildCache;
+        ProxQueryHandler* rebuildServerQueryHandler[NUM_OBJECT_CLASSES];
+        ProxQueryHandler* rebuildObjectQueryHandler[NUM_OBJECT_CLASSES];
+    };
+    typedef std::vector<ProxShard*> ProxShardList;
+    ProxShardList mShards;
+    Sirikata::AtomicValue<bool> mShutdownProxThread;
 
-    // These track local objects and answer queries from other
-    // servers.
-    ServerQueryMap mServerQueries[NUM_OBJECT_CLASSES];
-    InvertedServerQueryMap mInvertedServerQueries;
-    ProxQueryHandler* mServerQueryHandler[NUM_OBJECT_CLASSES];
     bool mServerDistance; // Using distance queries
+    bool mObjectDistance; // Using distance queries
+
+    // Whether location updates are batched, both in the location caches and
+    // for updates to object queries.
+    bool mBatchUpdates;
+
+    String mServerHandlerType;
+    String mServerHandlerOptions;
+    String mObjectHandlerType;
+    String mObjectHandlerOptions;
+
     // Results from queries to other servers, so we know what we need to remove
     // on forceful disconnection
     ServerQueryResultSet mServerQueryResults;
 
-    // These track all objects being reported to this server and
-    // answer queries for objects connected to this server.
-    ObjectQueryMap mObjectQueries[NUM_OBJECT_CLASSES];
-    InvertedObjectQueryMap mInvertedObjectQueries;
-    ProxQueryHandler* mObjectQueryHandler[NUM_OBJECT_CLASSES];
-    bool mObjectDistance; // Using distance queries
-
     // Threads: Thread-safe data used for exchange between threads
     Sirikata::ThreadSafeQueue<Message*> mServerResults; // server query results that need to be sent
     Sirikata::ThreadSafeQueue<Sirikata::Protocol::Object::ObjectMessage*> mObjectResults; // object query results that need to be sent
@@ -43,7 +43,10 @@ ServerMessageQueue::ServerMessageQueue(SpaceContext* ctx, SpaceNetwork* net, Sen
           mSender(sender),
           mUsedWeightSum(0.0),
           mCapacityEstimator(Duration::milliseconds((int64)200).toSeconds()),
-          mBlocked(false)
+          mBlocked(false),
+          mSentMessages(0),
+          mSentHeaderBytes(0),
+          mSentPayloadBytes(0)
 {
     mProfiler = mContext->profiler->addStage("Server Message Queue");
     mNetwork->setSendListener(this);
@@ -80,13 +83,19 @@ uint32 ServerMessageQueue::trySend(const ServerID& dest, const Message* msg) {
     if (strm_out==NULL) {
         return 0;
     }
-    Network::Chunk serialized;
-    msg->serialize(&serialized);
-    uint32 packet_size = serialized.size();
-    bool sent_success = strm_out->send(serialized);
+    // Only the header is serialized here, the payload goes to the network
+    // straight from the Message's buffer.
+    std::string header;
+    msg->serializeHeader(&header);
+    const Network::SharedBuffer& payload = msg->payloadBuffer();
+    uint32 packet_size = header.size() + payload.size();
+    bool sent_success = strm_out->send(MemoryReference(header), payload.ref());
 
     if (sent_success) {
         TIMESTAMP_PAYLOAD(msg, Trace::SPACE_TO_SPACE_HIT_NETWORK);
+        mSentMessages++;
+        mSentHeaderBytes += header.size();
+        mSentPayloadBytes += payload.size();
         return packet_size;
     }
 
@@ -116,6 +116,12 @@ public:
     bool mBlocked; // Implementations should set this when the network gets
                    // blocked.  It will cause us to report actual measured
                    // capacity instead of an overestimate.
+
+    // Stats on data handed to the network. Header bytes are serialized (and
+    // copied) per send, payload bytes are passed through by reference.
+    uint64 mSentMessages;
+    uint64 mSentHeaderBytes;
+    uint64 mSentPayloadBytes;
 };
 }
 
@@ -59,7 +59,10 @@ public:
 
         virtual void serverConnectionReceived(ServerID sid) = 0;
 
-        virtual void serverMessageReceived(Message* msg) = 0;
+        /** Invoked with each batch of messages pulled from the network. The
+         *  listener takes ownership of the messages.
+         */
+        virtual void serverMessagesReceived(const std::vector<Message*>& msgs) = 0;
     };
 
     ServerMessageReceiver(SpaceContext* ctx, SpaceNetwork* net, Listener* listener);
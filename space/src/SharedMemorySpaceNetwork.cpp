@@ -0,0 +1,680 @@
+/*  Sirikata
+ *  SharedMemorySpaceNetwork.cpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SharedMemorySpaceNetwork.hpp"
+#include "TCPSpaceNetwork.hpp"
+#include "Options.hpp"
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrandImpl.hpp>
+#include <sirikata/core/network/ServerIDMap.hpp>
+#include <sirikata/core/options/CommonOptions.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <boost/interprocess/exceptions.hpp>
+
+#define SHMNET_LOG(level,msg) SILOG(shmnet,level,msg)
+
+namespace Sirikata {
+
+namespace bip = boost::interprocess;
+
+// Senders announce new rings by filling in a free entry, and the receiver frees
+// it again once it has picked the ring up, so entries are only in use while a
+// registration is pending. Like rings, a zero filled directory is valid, so
+// either side may create it.
+struct SharedMemorySpaceNetwork::Directory {
+    enum {
+        MAX_SENDERS = 1024
+    };
+    struct Entry {
+        enum State {
+            Free = 0,
+            Claimed = 1, // Being filled in by a sender
+            Ready = 2 // Sender, incarnation and sequence are valid
+        };
+        volatile uint32 state;
+        uint32 sender;
+        uint64 incarnation;
+        uint32 sequence;
+        uint32 padding;
+    };
+
+    // The incarnation of the receiver currently listening, 0 if none.
+    // Senders watch this to find out their rings are no longer being read.
+    volatile uint64 epoch;
+    // One past the highest entry ever claimed, so the receiver doesn't have to
+    // scan the whole directory
+    volatile uint32 count;
+    uint32 padding;
+    Entry entries[MAX_SENDERS];
+};
+
+namespace {
+uint32 roundUpPowerOfTwo(uint32 v) {
+    uint32 result = 1;
+    while(result < v) result <<= 1;
+    return result;
+}
+
+// How often a sender without a working ring tries to register a new one
+Duration registerRetryInterval() {
+    return Duration::milliseconds((int64)100);
+}
+}
+
+
+SharedMemorySpaceNetwork::ShmSendStream::ShmSendStream(ServerID sid)
+ : nextRegister(Time::null()),
+   mID(sid),
+   mDirectorySegment(NULL),
+   mRing(NULL),
+   mEpoch(0),
+   mBlockedSize(0),
+   mLost(false)
+{
+}
+
+SharedMemorySpaceNetwork::ShmSendStream::~ShmSendStream() {
+    delete mRing;
+    delete mDirectorySegment;
+}
+
+ServerID SharedMemorySpaceNetwork::ShmSendStream::id() const {
+    return mID;
+}
+
+bool SharedMemorySpaceNetwork::ShmSendStream::send(const Chunk& data) {
+    return send(MemoryReference(data), MemoryReference::null());
+}
+
+bool SharedMemorySpaceNetwork::ShmSendStream::send(MemoryReference first, MemoryReference second) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+
+    // Without a ring the network strand tells the sender when to retry, once
+    // a new one is registered
+    if (!checkReceiverLocked())
+        return false;
+
+    if (mRing->write(first, second))
+        return true;
+
+    uint32 msg_size = (uint32)(first.size() + second.size());
+    if (Ring::recordSize(msg_size) > mRing->maxRecordSize()) {
+        SHMNET_LOG(error,"Message of " << msg_size << " bytes to server " << mID << " can never fit in the shared memory ring, increase --shm-net.ring-size");
+        return false;
+    }
+    // Remember what we need room for so the poller can tell the sender when to
+    // retry. Empty messages still need space for their length.
+    mBlockedSize = std::max(msg_size, (uint32)1);
+    return false;
+}
+
+void SharedMemorySpaceNetwork::ShmSendStream::setConnection(Segment* directory, Ring* ring, uint64 epoch) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+
+    delete mRing;
+    delete mDirectorySegment;
+    mDirectorySegment = directory;
+    mRing = ring;
+    mEpoch = epoch;
+    mBlockedSize = 0;
+}
+
+bool SharedMemorySpaceNetwork::ShmSendStream::checkReceiverLocked() {
+    if (mRing == NULL)
+        return false;
+
+    Directory* dir = (Directory*)mDirectorySegment->data();
+    if (dir->epoch == mEpoch)
+        return true;
+
+    // The receiver shut down or restarted, either way nobody is going to read
+    // this ring anymore.
+    delete mRing;
+    mRing = NULL;
+    delete mDirectorySegment;
+    mDirectorySegment = NULL;
+    mBlockedSize = 0;
+    mLost = true;
+    return false;
+}
+
+bool SharedMemorySpaceNetwork::ShmSendStream::checkReceiver() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    return checkReceiverLocked();
+}
+
+bool SharedMemorySpaceNetwork::ShmSendStream::takeLost() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    bool result = mLost;
+    mLost = false;
+    return result;
+}
+
+bool SharedMemorySpaceNetwork::ShmSendStream::blocked() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    return (mBlockedSize != 0);
+}
+
+bool SharedMemorySpaceNetwork::ShmSendStream::unblocked() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    if (mRing == NULL || mBlockedSize == 0 || !mRing->hasSpaceFor(mBlockedSize))
+        return false;
+    mBlockedSize = 0;
+    return true;
+}
+
+
+SharedMemorySpaceNetwork::ShmReceiveStream::ShmReceiveStream(ServerID sid)
+ : mID(sid),
+   mRing(NULL),
+   mRetiredRing(NULL),
+   mIncarnation(0),
+   mSequence(0),
+   mFront(NULL),
+   mNotified(0)
+{
+}
+
+SharedMemorySpaceNetwork::ShmReceiveStream::~ShmReceiveStream() {
+    delete mFront;
+    delete mRing;
+    delete mRetiredRing;
+}
+
+ServerID SharedMemorySpaceNetwork::ShmReceiveStream::id() const {
+    return mID;
+}
+
+Network::Chunk* SharedMemorySpaceNetwork::ShmReceiveStream::readNext() {
+    if (mRetiredRing != NULL) {
+        Chunk* result = mRetiredRing->read();
+        if (result != NULL)
+            return result;
+        delete mRetiredRing;
+        mRetiredRing = NULL;
+    }
+    if (mRing == NULL)
+        return NULL;
+    return mRing->read();
+}
+
+Network::Chunk* SharedMemorySpaceNetwork::ShmReceiveStream::front() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+
+    if (mFront != NULL)
+        return mFront;
+
+    // Clear the notification flag *before* looking for data so that data
+    // arriving after we find the rings empty always triggers a notification.
+    mNotified = 0;
+    memory_barrier();
+    mFront = readNext();
+    if (mFront != NULL)
+        mNotified = 1;
+    return mFront;
+}
+
+Network::Chunk* SharedMemorySpaceNetwork::ShmReceiveStream::pop() {
+    Chunk* result = front();
+
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    assert(result == mFront);
+    mFront = NULL;
+    return result;
+}
+
+uint32 SharedMemorySpaceNetwork::ShmReceiveStream::popBatch(std::vector<Chunk*>& chunks, uint32 max_chunks) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+
+    uint32 npopped = 0;
+    if (mFront != NULL && max_chunks > 0) {
+        chunks.push_back(mFront);
+        mFront = NULL;
+        npopped++;
+    }
+    while(npopped < max_chunks) {
+        Chunk* c = readNext();
+        if (c == NULL) {
+            // Same as front(), clear the flag before the final check
+            mNotified = 0;
+            memory_barrier();
+            c = readNext();
+            if (c == NULL) break;
+            mNotified = 1;
+        }
+        chunks.push_back(c);
+        npopped++;
+    }
+    return npopped;
+}
+
+void SharedMemorySpaceNetwork::ShmReceiveStream::setRing(Ring* ring, uint64 incarnation, uint32 sequence) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+
+    if (mRing != NULL) {
+        // A sender that registered twice before we drained the first ring
+        // loses whatever was left in it, which is no worse than a TCP
+        // connection dropping.
+        delete mRetiredRing;
+        mRetiredRing = mRing;
+    }
+    mRing = ring;
+    mIncarnation = incarnation;
+    mSequence = sequence;
+}
+
+bool SharedMemorySpaceNetwork::ShmReceiveStream::isNewer(uint64 incarnation, uint32 sequence) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    // Incarnations increase across restarts of the sender, sequences across
+    // registrations within one run
+    if (incarnation != mIncarnation)
+        return incarnation > mIncarnation;
+    return sequence > mSequence;
+}
+
+bool SharedMemorySpaceNetwork::ShmReceiveStream::shouldNotify() {
+    if (mNotified != 0)
+        return false;
+
+    // If the receiver is busy with the stream it will either find the data
+    // itself or clear mNotified, so we can just check again on the next poll.
+    boost::mutex::scoped_try_lock lck(mMutex);
+    if (!lck.owns_lock())
+        return false;
+
+    bool has_data =
+        (mFront != NULL) ||
+        (mRetiredRing != NULL && !mRetiredRing->empty()) ||
+        (mRing != NULL && !mRing->empty());
+    if (!has_data)
+        return false;
+
+    return SizedAtomicValue<sizeof(uint32)>::cas(&mNotified, (uint32)0, (uint32)1);
+}
+
+
+
+SharedMemorySpaceNetwork::SharedMemorySpaceNetwork(SpaceContext* ctx)
+ : SpaceNetwork(ctx),
+   mTCP(new TCPSpaceNetwork(ctx)),
+   mName(GetOptionValue<String>(SHM_NETWORK_NAME)),
+   mRingSize(roundUpPowerOfTwo(std::max(GetOptionValue<uint32>(SHM_NETWORK_RING_SIZE), (uint32)4096))),
+   mMinPollInterval(GetOptionValue<Duration>(SHM_NETWORK_POLL_INTERVAL)),
+   mMaxPollInterval(std::max(GetOptionValue<Duration>(SHM_NETWORK_MAX_POLL_INTERVAL), mMinPollInterval)),
+   mPollInterval(mMinPollInterval),
+   mIncarnation(Timer::now().raw()),
+   mRegistrations(0),
+   mLocalAddress(),
+   mIOStrand(ctx->ioService->createStrand()),
+   mStopping(false),
+   mSendListener(NULL),
+   mReceiveListener(NULL),
+   mDirectorySegment(NULL),
+   mDirectory(NULL)
+{
+    mTCP->addListener(this);
+
+    mPollTimer = Network::IOTimer::create(
+        ctx->ioService,
+        mIOStrand->wrap( std::tr1::bind(&SharedMemorySpaceNetwork::poll, this) )
+    );
+}
+
+SharedMemorySpaceNetwork::~SharedMemorySpaceNetwork() {
+    mPollTimer->cancel();
+
+    mTCP->removeListener(this);
+    delete mTCP;
+
+    for(SendStreamMap::iterator it = mSendStreams.begin(); it != mSendStreams.end(); it++)
+        delete it->second;
+    mSendStreams.clear();
+    for(ReceiveStreamMap::iterator it = mReceiveStreams.begin(); it != mReceiveStreams.end(); it++)
+        delete it->second;
+    mReceiveStreams.clear();
+
+    // Let senders know nobody is listening anymore, since they can't tell the
+    // directory has been removed
+    if (mDirectory != NULL) {
+        mDirectory->epoch = 0;
+        memory_barrier();
+    }
+    delete mDirectorySegment;
+
+    delete mIOStrand;
+}
+
+void SharedMemorySpaceNetwork::start() {
+    static_cast<Service*>(mTCP)->start();
+    mIOStrand->post( std::tr1::bind(&SharedMemorySpaceNetwork::poll, this) );
+}
+
+void SharedMemorySpaceNetwork::stop() {
+    mStopping = true;
+    mPollTimer->cancel();
+    static_cast<Service*>(mTCP)->stop();
+}
+
+String SharedMemorySpaceNetwork::directoryName(const ServerID& receiver) const {
+    std::ostringstream os;
+    os << mName << "-" << receiver;
+    return os.str();
+}
+
+String SharedMemorySpaceNetwork::ringName(const ServerID& sender, const ServerID& receiver, uint64 incarnation, uint32 sequence) const {
+    std::ostringstream os;
+    os << mName << "-" << sender << "-" << receiver << "-" << std::hex << incarnation << "-" << sequence;
+    return os.str();
+}
+
+bool SharedMemorySpaceNetwork::isLocal(const ServerID& sid) {
+    if (mServerIDMap == NULL)
+        return false;
+
+    if (mLocalAddress == Address4()) {
+        Address4* self = mServerIDMap->lookupInternal(mContext->id());
+        if (self == NULL)
+            return false;
+        mLocalAddress = *self;
+    }
+
+    Address4* remote = mServerIDMap->lookupInternal(sid);
+    if (remote == NULL)
+        return false;
+
+    // Address4 keeps the address in network order, so the first byte is the
+    // first octet
+    bool remote_loopback = ((const uint8*)&remote->ip)[0] == 127;
+    return (remote->ip == mLocalAddress.ip) || remote_loopback;
+}
+
+void SharedMemorySpaceNetwork::setSendListener(SendListener* sl) {
+    mSendListener = sl;
+    mTCP->setSendListener(sl);
+}
+
+void SharedMemorySpaceNetwork::listen(const ServerID& as_server, ReceiveListener* receive_listener) {
+    mReceiveListener = receive_listener;
+
+    // Remote servers still reach us over TCP
+    mTCP->setServerIDMap(mServerIDMap);
+    mTCP->listen(as_server, receive_listener);
+
+    try {
+        mDirectorySegment = new Segment(directoryName(as_server), Segment::OpenOrCreate, sizeof(Directory), true);
+        mDirectory = (Directory*)mDirectorySegment->data();
+        // Senders registered with a previous run will notice the change and
+        // register again
+        memory_barrier();
+        mDirectory->epoch = mIncarnation;
+        SHMNET_LOG(info,"Listening for local space servers on " << directoryName(as_server));
+    }
+    catch(bip::interprocess_exception& e) {
+        SHMNET_LOG(error,"Couldn't create shared memory directory, only TCP connections will be accepted: " << e.what());
+        mDirectorySegment = NULL;
+        mDirectory = NULL;
+    }
+}
+
+SpaceNetwork::SendStream* SharedMemorySpaceNetwork::connect(const ServerID& addr) {
+    mTCP->setServerIDMap(mServerIDMap);
+
+    if (!isLocal(addr))
+        return mTCP->connect(addr);
+
+    {
+        boost::lock_guard<boost::mutex> lck(mMutex);
+        SendStreamMap::iterator it = mSendStreams.find(addr);
+        if (it != mSendStreams.end())
+            return it->second;
+    }
+
+    ShmSendStream* strm = new ShmSendStream(addr);
+    RegisterResult res = registerStream(strm);
+    if (res == RegisterFailed) {
+        delete strm;
+        SHMNET_LOG(warning,"Falling back to TCP for local server " << addr);
+        return mTCP->connect(addr);
+    }
+    if (res == NotListening) {
+        SHMNET_LOG(info,"Local server " << addr << " isn't listening for shared memory connections yet, will keep trying");
+        strm->nextRegister = Timer::now() + registerRetryInterval();
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lck(mMutex);
+        mSendStreams[addr] = strm;
+    }
+
+    if (res == Registered) {
+        SHMNET_LOG(info,"Connected to local server " << addr << " through shared memory");
+        notify(&SpaceNetworkConnectionListener::onSpaceNetworkConnected, addr);
+        // As with TCP, tell the sender it can start sending, since the send
+        // which triggered the connection may have failed.
+        mSendListener->networkReadyToSend(addr);
+    }
+    return strm;
+}
+
+SharedMemorySpaceNetwork::RegisterResult SharedMemorySpaceNetwork::registerStream(ShmSendStream* strm) {
+    ServerID dest = strm->id();
+
+    Segment* dir_seg = NULL;
+    try {
+        dir_seg = new Segment(directoryName(dest), Segment::OpenOrCreate, sizeof(Directory), false);
+    }
+    catch(bip::interprocess_exception& e) {
+        SHMNET_LOG(error,"Couldn't open shared memory directory for server " << dest << ": " << e.what());
+        return RegisterFailed;
+    }
+
+    // Only register with a receiver that's listening, so any change to the
+    // epoch afterwards means the ring has been abandoned
+    Directory* dir = (Directory*)dir_seg->data();
+    uint64 epoch = dir->epoch;
+    if (epoch == 0) {
+        delete dir_seg;
+        return NotListening;
+    }
+    memory_barrier();
+
+    uint32 sequence = SizedAtomicValue<sizeof(uint32)>::inc(&mRegistrations);
+    Segment* ring_seg = NULL;
+    try {
+        ring_seg = new Segment(ringName(mContext->id(), dest, mIncarnation, sequence), Segment::CreateNew, Ring::segmentSize(mRingSize), true);
+    }
+    catch(bip::interprocess_exception& e) {
+        SHMNET_LOG(error,"Couldn't set up shared memory ring for server " << dest << ": " << e.what());
+        delete dir_seg;
+        return RegisterFailed;
+    }
+
+    uint32 idx = Directory::MAX_SENDERS;
+    for(uint32 i = 0; i < Directory::MAX_SENDERS; i++) {
+        if (dir->entries[i].state == Directory::Entry::Free &&
+            SizedAtomicValue<sizeof(uint32)>::cas(&dir->entries[i].state, (uint32)Directory::Entry::Free, (uint32)Directory::Entry::Claimed)) {
+            idx = i;
+            break;
+        }
+    }
+    if (idx == Directory::MAX_SENDERS) {
+        SHMNET_LOG(error,"Shared memory directory for server " << dest << " is full");
+        delete dir_seg;
+        delete ring_seg;
+        return RegisterFailed;
+    }
+    dir->entries[idx].sender = mContext->id();
+    dir->entries[idx].incarnation = mIncarnation;
+    dir->entries[idx].sequence = sequence;
+    memory_barrier();
+    dir->entries[idx].state = Directory::Entry::Ready;
+    while(true) {
+        uint32 count = dir->count;
+        if (count > idx || SizedAtomicValue<sizeof(uint32)>::cas(&dir->count, count, idx + 1))
+            break;
+    }
+
+    // Keep the directory mapped to watch the receiver's epoch
+    strm->setConnection(dir_seg, new Ring(ring_seg), epoch);
+    return Registered;
+}
+
+bool SharedMemorySpaceNetwork::checkDirectory() {
+    bool found = false;
+    uint32 count = std::min((uint32)mDirectory->count, (uint32)Directory::MAX_SENDERS);
+    for(uint32 idx = 0; idx < count; idx++) {
+        Directory::Entry& entry = mDirectory->entries[idx];
+        // Unused, or a registration still in progress which we'll pick up on a
+        // later poll
+        if (entry.state != Directory::Entry::Ready)
+            continue;
+        memory_barrier();
+
+        ServerID sender = entry.sender;
+        uint64 incarnation = entry.incarnation;
+        uint32 sequence = entry.sequence;
+        // Everything we need is copied out, so the entry can be reused
+        memory_barrier();
+        entry.state = Directory::Entry::Free;
+        found = true;
+
+        ShmReceiveStream* strm = NULL;
+        {
+            boost::lock_guard<boost::mutex> lck(mMutex);
+            ReceiveStreamMap::iterator it = mReceiveStreams.find(sender);
+            if (it != mReceiveStreams.end())
+                strm = it->second;
+        }
+        // Entries are scanned in directory order, not registration order, so
+        // this may be a stale registration
+        if (strm != NULL && !strm->isNewer(incarnation, sequence))
+            continue;
+
+        Ring* ring = NULL;
+        try {
+            ring = new Ring(new Segment(ringName(sender, mContext->id(), incarnation, sequence), Segment::OpenExisting, 0, false));
+        }
+        catch(bip::interprocess_exception& e) {
+            // Most likely the sender has already shut down or replaced the
+            // ring
+            SHMNET_LOG(warning,"Couldn't open shared memory ring from server " << sender << ": " << e.what());
+            continue;
+        }
+
+        if (strm != NULL) {
+            SHMNET_LOG(info,"Server " << sender << " reconnected through shared memory");
+            strm->setRing(ring, incarnation, sequence);
+            continue;
+        }
+
+        SHMNET_LOG(info,"Accepted shared memory connection from server " << sender);
+        strm = new ShmReceiveStream(sender);
+        strm->setRing(ring, incarnation, sequence);
+        {
+            boost::lock_guard<boost::mutex> lck(mMutex);
+            mReceiveStreams[sender] = strm;
+        }
+        mReceiveListener->networkReceivedConnection(strm);
+        notify(&SpaceNetworkConnectionListener::onSpaceNetworkConnected, sender);
+    }
+    return found;
+}
+
+void SharedMemorySpaceNetwork::poll() {
+    if (mStopping)
+        return;
+
+    bool active = false;
+    if (mDirectory != NULL)
+        active = checkDirectory();
+
+    Time now = Timer::now();
+    std::vector<ShmReceiveStream*> received;
+    std::vector<ServerID> unblocked;
+    std::vector<ServerID> lost;
+    std::vector<ShmSendStream*> unregistered;
+    {
+        boost::lock_guard<boost::mutex> lck(mMutex);
+        for(ReceiveStreamMap::iterator it = mReceiveStreams.begin(); it != mReceiveStreams.end(); it++)
+            if (it->second->shouldNotify()) received.push_back(it->second);
+        for(SendStreamMap::iterator it = mSendStreams.begin(); it != mSendStreams.end(); it++) {
+            ShmSendStream* strm = it->second;
+            if (!strm->checkReceiver()) {
+                if (strm->takeLost()) lost.push_back(it->first);
+                if (now >= strm->nextRegister) unregistered.push_back(strm);
+                continue;
+            }
+            if (strm->unblocked())
+                unblocked.push_back(it->first);
+            else if (strm->blocked())
+                active = true;
+        }
+    }
+
+    // Listener callbacks are made without holding our lock
+    for(uint32 i = 0; i < lost.size(); i++) {
+        SHMNET_LOG(info,"Lost shared memory connection to server " << lost[i]);
+        notify(&SpaceNetworkConnectionListener::onSpaceNetworkDisconnected, lost[i]);
+    }
+    for(uint32 i = 0; i < unregistered.size(); i++) {
+        ShmSendStream* strm = unregistered[i];
+        if (registerStream(strm) != Registered) {
+            strm->nextRegister = now + registerRetryInterval();
+            continue;
+        }
+        SHMNET_LOG(info,"Connected to local server " << strm->id() << " through shared memory");
+        notify(&SpaceNetworkConnectionListener::onSpaceNetworkConnected, strm->id());
+        unblocked.push_back(strm->id());
+    }
+    for(uint32 i = 0; i < received.size(); i++)
+        mReceiveListener->networkReceivedData(received[i]);
+    for(uint32 i = 0; i < unblocked.size(); i++)
+        mSendListener->networkReadyToSend(unblocked[i]);
+
+    // Poll quickly while data is moving, backing off while everything is idle
+    if (active || !received.empty() || !unblocked.empty())
+        mPollInterval = mMinPollInterval;
+    else
+        mPollInterval = std::min(mPollInterval * 2.0, mMaxPollInterval);
+    mPollTimer->wait(mPollInterval);
+}
+
+void SharedMemorySpaceNetwork::onSpaceNetworkConnected(ServerID sid) {
+    notify(&SpaceNetworkConnectionListener::onSpaceNetworkConnected, sid);
+}
+
+void SharedMemorySpaceNetwork::onSpaceNetworkDisconnected(ServerID sid) {
+    notify(&SpaceNetworkConnectionListener::onSpaceNetworkDisconnected, sid);
+}
+
+} // namespace Sirikata
@@ -0,0 +1,225 @@
+/*  Sirikata
+ *  SharedMemorySpaceNetwork.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_SHARED_MEMORY_SPACE_NETWORK_HPP_
+#define _SIRIKATA_SHARED_MEMORY_SPACE_NETWORK_HPP_
+
+#include <sirikata/space/SpaceNetwork.hpp>
+#include <sirikata/space/SharedMemoryRing.hpp>
+#include <sirikata/core/network/Address4.hpp>
+#include <sirikata/core/network/IOTimer.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Sirikata {
+
+class TCPSpaceNetwork;
+
+/** SharedMemorySpaceNetwork connects space servers running on the same host
+ *  through single producer, single consumer ring buffers in shared memory,
+ *  one for each ordered pair of servers, avoiding the framing, syscalls and
+ *  kernel copies of talking over loopback.  Servers whose internal address in
+ *  the ServerIDMap is on another host are handed to an embedded
+ *  TCPSpaceNetwork, so the two can be mixed freely.
+ *
+ *  Each receiving server has a small directory segment which senders register
+ *  their rings in, with entries freed again once the receiver has picked the
+ *  ring up.  A timer on the network strand polls the directory for new
+ *  senders, the rings for newly arrived data and blocked sends for free space,
+ *  and generates the usual ReceiveListener and SendListener callbacks.  The
+ *  timer backs off while there's nothing to do.
+ *
+ *  The directory also records which run of the receiver is listening.  When
+ *  that changes, because the receiver shut down or restarted, senders report
+ *  the server as disconnected and register a new ring once a receiver is
+ *  listening again.
+ *
+ *  Segments are named from the shm-net.name option, so separate deployments
+ *  on the same host need distinct names.  Segments left behind by a crashed
+ *  server are not cleaned up automatically.
+ */
+class SharedMemorySpaceNetwork : public SpaceNetwork, SpaceNetworkConnectionListener {
+public:
+    SharedMemorySpaceNetwork(SpaceContext* ctx);
+    virtual ~SharedMemorySpaceNetwork();
+
+    virtual void setSendListener(SendListener* sl);
+
+    virtual void listen(const ServerID& addr, ReceiveListener* receive_listener);
+    virtual SendStream* connect(const ServerID& addr);
+
+protected:
+    // Service Interface
+    virtual void start();
+    virtual void stop();
+
+private:
+    typedef SharedMemorySegment Segment;
+    typedef SharedMemoryRing Ring;
+
+    /** Sends to one local server.  The stream stays the same for the life of
+     *  the network, but the ring underneath it is replaced whenever the
+     *  receiver changes.
+     */
+    class ShmSendStream : public SpaceNetwork::SendStream {
+    public:
+        ShmSendStream(ServerID sid);
+        ~ShmSendStream();
+
+        virtual ServerID id() const;
+        virtual bool send(const Chunk&);
+        virtual bool send(MemoryReference first, MemoryReference second);
+
+        // Start using a newly registered ring. Takes ownership of both.
+        void setConnection(Segment* directory, Ring* ring, uint64 epoch);
+        // Checks that the receiver the ring was registered with is still
+        // listening, dropping the ring if it isn't.
+        bool checkReceiver();
+        // Returns true, once, if the ring was dropped since the last call.
+        bool takeLost();
+        // Whether a send failed for lack of space
+        bool blocked();
+        // Checks whether a failed send can now be retried, clearing the
+        // blocked state if so.
+        bool unblocked();
+
+        // When to next try to register a ring, only used by the network strand
+        Time nextRegister;
+    private:
+        bool checkReceiverLocked();
+
+        ServerID mID;
+        // Sends come from the server message queue while the network strand
+        // checks the receiver and swaps rings
+        boost::mutex mMutex;
+        Segment* mDirectorySegment;
+        Ring* mRing;
+        // The directory epoch the ring was registered under
+        uint64 mEpoch;
+        // Size of the message that last failed to send, 0 if not blocked
+        uint32 mBlockedSize;
+        bool mLost;
+    };
+    typedef std::tr1::unordered_map<ServerID, ShmSendStream*> SendStreamMap;
+
+    class ShmReceiveStream : public SpaceNetwork::ReceiveStream {
+    public:
+        ShmReceiveStream(ServerID sid);
+        ~ShmReceiveStream();
+
+        virtual ServerID id() const;
+        virtual Chunk* front();
+        virtual Chunk* pop();
+        virtual uint32 popBatch(std::vector<Chunk*>& chunks, uint32 max_chunks);
+
+        // Replace the ring, e.g. after the sender restarted or re-registered.
+        // Anything left in the old ring is delivered first.
+        void setRing(Ring* ring, uint64 incarnation, uint32 sequence);
+        // Whether a registration is for a newer ring than the current one
+        bool isNewer(uint64 incarnation, uint32 sequence);
+        // Returns true if data is available and the listener hasn't been told
+        // about it since the stream was last found empty.
+        bool shouldNotify();
+    private:
+        Chunk* readNext();
+
+        ServerID mID;
+        boost::mutex mMutex;
+        Ring* mRing;
+        Ring* mRetiredRing;
+        uint64 mIncarnation;
+        uint32 mSequence;
+        Chunk* mFront;
+        volatile uint32 mNotified;
+    };
+    typedef std::tr1::unordered_map<ServerID, ShmReceiveStream*> ReceiveStreamMap;
+
+    struct Directory;
+
+    enum RegisterResult {
+        Registered,
+        NotListening, // No receiver yet, try again later
+        RegisterFailed
+    };
+
+    // Whether the server can be reached through shared memory
+    bool isLocal(const ServerID& sid);
+    String directoryName(const ServerID& receiver) const;
+    String ringName(const ServerID& sender, const ServerID& receiver, uint64 incarnation, uint32 sequence) const;
+
+    // Create a new ring for the stream and register it with the receiver
+    RegisterResult registerStream(ShmSendStream* strm);
+
+    // Network strand
+    void poll();
+    // Returns true if any new senders were found
+    bool checkDirectory();
+
+    // SpaceNetworkConnectionListener Interface, forwarding TCP events
+    virtual void onSpaceNetworkConnected(ServerID sid);
+    virtual void onSpaceNetworkDisconnected(ServerID sid);
+
+    TCPSpaceNetwork* mTCP;
+
+    String mName;
+    uint32 mRingSize;
+    // Polling starts at mMinPollInterval and doubles up to mMaxPollInterval
+    // while idle
+    Duration mMinPollInterval;
+    Duration mMaxPollInterval;
+    Duration mPollInterval;
+    // Identifies this run of the server so receivers can tell restarted
+    // senders' rings apart from stale ones.
+    uint64 mIncarnation;
+    // Number of rings registered so far, to tell this run's rings apart
+    volatile uint32 mRegistrations;
+    Address4 mLocalAddress;
+
+    Network::IOStrand* mIOStrand;
+    Network::IOTimerPtr mPollTimer;
+    bool mStopping;
+
+    SendListener* mSendListener;
+    ReceiveListener* mReceiveListener;
+
+    // Protects the stream maps, which are accessed from the network strand and
+    // by connect()
+    boost::mutex mMutex;
+    SendStreamMap mSendStreams;
+    ReceiveStreamMap mReceiveStreams;
+
+    Segment* mDirectorySegment;
+    Directory* mDirectory;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SHARED_MEMORY_SPACE_NETWORK_HPP_
@@ -122,6 +122,29 @@ Chunk* TCPSpaceNetwork::RemoteStream::pop(Network::IOStrand* ios) {
     return result;
 }
 
+uint32 TCPSpaceNetwork::RemoteStream::popBatch(Network::IOStrand* ios, std::vector<Chunk*>& chunks, uint32 max_chunks) {
+    boost::lock_guard<boost::mutex> lck(mPushPopMutex);
+    // Same ordering requirements as pop(), we just drain more than one element
+    // before unpausing.
+
+    bool was_paused = paused;
+
+    uint32 npopped = 0;
+    Chunk* result = NULL;
+    while(npopped < max_chunks && receive_queue.pop(result)) {
+        chunks.push_back(result);
+        npopped++;
+    }
+
+    paused = false;
+    if (was_paused) {
+        ios->post(
+            std::tr1::bind(&Sirikata::Network::Stream::readyRead, stream)
+        );
+    }
+    return npopped;
+}
+
 
 TCPSpaceNetwork::RemoteSession::RemoteSession(ServerID sid)
  : logical_endpoint(sid)
@@ -151,6 +174,10 @@ ServerID TCPSpaceNetwork::TCPSendStream::id() const {
 }
 
 bool TCPSpaceNetwork::TCPSendStream::send(const Chunk& data) {
+    return send(MemoryReference(data), MemoryReference::null());
+}
+
+bool TCPSpaceNetwork::TCPSendStream::send(MemoryReference first, MemoryReference second) {
     if (!session)
         return false;
 
@@ -161,7 +188,7 @@ bool TCPSpaceNetwork::TCPSendStream::send(const Chunk& data) {
     bool success = (
         remote_stream->connected &&
         !remote_stream->shutting_down &&
-        remote_stream->stream->send(data, ReliableOrdered));
+        remote_stream->stream->send(first, second, ReliableOrdered));
 
     if (!success)
         remote_stream->stream->requestReadySendCallback();
@@ -225,6 +252,24 @@ Chunk* TCPSpaceNetwork::TCPReceiveStream::pop() {
     return result;
 }
 
+uint32 TCPSpaceNetwork::TCPReceiveStream::popBatch(std::vector<Chunk*>& chunks, uint32 max_chunks) {
+    if (max_chunks == 0)
+        return 0;
+
+    // Anything already pulled out by front() needs to go first. This also
+    // selects the stream we should continue reading from.
+    Chunk* first = front();
+    if (first == NULL)
+        return 0;
+    RemoteStreamPtr strm = front_stream;
+    pop();
+    chunks.push_back(first);
+
+    // Only continue with the same stream, the next batch will pick up any
+    // other stream with data.
+    return 1 + strm->popBatch(ios, chunks, max_chunks - 1);
+}
+
 bool TCPSpaceNetwork::TCPReceiveStream::canReadFrom(RemoteStreamPtr& strm) {
     return (
         strm &&
@@ -63,6 +63,7 @@ class TCPSpaceNetwork : public SpaceNetwork {
 
         bool push(Chunk& data, bool* was_empty);
         Chunk* pop(Network::IOStrand* ios);
+        uint32 popBatch(Network::IOStrand* ios, std::vector<Chunk*>& chunks, uint32 max_chunks);
 
         Sirikata::Network::Stream* stream;
 
@@ -139,6 +140,7 @@ class TCPSpaceNetwork : public SpaceNetwork {
 
         virtual ServerID id() const;
         virtual bool send(const Chunk&);
+        virtual bool send(MemoryReference first, MemoryReference second);
 
     private:
         ServerID logical_endpoint;
@@ -153,6 +155,7 @@ class TCPSpaceNetwork : public SpaceNetwork {
         virtual ServerID id() const;
         virtual Chunk* front();
         virtual Chunk* pop();
+        virtual uint32 popBatch(std::vector<Chunk*>& chunks, uint32 max_chunks);
 
     private:
         // Get the current queue for receiving data from the address.
@@ -51,8 +51,9 @@ namespace Sirikata
 
 
 
-  CommunicationCache::CommunicationCache(SpaceContext* spctx, float scalingUnits, CoordinateSegmentation* cseg,uint32 cacheSize)
-    : mCompleteCache(.2,"CommunicationCache",&commCacheScoreFunction,&commCacheScoreFunctionPrint,spctx,cacheSize,FLT_MAX),
+  CommunicationCache::CommunicationCache(SpaceContext* spctx, float scalingUnits, CoordinateSegmentation* cseg,uint32 cacheSize,Duration negativeLifetime)
+    : OSegCache(spctx, negativeLifetime),
+      mCompleteCache(.2,"CommunicationCache",&commCacheScoreFunction,&commCacheScoreFunctionPrint,spctx,cacheSize,FLT_MAX),
       mDistScaledUnits(scalingUnits),
       mCSeg(cseg),
       ctx(spctx),
@@ -90,7 +91,7 @@ namespace Sirikata
     mCompleteCache.insert(uuid,sID.server(),0,0,0,0,sID.radius(),lookupWeight,1);
   }
 
-  const OSegEntry& CommunicationCache::get(const UUID& uuid)
+  OSegEntry CommunicationCache::get(const UUID& uuid)
   {
     boost::lock_guard<boost::mutex> lck(mMutex);
     return mCompleteCache.lookup(uuid);
@@ -59,11 +59,11 @@ namespace Sirikata
     uint32 mCacheSize;
 
   public:
-    CommunicationCache(SpaceContext* spctx, float scalingUnits, CoordinateSegmentation* cseg,uint32 cacheSize);
+    CommunicationCache(SpaceContext* spctx, float scalingUnits, CoordinateSegmentation* cseg,uint32 cacheSize,Duration negativeLifetime);
       virtual ~CommunicationCache() {}
 
     virtual void insert(const UUID& uuid, const OSegEntry& sID);
-    virtual const OSegEntry& get(const UUID& uuid);
+    virtual OSegEntry get(const UUID& uuid);
     virtual void remove(const UUID& oid);
 
   };
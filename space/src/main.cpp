@@ -53,6 +53,7 @@
 #include <sirikata/core/util/PluginManager.hpp>
 #include <sirikata/core/trace/Trace.hpp>
 #include "TCPSpaceNetwork.hpp"
+#include "SharedMemorySpaceNetwork.hpp"
 #include "FairServerMessageReceiver.hpp"
 #include "FairServerMessageQueue.hpp"
 #include <sirikata/core/network/ServerIDMap.hpp>
@@ -61,7 +62,8 @@
 #include <sirikata/space/LoadMonitor.hpp>
 #include <sirikata/space/ObjectSegmentation.hpp>
 #include "caches/CommunicationCache.hpp"
-#include "caches/CacheLRUOriginal.hpp"
+#include <sirikata/space/CacheLRUOriginal.hpp>
+#include <sirikata/space/ShardedClockProCache.hpp>
 
 #include <sirikata/space/SpaceContext.hpp>
 
@@ -113,6 +115,8 @@ int main(int argc, char** argv) {
     String network_type = GetOptionValue<String>(NETWORK_TYPE);
     if (network_type == "tcp")
       gNetwork = new TCPSpaceNetwork(space_context);
+    else if (network_type == "shm")
+      gNetwork = new SharedMemorySpaceNetwork(space_context);
 
     BoundingBox3f region = GetOptionValue<BoundingBox3f>("region");
     Vector3ui32 layout = GetOptionValue<Vector3ui32>("layout");
@@ -190,14 +194,20 @@ int main(int argc, char** argv) {
     OSegCache* oseg_cache = NULL;
     std::string cacheSelector = GetOptionValue<String>(CACHE_SELECTOR);
     uint32 cacheSize = GetOptionValue<uint32>(OSEG_CACHE_SIZE);
+    Duration negativeLifetime = GetOptionValue<Duration>(OSEG_CACHE_NEGATIVE_LIFETIME);
     if (cacheSelector == CACHE_TYPE_COMMUNICATION) {
         double cacheCommScaling = GetOptionValue<double>(CACHE_COMM_SCALING);
-        oseg_cache = new CommunicationCache(space_context, cacheCommScaling, cseg, cacheSize);
+        oseg_cache = new CommunicationCache(space_context, cacheCommScaling, cseg, cacheSize, negativeLifetime);
     }
     else if (cacheSelector == CACHE_TYPE_ORIGINAL_LRU) {
         uint32 cacheCleanGroupSize = GetOptionValue<uint32>(OSEG_CACHE_CLEAN_GROUP_SIZE);
         Duration entryLifetime = GetOptionValue<Duration>(OSEG_CACHE_ENTRY_LIFETIME);
-        oseg_cache = new CacheLRUOriginal(space_context, cacheSize, cacheCleanGroupSize, entryLifetime);
+        oseg_cache = new CacheLRUOriginal(space_context, cacheSize, cacheCleanGroupSize, entryLifetime, negativeLifetime);
+    }
+    else if (cacheSelector == CACHE_TYPE_SHARDED_CLOCKPRO) {
+        uint32 cacheShards = GetOptionValue<uint32>(OSEG_CACHE_SHARDS);
+        Duration entryLifetime = GetOptionValue<Duration>(OSEG_CACHE_ENTRY_LIFETIME);
+        oseg_cache = new ShardedClockProCache(space_context, cacheSize, cacheShards, entryLifetime, negativeLifetime);
     }
     else {
         std::cout<<"\n\nUNKNOWN CACHE TYPE SELECTED.  Please re-try.\n\n";
@@ -240,7 +250,12 @@ int main(int argc, char** argv) {
     }
 
     ///////////Go go go!! start of simulation/////////////////////
-    SSTConnectionManager* sstConnMgr = new SSTConnectionManager();
+    SSTConnectionManager* sstConnMgr = new SSTConnectionManager(
+        space_context,
+        GetOptionValue<Duration>(OPT_SST_STATS_INTERVAL),
+        String("space.server") + boost::lexical_cast<String>(server_id) + ".sst",
+        GetOptionValue<bool>(OPT_SST_STATS_PER_CONNECTION)
+    );
 
     space_context->add(space_context);
     space_context->add(auth);
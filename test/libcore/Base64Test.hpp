@@ -0,0 +1,119 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  Base64Test.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/util/Base64.hpp>
+
+using namespace Sirikata;
+
+class Base64Test : public CxxTest::TestSuite
+{
+    std::vector<uint8> randomBytes(size_t len) {
+        std::vector<uint8> result(len);
+        for(size_t i = 0; i < len; i++)
+            result[i] = (uint8)(rand() & 0xFF);
+        return result;
+    }
+
+    std::string encode(const std::vector<uint8>& data) {
+        std::string result(Base64::encodedSize(data.size()), '\0');
+        size_t written = Base64::encode(data.empty() ? NULL : &data[0], data.size(), (uint8*)&result[0]);
+        TS_ASSERT_EQUALS(written, result.size());
+        return result;
+    }
+
+    std::vector<uint8> decode(const std::string& data) {
+        std::vector<uint8> result(Base64::decodedMaxSize(data.size()));
+        size_t written = Base64::decode((const uint8*)data.data(), data.size(), &result[0]);
+        result.resize(written);
+        return result;
+    }
+
+public:
+    // SIRIKATA_SIMD builds should get the matching vector kernels
+    void testSimdImplementation( void ) {
+#if defined(SIRIKATA_SIMD_AVX2)
+        TS_ASSERT_EQUALS(std::string(Base64::implementation()), std::string("avx2"));
+#elif defined(SIRIKATA_SIMD_SSSE3)
+        TS_ASSERT_EQUALS(std::string(Base64::implementation()), std::string("ssse3"));
+#endif
+    }
+
+    void testKnownValues( void ) {
+        const char* raw = "Sirikata";
+        std::vector<uint8> data(raw, raw + 8);
+        TS_ASSERT_EQUALS(encode(data), std::string("U2lyaWthdGE="));
+        data.resize(7);
+        TS_ASSERT_EQUALS(encode(data), std::string("U2lyaWthdA=="));
+        data.resize(6);
+        TS_ASSERT_EQUALS(encode(data), std::string("U2lyaWth"));
+
+        // URL safe alphabet
+        uint8 high[3] = { 0xFB, 0xFF, 0xBF };
+        TS_ASSERT_EQUALS(encode(std::vector<uint8>(high, high + 3)), std::string("-_-_"));
+        // Both alphabets decode
+        TS_ASSERT(decode("-_-_") == std::vector<uint8>(high, high + 3));
+        TS_ASSERT(decode("+/+/") == std::vector<uint8>(high, high + 3));
+    }
+
+    void testRoundTrip( void ) {
+        // Cover lengths on both sides of the vector block sizes
+        for(size_t len = 0; len < 300; len++) {
+            std::vector<uint8> data = randomBytes(len);
+            std::string encoded = encode(data);
+
+            std::string scalar(Base64::encodedSize(len), '\0');
+            Base64::encodeScalar(data.empty() ? NULL : &data[0], len, (uint8*)&scalar[0]);
+            TS_ASSERT_EQUALS(encoded, scalar);
+
+            TS_ASSERT(decode(encoded) == data);
+        }
+    }
+
+    void testSkipsWhitespaceAndStopsAtPadding( void ) {
+        std::vector<uint8> data = randomBytes(200);
+        std::string encoded = encode(data);
+
+        // Whitespace and characters outside the alphabet are ignored
+        std::string spaced;
+        for(size_t i = 0; i < encoded.size(); i++) {
+            spaced.push_back(encoded[i]);
+            if (i % 37 == 0) spaced.push_back('\n');
+            if (i % 53 == 0) spaced.push_back('*');
+        }
+        TS_ASSERT(decode(spaced) == data);
+
+        // Anything after the padded quartet is ignored
+        std::vector<uint8> two = randomBytes(2);
+        std::string padded = encode(two) + encode(randomBytes(90));
+        TS_ASSERT(decode(padded) == two);
+    }
+};
@@ -136,6 +136,43 @@ public:
         ASSERT_FAIR_QUEUE_POP(test_queue, 0, 2); // t = 8
         ASSERT_FAIR_QUEUE_POP(test_queue, 2, 8); // t = 9
     }
+
+    // Changing the weight of a queue should reorder its pending message
+    void testWeightUpdate(void) {
+        FairQueue<SizedElem, uint32, SizedElemQueue> test_queue;
+
+        test_queue.addQueue(new SizedElemQueue(1 << 28), 0, 1.f);
+        test_queue.addQueue(new SizedElemQueue(1 << 28), 1, 1.f);
+
+        test_queue.push(0, new SizedElem(4)); // t = 4
+        test_queue.push(1, new SizedElem(3)); // t = 3
+        test_queue.setQueueWeight(0, 4.f); // t = 1
+        TS_ASSERT_EQUALS(test_queue.avg_weight(), 2.5f);
+
+        ASSERT_FAIR_QUEUE_POP(test_queue, 0, 4);
+        ASSERT_FAIR_QUEUE_POP(test_queue, 1, 3);
+        TS_ASSERT(test_queue.empty());
+    }
+
+    // Disabled queues are skipped, but still count as non-empty
+    void testDisableEnable(void) {
+        FairQueue<SizedElem, uint32, SizedElemQueue> test_queue;
+
+        test_queue.addQueue(new SizedElemQueue(1 << 28), 0, 1.f);
+        test_queue.addQueue(new SizedElemQueue(1 << 28), 1, 1.f);
+
+        test_queue.push(0, new SizedElem(1));
+        test_queue.push(1, new SizedElem(2));
+        test_queue.disableQueue(0);
+
+        ASSERT_FAIR_QUEUE_POP(test_queue, 1, 2);
+        TS_ASSERT(!test_queue.empty());
+        TS_ASSERT(test_queue.pop() == NULL);
+
+        test_queue.enableQueue(0);
+        ASSERT_FAIR_QUEUE_POP(test_queue, 0, 1);
+        TS_ASSERT(test_queue.empty());
+    }
 };
 
 #endif //_SIRIKATA_FAIR_QUEUE_TEST_HPP_
@@ -0,0 +1,212 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  ProxCompactEncodingTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_PROX_COMPACT_ENCODING_TEST_HPP_
+#define _SIRIKATA_PROX_COMPACT_ENCODING_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/network/ProxCompactEncoding.hpp>
+#include "Protocol_Prox.pbj.hpp"
+#include <cxxtest/TestSuite.h>
+
+class ProxCompactEncodingTest : public CxxTest::TestSuite
+{
+    typedef Sirikata::Vector3f Vector3f;
+    typedef Sirikata::Quaternion Quaternion;
+    typedef Sirikata::UUID UUID;
+    typedef Sirikata::Time Time;
+    typedef Sirikata::Duration Duration;
+    typedef Sirikata::TimedMotionVector3f TimedMotionVector3f;
+    typedef Sirikata::TimedMotionQuaternion TimedMotionQuaternion;
+    typedef Sirikata::MotionVector3f MotionVector3f;
+    typedef Sirikata::MotionQuaternion MotionQuaternion;
+    typedef Sirikata::BoundingSphere3f BoundingSphere3f;
+    typedef Sirikata::Network::ProxCompactEncoding ProxCompactEncoding;
+    typedef Sirikata::Network::ProxCompactEncoder ProxCompactEncoder;
+    typedef Sirikata::Network::ProxCompactDecoder ProxCompactDecoder;
+    typedef Sirikata::Protocol::Prox::ProximityResults ProximityResults;
+
+    void checkClose(const Vector3f& a, const Vector3f& b, float tol) {
+        TS_ASSERT_DELTA(a.x, b.x, tol);
+        TS_ASSERT_DELTA(a.y, b.y, tol);
+        TS_ASSERT_DELTA(a.z, b.z, tol);
+    }
+
+public:
+    void testHello( void )
+    {
+        std::string hello = ProxCompactEncoding::hello();
+        TS_ASSERT(ProxCompactEncoding::isHello(hello));
+        TS_ASSERT(!ProxCompactEncoding::isCompact(hello));
+
+        ProxCompactEncoder encoder;
+        encoder.begin(Time::null(), Vector3f(0,0,0));
+        std::string msg = encoder.finish();
+        TS_ASSERT(ProxCompactEncoding::isCompact(msg));
+        TS_ASSERT(!ProxCompactEncoding::isHello(msg));
+    }
+
+    void testRoundTrip( void )
+    {
+        ProxCompactEncoder encoder(0.01f);
+        ProxCompactDecoder decoder;
+
+        Time t = Time::microseconds(1000000000);
+        Vector3f ref(100.f, -50.f, 20.f);
+        UUID a = UUID::random(), b = UUID::random(), c = UUID::random();
+        TimedMotionVector3f loc(t - Duration::milliseconds((Sirikata::int64)250), MotionVector3f(Vector3f(110.5f, -52.25f, 20.f), Vector3f(1.f, 0.f, -2.5f)));
+        TimedMotionQuaternion orient(t, MotionQuaternion(Quaternion(0.f, 0.f, 0.7071f, 0.7071f, Quaternion::XYZW()), Quaternion::identity()));
+        BoundingSphere3f bounds(Vector3f(110.5f, -52.25f, 20.f), 1.5f);
+        Sirikata::String mesh("meerkat:///test/cube.dae");
+
+        // First message introduces the objects and the mesh
+        encoder.begin(t, ref);
+        encoder.addAddition(a, loc, orient, bounds, mesh, "");
+        encoder.addAddition(b, loc, orient, bounds, mesh, "{physics}");
+        encoder.addRemoval(c);
+        std::string first = encoder.finish();
+
+        ProximityResults results;
+        TS_ASSERT(decoder.decode(first, &results));
+        TS_ASSERT_EQUALS(results.t(), t);
+        TS_ASSERT_EQUALS(results.update_size(), 2);
+        // Removals come first
+        TS_ASSERT_EQUALS(results.update(0).removal_size(), 1);
+        TS_ASSERT_EQUALS(results.update(0).removal(0).object(), c);
+        TS_ASSERT_EQUALS(results.update(1).addition_size(), 2);
+
+        Sirikata::Protocol::Prox::ObjectAddition add_a = results.update(1).addition(0);
+        TS_ASSERT_EQUALS(add_a.object(), a);
+        TS_ASSERT_EQUALS(add_a.location().t(), loc.updateTime());
+        checkClose(add_a.location().position(), loc.position(), 0.005f);
+        checkClose(add_a.location().velocity(), loc.velocity(), 0.005f);
+        TS_ASSERT_EQUALS(add_a.orientation().t(), orient.updateTime());
+        TS_ASSERT_DELTA(add_a.orientation().position().z, 0.7071f, 0.0001f);
+        TS_ASSERT_DELTA(add_a.orientation().position().w, 0.7071f, 0.0001f);
+        checkClose(add_a.bounds().center(), bounds.center(), 0.005f);
+        TS_ASSERT_EQUALS(add_a.bounds().radius(), 1.5f);
+        TS_ASSERT(add_a.has_mesh());
+        TS_ASSERT_EQUALS(add_a.mesh(), mesh);
+        TS_ASSERT(!add_a.has_physics());
+
+        Sirikata::Protocol::Prox::ObjectAddition add_b = results.update(1).addition(1);
+        TS_ASSERT_EQUALS(add_b.object(), b);
+        TS_ASSERT_EQUALS(add_b.mesh(), mesh);
+        TS_ASSERT(add_b.has_physics());
+        TS_ASSERT_EQUALS(add_b.physics(), "{physics}");
+
+        // Second message only refers back to them, so it's much smaller
+        encoder.begin(t, ref);
+        encoder.addAddition(a, loc, orient, bounds, mesh, "");
+        std::string second = encoder.finish();
+        TS_ASSERT(second.size() < first.size() / 2);
+
+        ProximityResults results2;
+        TS_ASSERT(decoder.decode(second, &results2));
+        TS_ASSERT_EQUALS(results2.update(1).addition_size(), 1);
+        TS_ASSERT_EQUALS(results2.update(1).addition(0).object(), a);
+        TS_ASSERT_EQUALS(results2.update(1).addition(0).mesh(), mesh);
+    }
+
+    void testDictionaryEviction( void )
+    {
+        // Small dictionaries so objects and meshes keep getting evicted and
+        // reintroduced.
+        ProxCompactEncoder encoder(0.01f, 4, 2);
+        ProxCompactDecoder decoder(4, 2);
+
+        std::vector<UUID> objects;
+        for(int i = 0; i < 10; i++)
+            objects.push_back(UUID::random());
+        const char* meshes[3] = { "meerkat:///a.dae", "meerkat:///b.dae", "meerkat:///c.dae" };
+
+        TimedMotionVector3f loc(Time::null(), MotionVector3f());
+        TimedMotionQuaternion orient(Time::null(), MotionQuaternion());
+        BoundingSphere3f bounds(Vector3f(0,0,0), 1.f);
+        for(int round = 0; round < 5; round++) {
+            encoder.begin(Time::null(), Vector3f(0,0,0));
+            // Keep reusing the first object so it stays referenced
+            encoder.addAddition(objects[0], loc, orient, bounds, meshes[0], "");
+            for(int i = 0; i < 3; i++) {
+                int idx = (round * 3 + i) % objects.size();
+                encoder.addAddition(objects[idx], loc, orient, bounds, meshes[(round + i) % 3], "");
+            }
+            std::string msg = encoder.finish();
+
+            ProximityResults results;
+            TS_ASSERT(decoder.decode(msg, &results));
+            TS_ASSERT_EQUALS(results.update(1).addition_size(), 4);
+            TS_ASSERT_EQUALS(results.update(1).addition(0).object(), objects[0]);
+            TS_ASSERT_EQUALS(results.update(1).addition(0).mesh(), meshes[0]);
+            for(int i = 0; i < 3; i++) {
+                int idx = (round * 3 + i) % objects.size();
+                TS_ASSERT_EQUALS(results.update(1).addition(i+1).object(), objects[idx]);
+                TS_ASSERT_EQUALS(results.update(1).addition(i+1).mesh(), meshes[(round + i) % 3]);
+            }
+        }
+    }
+
+    void testDictionaryTooSmall( void )
+    {
+        ProxCompactEncoder encoder(0.01f, 4, 2);
+        encoder.begin(Time::null(), Vector3f(0,0,0));
+        for(int i = 0; i < 3; i++)
+            encoder.addRemoval(UUID::random());
+        std::string msg = encoder.finish();
+
+        // The encoder uses more slots than the decoder is willing to keep
+        ProxCompactDecoder decoder(2, 2);
+        ProximityResults results;
+        TS_ASSERT(!decoder.decode(msg, &results));
+    }
+
+    void testTruncated( void )
+    {
+        ProxCompactEncoder encoder;
+        encoder.begin(Time::null(), Vector3f(0,0,0));
+        encoder.addAddition(
+            UUID::random(),
+            TimedMotionVector3f(Time::null(), MotionVector3f()),
+            TimedMotionQuaternion(Time::null(), MotionQuaternion()),
+            BoundingSphere3f(Vector3f(0,0,0), 1.f), "meerkat:///test/cube.dae", ""
+        );
+        std::string msg = encoder.finish();
+
+        for(size_t len = 0; len < msg.size(); len++) {
+            ProxCompactDecoder decoder;
+            ProximityResults results;
+            TS_ASSERT(!decoder.decode(msg.substr(0, len), &results));
+        }
+    }
+};
+
+#endif //_SIRIKATA_PROX_COMPACT_ENCODING_TEST_HPP_
@@ -0,0 +1,138 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  RingBufferQueueTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/queue/RingBufferQueue.hpp>
+#include <sirikata/core/util/Thread.hpp>
+
+using namespace Sirikata;
+
+class RingBufferQueueTest : public CxxTest::TestSuite
+{
+    typedef RingBufferQueue<uint32> Queue;
+
+    enum {
+        NumProducers = 4,
+        ItemsPerProducer = 20000
+    };
+
+    void produce(Queue* queue, uint32 base) {
+        for(uint32 i = 1; i <= ItemsPerProducer; i++)
+            queue->push(base + i);
+    }
+
+    void consume(Queue* queue, uint32 count, uint64* sum) {
+        uint64 total = 0;
+        for(uint32 i = 0; i < count; i++) {
+            uint32 val = 0;
+            queue->blockingPop(val);
+            total += val;
+        }
+        *sum = total;
+    }
+
+public:
+    void testCapacity( void ) {
+        Queue q(100);
+        TS_ASSERT_EQUALS(q.capacity(), (size_t)128);
+        Queue q2(128);
+        TS_ASSERT_EQUALS(q2.capacity(), (size_t)128);
+    }
+
+    void testOrdering( void ) {
+        Queue q(8);
+        TS_ASSERT(q.probablyEmpty());
+        for(uint32 lap = 0; lap < 3; lap++) {
+            for(uint32 i = 0; i < 8; i++)
+                TS_ASSERT(q.tryPush(lap * 8 + i));
+            // Full
+            TS_ASSERT(!q.tryPush(1000));
+            TS_ASSERT(!q.probablyEmpty());
+
+            uint32 val;
+            for(uint32 i = 0; i < 8; i++) {
+                TS_ASSERT(q.pop(val));
+                TS_ASSERT_EQUALS(val, lap * 8 + i);
+            }
+            TS_ASSERT(!q.pop(val));
+            TS_ASSERT(q.probablyEmpty());
+        }
+    }
+
+    void testBatch( void ) {
+        Queue q(4);
+        uint32 in[6] = { 1, 2, 3, 4, 5, 6 };
+        TS_ASSERT_EQUALS(q.pushBatch(in, 6), (size_t)4);
+
+        uint32 out[6];
+        TS_ASSERT_EQUALS(q.popBatch(out, 3), (size_t)3);
+        TS_ASSERT_EQUALS(out[0], (uint32)1);
+        TS_ASSERT_EQUALS(out[2], (uint32)3);
+
+        TS_ASSERT_EQUALS(q.pushBatch(in + 4, 2), (size_t)2);
+        std::deque<uint32> all;
+        q.popAll(&all);
+        TS_ASSERT_EQUALS(all.size(), (size_t)3);
+        TS_ASSERT_EQUALS(all[0], (uint32)4);
+        TS_ASSERT_EQUALS(all[1], (uint32)5);
+        TS_ASSERT_EQUALS(all[2], (uint32)6);
+        TS_ASSERT(q.probablyEmpty());
+    }
+
+    void testContention( void ) {
+        // Small queue so producers regularly block on a full queue and the
+        // consumers on an empty one
+        Queue q(16);
+        uint32 per_consumer = (NumProducers * ItemsPerProducer) / 2;
+
+        uint64 sums[2] = { 0, 0 };
+        Thread* consumers[2];
+        for(int i = 0; i < 2; i++)
+            consumers[i] = new Thread(std::tr1::bind(&RingBufferQueueTest::consume, this, &q, per_consumer, &sums[i]));
+        Thread* producers[NumProducers];
+        for(int i = 0; i < NumProducers; i++)
+            producers[i] = new Thread(std::tr1::bind(&RingBufferQueueTest::produce, this, &q, (uint32)(i * ItemsPerProducer)));
+
+        for(int i = 0; i < NumProducers; i++) {
+            producers[i]->join();
+            delete producers[i];
+        }
+        for(int i = 0; i < 2; i++) {
+            consumers[i]->join();
+            delete consumers[i];
+        }
+
+        // Every value 1..N should have been seen exactly once
+        uint64 n = NumProducers * ItemsPerProducer;
+        TS_ASSERT_EQUALS(sums[0] + sums[1], n * (n + 1) / 2);
+        TS_ASSERT(q.probablyEmpty());
+    }
+};
@@ -0,0 +1,175 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  SSTCongestionControlTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/network/SSTCongestionControl.hpp>
+
+using namespace Sirikata;
+
+class SSTCongestionControlTest : public CxxTest::TestSuite
+{
+    enum {
+        MSS = 1000
+    };
+
+    // Acks a full window one segment at a time
+    void ackWindow(SSTCongestionControl* cc, const RTTEstimator& rtt) {
+        uint32 segments = cc->window() / MSS;
+        for(uint32 i = 0; i < segments; i++)
+            cc->onAck(MSS, rtt);
+    }
+
+public:
+    void testRTTEstimator( void ) {
+        RTTEstimator rtt(Duration::seconds(1), Duration::milliseconds((int64)200), Duration::seconds(20));
+        TS_ASSERT(!rtt.hasSample());
+        TS_ASSERT_EQUALS(rtt.rto(), Duration::seconds(1));
+
+        // First sample: SRTT = R, RTTVAR = R/2, RTO = SRTT + 4*RTTVAR
+        rtt.sample(Duration::milliseconds((int64)100));
+        TS_ASSERT(rtt.hasSample());
+        TS_ASSERT_EQUALS(rtt.smoothed(), Duration::milliseconds((int64)100));
+        TS_ASSERT_EQUALS(rtt.variance(), Duration::milliseconds((int64)50));
+        TS_ASSERT_EQUALS(rtt.rto(), Duration::milliseconds((int64)300));
+
+        // Steady samples converge and shrink the variance, but the RTO stays
+        // above the minimum
+        for(int i = 0; i < 100; i++)
+            rtt.sample(Duration::milliseconds((int64)100));
+        TS_ASSERT_EQUALS(rtt.smoothed(), Duration::milliseconds((int64)100));
+        TS_ASSERT_EQUALS(rtt.rto(), Duration::milliseconds((int64)200));
+        TS_ASSERT_EQUALS(rtt.minimum(), Duration::milliseconds((int64)100));
+
+        // Backoff doubles up to the maximum and is cleared by a sample
+        rtt.backoff();
+        TS_ASSERT_EQUALS(rtt.rto(), Duration::milliseconds((int64)400));
+        for(int i = 0; i < 20; i++)
+            rtt.backoff();
+        TS_ASSERT_EQUALS(rtt.rto(), Duration::seconds(20));
+        rtt.sample(Duration::milliseconds((int64)100));
+        TS_ASSERT_EQUALS(rtt.rto(), Duration::milliseconds((int64)200));
+    }
+
+    void testCreate( void ) {
+        SSTCongestionControl* cc = SSTCongestionControl::create("aimd", MSS);
+        TS_ASSERT(cc != NULL && String(cc->name()) == "aimd");
+        delete cc;
+        cc = SSTCongestionControl::create("delay", MSS);
+        TS_ASSERT(cc != NULL && String(cc->name()) == "delay");
+        delete cc;
+        cc = SSTCongestionControl::create("none", MSS);
+        TS_ASSERT(cc != NULL && String(cc->name()) == "none");
+        delete cc;
+        TS_ASSERT(SSTCongestionControl::create("bogus", MSS) == NULL);
+    }
+
+    void testAIMD( void ) {
+        AIMDCongestionControl cc(MSS);
+        RTTEstimator rtt;
+        TS_ASSERT_EQUALS(cc.window(), (uint32)(4*MSS));
+        TS_ASSERT(cc.inSlowStart());
+
+        // Slow start doubles each round trip
+        ackWindow(&cc, rtt);
+        TS_ASSERT_EQUALS(cc.window(), (uint32)(8*MSS));
+        ackWindow(&cc, rtt);
+        TS_ASSERT_EQUALS(cc.window(), (uint32)(16*MSS));
+
+        // Loss halves the window and leaves slow start
+        cc.onLoss();
+        TS_ASSERT_EQUALS(cc.window(), (uint32)(8*MSS));
+        TS_ASSERT(!cc.inSlowStart());
+
+        // Congestion avoidance adds one segment per round trip
+        ackWindow(&cc, rtt);
+        TS_ASSERT_EQUALS(cc.window(), (uint32)(9*MSS));
+        ackWindow(&cc, rtt);
+        TS_ASSERT_EQUALS(cc.window(), (uint32)(10*MSS));
+
+        // Timeouts collapse to a single segment and slow start back up to
+        // half the old window
+        cc.onTimeout();
+        TS_ASSERT_EQUALS(cc.window(), (uint32)MSS);
+        TS_ASSERT_EQUALS(cc.slowStartThreshold(), (uint32)(5*MSS));
+        TS_ASSERT(cc.inSlowStart());
+        for(int i = 0; i < 3; i++)
+            ackWindow(&cc, rtt);
+        TS_ASSERT(!cc.inSlowStart());
+    }
+
+    void testDelay( void ) {
+        DelayCongestionControl cc(MSS);
+        RTTEstimator rtt;
+        rtt.sample(Duration::milliseconds((int64)100));
+
+        // No queueing delay, slow start continues
+        ackWindow(&cc, rtt);
+        TS_ASSERT_EQUALS(cc.window(), (uint32)(8*MSS));
+        TS_ASSERT(cc.inSlowStart());
+
+        // Delay building up ends slow start
+        for(int i = 0; i < 20; i++)
+            rtt.sample(Duration::milliseconds((int64)150));
+        ackWindow(&cc, rtt);
+        TS_ASSERT(!cc.inSlowStart());
+        uint32 window = cc.window();
+
+        // Holding steady between ALPHA and BETA
+        ackWindow(&cc, rtt);
+        TS_ASSERT_EQUALS(cc.window(), window);
+
+        // With two thirds of the window queued we're above BETA and back off
+        // a segment per round trip
+        for(int i = 0; i < 50; i++)
+            rtt.sample(Duration::milliseconds((int64)300));
+        ackWindow(&cc, rtt);
+        TS_ASSERT_EQUALS(cc.window(), window - MSS);
+        TS_ASSERT(!cc.inSlowStart());
+
+        // Once the queue drains we grow again
+        for(int i = 0; i < 50; i++)
+            rtt.sample(Duration::milliseconds((int64)100));
+        window = cc.window();
+        ackWindow(&cc, rtt);
+        TS_ASSERT_EQUALS(cc.window(), window + MSS);
+    }
+
+    void testNone( void ) {
+        NullCongestionControl cc(MSS);
+        RTTEstimator rtt;
+        uint32 window = cc.window();
+        TS_ASSERT(window >= (uint32)(1 << 20));
+        cc.onTimeout();
+        cc.onLoss();
+        cc.onAck(MSS, rtt);
+        TS_ASSERT_EQUALS(cc.window(), window);
+    }
+};
@@ -0,0 +1,154 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  SSTSegmentSchedulerTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/network/SSTSegmentScheduler.hpp>
+
+using namespace Sirikata;
+
+class SSTSegmentSchedulerTest : public CxxTest::TestSuite
+{
+    typedef SegmentScheduler<int> Scheduler;
+public:
+    void testSingleFlowFIFO( void ) {
+        Scheduler sched(100);
+        TS_ASSERT(sched.empty());
+
+        Time t = Time::null();
+        for(int i = 0; i < 10; i++)
+            sched.push(1, 0, i, 100, t);
+        TS_ASSERT_EQUALS(sched.size(), (uint32)10);
+        TS_ASSERT_EQUALS(sched.size(1), (uint32)10);
+
+        for(int i = 0; i < 10; i++) {
+            // front() is stable until pop()
+            TS_ASSERT_EQUALS(sched.front(), i);
+            TS_ASSERT_EQUALS(sched.front(), i);
+            sched.pop(t);
+        }
+        TS_ASSERT(sched.empty());
+        TS_ASSERT_EQUALS(sched.size(1), (uint32)0);
+    }
+
+    void testEqualPrioritiesInterleave( void ) {
+        Scheduler sched(100);
+        Time t = Time::null();
+
+        // A bulk flow queues up a lot before a second flow shows up. They
+        // should alternate rather than the second waiting for the first.
+        for(int i = 0; i < 20; i++)
+            sched.push(1, 0, 1, 100, t);
+        for(int i = 0; i < 5; i++)
+            sched.push(2, 0, 2, 100, t);
+
+        int seen_2 = 0;
+        for(int i = 0; i < 10; i++) {
+            if (sched.front() == 2) seen_2++;
+            sched.pop(t);
+        }
+        TS_ASSERT_EQUALS(seen_2, 5);
+    }
+
+    void testWeightedShare( void ) {
+        Scheduler sched(100);
+        Time t = Time::null();
+
+        // Priority 1 has twice the weight of priority 0
+        for(int i = 0; i < 300; i++) {
+            sched.push(1, 0, 0, 100, t);
+            sched.push(2, 1, 1, 100, t);
+        }
+
+        int counts[2] = { 0, 0 };
+        for(int i = 0; i < 300; i++) {
+            counts[sched.front()]++;
+            sched.pop(t);
+        }
+        TS_ASSERT_EQUALS(counts[0], 100);
+        TS_ASSERT_EQUALS(counts[1], 200);
+
+        TS_ASSERT_EQUALS(Scheduler::weight(Scheduler::MAX_PRIORITY+5), Scheduler::weight(Scheduler::MAX_PRIORITY));
+        TS_ASSERT_EQUALS(Scheduler::weight(Scheduler::MIN_PRIORITY), (uint32)1);
+        TS_ASSERT_EQUALS(sched.credit(0), (int64)100);
+        TS_ASSERT_EQUALS(sched.credit(-1), (int64)50);
+    }
+
+    void testLowPriorityNotStarved( void ) {
+        Scheduler sched(100);
+        Time t = Time::null();
+
+        sched.push(1, Scheduler::MIN_PRIORITY, -1, 100, t);
+        for(int i = 0; i < 1000; i++)
+            sched.push(2, Scheduler::MAX_PRIORITY, i, 100, t);
+
+        int position = -1;
+        for(int i = 0; i < 1001; i++) {
+            if (sched.front() == -1) position = i;
+            sched.pop(t);
+        }
+        TS_ASSERT(position >= 0);
+        TS_ASSERT(position <= (int)Scheduler::weight(Scheduler::MAX_PRIORITY));
+    }
+
+    void testLargeItemsAccumulateCredit( void ) {
+        // Items bigger than a flow's quantum still get sent once the flow has
+        // saved up enough turns.
+        Scheduler sched(10);
+        Time t = Time::null();
+
+        sched.push(1, 0, 1, 55, t);
+        sched.push(2, 0, 2, 5, t);
+        TS_ASSERT_EQUALS(sched.front(), 2);
+        sched.pop(t);
+        TS_ASSERT_EQUALS(sched.front(), 1);
+        sched.pop(t);
+        TS_ASSERT(sched.empty());
+    }
+
+    void testQueueingDelay( void ) {
+        Scheduler sched(100);
+        Time t = Time::null();
+
+        sched.push(1, 2, 0, 10, t);
+        sched.push(1, 2, 1, 10, t);
+        sched.pop(t + Duration::milliseconds((int64)10));
+        sched.pop(t + Duration::milliseconds((int64)30));
+
+        const Scheduler::DelayStats& stats = sched.queueingDelay(2);
+        TS_ASSERT_EQUALS(stats.count, (uint64)2);
+        TS_ASSERT_EQUALS(stats.max, Duration::milliseconds((int64)30));
+        TS_ASSERT_EQUALS(stats.average(), Duration::milliseconds((int64)20));
+        TS_ASSERT_EQUALS(sched.queueingDelay(0).count, (uint64)0);
+
+        sched.resetQueueingDelay();
+        TS_ASSERT_EQUALS(sched.queueingDelay(2).count, (uint64)0);
+    }
+};
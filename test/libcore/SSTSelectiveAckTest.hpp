@@ -0,0 +1,177 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  SSTSelectiveAckTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cxxtest/TestSuite.h>
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/network/SSTSelectiveAck.hpp>
+
+using namespace Sirikata;
+
+class SSTSelectiveAckTest : public CxxTest::TestSuite
+{
+    enum {
+        Window = 1000,
+        Base = 5000
+    };
+
+    uint8 mBitmap[Window];
+
+    void receive(uint32 begin, uint32 end) {
+        for(uint32 i = begin; i < end; i++)
+            mBitmap[i] = 1;
+    }
+
+public:
+    void setUp() {
+        memset(mBitmap, 0, sizeof(mBitmap));
+    }
+
+    void testInOrder( void ) {
+        receive(0, 300);
+        SelectiveAckBlockList blocks;
+        TS_ASSERT_EQUALS(buildSelectiveAck(mBitmap, 300, Base, 4, &blocks), (uint64)(Base + 300));
+        TS_ASSERT(blocks.empty());
+    }
+
+    void testOutOfOrderBlocks( void ) {
+        // The first segment was lost, later ones arrived with another hole
+        // between them
+        receive(100, 200);
+        receive(300, 350);
+        SelectiveAckBlockList blocks;
+        TS_ASSERT_EQUALS(buildSelectiveAck(mBitmap, 350, Base, 4, &blocks), (uint64)Base);
+        TS_ASSERT_EQUALS(blocks.size(), (size_t)2);
+        if (blocks.size() != 2) return;
+        TS_ASSERT_EQUALS(blocks[0].begin, (uint64)(Base + 100));
+        TS_ASSERT_EQUALS(blocks[0].length, (uint64)100);
+        TS_ASSERT_EQUALS(blocks[1].begin, (uint64)(Base + 300));
+        TS_ASSERT_EQUALS(blocks[1].length, (uint64)50);
+
+        // Once the first hole is filled the cumulative ack moves up to the
+        // second one
+        receive(0, 100);
+        blocks.clear();
+        TS_ASSERT_EQUALS(buildSelectiveAck(mBitmap, 350, Base, 4, &blocks), (uint64)(Base + 200));
+        TS_ASSERT_EQUALS(blocks.size(), (size_t)1);
+        if (blocks.size() != 1) return;
+        TS_ASSERT_EQUALS(blocks[0].begin, (uint64)(Base + 300));
+        TS_ASSERT_EQUALS(blocks[0].length, (uint64)50);
+    }
+
+    void testMaxBlocks( void ) {
+        // Every other 10 bytes received, past a hole at the start
+        for(uint32 i = 10; i < 200; i += 20)
+            receive(i, i + 10);
+        SelectiveAckBlockList blocks;
+        TS_ASSERT_EQUALS(buildSelectiveAck(mBitmap, 200, Base, 4, &blocks), (uint64)Base);
+        TS_ASSERT_EQUALS(blocks.size(), (size_t)4);
+        if (blocks.size() != 4) return;
+        // The lowest blocks are the ones reported
+        for(uint32 i = 0; i < 4; i++) {
+            TS_ASSERT_EQUALS(blocks[i].begin, (uint64)(Base + 10 + 20*i));
+            TS_ASSERT_EQUALS(blocks[i].length, (uint64)10);
+        }
+    }
+
+    void testCovers( void ) {
+        SelectiveAckBlockList blocks;
+        blocks.push_back(SelectiveAckBlock(200, 100));
+        blocks.push_back(SelectiveAckBlock(400, 50));
+
+        TS_ASSERT(selectiveAckCovers(100, blocks, 0, 100));
+        TS_ASSERT(!selectiveAckCovers(100, blocks, 100, 200));
+        TS_ASSERT(selectiveAckCovers(100, blocks, 200, 300));
+        TS_ASSERT(selectiveAckCovers(100, blocks, 400, 450));
+        // Partially received buffers still need to be resent
+        TS_ASSERT(!selectiveAckCovers(100, blocks, 250, 350));
+        TS_ASSERT(!selectiveAckCovers(100, blocks, 400, 500));
+    }
+
+    void testFastRetransmit( void ) {
+        DuplicateAckTracker tracker(3);
+
+        tracker.ack(1000, false);
+        TS_ASSERT_EQUALS(tracker.cumulative(), (uint64)1000);
+        TS_ASSERT(!tracker.shouldRetransmit());
+
+        // Later segments arrive past a hole at 1000
+        tracker.ack(1000, true);
+        tracker.ack(1000, true);
+        TS_ASSERT_EQUALS(tracker.duplicates(), (uint32)2);
+        TS_ASSERT(!tracker.shouldRetransmit());
+        tracker.ack(1000, true);
+        TS_ASSERT(tracker.shouldRetransmit());
+
+        // Only one retransmission per loss, even with more duplicates
+        tracker.retransmitted(5000);
+        TS_ASSERT(tracker.inRecovery());
+        for(int i = 0; i < 5; i++)
+            tracker.ack(1000, true);
+        TS_ASSERT(!tracker.shouldRetransmit());
+
+        // A partial ack doesn't end recovery
+        tracker.ack(3000, true);
+        TS_ASSERT(tracker.inRecovery());
+        for(int i = 0; i < 3; i++)
+            tracker.ack(3000, true);
+        TS_ASSERT(!tracker.shouldRetransmit());
+
+        // Acking everything that was outstanding does, and the next loss
+        // gets its own fast retransmit
+        tracker.ack(5000, false);
+        TS_ASSERT(!tracker.inRecovery());
+        for(int i = 0; i < 3; i++)
+            tracker.ack(5000, true);
+        TS_ASSERT(tracker.shouldRetransmit());
+    }
+
+    void testDuplicatesNeedBlocks( void ) {
+        DuplicateAckTracker tracker(3);
+        tracker.ack(1000, false);
+
+        // Repeated acks without blocks don't indicate a hole
+        for(int i = 0; i < 5; i++)
+            tracker.ack(1000, false);
+        TS_ASSERT_EQUALS(tracker.duplicates(), (uint32)0);
+
+        // Neither do stale acks from before the current cumulative ack
+        for(int i = 0; i < 5; i++)
+            tracker.ack(500, true);
+        TS_ASSERT(!tracker.shouldRetransmit());
+
+        // A timeout forgets about any duplicates seen so far
+        tracker.ack(1000, true);
+        tracker.ack(1000, true);
+        tracker.reset();
+        tracker.ack(1000, true);
+        TS_ASSERT(!tracker.shouldRetransmit());
+    }
+};
@@ -0,0 +1,106 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  SSTSequenceRingTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/network/SSTSequenceRing.hpp>
+
+using namespace Sirikata;
+
+class SSTSequenceRingTest : public CxxTest::TestSuite
+{
+public:
+    void testInsertFindErase( void ) {
+        SequenceRing<int> ring(8);
+        TS_ASSERT(ring.empty());
+        TS_ASSERT(ring.find(1) == NULL);
+
+        for(int i = 1; i <= 5; i++)
+            ring.insert(i, i*10);
+        TS_ASSERT_EQUALS(ring.size(), (uint32)5);
+        TS_ASSERT_EQUALS(*ring.find(3), 30);
+
+        // Replacing keeps the size
+        ring.insert(3, 31);
+        TS_ASSERT_EQUALS(ring.size(), (uint32)5);
+        TS_ASSERT_EQUALS(*ring.find(3), 31);
+
+        // Removal out of order
+        TS_ASSERT(ring.erase(3));
+        TS_ASSERT(!ring.erase(3));
+        TS_ASSERT(ring.find(3) == NULL);
+        TS_ASSERT_EQUALS(ring.size(), (uint32)4);
+
+        // A sequence number aliasing a removed one reuses its slot
+        ring.insert(3 + 8, 110);
+        TS_ASSERT_EQUALS(ring.capacity(), (uint32)8);
+        TS_ASSERT(ring.find(3) == NULL);
+        TS_ASSERT_EQUALS(*ring.find(11), 110);
+
+        ring.clear();
+        TS_ASSERT(ring.empty());
+        TS_ASSERT(ring.find(1) == NULL);
+    }
+
+    void testGrow( void ) {
+        SequenceRing<uint64> ring(4);
+
+        // Leave a hole at the front, as happens when a segment is lost
+        for(uint64 i = 100; i < 104; i++)
+            ring.insert(i, i);
+        ring.erase(101);
+        ring.erase(102);
+
+        // Keep sending well past the capacity; the old segment forces growth
+        for(uint64 i = 104; i < 200; i++) {
+            ring.insert(i, i);
+            ring.erase(i-1);
+        }
+        TS_ASSERT(ring.capacity() >= (uint32)128);
+        TS_ASSERT_EQUALS(ring.size(), (uint32)2);
+        TS_ASSERT_EQUALS(*ring.find(100), (uint64)100);
+        TS_ASSERT_EQUALS(*ring.find(199), (uint64)199);
+        TS_ASSERT(ring.find(150) == NULL);
+    }
+
+    void testSlidingWindow( void ) {
+        // In the common case acks arrive in order and the ring never grows
+        SequenceRing<uint64> ring(16);
+        uint64 next = 1;
+        for(int i = 0; i < 16; i++, next++)
+            ring.insert(next, next);
+        for(uint64 acked = 1; acked < 10000; acked++, next++) {
+            TS_ASSERT(ring.erase(acked));
+            ring.insert(next, next);
+        }
+        TS_ASSERT_EQUALS(ring.capacity(), (uint32)16);
+        TS_ASSERT_EQUALS(ring.size(), (uint32)16);
+    }
+};
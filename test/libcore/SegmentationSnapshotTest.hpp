@@ -0,0 +1,212 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  SegmentationSnapshotTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cxxtest/TestSuite.h>
+#include <sirikata/space/SegmentationSnapshot.hpp>
+#include <sirikata/space/SegmentationLookupCache.hpp>
+#include <sirikata/core/util/Thread.hpp>
+
+using namespace Sirikata;
+
+class SegmentationSnapshotTest : public CxxTest::TestSuite
+{
+    // Splits [0,dim)^3 into unit cubes, numbering servers in x, y, z order
+    static std::vector<SegmentationInfo> grid(int dim) {
+        std::vector<SegmentationInfo> result;
+        for(int x = 0; x < dim; x++) {
+            for(int y = 0; y < dim; y++) {
+                for(int z = 0; z < dim; z++) {
+                    SegmentationInfo info;
+                    info.server = (x*dim + y)*dim + z + 1;
+                    info.region.push_back(BoundingBox3f(Vector3f(x,y,z), Vector3f(x+1,y+1,z+1)));
+                    result.push_back(info);
+                }
+            }
+        }
+        return result;
+    }
+
+public:
+    void testEmpty( void ) {
+        SegmentationSnapshot snapshot;
+        TS_ASSERT_EQUALS(snapshot.numRegions(), (uint32)0);
+        TS_ASSERT_EQUALS(snapshot.lookup(Vector3f(0,0,0)), (ServerID)NullServerID);
+
+        SegmentationSnapshot from_empty( (std::vector<SegmentationInfo>()) );
+        TS_ASSERT_EQUALS(from_empty.lookup(Vector3f(1,2,3)), (ServerID)NullServerID);
+    }
+
+    void testLookupMatchesRegions( void ) {
+        const int dim = 5;
+        SegmentationSnapshot snapshot(grid(dim));
+        TS_ASSERT_EQUALS(snapshot.numRegions(), (uint32)(dim*dim*dim));
+        // Enough regions that we actually built a tree
+        TS_ASSERT(snapshot.numNodes() > 1);
+
+        srand(7);
+        for(int i = 0; i < 10000; i++) {
+            Vector3f pos(
+                (rand() / (float)RAND_MAX) * dim,
+                (rand() / (float)RAND_MAX) * dim,
+                (rand() / (float)RAND_MAX) * dim
+            );
+            ServerID result = snapshot.lookup(pos);
+            TS_ASSERT(result != NullServerID);
+            if (result == NullServerID) continue;
+
+            int idx = result - 1;
+            int x = idx / (dim*dim), y = (idx / dim) % dim, z = idx % dim;
+            BoundingBox3f bbox(Vector3f(x,y,z), Vector3f(x+1,y+1,z+1));
+            TS_ASSERT(bbox.contains(pos));
+        }
+
+        // Outside everything
+        TS_ASSERT_EQUALS(snapshot.lookup(Vector3f(-1,0,0)), (ServerID)NullServerID);
+        TS_ASSERT_EQUALS(snapshot.lookup(Vector3f(0,dim+1,0)), (ServerID)NullServerID);
+    }
+
+    void testIrregularRegions( void ) {
+        // Regions that don't line up with the grid and a server with more
+        // than one region
+        std::vector<SegmentationInfo> seg(2);
+        seg[0].server = 1;
+        seg[0].region.push_back(BoundingBox3f(Vector3f(0,0,0), Vector3f(3.3f,10,10)));
+        seg[0].region.push_back(BoundingBox3f(Vector3f(7.1f,0,0), Vector3f(10,10,10)));
+        seg[1].server = 2;
+        seg[1].region.push_back(BoundingBox3f(Vector3f(3.3f,0,0), Vector3f(7.1f,10,10)));
+        SegmentationSnapshot snapshot(seg);
+
+        TS_ASSERT_EQUALS(snapshot.lookup(Vector3f(1,5,5)), (ServerID)1);
+        TS_ASSERT_EQUALS(snapshot.lookup(Vector3f(3.4f,5,5)), (ServerID)2);
+        TS_ASSERT_EQUALS(snapshot.lookup(Vector3f(7.0f,9,1)), (ServerID)2);
+        TS_ASSERT_EQUALS(snapshot.lookup(Vector3f(9,0,10)), (ServerID)1);
+    }
+
+    void testPublisher( void ) {
+        typedef SegmentationSnapshot::Publisher::Reader Reader;
+
+        SegmentationSnapshot::Publisher publisher;
+        TS_ASSERT_EQUALS(Reader(publisher)->numRegions(), (uint32)0);
+
+        publisher.publish(new SegmentationSnapshot(grid(2)));
+        TS_ASSERT_EQUALS(publisher.numRetired(), (uint32)0);
+        TS_ASSERT_EQUALS(Reader(publisher)->numRegions(), (uint32)8);
+        TS_ASSERT_EQUALS(Reader(publisher)->lookup(Vector3f(1.5f,0.5f,0.5f)), (ServerID)5);
+
+        {
+            // A reader still using the old snapshot keeps it alive across
+            // publishes, but not snapshots published after it started
+            Reader held(publisher);
+            publisher.publish(new SegmentationSnapshot(grid(3)));
+            TS_ASSERT_EQUALS(Reader(publisher)->numRegions(), (uint32)27);
+            publisher.publish(new SegmentationSnapshot(grid(4)));
+            TS_ASSERT_EQUALS(Reader(publisher)->numRegions(), (uint32)64);
+            TS_ASSERT_EQUALS(publisher.numRetired(), (uint32)2);
+            TS_ASSERT_EQUALS(held->numRegions(), (uint32)8);
+            TS_ASSERT_EQUALS(held->lookup(Vector3f(1.5f,0.5f,0.5f)), (ServerID)5);
+
+            // Readers that started later only pin the latest epoch
+            Reader later(publisher);
+            publisher.reclaim();
+            TS_ASSERT_EQUALS(publisher.numRetired(), (uint32)2);
+        }
+        publisher.reclaim();
+        TS_ASSERT_EQUALS(publisher.numRetired(), (uint32)0);
+    }
+
+    void testPublisherConcurrentReaders( void ) {
+        typedef SegmentationSnapshot::Publisher::Reader Reader;
+
+        // Every snapshot maps the probe position to the number of regions
+        // per axis, so a reader seeing a freed or half built snapshot shows
+        // up as a bad lookup.
+        SegmentationSnapshot::Publisher publisher;
+        publisher.publish(new SegmentationSnapshot(uniform(1)));
+
+        volatile bool done = false;
+        AtomicValue<uint32> bad(0);
+        std::vector<Thread*> readers;
+        for(int i = 0; i < 4; i++)
+            readers.push_back(new Thread(std::tr1::bind(&SegmentationSnapshotTest::readSnapshots, &publisher, &done, &bad)));
+
+        for(uint32 i = 0; i < 2000; i++)
+            publisher.publish(new SegmentationSnapshot(uniform(1 + i % 5)));
+
+        done = true;
+        for(uint32 i = 0; i < readers.size(); i++) {
+            readers[i]->join();
+            delete readers[i];
+        }
+        TS_ASSERT_EQUALS(bad.read(), (uint32)0);
+        publisher.reclaim();
+        TS_ASSERT_EQUALS(publisher.numRetired(), (uint32)0);
+    }
+
+    void testLookupCache( void ) {
+        SegmentationLookupCache cache;
+        TS_ASSERT_EQUALS(cache.lookup(Vector3f(0.5f,0.5f,0.5f)), (ServerID)NullServerID);
+
+        // Lookup responses are found before and after they're published
+        cache.addRegion(3, BoundingBox3f(Vector3f(0,0,0), Vector3f(1,1,1)));
+        TS_ASSERT_EQUALS(cache.lookup(Vector3f(0.5f,0.5f,0.5f)), (ServerID)3);
+        cache.service();
+        TS_ASSERT_EQUALS(cache.lookup(Vector3f(0.5f,0.5f,0.5f)), (ServerID)3);
+
+        // Segmentation changes only replace the servers they mention
+        cache.addRegion(4, BoundingBox3f(Vector3f(1,0,0), Vector3f(2,1,1)));
+        std::map<ServerID, BoundingBoxList> changed;
+        changed[3].push_back(BoundingBox3f(Vector3f(0,1,0), Vector3f(1,2,1)));
+        cache.replaceRegions(changed);
+        TS_ASSERT_EQUALS(cache.lookup(Vector3f(0.5f,0.5f,0.5f)), (ServerID)NullServerID);
+        TS_ASSERT_EQUALS(cache.lookup(Vector3f(0.5f,1.5f,0.5f)), (ServerID)3);
+        TS_ASSERT_EQUALS(cache.lookup(Vector3f(1.5f,0.5f,0.5f)), (ServerID)4);
+    }
+
+private:
+    // Splits [0,1)^3 into dim^3 regions, all owned by server dim
+    static std::vector<SegmentationInfo> uniform(int dim) {
+        std::vector<SegmentationInfo> result = grid(dim);
+        for(uint32 i = 0; i < result.size(); i++) {
+            result[i].server = dim;
+            result[i].region[0] = BoundingBox3f(result[i].region[0].min() / (float32)dim, result[i].region[0].max() / (float32)dim);
+        }
+        return result;
+    }
+
+    static void readSnapshots(SegmentationSnapshot::Publisher* publisher, volatile bool* done, AtomicValue<uint32>* bad) {
+        while(!*done) {
+            SegmentationSnapshot::Publisher::Reader snapshot(*publisher);
+            ServerID server = snapshot->lookup(Vector3f(0.3f,0.6f,0.9f));
+            if (server < 1 || server > 5 || snapshot->numRegions() != server*server*server)
+                (*bad)++;
+        }
+    }
+};
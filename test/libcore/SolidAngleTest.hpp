@@ -0,0 +1,131 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  SolidAngleTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_SOLID_ANGLE_TEST_HPP_
+#define _SIRIKATA_SOLID_ANGLE_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <cxxtest/TestSuite.h>
+
+class SolidAngleTest : public CxxTest::TestSuite
+{
+    typedef Sirikata::Vector3<float> Vector3f;
+    typedef Sirikata::SolidAngle SolidAngle;
+    typedef Sirikata::uint32 uint32;
+
+    // Checks visibleBatch against fromCenterRadius for a set of objects.
+    void checkBatch(const SolidAngle& sa, const Vector3f& qpos,
+        const std::vector<float>& xs, const std::vector<float>& ys, const std::vector<float>& zs, const std::vector<float>& rs)
+    {
+        uint32 n = xs.size();
+        std::vector<uint32> mask((n+31)/32 + 1, 0xFFFFFFFF);
+        uint32 nvisible = sa.visibleBatch(qpos, &xs[0], &ys[0], &zs[0], &rs[0], n, &mask[0]);
+
+        uint32 expected_visible = 0;
+        for(uint32 i = 0; i < n; i++) {
+            bool expected = SolidAngle::fromCenterRadius(Vector3f(xs[i], ys[i], zs[i]) - qpos, rs[i]) >= sa;
+            bool got = ((mask[i/32] >> (i%32)) & 1) != 0;
+            TS_ASSERT_EQUALS(got, expected);
+            if (expected) expected_visible++;
+        }
+        TS_ASSERT_EQUALS(nvisible, expected_visible);
+        // Words past the end must not be touched
+        TS_ASSERT_EQUALS(mask.back(), (uint32)0xFFFFFFFF);
+    }
+
+public:
+    // SIRIKATA_SIMD builds should actually get the vector code paths
+    void testSimdFlags( void )
+    {
+#if defined(SIRIKATA_SIMD_AVX2) && !defined(__AVX2__)
+        TS_FAIL("Built with SIRIKATA_SIMD=AVX2 but the compiler isn't targeting AVX2");
+#endif
+#if defined(SIRIKATA_SIMD_SSSE3) && !defined(__SSSE3__)
+        TS_FAIL("Built with SIRIKATA_SIMD=SSSE3 but the compiler isn't targeting SSSE3");
+#endif
+    }
+
+    void testFromCenterRadius( void )
+    {
+        // Inside the object covers everything
+        TS_ASSERT_EQUALS(SolidAngle::fromCenterRadius(Vector3f(0,0,0), 1.f), SolidAngle::Max);
+        // Farther objects subtend smaller angles
+        TS_ASSERT(SolidAngle::fromCenterRadius(Vector3f(10,0,0), 1.f) > SolidAngle::fromCenterRadius(Vector3f(20,0,0), 1.f));
+    }
+
+    void testBatchMatchesScalar( void )
+    {
+        srand(42);
+        // Odd sizes exercise the scalar remainder after the vector loop
+        uint32 sizes[] = { 1, 3, 4, 7, 8, 31, 32, 33, 100 };
+        for(uint32 si = 0; si < sizeof(sizes)/sizeof(sizes[0]); si++) {
+            uint32 n = sizes[si];
+            std::vector<float> xs(n), ys(n), zs(n), rs(n);
+            for(uint32 i = 0; i < n; i++) {
+                xs[i] = (float)(rand() % 200 - 100);
+                ys[i] = (float)(rand() % 200 - 100);
+                zs[i] = (float)(rand() % 200 - 100);
+                rs[i] = (rand() % 100) / 10.f;
+            }
+            checkBatch(SolidAngle::Min, Vector3f(1,2,3), xs, ys, zs, rs);
+            checkBatch(SolidAngle(0.01f), Vector3f(1,2,3), xs, ys, zs, rs);
+            checkBatch(SolidAngle(1.f), Vector3f(-5,0,7), xs, ys, zs, rs);
+            // More than a hemisphere, only containing objects qualify
+            checkBatch(SolidAngle(SolidAngle::Pi * 3.f), Vector3f(0,0,0), xs, ys, zs, rs);
+            checkBatch(SolidAngle::Max, Vector3f(0,0,0), xs, ys, zs, rs);
+        }
+    }
+
+    void testBatchMultipleQueries( void )
+    {
+        float xs[] = { 10.f, 0.f, -50.f, 3.f, 0.f };
+        float ys[] = { 0.f, 10.f, 0.f, 3.f, 0.f };
+        float zs[] = { 0.f, 0.f, 0.f, 3.f, 100.f };
+        float rs[] = { 1.f, 5.f, 1.f, .1f, 2.f };
+        float qx[] = { 0.f, 10.f };
+        float qy[] = { 0.f, 0.f };
+        float qz[] = { 0.f, 0.f };
+        SolidAngle angles[] = { SolidAngle(.1f), SolidAngle(.1f) };
+
+        uint32 mask[2];
+        SolidAngle::visibleBatch(qx, qy, qz, angles, 2, xs, ys, zs, rs, 5, mask);
+        for(uint32 q = 0; q < 2; q++) {
+            uint32 single;
+            angles[q].visibleBatch(Vector3f(qx[q], qy[q], qz[q]), xs, ys, zs, rs, 5, &single);
+            TS_ASSERT_EQUALS(mask[q], single);
+        }
+        // The first object contains the second query
+        TS_ASSERT(mask[1] & 1);
+    }
+};
+
+#endif //_SIRIKATA_SOLID_ANGLE_TEST_HPP_
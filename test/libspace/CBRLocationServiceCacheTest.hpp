@@ -0,0 +1,220 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  CBRLocationServiceCacheTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cxxtest/TestSuite.h>
+#include <sirikata/space/CBRLocationServiceCache.hpp>
+#include <sirikata/core/network/IOServiceFactory.hpp>
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+
+using namespace Sirikata;
+
+class CBRLocationServiceCacheTest : public CxxTest::TestSuite
+{
+    // Records the sequence of notifications the cache delivers to libprox.
+    class RecordingListener : public CBRLocationServiceCache::LocationUpdateListener {
+    public:
+        enum EventType {
+            Connected,
+            Disconnected,
+            Position,
+            Region,
+            MaxSize
+        };
+        struct Event {
+            Event(EventType t, const UUID& o, const Vector3f& p = Vector3f(0,0,0))
+             : type(t), obj(o), pos(p) {}
+            EventType type;
+            UUID obj;
+            Vector3f pos;
+        };
+        std::vector<Event> events;
+        // Objects currently connected, i.e. what a query handler would see
+        std::set<UUID> connected;
+
+        virtual ~RecordingListener() {}
+        virtual void locationConnected(const UUID& uuid, bool local, const TimedMotionVector3f& loc, const BoundingSphere3f& region, float32 ms) {
+            events.push_back(Event(Connected, uuid, loc.position()));
+            connected.insert(uuid);
+        }
+        virtual void locationPositionUpdated(const UUID& uuid, const TimedMotionVector3f& oldval, const TimedMotionVector3f& newval) {
+            events.push_back(Event(Position, uuid, newval.position()));
+        }
+        virtual void locationRegionUpdated(const UUID& uuid, const BoundingSphere3f& oldval, const BoundingSphere3f& newval) {
+            events.push_back(Event(Region, uuid));
+        }
+        virtual void locationMaxSizeUpdated(const UUID& uuid, float32 oldval, float32 newval) {
+            events.push_back(Event(MaxSize, uuid));
+        }
+        virtual void locationDisconnected(const UUID& uuid) {
+            events.push_back(Event(Disconnected, uuid));
+            connected.erase(uuid);
+        }
+        virtual void locationDisconnected(const UUID& uuid, bool temporary) {
+            events.push_back(Event(Disconnected, uuid));
+            connected.erase(uuid);
+        }
+    };
+
+    Network::IOService* mService;
+    Network::IOStrand* mStrand;
+
+    static TimedMotionVector3f at(float32 x) {
+        return TimedMotionVector3f(Time::null(), MotionVector3f(Vector3f(x, 0, 0), Vector3f(0, 0, 0)));
+    }
+
+    void addObject(CBRLocationServiceCache* cache, const UUID& id, const TimedMotionVector3f& loc, bool agg = false) {
+        cache->localObjectAdded(
+            id, agg, loc,
+            TimedMotionQuaternion(Time::null(), MotionQuaternion(Quaternion::identity(), Quaternion::identity())),
+            BoundingSphere3f(Vector3f(0,0,0), 1.f), "", ""
+        );
+    }
+
+    // Run everything the cache has posted to the strand.
+    void runStrand() {
+        mService->reset();
+        mService->poll();
+    }
+
+public:
+    void setUp() {
+        mService = Network::IOServiceFactory::makeIOService();
+        mStrand = mService->createStrand();
+    }
+
+    void tearDown() {
+        delete mStrand;
+        Network::IOServiceFactory::destroyIOService(mService);
+    }
+
+    void testBatchedRemoveAddPositionKeepsOrder() {
+        CBRLocationServiceCache cache(mStrand, NULL, false, true);
+        RecordingListener listener;
+        cache.addUpdateListener(&listener);
+
+        UUID id = UUID::random();
+        addObject(&cache, id, at(0));
+        runStrand();
+        TS_ASSERT_EQUALS(listener.events.size(), (size_t)1);
+        listener.events.clear();
+
+        // All of these land in one batch. The stale position from before the
+        // removal must not be applied to the re-added object, and the final
+        // position must win over the one it was re-added with.
+        cache.localLocationUpdated(id, false, at(1));
+        cache.localObjectRemoved(id, false);
+        addObject(&cache, id, at(5));
+        cache.localLocationUpdated(id, false, at(2));
+        cache.localLocationUpdated(id, false, at(3));
+        runStrand();
+
+        TS_ASSERT(cache.tracking(id) == false);
+        TS_ASSERT_EQUALS(cache.location(id).position(), Vector3f(3, 0, 0));
+
+        TS_ASSERT_EQUALS(listener.events.size(), (size_t)3);
+        if (listener.events.size() != 3) return;
+        TS_ASSERT_EQUALS(listener.events[0].type, RecordingListener::Disconnected);
+        TS_ASSERT_EQUALS(listener.events[1].type, RecordingListener::Connected);
+        TS_ASSERT_EQUALS(listener.events[1].pos, Vector3f(5, 0, 0));
+        TS_ASSERT_EQUALS(listener.events[2].type, RecordingListener::Position);
+        TS_ASSERT_EQUALS(listener.events[2].pos, Vector3f(3, 0, 0));
+
+        cache.removeUpdateListener(&listener);
+    }
+
+    void testBatchedRemoveDropsPendingUpdate() {
+        CBRLocationServiceCache cache(mStrand, NULL, false, true);
+        RecordingListener listener;
+        cache.addUpdateListener(&listener);
+
+        UUID id = UUID::random();
+        addObject(&cache, id, at(0));
+        cache.localLocationUpdated(id, false, at(1));
+        cache.localObjectRemoved(id, false);
+        runStrand();
+
+        TS_ASSERT_EQUALS(listener.events.size(), (size_t)2);
+        if (listener.events.size() != 2) return;
+        TS_ASSERT_EQUALS(listener.events[0].type, RecordingListener::Connected);
+        TS_ASSERT_EQUALS(listener.events[1].type, RecordingListener::Disconnected);
+
+        cache.removeUpdateListener(&listener);
+    }
+
+    void testRebuiltCacheAnnouncesExistingObjects() {
+        CBRLocationServiceCache old_cache(mStrand, NULL, false, false);
+        RecordingListener old_listener;
+        old_cache.addUpdateListener(&old_listener);
+
+        UUID kept = UUID::random(), moved = UUID::random(), agg = UUID::random(), removed = UUID::random();
+        addObject(&old_cache, kept, at(0));
+        addObject(&old_cache, moved, at(1));
+        addObject(&old_cache, agg, at(2), true);
+        addObject(&old_cache, removed, at(3));
+        runStrand();
+        // Still tracked, so the entry sticks around after removal
+        CBRLocationServiceCache::Iterator removed_it = old_cache.startTracking(removed);
+        old_cache.localObjectRemoved(removed, false);
+        runStrand();
+
+        // Same sequence Proximity uses to rebuild query handlers: a paused
+        // cache filled from the old one, with new listeners added afterwards
+        // and updates arriving while it's being built.
+        CBRLocationServiceCache new_cache(mStrand, NULL, false, false);
+        new_cache.pause();
+        new_cache.copyFrom(&old_cache);
+        RecordingListener new_listener;
+        new_cache.addUpdateListener(&new_listener);
+        new_cache.announceObjects();
+
+        TS_ASSERT_EQUALS(new_listener.connected, old_listener.connected);
+        TS_ASSERT(new_listener.connected.find(agg) == new_listener.connected.end());
+        TS_ASSERT(new_listener.connected.find(removed) == new_listener.connected.end());
+
+        UUID added = UUID::random();
+        addObject(&old_cache, added, at(4));
+        addObject(&new_cache, added, at(4));
+        old_cache.localLocationUpdated(moved, false, at(5));
+        new_cache.localLocationUpdated(moved, false, at(5));
+        runStrand();
+        // Nothing applied while paused
+        TS_ASSERT(new_listener.connected.find(added) == new_listener.connected.end());
+
+        new_cache.resume();
+        TS_ASSERT_EQUALS(new_listener.connected, old_listener.connected);
+        TS_ASSERT_EQUALS(new_cache.location(moved).position(), Vector3f(5, 0, 0));
+
+        old_cache.stopTracking(removed_it);
+        new_cache.removeUpdateListener(&new_listener);
+        old_cache.removeUpdateListener(&old_listener);
+    }
+};
@@ -0,0 +1,199 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  OSegCacheTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cxxtest/TestSuite.h>
+#include <sirikata/space/OSegCache.hpp>
+
+using namespace Sirikata;
+
+class OSegCacheTest : public CxxTest::TestSuite
+{
+    // Plain map backed cache with a clock the test controls, so negative
+    // entries and in flight requests can be aged without sleeping.
+    class FakeCache : public OSegCache {
+    public:
+        FakeCache(const Duration& negative_lifetime)
+         : OSegCache(NULL, negative_lifetime),
+           time(Time::null())
+        {}
+
+        virtual void insert(const UUID& uuid, const OSegEntry& sID) {
+            entries[uuid] = sID;
+        }
+        virtual OSegEntry get(const UUID& uuid) {
+            std::map<UUID, OSegEntry>::iterator it = entries.find(uuid);
+            if (it == entries.end()) return OSegEntry::null();
+            return it->second;
+        }
+        virtual void remove(const UUID& uuid) {
+            entries.erase(uuid);
+        }
+
+        std::map<UUID, OSegEntry> entries;
+        Time time;
+
+    protected:
+        virtual Time now() const {
+            return time;
+        }
+    };
+
+    static const Duration lifetime() {
+        return Duration::milliseconds((int64)500);
+    }
+
+public:
+    void testHitsAndMisses() {
+        FakeCache cache(lifetime());
+        UUID present = UUID::random(), absent = UUID::random();
+        cache.insert(present, OSegEntry(3, 1.f));
+
+        bool negative = true;
+        OSegEntry result = cache.lookup(present, &negative);
+        TS_ASSERT_EQUALS(result.server(), (uint32)3);
+        TS_ASSERT(!negative);
+
+        result = cache.lookup(absent, &negative);
+        TS_ASSERT(result.isNull());
+        TS_ASSERT(!negative);
+
+        OSegCache::Stats stats = cache.stats();
+        TS_ASSERT_EQUALS(stats.hits, (uint64)1);
+        TS_ASSERT_EQUALS(stats.misses, (uint64)1);
+        TS_ASSERT_EQUALS(stats.negativeHits, (uint64)0);
+    }
+
+    void testNegativeExpiry() {
+        FakeCache cache(lifetime());
+        UUID missing = UUID::random();
+        cache.insertNegative(missing);
+
+        bool negative = false;
+        cache.time = Time::null() + lifetime() * 0.5;
+        TS_ASSERT(cache.lookup(missing, &negative).isNull());
+        TS_ASSERT(negative);
+
+        // Expired entries fall through to a miss and are dropped
+        cache.time = Time::null() + lifetime();
+        TS_ASSERT(cache.lookup(missing, &negative).isNull());
+        TS_ASSERT(!negative);
+        TS_ASSERT_EQUALS(cache.negativeSize(), (size_t)0);
+
+        OSegCache::Stats stats = cache.stats();
+        TS_ASSERT_EQUALS(stats.negativeHits, (uint64)1);
+        TS_ASSERT_EQUALS(stats.misses, (uint64)1);
+    }
+
+    void testNegativeDisabled() {
+        FakeCache cache(Duration::zero());
+        UUID missing = UUID::random();
+        cache.insertNegative(missing);
+        TS_ASSERT_EQUALS(cache.negativeSize(), (size_t)0);
+
+        bool negative = true;
+        cache.lookup(missing, &negative);
+        TS_ASSERT(!negative);
+    }
+
+    void testRemoveNegative() {
+        FakeCache cache(lifetime());
+        UUID obj = UUID::random();
+        cache.insertNegative(obj);
+        // The object showed up, e.g. it was just added to this server
+        cache.removeNegative(obj);
+
+        bool negative = true;
+        cache.lookup(obj, &negative);
+        TS_ASSERT(!negative);
+        TS_ASSERT_EQUALS(cache.negativeSize(), (size_t)0);
+    }
+
+    void testNegativeSweep() {
+        FakeCache cache(lifetime());
+        // Just under the initial sweep threshold, nothing is swept even
+        // once all of them have expired
+        for(int i = 0; i < 1023; i++)
+            cache.insertNegative(UUID::random());
+        TS_ASSERT_EQUALS(cache.negativeSize(), (size_t)1023);
+
+        // Reaching the threshold sweeps the expired entries, keeping only
+        // the live one
+        cache.time = Time::null() + lifetime() * 2.0;
+        cache.insertNegative(UUID::random());
+        TS_ASSERT_EQUALS(cache.negativeSize(), (size_t)1);
+
+        // With many live entries the threshold grows to twice what survived
+        // the last sweep, so we don't sweep on every insert
+        for(int i = 0; i < 1023; i++)
+            cache.insertNegative(UUID::random());
+        TS_ASSERT_EQUALS(cache.negativeSize(), (size_t)1024);
+        for(int i = 0; i < 1023; i++)
+            cache.insertNegative(UUID::random());
+        TS_ASSERT_EQUALS(cache.negativeSize(), (size_t)2047);
+
+        cache.time = cache.time + lifetime() * 2.0;
+        cache.insertNegative(UUID::random());
+        TS_ASSERT_EQUALS(cache.negativeSize(), (size_t)1);
+    }
+
+    void testBeginLookupCoalesces() {
+        FakeCache cache(lifetime());
+        UUID obj = UUID::random(), other = UUID::random();
+
+        TS_ASSERT(cache.beginLookup(obj));
+        TS_ASSERT(!cache.beginLookup(obj));
+        TS_ASSERT(!cache.beginLookup(obj));
+        // Other objects aren't affected
+        TS_ASSERT(cache.beginLookup(other));
+        TS_ASSERT_EQUALS(cache.stats().coalesced, (uint64)2);
+
+        // Once the request finishes, the next lookup issues a new one
+        cache.finishLookup(obj);
+        TS_ASSERT(cache.beginLookup(obj));
+        TS_ASSERT_EQUALS(cache.stats().coalesced, (uint64)2);
+    }
+
+    void testInFlightTimeoutTakeover() {
+        FakeCache cache(lifetime());
+        UUID obj = UUID::random();
+
+        TS_ASSERT(cache.beginLookup(obj));
+        cache.time = Time::null() + OSegCache::InFlightTimeout * 0.5;
+        TS_ASSERT(!cache.beginLookup(obj));
+
+        // The original request is presumed lost, so the next lookup takes
+        // over and absorbs later ones itself
+        cache.time = Time::null() + OSegCache::InFlightTimeout;
+        TS_ASSERT(cache.beginLookup(obj));
+        TS_ASSERT(!cache.beginLookup(obj));
+        TS_ASSERT_EQUALS(cache.stats().coalesced, (uint64)2);
+    }
+};
@@ -0,0 +1,178 @@
+/*  Sirikata Tests -- Sirikata Test Suite
+ *  ShardedClockProCacheTest.hpp
+ *
+ *  Copyright (c) 2011, Stanford University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cxxtest/TestSuite.h>
+#include <sirikata/space/ShardedClockProCache.hpp>
+
+using namespace Sirikata;
+
+class ShardedClockProCacheTest : public CxxTest::TestSuite
+{
+    // Cache with a clock the test controls
+    class TestCache : public ShardedClockProCache {
+    public:
+        TestCache(uint32 maxSize, uint32 numShards)
+         : ShardedClockProCache(NULL, maxSize, numShards, Duration::seconds(100), Duration::zero()),
+           time(Time::null())
+        {}
+
+        Time time;
+
+    protected:
+        virtual Time now() const {
+            return time;
+        }
+    };
+
+    enum {
+        CAPACITY = 16
+    };
+
+    static void insertNew(TestCache* cache, int count) {
+        for(int i = 0; i < count; i++)
+            cache->insert(UUID::random(), OSegEntry(3, 1.f));
+    }
+
+    static uint32 countResident(TestCache* cache, const std::vector<UUID>& ids) {
+        uint32 result = 0;
+        for(uint32 i = 0; i < ids.size(); i++)
+            if (cache->get(ids[i]).notNull()) result++;
+        return result;
+    }
+
+    // Looks up each object, reinserting the ones that missed as an OSeg
+    // lookup would. Returns the number of misses.
+    static uint32 touch(TestCache* cache, const std::vector<UUID>& ids) {
+        uint32 misses = 0;
+        for(uint32 i = 0; i < ids.size(); i++) {
+            if (cache->get(ids[i]).isNull()) {
+                misses++;
+                cache->insert(ids[i], OSegEntry(2, 1.f));
+            }
+        }
+        return misses;
+    }
+
+    static std::vector<UUID> randomIDs(int count) {
+        std::vector<UUID> result;
+        for(int i = 0; i < count; i++)
+            result.push_back(UUID::random());
+        return result;
+    }
+
+public:
+    void testCapacityBound() {
+        for(uint32 shards = 1; shards <= 4; shards *= 2) {
+            TestCache cache(CAPACITY*4, shards);
+            std::vector<UUID> ids = randomIDs(CAPACITY*40);
+            for(uint32 i = 0; i < ids.size(); i++)
+                cache.insert(ids[i], OSegEntry(1, 1.f));
+
+            uint32 resident = countResident(&cache, ids);
+            TS_ASSERT(resident <= CAPACITY*4);
+            TS_ASSERT(resident > 0);
+            // The newest entry is always kept
+            TS_ASSERT(cache.get(ids.back()).notNull());
+        }
+    }
+
+    void testInsertAndRemove() {
+        TestCache cache(CAPACITY, 1);
+        UUID obj = UUID::random();
+        cache.insert(obj, OSegEntry(5, 2.f));
+        TS_ASSERT_EQUALS(cache.get(obj).server(), (uint32)5);
+
+        cache.insert(obj, OSegEntry(6, 2.f));
+        TS_ASSERT_EQUALS(cache.get(obj).server(), (uint32)6);
+
+        cache.remove(obj);
+        TS_ASSERT(cache.get(obj).isNull());
+    }
+
+    void testEntryLifetime() {
+        TestCache cache(CAPACITY, 1);
+        UUID obj = UUID::random();
+        cache.insert(obj, OSegEntry(5, 2.f));
+        cache.time = Time::null() + Duration::seconds(50);
+        TS_ASSERT(cache.get(obj).notNull());
+        cache.time = Time::null() + Duration::seconds(101);
+        TS_ASSERT(cache.get(obj).isNull());
+    }
+
+    void testScanResistance() {
+        // Entries which are looked up get promoted to hot instead of being
+        // evicted, so a long run of one-off entries doesn't flush them
+        TestCache cache(CAPACITY, 1);
+        std::vector<UUID> working = randomIDs(CAPACITY/2);
+        for(int round = 0; round < 20; round++) {
+            TS_ASSERT_EQUALS(touch(&cache, working), (uint32)(round == 0 ? working.size() : 0));
+            insertNew(&cache, 4);
+        }
+        insertNew(&cache, CAPACITY*4);
+        TS_ASSERT_EQUALS(countResident(&cache, working), (uint32)working.size());
+    }
+
+    void testTestPagePromotion() {
+        // An entry re-inserted while it is a non-resident test page comes back
+        // hot and survives a scan which flushes a fresh cold entry
+        TestCache cache(CAPACITY, 1);
+        UUID obj = UUID::random();
+        cache.insert(obj, OSegEntry(1, 1.f));
+        insertNew(&cache, CAPACITY);
+        TS_ASSERT(cache.get(obj).isNull());
+
+        cache.insert(obj, OSegEntry(1, 1.f));
+        UUID fresh = UUID::random();
+        cache.insert(fresh, OSegEntry(1, 1.f));
+        insertNew(&cache, CAPACITY*4);
+        TS_ASSERT(cache.get(obj).notNull());
+        TS_ASSERT(cache.get(fresh).isNull());
+    }
+
+    void testDemotion() {
+        // When the working set moves, the old hot entries get demoted and
+        // evicted to make room for the new one
+        TestCache cache(CAPACITY, 1);
+        std::vector<UUID> old_set = randomIDs(CAPACITY/2);
+        std::vector<UUID> new_set = randomIDs(CAPACITY*3/4);
+        for(int round = 0; round < 20; round++) {
+            touch(&cache, old_set);
+            insertNew(&cache, 4);
+        }
+
+        uint32 misses = 0;
+        for(int round = 0; round < 40; round++)
+            misses = touch(&cache, new_set);
+        TS_ASSERT_EQUALS(misses, (uint32)0);
+        TS_ASSERT_EQUALS(countResident(&cache, new_set), (uint32)new_set.size());
+        TS_ASSERT(countResident(&cache, old_set) <= CAPACITY - new_set.size());
+    }
+};